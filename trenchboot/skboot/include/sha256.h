@@ -0,0 +1,15 @@
+#ifndef __SHA256_H__
+#define __SHA256_H__
+
+typedef struct {
+    u64 length;
+    u32 state[8], curlen;
+    unsigned char buf[64];
+} sha256_state;
+
+void sha256_init(sha256_state *md);
+int sha256_process(sha256_state *md, const unsigned char *in,
+                   unsigned long inlen);
+int sha256_done(sha256_state *md, unsigned char *out);
+
+#endif /* __SHA256_H__ */
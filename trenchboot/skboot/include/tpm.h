@@ -167,6 +167,10 @@ typedef struct {
     hash_entry_t entries[MAX_ALG_NUM];
 } hash_list_t;
 
+extern bool hash_buffer_multi(const unsigned char *buf, size_t size,
+                              const uint16_t *algs, unsigned int count,
+                              hash_list_t *hl);
+
 
 // move from tpm.c
 
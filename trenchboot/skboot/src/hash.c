@@ -0,0 +1,115 @@
+/*
+ * hash.c: single pass hashing of a buffer into several digests
+ *
+ * Copyright (c) 2006-2012, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <types.h>
+#include <stdbool.h>
+#include <skboot.h>
+#include <printk.h>
+#include <processor.h>
+#include <string.h>
+#include <sha1.h>
+#include <sha256.h>
+#include <tpm.h>
+
+/* same chunk size as slboot/common/hash.c */
+#define HASH_MULTI_CHUNK    0x2000
+
+typedef union {
+    struct sha1_ctxt sha1;
+    sha256_state     sha256;
+} hash_ctx_t;
+
+/*
+ * hash_buffer_multi
+ *
+ * cut down copy of slboot's hash_buffer_multi, for the SHA1 and SHA256
+ * implementations skboot carries.
+ */
+bool hash_buffer_multi(const unsigned char *buf, size_t size,
+                       const uint16_t *algs, unsigned int count,
+                       hash_list_t *hl)
+{
+    hash_ctx_t ctx[MAX_ALG_NUM];
+    size_t off, chunk;
+    unsigned int i;
+
+    if ( hl == NULL || algs == NULL || count > MAX_ALG_NUM )
+        return false;
+
+    for ( i = 0; i < count; i++ ) {
+        if ( algs[i] == HASH_ALG_SHA1 )
+            sha1_init(&ctx[i].sha1);
+        else if ( algs[i] == HASH_ALG_SHA256 )
+            sha256_init(&ctx[i].sha256);
+        else {
+            printk(SKBOOT_ERR"unsupported hash alg (%u)\n", algs[i]);
+            return false;
+        }
+    }
+
+    for ( off = 0; off < size; off += chunk ) {
+        chunk = size - off;
+        if ( chunk > HASH_MULTI_CHUNK )
+            chunk = HASH_MULTI_CHUNK;
+
+        for ( i = 0; i < count; i++ ) {
+            if ( algs[i] == HASH_ALG_SHA1 )
+                sha1_loop(&ctx[i].sha1, buf + off, chunk);
+            else
+                sha256_process(&ctx[i].sha256, buf + off, chunk);
+        }
+    }
+
+    for ( i = 0; i < count; i++ ) {
+        hl->entries[i].alg = algs[i];
+        if ( algs[i] == HASH_ALG_SHA1 )
+            sha1_result(&ctx[i].sha1, hl->entries[i].hash.sha1);
+        else
+            sha256_done(&ctx[i].sha256, hl->entries[i].hash.sha256);
+    }
+    hl->count = count;
+
+    return true;
+}
+
+/*
+ * Local variables:
+ * mode: C
+ * c-set-style: "BSD"
+ * c-basic-offset: 4
+ * tab-width: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
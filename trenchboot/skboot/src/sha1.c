@@ -44,33 +44,7 @@
 #include <types.h>
 #include <skboot.h>
 #include <string.h>
-
-struct sha1_ctxt {
-    union {
-        uint8_t b8[20];
-        uint32_t b32[5];
-    } h;
-    union {
-        uint8_t b8[8];
-        uint64_t b64[1];
-    } c;
-    union {
-        uint8_t b8[64];
-        uint32_t b32[16];
-    } m;
-    uint8_t count;
-};
-
-static void sha1_init(struct sha1_ctxt *);
-static void sha1_pad(struct sha1_ctxt *);
-static void sha1_loop(struct sha1_ctxt *, const uint8_t *, size_t);
-static void sha1_result(struct sha1_ctxt *, unsigned char *);
-
-/* compatibilty with other SHA1 source codes */
-typedef struct sha1_ctxt SHA_CTX;
-#define SHA1_Init(x)		sha1_init((x))
-#define SHA1_Update(x, y, z)	sha1_loop((x), (y), (z))
-#define SHA1_Final(x, y)	sha1_result((y), (x))
+#include <sha1.h>
 
 #define BIG_ENDIAN \
     (!(__x86_64__ || __i386__ || _M_IX86 || _M_X64 || __ARMEL__ || __MIPSEL__))
@@ -186,7 +160,7 @@ static void sha1_step(struct sha1_ctxt *ctxt)
 
 /*------------------------------------------------------------*/
 
-static void sha1_init(struct sha1_ctxt *ctxt)
+void sha1_init(struct sha1_ctxt *ctxt)
 {
     sk_memset(ctxt,0, sizeof(struct sha1_ctxt));
     H(0) = 0x67452301;
@@ -196,7 +170,7 @@ static void sha1_init(struct sha1_ctxt *ctxt)
     H(4) = 0xc3d2e1f0;
 }
 
-static void sha1_pad(struct sha1_ctxt *ctxt)
+void sha1_pad(struct sha1_ctxt *ctxt)
 {
     size_t padlen;    /*pad length in bytes*/
     size_t padstart;
@@ -229,7 +203,7 @@ static void sha1_pad(struct sha1_ctxt *ctxt)
 #endif
 }
 
-static void sha1_loop(struct sha1_ctxt *ctxt,const uint8_t *input,size_t len)
+void sha1_loop(struct sha1_ctxt *ctxt,const uint8_t *input,size_t len)
 {
     size_t gaplen;
     size_t gapstart;
@@ -253,7 +227,7 @@ static void sha1_loop(struct sha1_ctxt *ctxt,const uint8_t *input,size_t len)
     }
 }
 
-static void sha1_result(struct sha1_ctxt *ctxt,unsigned char *digest0)
+void sha1_result(struct sha1_ctxt *ctxt,unsigned char *digest0)
 {
     uint8_t *digest;
     digest = (uint8_t *)digest0;
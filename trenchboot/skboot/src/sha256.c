@@ -2,6 +2,7 @@
 #include <stdbool.h>
 #include <skboot.h>
 #include <string.h>
+#include <sha256.h>
 
 #define STORE64H(x, y)                                                                   \
    { (y)[0] = (unsigned char)(((x)>>56)&255); (y)[1] = (unsigned char)(((x)>>48)&255);   \
@@ -19,12 +20,6 @@
            ((unsigned long)((y)[2] & 255)<<8)  | \
            ((unsigned long)((y)[3] & 255)); }
 
-typedef struct {
-    u64 length;
-    u32 state[8], curlen;
-    unsigned char buf[64];
-} sha256_state;
-
 /* Various logical functions */
 #define RORc(x, y)      ( ((((unsigned long)(x)&0xFFFFFFFFUL)>>(unsigned long)((y)&31)) \
                             | ((unsigned long)(x)<<(unsigned long)(32-((y)&31)))) \
@@ -142,7 +137,7 @@ static int sha256_compress(sha256_state * md, unsigned char *buf)
 
 #define SHA256_BLOCK_SIZE   64
 #define MIN(x, y) ( ((x)<(y))?(x):(y) )
-static int sha256_process(sha256_state * md, const unsigned char *in, unsigned long inlen)
+int sha256_process(sha256_state * md, const unsigned char *in, unsigned long inlen)
 {
     unsigned long n;
     int           err;
@@ -183,7 +178,7 @@ static int sha256_process(sha256_state * md, const unsigned char *in, unsigned l
    @param md   The hash state you wish to initialize
    @return CRYPT_OK if successful
 */
-static void sha256_init(sha256_state * md)
+void sha256_init(sha256_state * md)
 {
     if (md == NULL)
         return;
@@ -206,7 +201,7 @@ static void sha256_init(sha256_state * md)
    @param out [out] The destination of the hash (32 bytes)
    @return 0 if successful
 */
-static int sha256_done(sha256_state * md, unsigned char *out)
+int sha256_done(sha256_state * md, unsigned char *out)
 {
     int i;
 
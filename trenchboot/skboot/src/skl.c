@@ -8,8 +8,10 @@
 #include <processor.h>
 #include <loader.h>
 #include <e820.h>
+#include <misc.h>
 #include <linux.h>
 #include <skl.h>
+#include <tpm.h>
 
 skl_info_t skl_info = {
 	.uuid = {
@@ -112,6 +114,9 @@ static uint32_t add_iommu_info_tag(skl_tag_hdr_t *ntag)
            E42C_ENTRIES*sizeof(skl_ivhd_entry_t);
 }
 
+/* the order the hash tags are laid out in */
+static const uint16_t skl_hash_algs[] = { HASH_ALG_SHA256, HASH_ALG_SHA1 };
+
 bool prepare_skl_bootloader_data(void)
 {
     skl_tag_tags_size_t *stag;
@@ -120,7 +125,7 @@ bool prepare_skl_bootloader_data(void)
     skl_tag_evtlog_t *ltag;
     skl_tag_setup_indirect_t *itag;
     skl_tag_hdr_t *etag;
-    sk_hash_t hash;
+    hash_list_t hl;
     uint32_t iommu_size;
 
     /* Size tag is always first */
@@ -130,16 +135,20 @@ bool prepare_skl_bootloader_data(void)
     stag->size = sizeof(skl_tag_tags_size_t);
     printk(SKBOOT_INFO"SKL added size tag\n");
 
-    /* Hash tags for measured part of SKL */
+    /* Hash tags for measured part of SKL, both banks in one pass */
+    if (!hash_buffer_multi((u8 *)g_skl_module,
+                           g_skl_module->skl_info_offset,
+                           skl_hash_algs, ARRAY_SIZE(skl_hash_algs), &hl)) {
+        printk(SKBOOT_ERR"SKL failed to hash measured region\n");
+        return false;
+    }
+
     htag = (skl_tag_hash_t *)((u8 *)stag + sizeof(skl_tag_tags_size_t));
     htag->hdr.type = SKL_TAG_SKL_HASH;
     htag->hdr.len = sizeof(skl_tag_hash_t) + SHA256_LENGTH;
     htag->algo_id = HASH_ALG_SHA256;
-    sha256_buffer((u8 *)g_skl_module,
-                  g_skl_module->skl_info_offset,
-                  hash.sha256);
     sk_memcpy((u8 *)htag + sizeof(skl_tag_hash_t),
-              &hash.sha256[0], SHA256_LENGTH);
+              &hl.entries[0].hash.sha256[0], SHA256_LENGTH);
     stag->size += htag->hdr.len;
     printk(SKBOOT_INFO"SKL added hash tag for SHA256\n");
 
@@ -147,11 +156,8 @@ bool prepare_skl_bootloader_data(void)
     htag->hdr.type = SKL_TAG_SKL_HASH;
     htag->hdr.len = sizeof(skl_tag_hash_t) + SHA1_LENGTH;
     htag->algo_id = HASH_ALG_SHA1;
-    sha1_buffer((u8 *)g_skl_module,
-                g_skl_module->skl_info_offset,
-                hash.sha1);
     sk_memcpy((u8 *)htag + sizeof(skl_tag_hash_t),
-              &hash.sha1[0], SHA1_LENGTH);
+              &hl.entries[1].hash.sha1[0], SHA1_LENGTH);
     stag->size += htag->hdr.len;
     printk(SKBOOT_INFO"SKL added hash tag for SHA1\n");
 
@@ -0,0 +1,20 @@
+/*
+ * Copyright (c) 2019 Apertus Solutions, LLC
+ *
+ * Author(s):
+ *      Daniel P. Smith <dpsmith@apertussolutions.com>
+ *
+ * Host stand-in for slboot's string.h, mapping the tb_ helpers the
+ * digests use onto the C library.
+ */
+
+#ifndef __BENCH_STRING_H__
+#define __BENCH_STRING_H__
+
+#include_next <string.h>
+
+#define tb_memcpy	memcpy
+#define tb_memset	memset
+#define tb_memcmp	memcmp
+
+#endif
@@ -0,0 +1,271 @@
+/*
+ * Copyright (c) 2019 Apertus Solutions, LLC
+ *
+ * Author(s):
+ *      Daniel P. Smith <dpsmith@apertussolutions.com>
+ *
+ * Run slboot's SHA-384, SHA-512 and SM3 on the host: check each against
+ * the published known answers, one shot and fed in odd sized pieces, then
+ * time it over a fixed buffer. Prints a YAML report with the rate of each
+ * digest and exits non-zero if any known answer is wrong.
+ */
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <types.h>
+#include <sha256.h>
+#include <sha512.h>
+#include <sm3.h>
+
+#define MAX_DIGEST	64
+/* small and prime, so pieces straddle the block boundaries */
+#define PIECE		7
+
+enum alg {
+	SHA384,
+	SHA512,
+	SM3,
+	ALGS
+};
+
+static const struct {
+	const char *name;
+	size_t size;
+} algs[ALGS] = {
+	[SHA384] = { "sha384", 48 },
+	[SHA512] = { "sha512", 64 },
+	[SM3] = { "sm3_256", 32 },
+};
+
+/* FIPS 180-4 examples and GB/T 32905-2016 appendix A, msg repeat times */
+static const struct {
+	enum alg alg;
+	const char *msg;
+	size_t repeat;
+	const char *digest;
+} kats[] = {
+	{ SHA384, "", 1,
+	  "38b060a751ac96384cd9327eb1b1e36a21fdb71114be0743"
+	  "4c0cc7bf63f6e1da274edebfe76f65fbd51ad2f14898b95b" },
+	{ SHA384, "abc", 1,
+	  "cb00753f45a35e8bb5a03d699ac65007272c32ab0eded163"
+	  "1a8b605a43ff5bed8086072ba1e7cc2358baeca134c825a7" },
+	{ SHA384, "abcdefghbcdefghicdefghijdefghijkefghijklfghijklmghijklmn"
+		  "hijklmnoijklmnopjklmnopqklmnopqrlmnopqrsmnopqrstnopqrstu", 1,
+	  "09330c33f71147e83d192fc782cd1b4753111b173b3b05d2"
+	  "2fa08086e3b0f712fcc7c71a557e2db966c3e9fa91746039" },
+	{ SHA384, "a", 1000000,
+	  "9d0e1809716474cb086e834e310a4a1ced149e9c00f24852"
+	  "7972cec5704c2a5b07b8b3dc38ecc4ebae97ddd87f3d8985" },
+	{ SHA512, "", 1,
+	  "cf83e1357eefb8bdf1542850d66d8007d620e4050b5715dc83f4a921d36ce9ce"
+	  "47d0d13c5d85f2b0ff8318d2877eec2f63b931bd47417a81a538327af927da3e" },
+	{ SHA512, "abc", 1,
+	  "ddaf35a193617abacc417349ae20413112e6fa4e89a97ea20a9eeee64b55d39a"
+	  "2192992a274fc1a836ba3c23a3feebbd454d4423643ce80e2a9ac94fa54ca49f" },
+	{ SHA512, "abcdefghbcdefghicdefghijdefghijkefghijklfghijklmghijklmn"
+		  "hijklmnoijklmnopjklmnopqklmnopqrlmnopqrsmnopqrstnopqrstu", 1,
+	  "8e959b75dae313da8cf4f72814fc143f8f7779c6eb9f7fa17299aeadb6889018"
+	  "501d289e4900f7e4331b99dec4b5433ac7d329eeb6dd26545e96e55b874be909" },
+	{ SHA512, "a", 1000000,
+	  "e718483d0ce769644e2e42c7bc15b4638e1f98b13b2044285632a803afa973eb"
+	  "de0ff244877ea60a4cb0432ce577c31beb009c5c2c49aa2e4eadb217ad8cc09b" },
+	{ SM3, "", 1,
+	  "1ab21d8355cfa17f8e61194831e81a8f22bec8c728fefb747ed035eb5082aa2b" },
+	{ SM3, "abc", 1,
+	  "66c7f0f462eeedd9d1f2d46bdc10e4e24167c4875cf2f7a2297da02b8f4ba8e0" },
+	{ SM3, "abcd", 16,
+	  "debe9ff92275b8a138604889c18e5a4d6fdb70e5387e5765293dcba39c0c5732" },
+	{ SM3, "a", 1000000,
+	  "c8aaf89429554029e231941a2acc0ad61ff2a5acd8fadd25847a3a732b3b02c3" },
+};
+
+static u64 host_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (u64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void digest(enum alg alg, const u8 *buf, size_t len, u8 *out)
+{
+	switch (alg) {
+	case SHA384:
+		sha384_buffer(buf, len, out);
+		break;
+	case SHA512:
+		sha512_buffer(buf, len, out);
+		break;
+	default:
+		sm3_buffer(buf, len, out);
+		break;
+	}
+}
+
+/* the same digest through init, process and done, PIECE bytes at a time */
+static void digest_pieces(enum alg alg, const u8 *buf, size_t len, u8 *out)
+{
+	u8 full[MAX_DIGEST];
+	sha512_state sha;
+	sm3_state sm3;
+	size_t n;
+
+	if (alg == SM3)
+		sm3_init(&sm3);
+	else if (alg == SHA384)
+		sha384_init(&sha);
+	else
+		sha512_init(&sha);
+
+	for (; len; buf += n, len -= n) {
+		n = len < PIECE ? len : PIECE;
+		if (alg == SM3)
+			sm3_process(&sm3, buf, n);
+		else
+			sha512_process(&sha, buf, n);
+	}
+
+	if (alg == SM3) {
+		sm3_done(&sm3, out);
+		return;
+	}
+
+	/* SHA-384 is the first 48 bytes of the SHA-512 output */
+	sha512_done(&sha, full);
+	memcpy(out, full, algs[alg].size);
+}
+
+static void hex(const u8 *d, size_t size, char *out)
+{
+	size_t i;
+
+	for (i = 0; i < size; i++)
+		sprintf(out + 2 * i, "%02x", d[i]);
+}
+
+static unsigned run_kats(void)
+{
+	char got[2 * MAX_DIGEST + 1];
+	u8 d[MAX_DIGEST];
+	unsigned failures = 0;
+	size_t i, j, len;
+	u8 *msg;
+
+	printf("kat:\n");
+	for (i = 0; i < sizeof(kats) / sizeof(kats[0]); i++) {
+		len = strlen(kats[i].msg) * kats[i].repeat;
+		msg = malloc(len ? len : 1);
+		for (j = 0; j < kats[i].repeat; j++)
+			memcpy(msg + j * strlen(kats[i].msg), kats[i].msg,
+			       strlen(kats[i].msg));
+
+		digest(kats[i].alg, msg, len, d);
+		hex(d, algs[kats[i].alg].size, got);
+		if (strcmp(got, kats[i].digest)) {
+			fprintf(stderr, "%s of %zu bytes: %s\n",
+				algs[kats[i].alg].name, len, got);
+			failures++;
+		}
+
+		digest_pieces(kats[i].alg, msg, len, d);
+		hex(d, algs[kats[i].alg].size, got);
+		if (strcmp(got, kats[i].digest)) {
+			fprintf(stderr, "%s of %zu bytes in pieces: %s\n",
+				algs[kats[i].alg].name, len, got);
+			failures++;
+		}
+
+		free(msg);
+	}
+
+	printf("  vectors: %zu\n"
+	       "  failures: %u\n",
+	       sizeof(kats) / sizeof(kats[0]), failures);
+
+	return failures;
+}
+
+static void run_bench(size_t size, unsigned n)
+{
+	u8 *buf = malloc(size ? size : 1);
+	u8 d[MAX_DIGEST];
+	unsigned i;
+	size_t j;
+	u64 ns;
+	int a;
+
+	for (j = 0; j < size; j++)
+		buf[j] = j * 131 + 7;
+
+	printf("bench:\n"
+	       "  size: %zu\n"
+	       "  count: %u\n"
+	       "  results:\n", size, n);
+
+	for (a = 0; a < ALGS; a++) {
+		ns = host_ns();
+		for (i = 0; i < n; i++) {
+			buf[0] = i;
+			digest(a, buf, size, d);
+		}
+		ns = host_ns() - ns;
+
+		/* bytes per ns times 1000 is MB/s */
+		printf("    - alg: %s\n"
+		       "      ns/op: %.0f\n"
+		       "      mb/s: %.1f\n",
+		       algs[a].name, n ? (double)ns / n : 0.0,
+		       ns ? (double)size * n * 1000 / ns : 0.0);
+	}
+
+	free(buf);
+}
+
+static void usage(void)
+{
+	printf("Usage: sha_bench [options]\n"
+	       "  -s, --size N    bytes per digest (default 1048576)\n"
+	       "  -n, --count N   digests per algorithm (default 64)\n");
+}
+
+int main(int argc, char *argv[])
+{
+	static const struct option long_options[] = {
+		{ "size",  required_argument, NULL, 's' },
+		{ "count", required_argument, NULL, 'n' },
+		{ "help",  no_argument,       NULL, 'h' },
+		{ NULL,    0,                 NULL, 0   },
+	};
+	size_t size = 1048576;
+	unsigned n = 64, failures;
+	int c;
+
+	while ((c = getopt_long(argc, argv, "s:n:h", long_options,
+				NULL)) != -1) {
+		switch (c) {
+		case 's':
+			size = strtoul(optarg, NULL, 0);
+			break;
+		case 'n':
+			n = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			usage();
+			return 1;
+		}
+	}
+
+	printf("---\n");
+	failures = run_kats();
+	if (!failures)
+		run_bench(size, n);
+
+	printf("result: %s\n", failures ? "fail" : "pass");
+
+	return failures ? 1 : 0;
+}
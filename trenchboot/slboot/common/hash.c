@@ -42,8 +42,258 @@
 #include <misc.h>
 #include <sha1.h>
 #include <sha256.h>
+#include <sha512.h>
+#include <sm3.h>
+#include <sha_x86.h>
+#include <processor.h>
 #include <hash.h>
 
+/*
+ * Known answers for the self tests: the FIPS 180 one and two block
+ * messages, plus 300 bytes of 0x00..0xff.. to run a multi-block call
+ * and a padded tail block through each implementation.
+ */
+#define KAT_LONG_LEN    300
+
+static const char kat_abc[] = "abc";
+static const char kat_2blk[] =
+    "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+
+static const struct {
+    uint16_t alg;
+    uint8_t digest[3][SHA512_LENGTH];
+} hash_kats[] = {
+    { TB_HALG_SHA1, {
+        { 0xa9, 0x99, 0x3e, 0x36, 0x47, 0x06, 0x81, 0x6a,
+          0xba, 0x3e, 0x25, 0x71, 0x78, 0x50, 0xc2, 0x6c,
+          0x9c, 0xd0, 0xd8, 0x9d },
+        { 0x84, 0x98, 0x3e, 0x44, 0x1c, 0x3b, 0xd2, 0x6e,
+          0xba, 0xae, 0x4a, 0xa1, 0xf9, 0x51, 0x29, 0xe5,
+          0xe5, 0x46, 0x70, 0xf1 },
+        { 0xbf, 0x77, 0xec, 0xf1, 0x43, 0xce, 0xb2, 0x1f,
+          0x16, 0x76, 0xc3, 0x4b, 0x8d, 0x89, 0xc8, 0xbb,
+          0x3c, 0x43, 0xcc, 0x4e },
+    } },
+    { TB_HALG_SHA256, {
+        { 0xba, 0x78, 0x16, 0xbf, 0x8f, 0x01, 0xcf, 0xea,
+          0x41, 0x41, 0x40, 0xde, 0x5d, 0xae, 0x22, 0x23,
+          0xb0, 0x03, 0x61, 0xa3, 0x96, 0x17, 0x7a, 0x9c,
+          0xb4, 0x10, 0xff, 0x61, 0xf2, 0x00, 0x15, 0xad },
+        { 0x24, 0x8d, 0x6a, 0x61, 0xd2, 0x06, 0x38, 0xb8,
+          0xe5, 0xc0, 0x26, 0x93, 0x0c, 0x3e, 0x60, 0x39,
+          0xa3, 0x3c, 0xe4, 0x59, 0x64, 0xff, 0x21, 0x67,
+          0xf6, 0xec, 0xed, 0xd4, 0x19, 0xdb, 0x06, 0xc1 },
+        { 0x77, 0x28, 0xae, 0x2f, 0x2c, 0x36, 0xe2, 0xaa,
+          0xaf, 0xbe, 0x79, 0xca, 0x14, 0xc8, 0x7a, 0xe2,
+          0xf8, 0x9e, 0x7c, 0x88, 0xc4, 0x39, 0x0e, 0xcb,
+          0xbf, 0x82, 0xdc, 0xe8, 0x87, 0x06, 0x95, 0x8d },
+    } },
+    { TB_HALG_SHA384, {
+        { 0xcb, 0x00, 0x75, 0x3f, 0x45, 0xa3, 0x5e, 0x8b,
+          0xb5, 0xa0, 0x3d, 0x69, 0x9a, 0xc6, 0x50, 0x07,
+          0x27, 0x2c, 0x32, 0xab, 0x0e, 0xde, 0xd1, 0x63,
+          0x1a, 0x8b, 0x60, 0x5a, 0x43, 0xff, 0x5b, 0xed,
+          0x80, 0x86, 0x07, 0x2b, 0xa1, 0xe7, 0xcc, 0x23,
+          0x58, 0xba, 0xec, 0xa1, 0x34, 0xc8, 0x25, 0xa7 },
+        { 0x33, 0x91, 0xfd, 0xdd, 0xfc, 0x8d, 0xc7, 0x39,
+          0x37, 0x07, 0xa6, 0x5b, 0x1b, 0x47, 0x09, 0x39,
+          0x7c, 0xf8, 0xb1, 0xd1, 0x62, 0xaf, 0x05, 0xab,
+          0xfe, 0x8f, 0x45, 0x0d, 0xe5, 0xf3, 0x6b, 0xc6,
+          0xb0, 0x45, 0x5a, 0x85, 0x20, 0xbc, 0x4e, 0x6f,
+          0x5f, 0xe9, 0x5b, 0x1f, 0xe3, 0xc8, 0x45, 0x2b },
+        { 0x69, 0x67, 0x2a, 0xca, 0x50, 0xc4, 0x27, 0x9e,
+          0x4c, 0xdf, 0x78, 0x83, 0x80, 0x29, 0x4d, 0x76,
+          0x55, 0xbc, 0x68, 0xc7, 0x94, 0x9e, 0x27, 0x33,
+          0x18, 0xd6, 0x08, 0x17, 0xf3, 0x26, 0x2c, 0xff,
+          0x54, 0xe8, 0xc7, 0x8c, 0xea, 0xae, 0x08, 0x53,
+          0xe0, 0xa7, 0xad, 0xf3, 0x6f, 0x39, 0x2d, 0x38 },
+    } },
+    { TB_HALG_SHA512, {
+        { 0xdd, 0xaf, 0x35, 0xa1, 0x93, 0x61, 0x7a, 0xba,
+          0xcc, 0x41, 0x73, 0x49, 0xae, 0x20, 0x41, 0x31,
+          0x12, 0xe6, 0xfa, 0x4e, 0x89, 0xa9, 0x7e, 0xa2,
+          0x0a, 0x9e, 0xee, 0xe6, 0x4b, 0x55, 0xd3, 0x9a,
+          0x21, 0x92, 0x99, 0x2a, 0x27, 0x4f, 0xc1, 0xa8,
+          0x36, 0xba, 0x3c, 0x23, 0xa3, 0xfe, 0xeb, 0xbd,
+          0x45, 0x4d, 0x44, 0x23, 0x64, 0x3c, 0xe8, 0x0e,
+          0x2a, 0x9a, 0xc9, 0x4f, 0xa5, 0x4c, 0xa4, 0x9f },
+        { 0x20, 0x4a, 0x8f, 0xc6, 0xdd, 0xa8, 0x2f, 0x0a,
+          0x0c, 0xed, 0x7b, 0xeb, 0x8e, 0x08, 0xa4, 0x16,
+          0x57, 0xc1, 0x6e, 0xf4, 0x68, 0xb2, 0x28, 0xa8,
+          0x27, 0x9b, 0xe3, 0x31, 0xa7, 0x03, 0xc3, 0x35,
+          0x96, 0xfd, 0x15, 0xc1, 0x3b, 0x1b, 0x07, 0xf9,
+          0xaa, 0x1d, 0x3b, 0xea, 0x57, 0x78, 0x9c, 0xa0,
+          0x31, 0xad, 0x85, 0xc7, 0xa7, 0x1d, 0xd7, 0x03,
+          0x54, 0xec, 0x63, 0x12, 0x38, 0xca, 0x34, 0x45 },
+        { 0xf1, 0xdc, 0xa2, 0xeb, 0x67, 0x7b, 0x30, 0x32,
+          0x65, 0xb0, 0xb9, 0xba, 0xff, 0x0e, 0x06, 0x12,
+          0x02, 0x81, 0x8f, 0x35, 0xc1, 0x47, 0x0a, 0x69,
+          0xbb, 0xaa, 0x9b, 0xb6, 0x60, 0x25, 0xe9, 0x48,
+          0xd9, 0x0e, 0x56, 0x5e, 0x69, 0x64, 0x25, 0x06,
+          0xc6, 0x21, 0x3a, 0xef, 0x3c, 0xf9, 0xe9, 0x29,
+          0x35, 0x7a, 0x59, 0xda, 0x26, 0x3d, 0xeb, 0x34,
+          0xd1, 0x23, 0x6d, 0xbd, 0xcd, 0xa2, 0x79, 0xb3 },
+    } },
+    { TB_HALG_SM3, {
+        { 0x66, 0xc7, 0xf0, 0xf4, 0x62, 0xee, 0xed, 0xd9,
+          0xd1, 0xf2, 0xd4, 0x6b, 0xdc, 0x10, 0xe4, 0xe2,
+          0x41, 0x67, 0xc4, 0x87, 0x5c, 0xf2, 0xf7, 0xa2,
+          0x29, 0x7d, 0xa0, 0x2b, 0x8f, 0x4b, 0xa8, 0xe0 },
+        { 0x63, 0x9b, 0x6c, 0xc5, 0xe6, 0x4d, 0x9e, 0x37,
+          0xa3, 0x90, 0xb1, 0x92, 0xdf, 0x4f, 0xa1, 0xea,
+          0x07, 0x20, 0xab, 0x74, 0x7f, 0xf6, 0x92, 0xb9,
+          0xf3, 0x8c, 0x4e, 0x66, 0xad, 0x7b, 0x8c, 0x05 },
+        { 0x11, 0xf3, 0x94, 0x0f, 0x10, 0xce, 0x70, 0xef,
+          0x1f, 0x7b, 0xd8, 0x03, 0x2b, 0x0a, 0x72, 0x8b,
+          0x11, 0x24, 0xe5, 0x2c, 0xe7, 0x8c, 0x04, 0x8f,
+          0x10, 0x90, 0x36, 0x77, 0x76, 0xfe, 0xb2, 0xe4 },
+    } },
+};
+
+static uint8_t kat_long[KAT_LONG_LEN];
+
+static bool hash_impl_selected;
+
+/* algorithms whose implementation failed its self test, by alg id bit */
+static uint32_t hash_algs_failed;
+#define HALG_BIT(alg)   (1u << ((alg) & 0x1f))
+
+/* hash the buffer with the software implementation of hash_alg */
+static bool do_hash_buffer(const unsigned char* buf, size_t size,
+                           tb_hash_t *hash, uint16_t hash_alg)
+{
+    if ( hash_alg == TB_HALG_SHA1 )
+        sha1_buffer(buf, size, hash->sha1);
+    else if ( hash_alg == TB_HALG_SHA256 )
+        sha256_buffer(buf, size, hash->sha256);
+    else if ( hash_alg == TB_HALG_SHA384 )
+        sha384_buffer(buf, size, hash->sha384);
+    else if ( hash_alg == TB_HALG_SHA512 )
+        sha512_buffer(buf, size, hash->sha512);
+    else if ( hash_alg == TB_HALG_SM3 )
+        sm3_buffer(buf, size, hash->sm3);
+    else
+        return false;
+
+    return true;
+}
+
+/* hash the three messages with whatever implementation is in place */
+static bool hash_self_test(uint16_t hash_alg)
+{
+    const unsigned char *msg[3] = {
+        (const unsigned char *)kat_abc, (const unsigned char *)kat_2blk,
+        kat_long
+    };
+    const size_t len[3] = {
+        sizeof(kat_abc) - 1, sizeof(kat_2blk) - 1, KAT_LONG_LEN
+    };
+    tb_hash_t hash;
+    unsigned int k;
+    int i;
+
+    for ( k = 0; k < ARRAY_SIZE(hash_kats); k++ ) {
+        if ( hash_kats[k].alg == hash_alg )
+            break;
+    }
+    if ( k == ARRAY_SIZE(hash_kats) )
+        return false;
+
+    for ( i = 0; i < 3; i++ ) {
+        if ( !do_hash_buffer(msg[i], len[i], &hash, hash_alg) )
+            return false;
+        if ( tb_memcmp(&hash, hash_kats[k].digest[i],
+                       get_hash_size(hash_alg)) != 0 )
+            return false;
+    }
+
+    return true;
+}
+
+/* SSE state is off out of reset; the accelerated hashes need it on */
+static bool enable_sse(void)
+{
+    uint32_t edx = cpuid_edx(1);
+
+    if ( !(edx & CPUID_X86_FEATURE_FXSR) || !(edx & CPUID_X86_FEATURE_XMM) ||
+         !(edx & CPUID_X86_FEATURE_XMM2) )
+        return false;
+
+    write_cr0((read_cr0() & ~(CR0_EM | CR0_TS)) | CR0_MP);
+    write_cr4(read_cr4() | CR4_FXSR | CR4_XMM);
+
+    return true;
+}
+
+/*
+ * select_hash_impl
+ *
+ * pick the fastest SHA-1 and SHA-256 block functions the CPU supports,
+ * SHA extensions before SSSE3 before the portable C, and check each with
+ * the known answer tests before it is used. A failing implementation is
+ * dropped for the next one down; an algorithm with nothing left to drop
+ * to is refused by hash_buffer and extend_hash.
+ */
+static void select_hash_impl(void)
+{
+    static const char *names[] = { "generic", "ssse3", "sha-ni" };
+    sha1_blocks_t sha1_impl[3] = {
+        sha1_blocks_generic, sha1_blocks_ssse3, sha1_blocks_shani
+    };
+    sha256_blocks_t sha256_impl[3] = {
+        sha256_blocks_generic, sha256_blocks_ssse3, sha256_blocks_shani
+    };
+    static const uint16_t sw_only[] = {
+        TB_HALG_SHA384, TB_HALG_SHA512, TB_HALG_SM3
+    };
+    int best = 0, i;
+
+    if ( hash_impl_selected )
+        return;
+    hash_impl_selected = true;
+
+    if ( enable_sse() && (cpuid_ecx(1) & CPUID_X86_FEATURE_SSSE3) ) {
+        best = 1;
+        if ( cpuid_eax(0) >= 7 &&
+             (cpuid_ecx(1) & CPUID_X86_FEATURE_SSE4_1) &&
+             (cpuid_ebx1(7, 0) & CPUID_X86_FEATURE_SHA) )
+            best = 2;
+    }
+
+    for ( i = 0; i < KAT_LONG_LEN; i++ )
+        kat_long[i] = (uint8_t)i;
+
+    for ( i = best; i >= 0; i-- ) {
+        sha1_blocks = sha1_impl[i];
+        if ( hash_self_test(TB_HALG_SHA1) )
+            break;
+        printk(TBOOT_ERR"SHA-1 %s failed self test\n", names[i]);
+    }
+    if ( i >= 0 )
+        printk(TBOOT_INFO"SHA-1: using %s\n", names[i]);
+    else
+        hash_algs_failed |= HALG_BIT(TB_HALG_SHA1);
+
+    for ( i = best; i >= 0; i-- ) {
+        sha256_blocks = sha256_impl[i];
+        if ( hash_self_test(TB_HALG_SHA256) )
+            break;
+        printk(TBOOT_ERR"SHA-256 %s failed self test\n", names[i]);
+    }
+    if ( i >= 0 )
+        printk(TBOOT_INFO"SHA-256: using %s\n", names[i]);
+    else
+        hash_algs_failed |= HALG_BIT(TB_HALG_SHA256);
+
+    /* the remaining algorithms only have the portable implementation */
+    for ( i = 0; i < (int)ARRAY_SIZE(sw_only); i++ ) {
+        if ( hash_self_test(sw_only[i]) )
+            continue;
+        printk(TBOOT_ERR"%s failed self test\n", hash_alg_to_string(sw_only[i]));
+        hash_algs_failed |= HALG_BIT(sw_only[i]);
+    }
+}
+
 /*
  * are_hashes_equal
  *
@@ -83,22 +333,19 @@ bool hash_buffer(const unsigned char* buf, size_t size, tb_hash_t *hash,
         return false;
     }
 
-    if ( hash_alg == TB_HALG_SHA1 ) {
-        sha1_buffer(buf, size, hash->sha1);
-        return true;
-    }
-    else if ( hash_alg == TB_HALG_SHA256 ) {
-        sha256_buffer(buf, size, hash->sha256);
-        return true;
-    }
-    else if ( hash_alg == TB_HALG_SM3 ) {
-        printk(TBOOT_ERR"unsupported hash alg (%u)\n", hash_alg);
+    select_hash_impl();
+
+    if ( hash_algs_failed & HALG_BIT(hash_alg) ) {
+        printk(TBOOT_ERR"hash alg (%u) failed self test\n", hash_alg);
         return false;
     }
-    else {
+
+    if ( !do_hash_buffer(buf, size, hash, hash_alg) ) {
         printk(TBOOT_ERR"unsupported hash alg (%u)\n", hash_alg);
         return false;
     }
+
+    return true;
 }
 
 /*
@@ -109,33 +356,139 @@ bool hash_buffer(const unsigned char* buf, size_t size, tb_hash_t *hash,
  */
 bool extend_hash(tb_hash_t *hash1, const tb_hash_t *hash2, uint16_t hash_alg)
 {
-    uint8_t buf[2*get_hash_size(hash_alg)];
+    unsigned int len = get_hash_size(hash_alg);
+    uint8_t buf[2*SHA512_LENGTH];
 
     if ( hash1 == NULL || hash2 == NULL ) {
         printk(TBOOT_ERR"Error: There is no space for output hash.\n");
         return false;
     }
 
-    if ( hash_alg == TB_HALG_SHA1 ) {
-        tb_memcpy(buf, &(hash1->sha1), sizeof(hash1->sha1));
-        tb_memcpy(buf + sizeof(hash1->sha1), &(hash2->sha1), sizeof(hash1->sha1));
-        sha1_buffer(buf, 2*sizeof(hash1->sha1), hash1->sha1);
-        return true;
+    if ( len == 0 ) {
+        printk(TBOOT_ERR"unsupported hash alg (%u)\n", hash_alg);
+        return false;
     }
-    else if ( hash_alg == TB_HALG_SHA256 ) {
-        tb_memcpy(buf, &(hash1->sha256), sizeof(hash1->sha256));
-        tb_memcpy(buf + sizeof(hash1->sha256), &(hash2->sha256), sizeof(hash1->sha256));
-        sha256_buffer(buf, 2*sizeof(hash1->sha256), hash1->sha256);
-        return true;
+
+    tb_memcpy(buf, hash1, len);
+    tb_memcpy(buf + len, hash2, len);
+
+    return hash_buffer(buf, 2*len, hash1, hash_alg);
+}
+
+/* 8KB, so the chunk is still in L1 when the last algorithm reads it */
+#define HASH_MULTI_CHUNK    0x2000
+
+typedef union {
+    struct sha1_ctxt sha1;
+    sha256_state     sha256;
+    sha512_state     sha512;
+    sm3_state        sm3;
+} hash_ctx_t;
+
+static bool hash_ctx_init(hash_ctx_t *ctx, uint16_t hash_alg)
+{
+    if ( hash_alg == TB_HALG_SHA1 )
+        sha1_init(&ctx->sha1);
+    else if ( hash_alg == TB_HALG_SHA256 )
+        sha256_init(&ctx->sha256);
+    else if ( hash_alg == TB_HALG_SHA384 )
+        sha384_init(&ctx->sha512);
+    else if ( hash_alg == TB_HALG_SHA512 )
+        sha512_init(&ctx->sha512);
+    else if ( hash_alg == TB_HALG_SM3 )
+        sm3_init(&ctx->sm3);
+    else
+        return false;
+
+    return true;
+}
+
+static void hash_ctx_update(hash_ctx_t *ctx, uint16_t hash_alg,
+                            const unsigned char *buf, size_t size)
+{
+    if ( hash_alg == TB_HALG_SHA1 )
+        sha1_loop(&ctx->sha1, buf, size);
+    else if ( hash_alg == TB_HALG_SHA256 )
+        sha256_process(&ctx->sha256, buf, size);
+    else if ( hash_alg == TB_HALG_SHA384 || hash_alg == TB_HALG_SHA512 )
+        sha512_process(&ctx->sha512, buf, size);
+    else if ( hash_alg == TB_HALG_SM3 )
+        sm3_process(&ctx->sm3, buf, size);
+}
+
+static void hash_ctx_final(hash_ctx_t *ctx, uint16_t hash_alg,
+                           tb_hash_t *hash)
+{
+    uint8_t buf[SHA512_LENGTH];
+
+    if ( hash_alg == TB_HALG_SHA1 )
+        sha1_result(&ctx->sha1, hash->sha1);
+    else if ( hash_alg == TB_HALG_SHA256 )
+        sha256_done(&ctx->sha256, hash->sha256);
+    else if ( hash_alg == TB_HALG_SHA384 ) {
+        sha512_done(&ctx->sha512, buf);
+        tb_memcpy(hash->sha384, buf, SHA384_LENGTH);
     }
-    else if ( hash_alg == TB_HALG_SM3 ) {
-        printk(TBOOT_ERR"unsupported hash alg (%u)\n", hash_alg);
+    else if ( hash_alg == TB_HALG_SHA512 )
+        sha512_done(&ctx->sha512, hash->sha512);
+    else if ( hash_alg == TB_HALG_SM3 )
+        sm3_done(&ctx->sm3, hash->sm3);
+}
+
+/*
+ * hash_buffer_multi
+ *
+ * hash the buffer with each of the count algorithms in algs in a single
+ * pass, so a large module is read from memory once rather than once per
+ * bank. hl receives one entry per algorithm, in the order given.
+ */
+bool hash_buffer_multi(const unsigned char *buf, size_t size,
+                       const uint16_t *algs, unsigned int count,
+                       hash_list_t *hl)
+{
+    hash_ctx_t ctx[MAX_ALG_NUM];
+    size_t off, chunk;
+    unsigned int i;
+
+    if ( hl == NULL || algs == NULL ) {
+        printk(TBOOT_ERR"Error: There is no space for output hash.\n");
         return false;
     }
-    else {
-        printk(TBOOT_ERR"unsupported hash alg (%u)\n", hash_alg);
+
+    if ( count > MAX_ALG_NUM ) {
+        printk(TBOOT_ERR"too many hash algs (%u)\n", count);
         return false;
     }
+
+    select_hash_impl();
+
+    for ( i = 0; i < count; i++ ) {
+        if ( hash_algs_failed & HALG_BIT(algs[i]) ) {
+            printk(TBOOT_ERR"hash alg (%u) failed self test\n", algs[i]);
+            return false;
+        }
+        if ( !hash_ctx_init(&ctx[i], algs[i]) ) {
+            printk(TBOOT_ERR"unsupported hash alg (%u)\n", algs[i]);
+            return false;
+        }
+    }
+
+    for ( off = 0; off < size; off += chunk ) {
+        chunk = size - off;
+        if ( chunk > HASH_MULTI_CHUNK )
+            chunk = HASH_MULTI_CHUNK;
+
+        for ( i = 0; i < count; i++ )
+            hash_ctx_update(&ctx[i], algs[i], buf + off, chunk);
+    }
+
+    for ( i = 0; i < count; i++ ) {
+        hl->entries[i].alg = algs[i];
+        hash_ctx_final(&ctx[i], algs[i], &hl->entries[i].hash);
+    }
+    hl->count = count;
+
+    return true;
 }
 
 void print_hash(const tb_hash_t *hash, uint16_t hash_alg)
@@ -153,6 +506,8 @@ void print_hash(const tb_hash_t *hash, uint16_t hash_alg)
         print_hex(NULL, (uint8_t *)hash->sm3, sizeof(hash->sm3));
     else if ( hash_alg == TB_HALG_SHA384 )
         print_hex(NULL, (uint8_t *)hash->sha384, sizeof(hash->sha384));
+    else if ( hash_alg == TB_HALG_SHA512 )
+        print_hex(NULL, (uint8_t *)hash->sha512, sizeof(hash->sha512));
     else {
         printk(TBOOT_WARN"unsupported hash alg (%u)\n", hash_alg);
         return;
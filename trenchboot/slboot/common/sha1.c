@@ -61,7 +61,7 @@ static uint32_t _K[] = { 0x5a827999, 0x6ed9eba1, 0x8f1bbcdc, 0xca62c1d6 };
 #define	H(n)	(ctxt->h.b32[(n)])
 #define	COUNT	(ctxt->count)
 #define	BCOUNT	(ctxt->c.b64[0] / 8)
-#define	W(n)	(ctxt->m.b32[(n)])
+#define	W(n)	(w[(n)])
 #define	PUTBYTE(x){\
     ctxt->m.b8[(COUNT % 64)] = (x);\
     COUNT++;\
@@ -77,83 +77,66 @@ static uint32_t _K[] = { 0x5a827999, 0x6ed9eba1, 0x8f1bbcdc, 0xca62c1d6 };
     if (COUNT % 64 == 0)\
         sha1_step(ctxt);\
      }
-static void sha1_step(struct sha1_ctxt *ctxt)
+/*
+ * Portable compression of n consecutive 64 byte blocks, the fallback when
+ * hash.c finds no accelerated implementation for this CPU.
+ */
+void sha1_blocks_generic(uint32_t *h, const uint8_t *data, size_t n)
 {
     uint32_t    a, b, c, d, e;
+    uint32_t    w[16];
     size_t t, s;
     uint32_t    tmp;
 
-#if LITTLE_ENDIAN
-    struct sha1_ctxt tctxt;
-    tb_memcpy(&tctxt.m.b8[0], &ctxt->m.b8[0], 64);
-    ctxt->m.b8[0] = tctxt.m.b8[3]; ctxt->m.b8[1] = tctxt.m.b8[2];
-    ctxt->m.b8[2] = tctxt.m.b8[1]; ctxt->m.b8[3] = tctxt.m.b8[0];
-    ctxt->m.b8[4] = tctxt.m.b8[7]; ctxt->m.b8[5] = tctxt.m.b8[6];
-    ctxt->m.b8[6] = tctxt.m.b8[5]; ctxt->m.b8[7] = tctxt.m.b8[4];
-    ctxt->m.b8[8] = tctxt.m.b8[11]; ctxt->m.b8[9] = tctxt.m.b8[10];
-    ctxt->m.b8[10] = tctxt.m.b8[9]; ctxt->m.b8[11] = tctxt.m.b8[8];
-    ctxt->m.b8[12] = tctxt.m.b8[15]; ctxt->m.b8[13] = tctxt.m.b8[14];
-    ctxt->m.b8[14] = tctxt.m.b8[13]; ctxt->m.b8[15] = tctxt.m.b8[12];
-    ctxt->m.b8[16] = tctxt.m.b8[19]; ctxt->m.b8[17] = tctxt.m.b8[18];
-    ctxt->m.b8[18] = tctxt.m.b8[17]; ctxt->m.b8[19] = tctxt.m.b8[16];
-    ctxt->m.b8[20] = tctxt.m.b8[23]; ctxt->m.b8[21] = tctxt.m.b8[22];
-    ctxt->m.b8[22] = tctxt.m.b8[21]; ctxt->m.b8[23] = tctxt.m.b8[20];
-    ctxt->m.b8[24] = tctxt.m.b8[27]; ctxt->m.b8[25] = tctxt.m.b8[26];
-    ctxt->m.b8[26] = tctxt.m.b8[25]; ctxt->m.b8[27] = tctxt.m.b8[24];
-    ctxt->m.b8[28] = tctxt.m.b8[31]; ctxt->m.b8[29] = tctxt.m.b8[30];
-    ctxt->m.b8[30] = tctxt.m.b8[29]; ctxt->m.b8[31] = tctxt.m.b8[28];
-    ctxt->m.b8[32] = tctxt.m.b8[35]; ctxt->m.b8[33] = tctxt.m.b8[34];
-    ctxt->m.b8[34] = tctxt.m.b8[33]; ctxt->m.b8[35] = tctxt.m.b8[32];
-    ctxt->m.b8[36] = tctxt.m.b8[39]; ctxt->m.b8[37] = tctxt.m.b8[38];
-    ctxt->m.b8[38] = tctxt.m.b8[37]; ctxt->m.b8[39] = tctxt.m.b8[36];
-    ctxt->m.b8[40] = tctxt.m.b8[43]; ctxt->m.b8[41] = tctxt.m.b8[42];
-    ctxt->m.b8[42] = tctxt.m.b8[41]; ctxt->m.b8[43] = tctxt.m.b8[40];
-    ctxt->m.b8[44] = tctxt.m.b8[47]; ctxt->m.b8[45] = tctxt.m.b8[46];
-    ctxt->m.b8[46] = tctxt.m.b8[45]; ctxt->m.b8[47] = tctxt.m.b8[44];
-    ctxt->m.b8[48] = tctxt.m.b8[51]; ctxt->m.b8[49] = tctxt.m.b8[50];
-    ctxt->m.b8[50] = tctxt.m.b8[49]; ctxt->m.b8[51] = tctxt.m.b8[48];
-    ctxt->m.b8[52] = tctxt.m.b8[55]; ctxt->m.b8[53] = tctxt.m.b8[54];
-    ctxt->m.b8[54] = tctxt.m.b8[53]; ctxt->m.b8[55] = tctxt.m.b8[52];
-    ctxt->m.b8[56] = tctxt.m.b8[59]; ctxt->m.b8[57] = tctxt.m.b8[58];
-    ctxt->m.b8[58] = tctxt.m.b8[57]; ctxt->m.b8[59] = tctxt.m.b8[56];
-    ctxt->m.b8[60] = tctxt.m.b8[63]; ctxt->m.b8[61] = tctxt.m.b8[62];
-    ctxt->m.b8[62] = tctxt.m.b8[61]; ctxt->m.b8[63] = tctxt.m.b8[60];
-#endif
+    for ( ; n > 0; n--, data += 64) {
+        /* the message words are big endian */
+        for (t = 0; t < 16; t++)
+            W(t) = (uint32_t)data[4*t] << 24 | (uint32_t)data[4*t+1] << 16 |
+                   (uint32_t)data[4*t+2] << 8 | (uint32_t)data[4*t+3];
 
-    a = H(0); b = H(1); c = H(2); d = H(3); e = H(4);
+        a = h[0]; b = h[1]; c = h[2]; d = h[3]; e = h[4];
 
-    for (t = 0; t < 20; t++) {
-        s = t & 0x0f;
-        if (t >= 16){
+        for (t = 0; t < 20; t++) {
+            s = t & 0x0f;
+            if (t >= 16){
+                W(s) = S(1, W((s+13) & 0x0f) ^ W((s+8) & 0x0f) ^ W((s+2) & 0x0f) ^ W(s));
+            }
+            tmp = S(5, a) + F0(b, c, d) + e + W(s) + K(t);
+            e = d; d = c; c = S(30, b); b = a; a = tmp;
+        }
+        for (t = 20; t < 40; t++) {
+            s = t & 0x0f;
             W(s) = S(1, W((s+13) & 0x0f) ^ W((s+8) & 0x0f) ^ W((s+2) & 0x0f) ^ W(s));
+            tmp = S(5, a) + F1(b, c, d) + e + W(s) + K(t);
+            e = d; d = c; c = S(30, b); b = a; a = tmp;
         }
-        tmp = S(5, a) + F0(b, c, d) + e + W(s) + K(t);
-        e = d; d = c; c = S(30, b); b = a; a = tmp;
-    }
-    for (t = 20; t < 40; t++) {
-        s = t & 0x0f;
-        W(s) = S(1, W((s+13) & 0x0f) ^ W((s+8) & 0x0f) ^ W((s+2) & 0x0f) ^ W(s));
-        tmp = S(5, a) + F1(b, c, d) + e + W(s) + K(t);
-        e = d; d = c; c = S(30, b); b = a; a = tmp;
-    }
-    for (t = 40; t < 60; t++) {
-        s = t & 0x0f;
-        W(s) = S(1, W((s+13) & 0x0f) ^ W((s+8) & 0x0f) ^ W((s+2) & 0x0f) ^ W(s));
-        tmp = S(5, a) + F2(b, c, d) + e + W(s) + K(t);
-        e = d; d = c; c = S(30, b); b = a; a = tmp;
-    }
-    for (t = 60; t < 80; t++) {
-        s = t & 0x0f;
-        W(s) = S(1, W((s+13) & 0x0f) ^ W((s+8) & 0x0f) ^ W((s+2) & 0x0f) ^ W(s));
-        tmp = S(5, a) + F3(b, c, d) + e + W(s) + K(t);
-        e = d; d = c; c = S(30, b); b = a; a = tmp;
+        for (t = 40; t < 60; t++) {
+            s = t & 0x0f;
+            W(s) = S(1, W((s+13) & 0x0f) ^ W((s+8) & 0x0f) ^ W((s+2) & 0x0f) ^ W(s));
+            tmp = S(5, a) + F2(b, c, d) + e + W(s) + K(t);
+            e = d; d = c; c = S(30, b); b = a; a = tmp;
+        }
+        for (t = 60; t < 80; t++) {
+            s = t & 0x0f;
+            W(s) = S(1, W((s+13) & 0x0f) ^ W((s+8) & 0x0f) ^ W((s+2) & 0x0f) ^ W(s));
+            tmp = S(5, a) + F3(b, c, d) + e + W(s) + K(t);
+            e = d; d = c; c = S(30, b); b = a; a = tmp;
+        }
+
+        h[0] += a;
+        h[1] += b;
+        h[2] += c;
+        h[3] += d;
+        h[4] += e;
     }
+}
 
-    H(0) = H(0) + a;
-    H(1) = H(1) + b;
-    H(2) = H(2) + c;
-    H(3) = H(3) + d;
-    H(4) = H(4) + e;
+/* compression in use, hash.c replaces it after checking the CPU */
+sha1_blocks_t sha1_blocks = sha1_blocks_generic;
+
+static void sha1_step(struct sha1_ctxt *ctxt)
+{
+    sha1_blocks(ctxt->h.b32, ctxt->m.b8, 1);
 
     tb_memset(&ctxt->m.b8[0],0, 64);
 }
@@ -203,17 +186,31 @@ void sha1_pad(struct sha1_ctxt *ctxt)
 #endif
 }
 
+/*
+ * Only a partial block at either end goes through the context buffer, the
+ * whole blocks in between are compressed in place from the caller's buffer.
+ */
 void sha1_loop(struct sha1_ctxt *ctxt,const uint8_t *input,size_t len)
 {
     size_t gaplen;
     size_t gapstart;
     size_t off;
     size_t copysiz;
+    size_t nblocks;
 
     off = 0;
 
     while (off < len) {
         gapstart = COUNT % 64;
+
+        if (gapstart == 0 && len - off >= 64) {
+            nblocks = (len - off) / 64;
+            sha1_blocks(ctxt->h.b32, &input[off], nblocks);
+            ctxt->c.b64[0] += (uint64_t)nblocks * 64 * 8;
+            off += nblocks * 64;
+            continue;
+        }
+
         gaplen = 64 - gapstart;
 
         copysiz = (gaplen < len - off) ? gaplen : len - off;
@@ -16,15 +16,17 @@
 #define Gamma0(x)       (S(x, 7) ^ S(x, 18) ^ R(x, 3))
 #define Gamma1(x)       (S(x, 17) ^ S(x, 19) ^ R(x, 10))
 
+#define SHA256_BLOCK_SIZE   64
+
 /* compress 512-bits */
-static int sha256_compress(sha256_state * md, unsigned char *buf)
+static void sha256_block(u32 *state, const unsigned char *buf)
 {
     u32 S[8], W[64], t0, t1;
     int i;
 
     /* copy state into S */
     for (i = 0; i < 8; i++) {
-        S[i] = md->state[i];
+        S[i] = state[i];
     }
 
     /* copy the state into 512-bits into W[0..15] */
@@ -113,12 +115,29 @@ static int sha256_compress(sha256_state * md, unsigned char *buf)
     
     /* feedback */
     for (i = 0; i < 8; i++) {
-        md->state[i] = md->state[i] + S[i];
+        state[i] = state[i] + S[i];
     }
+}
+
+/*
+ * Portable compression of n consecutive 64 byte blocks, the fallback when
+ * hash.c finds no accelerated implementation for this CPU.
+ */
+void sha256_blocks_generic(u32 *state, const unsigned char *buf, size_t n)
+{
+    for ( ; n > 0; n--, buf += SHA256_BLOCK_SIZE)
+        sha256_block(state, buf);
+}
+
+/* compression in use, hash.c replaces it after checking the CPU */
+sha256_blocks_t sha256_blocks = sha256_blocks_generic;
+
+static int sha256_compress(sha256_state * md, unsigned char *buf)
+{
+    sha256_blocks(md->state, buf, 1);
     return 0;
 }
 
-#define SHA256_BLOCK_SIZE   64
 #define MIN(x, y) ( ((x)<(y))?(x):(y) )
 int sha256_process(sha256_state * md, const unsigned char *in, unsigned long inlen)
 {
@@ -132,12 +151,12 @@ int sha256_process(sha256_state * md, const unsigned char *in, unsigned long inl
 
     while (inlen > 0) {                                                          
         if (md->curlen == 0 && inlen >= SHA256_BLOCK_SIZE) {
-            if ((err = sha256_compress(md, (unsigned char *)in)) != 0) {
-                return err;
-            }
-            md->length += SHA256_BLOCK_SIZE * 8;          
-            in += SHA256_BLOCK_SIZE;                      
-            inlen -= SHA256_BLOCK_SIZE;                      
+            /* hand every whole block over in one call */
+            n = inlen / SHA256_BLOCK_SIZE;
+            sha256_blocks(md->state, in, n);
+            md->length += n * SHA256_BLOCK_SIZE * 8;
+            in += n * SHA256_BLOCK_SIZE;
+            inlen -= n * SHA256_BLOCK_SIZE;
         } else {                                              
            n = MIN(inlen, (SHA256_BLOCK_SIZE - md->curlen));
            tb_memcpy(md->buf + md->curlen, in, (size_t)n);
@@ -0,0 +1,251 @@
+#include <types.h>
+#include <stdbool.h>
+#include <string.h>
+#include <sha256.h>
+#include <sha512.h>
+
+/*
+ * SHA-384 and SHA-512 (FIPS 180-4), in the style of sha256.c: the same
+ * compression over 64 bit words and 128 byte blocks, SHA-384 differing
+ * only in its initial state and truncated output.
+ */
+
+/* Various logical functions */
+#define ROR64c(x, y)    (((x) >> (y)) | ((x) << (64 - (y))))
+#define Ch(x,y,z)       (z ^ (x & (y ^ z)))
+#define Maj(x,y,z)      (((x | y) & z) | (x & y))
+#define S(x, n)         ROR64c(x, n)
+#define R(x, n)         ((x) >> (n))
+#define Sigma0(x)       (S(x, 28) ^ S(x, 34) ^ S(x, 39))
+#define Sigma1(x)       (S(x, 14) ^ S(x, 18) ^ S(x, 41))
+#define Gamma0(x)       (S(x, 1) ^ S(x, 8) ^ R(x, 7))
+#define Gamma1(x)       (S(x, 19) ^ S(x, 61) ^ R(x, 6))
+
+static const u64 K[80] = {
+    0x428a2f98d728ae22ULL, 0x7137449123ef65cdULL,
+    0xb5c0fbcfec4d3b2fULL, 0xe9b5dba58189dbbcULL,
+    0x3956c25bf348b538ULL, 0x59f111f1b605d019ULL,
+    0x923f82a4af194f9bULL, 0xab1c5ed5da6d8118ULL,
+    0xd807aa98a3030242ULL, 0x12835b0145706fbeULL,
+    0x243185be4ee4b28cULL, 0x550c7dc3d5ffb4e2ULL,
+    0x72be5d74f27b896fULL, 0x80deb1fe3b1696b1ULL,
+    0x9bdc06a725c71235ULL, 0xc19bf174cf692694ULL,
+    0xe49b69c19ef14ad2ULL, 0xefbe4786384f25e3ULL,
+    0x0fc19dc68b8cd5b5ULL, 0x240ca1cc77ac9c65ULL,
+    0x2de92c6f592b0275ULL, 0x4a7484aa6ea6e483ULL,
+    0x5cb0a9dcbd41fbd4ULL, 0x76f988da831153b5ULL,
+    0x983e5152ee66dfabULL, 0xa831c66d2db43210ULL,
+    0xb00327c898fb213fULL, 0xbf597fc7beef0ee4ULL,
+    0xc6e00bf33da88fc2ULL, 0xd5a79147930aa725ULL,
+    0x06ca6351e003826fULL, 0x142929670a0e6e70ULL,
+    0x27b70a8546d22ffcULL, 0x2e1b21385c26c926ULL,
+    0x4d2c6dfc5ac42aedULL, 0x53380d139d95b3dfULL,
+    0x650a73548baf63deULL, 0x766a0abb3c77b2a8ULL,
+    0x81c2c92e47edaee6ULL, 0x92722c851482353bULL,
+    0xa2bfe8a14cf10364ULL, 0xa81a664bbc423001ULL,
+    0xc24b8b70d0f89791ULL, 0xc76c51a30654be30ULL,
+    0xd192e819d6ef5218ULL, 0xd69906245565a910ULL,
+    0xf40e35855771202aULL, 0x106aa07032bbd1b8ULL,
+    0x19a4c116b8d2d0c8ULL, 0x1e376c085141ab53ULL,
+    0x2748774cdf8eeb99ULL, 0x34b0bcb5e19b48a8ULL,
+    0x391c0cb3c5c95a63ULL, 0x4ed8aa4ae3418acbULL,
+    0x5b9cca4f7763e373ULL, 0x682e6ff3d6b2b8a3ULL,
+    0x748f82ee5defb2fcULL, 0x78a5636f43172f60ULL,
+    0x84c87814a1f0ab72ULL, 0x8cc702081a6439ecULL,
+    0x90befffa23631e28ULL, 0xa4506cebde82bde9ULL,
+    0xbef9a3f7b2c67915ULL, 0xc67178f2e372532bULL,
+    0xca273eceea26619cULL, 0xd186b8c721c0c207ULL,
+    0xeada7dd6cde0eb1eULL, 0xf57d4f7fee6ed178ULL,
+    0x06f067aa72176fbaULL, 0x0a637dc5a2c898a6ULL,
+    0x113f9804bef90daeULL, 0x1b710b35131c471bULL,
+    0x28db77f523047d84ULL, 0x32caab7b40c72493ULL,
+    0x3c9ebe0a15c9bebcULL, 0x431d67c49c100d4cULL,
+    0x4cc5d4becb3e42b6ULL, 0x597f299cfc657e2aULL,
+    0x5fcb6fab3ad6faecULL, 0x6c44198c4a475817ULL
+};
+
+/* compress 1024-bits */
+static void sha512_compress(sha512_state *md, const unsigned char *buf)
+{
+    u64 S[8], W[80], t0, t1;
+    int i;
+
+    /* copy state into S */
+    for (i = 0; i < 8; i++) {
+        S[i] = md->state[i];
+    }
+
+    /* copy the state into 1024-bits into W[0..15] */
+    for (i = 0; i < 16; i++) {
+        LOAD64H(W[i], buf + (8*i));
+    }
+
+    /* fill W[16..79] */
+    for (i = 16; i < 80; i++) {
+        W[i] = Gamma1(W[i - 2]) + W[i - 7] + Gamma0(W[i - 15]) + W[i - 16];
+    }
+
+    /* Compress */
+#define RND(a,b,c,d,e,f,g,h,i)                       \
+     t0 = h + Sigma1(e) + Ch(e, f, g) + K[i] + W[i]; \
+     t1 = Sigma0(a) + Maj(a, b, c);                  \
+     d += t0;                                        \
+     h  = t0 + t1;
+
+    for (i = 0; i < 80; i += 8) {
+        RND(S[0],S[1],S[2],S[3],S[4],S[5],S[6],S[7],i+0);
+        RND(S[7],S[0],S[1],S[2],S[3],S[4],S[5],S[6],i+1);
+        RND(S[6],S[7],S[0],S[1],S[2],S[3],S[4],S[5],i+2);
+        RND(S[5],S[6],S[7],S[0],S[1],S[2],S[3],S[4],i+3);
+        RND(S[4],S[5],S[6],S[7],S[0],S[1],S[2],S[3],i+4);
+        RND(S[3],S[4],S[5],S[6],S[7],S[0],S[1],S[2],i+5);
+        RND(S[2],S[3],S[4],S[5],S[6],S[7],S[0],S[1],i+6);
+        RND(S[1],S[2],S[3],S[4],S[5],S[6],S[7],S[0],i+7);
+    }
+#undef RND
+
+    /* feedback */
+    for (i = 0; i < 8; i++) {
+        md->state[i] = md->state[i] + S[i];
+    }
+}
+
+#define MIN(x, y) ( ((x)<(y))?(x):(y) )
+int sha512_process(sha512_state * md, const unsigned char *in, unsigned long inlen)
+{
+    unsigned long n;
+
+    if (md == NULL || in == NULL)
+        return -1;
+    if (md->curlen > sizeof(md->buf))
+        return -1;
+
+    while (inlen > 0) {
+        if (md->curlen == 0 && inlen >= SHA512_BLOCK_SIZE) {
+            sha512_compress(md, in);
+            md->length += SHA512_BLOCK_SIZE * 8;
+            in += SHA512_BLOCK_SIZE;
+            inlen -= SHA512_BLOCK_SIZE;
+        } else {
+            n = MIN(inlen, (SHA512_BLOCK_SIZE - md->curlen));
+            tb_memcpy(md->buf + md->curlen, in, (size_t)n);
+            md->curlen += n;
+            in += n;
+            inlen -= n;
+            if (md->curlen == SHA512_BLOCK_SIZE) {
+                sha512_compress(md, md->buf);
+                md->length += 8*SHA512_BLOCK_SIZE;
+                md->curlen = 0;
+            }
+        }
+    }
+    return 0;
+}
+
+void sha512_init(sha512_state * md)
+{
+    if (md == NULL)
+        return;
+
+    md->curlen = 0;
+    md->length = 0;
+    md->state[0] = 0x6a09e667f3bcc908ULL;
+    md->state[1] = 0xbb67ae8584caa73bULL;
+    md->state[2] = 0x3c6ef372fe94f82bULL;
+    md->state[3] = 0xa54ff53a5f1d36f1ULL;
+    md->state[4] = 0x510e527fade682d1ULL;
+    md->state[5] = 0x9b05688c2b3e6c1fULL;
+    md->state[6] = 0x1f83d9abfb41bd6bULL;
+    md->state[7] = 0x5be0cd19137e2179ULL;
+}
+
+void sha384_init(sha512_state * md)
+{
+    if (md == NULL)
+        return;
+
+    md->curlen = 0;
+    md->length = 0;
+    md->state[0] = 0xcbbb9d5dc1059ed8ULL;
+    md->state[1] = 0x629a292a367cd507ULL;
+    md->state[2] = 0x9159015a3070dd17ULL;
+    md->state[3] = 0x152fecd8f70e5939ULL;
+    md->state[4] = 0x67332667ffc00b31ULL;
+    md->state[5] = 0x8eb44a8768581511ULL;
+    md->state[6] = 0xdb0c2e0d64f98fa7ULL;
+    md->state[7] = 0x47b5481dbefa4fa4ULL;
+}
+
+/**
+   Terminate the hash to get the digest
+   @param md  The hash state
+   @param out [out] The destination of the hash (64 bytes)
+   @return 0 if successful
+*/
+int sha512_done(sha512_state * md, unsigned char *out)
+{
+    int i;
+
+    if (md == NULL || out == NULL)
+        return -1;
+
+    if (md->curlen >= sizeof(md->buf))
+        return -1;
+
+    /* increase the length of the message */
+    md->length += md->curlen * 8;
+
+    /* append the '1' bit */
+    md->buf[md->curlen++] = (unsigned char)0x80;
+
+    /* if the length is currently above 112 bytes we append zeros
+     * then compress.  Then we can fall back to padding zeros and length
+     * encoding like normal.
+     */
+    if (md->curlen > 112) {
+        while (md->curlen < 128) {
+            md->buf[md->curlen++] = (unsigned char)0;
+        }
+        sha512_compress(md, md->buf);
+        md->curlen = 0;
+    }
+
+    /* pad upto 120 bytes of zeroes, the upper 64 bits of the 128 bit
+     * length are always zero here */
+    while (md->curlen < 120) {
+        md->buf[md->curlen++] = (unsigned char)0;
+    }
+
+    /* store length */
+    STORE64H(md->length, md->buf+120);
+    sha512_compress(md, md->buf);
+
+    /* copy output */
+    for (i = 0; i < 8; i++) {
+        STORE64H(md->state[i], out+(8*i));
+    }
+
+    return 0;
+}
+
+void sha512_buffer(const unsigned char *buffer, size_t len,
+                   unsigned char hash[64])
+{
+    sha512_state md;
+
+    sha512_init(&md);
+    sha512_process(&md, buffer, len);
+    sha512_done(&md, hash);
+}
+
+void sha384_buffer(const unsigned char *buffer, size_t len,
+                   unsigned char hash[48])
+{
+    sha512_state md;
+    unsigned char buf[64];
+
+    sha384_init(&md);
+    sha512_process(&md, buffer, len);
+    sha512_done(&md, buf);
+    tb_memcpy(hash, buf, 48);
+}
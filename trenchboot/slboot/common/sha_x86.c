@@ -0,0 +1,384 @@
+/*
+ * sha_x86.c: SHA-1 and SHA-256 block functions using x86 vector extensions
+ *
+ * Copyright (c) 2019, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of the Intel Corporation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/*
+ * The intrinsics headers need the hosted C library, which slboot is built
+ * without (-nostdinc), so this file uses the GCC vector extensions and the
+ * ia32 builtins the intrinsics are wrappers around. Each function enables
+ * the instruction set it needs through a target attribute; the rest of
+ * slboot stays free of SSE. The boot stack is only 4 byte aligned, hence
+ * force_align_arg_pointer on the exported functions.
+ */
+
+#include <types.h>
+#include <compiler.h>
+#include <sha1.h>
+#include <sha256.h>
+#include <sha_x86.h>
+
+typedef int v4si __attribute__((vector_size(16)));
+typedef unsigned int v4su __attribute__((vector_size(16)));
+typedef char v16qi __attribute__((vector_size(16)));
+/* unaligned loads and stores of the message and the state */
+typedef int v4si_u __attribute__((vector_size(16), aligned(1), may_alias));
+
+#define SHA_X86_ENTRY(isa) \
+    __attribute__((target(isa), force_align_arg_pointer))
+
+#define LOADU(p)        (*(const v4si_u *)(p))
+#define STOREU(p, v)    (*(v4si_u *)(p) = (v))
+
+/* pshufb: byte swap each 32 bit word, and reverse all 16 bytes */
+#define BSWAP32(v)      ((v4si)__builtin_shuffle((v16qi)(v), \
+                         (v16qi){ 3, 2, 1, 0, 7, 6, 5, 4, \
+                                  11, 10, 9, 8, 15, 14, 13, 12 }))
+#define BSWAP128(v)     ((v4si)__builtin_shuffle((v16qi)(v), \
+                         (v16qi){ 15, 14, 13, 12, 11, 10, 9, 8, \
+                                  7, 6, 5, 4, 3, 2, 1, 0 }))
+
+/* lane wise rotates for the SSSE3 message schedules */
+#define VROR(x, n)      ((v4si)(((v4su)(x) >> (n)) | ((v4su)(x) << (32 - (n)))))
+#define VROL(x, n)      VROR(x, 32 - (n))
+
+#define ROR32(x, n)     (((x) >> (n)) | ((x) << (32 - (n))))
+#define ROL32(x, n)     ROR32(x, 32 - (n))
+
+static const u32 K256[64] __attribute__((aligned(16))) = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+    0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+    0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+    0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+    0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+    0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static const u32 K160[4] = {
+    0x5a827999, 0x6ed9eba1, 0x8f1bbcdc, 0xca62c1d6
+};
+
+/*
+ * SHA-256 with the SHA extensions. The state is kept as ABEF and CDGH,
+ * the layout sha256rnds2 works on, and each group of four rounds first
+ * extends the schedule with sha256msg1/sha256msg2:
+ * W[t..t+3] = msg2(msg1(W[t-16..], W[t-12..]) + W[t-7..t-4], W[t-4..])
+ */
+#define SHA256_RNDS4(m, k) { \
+    v4si wk = (m) + *(const v4si *)&K256[(k)]; \
+    s1 = __builtin_ia32_sha256rnds2(s1, s0, wk); \
+    wk = __builtin_shuffle(wk, (v4si){ 2, 3, 0, 0 }); \
+    s0 = __builtin_ia32_sha256rnds2(s0, s1, wk); \
+}
+
+#define SHA256_SCHED(m0, m1, m2, m3) \
+    m0 = __builtin_ia32_sha256msg2(__builtin_ia32_sha256msg1(m0, m1) + \
+             __builtin_shuffle(m2, m3, (v4si){ 1, 2, 3, 4 }), m3)
+
+SHA_X86_ENTRY("sha,sse4.1")
+void sha256_blocks_shani(u32 *state, const unsigned char *buf, size_t n)
+{
+    v4si s0, s1, abef, cdgh, tmp;
+    v4si m0, m1, m2, m3;
+
+    /* {a,b,c,d}, {e,f,g,h} -> {f,e,b,a}, {h,g,d,c} */
+    tmp = __builtin_shuffle(LOADU(state), (v4si){ 1, 0, 3, 2 });
+    s1 = __builtin_shuffle(LOADU(state + 4), (v4si){ 3, 2, 1, 0 });
+    s0 = __builtin_shuffle(s1, tmp, (v4si){ 2, 3, 4, 5 });
+    s1 = __builtin_shuffle(s1, tmp, (v4si){ 0, 1, 6, 7 });
+
+    for ( ; n > 0; n--, buf += 64) {
+        abef = s0;
+        cdgh = s1;
+
+        m0 = BSWAP32(LOADU(buf));
+        m1 = BSWAP32(LOADU(buf + 16));
+        m2 = BSWAP32(LOADU(buf + 32));
+        m3 = BSWAP32(LOADU(buf + 48));
+
+        SHA256_RNDS4(m0, 0);
+        SHA256_RNDS4(m1, 4);
+        SHA256_RNDS4(m2, 8);
+        SHA256_RNDS4(m3, 12);
+
+        SHA256_SCHED(m0, m1, m2, m3); SHA256_RNDS4(m0, 16);
+        SHA256_SCHED(m1, m2, m3, m0); SHA256_RNDS4(m1, 20);
+        SHA256_SCHED(m2, m3, m0, m1); SHA256_RNDS4(m2, 24);
+        SHA256_SCHED(m3, m0, m1, m2); SHA256_RNDS4(m3, 28);
+        SHA256_SCHED(m0, m1, m2, m3); SHA256_RNDS4(m0, 32);
+        SHA256_SCHED(m1, m2, m3, m0); SHA256_RNDS4(m1, 36);
+        SHA256_SCHED(m2, m3, m0, m1); SHA256_RNDS4(m2, 40);
+        SHA256_SCHED(m3, m0, m1, m2); SHA256_RNDS4(m3, 44);
+        SHA256_SCHED(m0, m1, m2, m3); SHA256_RNDS4(m0, 48);
+        SHA256_SCHED(m1, m2, m3, m0); SHA256_RNDS4(m1, 52);
+        SHA256_SCHED(m2, m3, m0, m1); SHA256_RNDS4(m2, 56);
+        SHA256_SCHED(m3, m0, m1, m2); SHA256_RNDS4(m3, 60);
+
+        s0 += abef;
+        s1 += cdgh;
+    }
+
+    STOREU(state, __builtin_shuffle(s0, s1, (v4si){ 3, 2, 7, 6 }));
+    STOREU(state + 4, __builtin_shuffle(s0, s1, (v4si){ 1, 0, 5, 4 }));
+}
+
+/*
+ * SHA-1 with the SHA extensions. ABCD is held with A in the top lane and
+ * E rides in the top lane of a second register, folded into the next
+ * message group by sha1nexte. Each group of four rounds overlaps the
+ * schedule for the groups after it.
+ */
+#define SHA1_RNDS4(e_in, e_out, m0, m1, m2, m3, f) { \
+    e_in = __builtin_ia32_sha1nexte(e_in, m0); \
+    e_out = abcd; \
+    m1 = __builtin_ia32_sha1msg2(m1, m0); \
+    abcd = __builtin_ia32_sha1rnds4(abcd, e_in, f); \
+    m3 = __builtin_ia32_sha1msg1(m3, m0); \
+    m2 ^= m0; \
+}
+
+SHA_X86_ENTRY("sha,sse4.1")
+void sha1_blocks_shani(uint32_t *h, const uint8_t *data, size_t n)
+{
+    v4si abcd, abcd_save, e0, e0_save, e1;
+    v4si m0, m1, m2, m3;
+
+    abcd = __builtin_shuffle(LOADU(h), (v4si){ 3, 2, 1, 0 });
+    e0 = (v4si){ 0, 0, 0, (int)h[4] };
+
+    for ( ; n > 0; n--, data += 64) {
+        abcd_save = abcd;
+        e0_save = e0;
+
+        m0 = BSWAP128(LOADU(data));
+        m1 = BSWAP128(LOADU(data + 16));
+        m2 = BSWAP128(LOADU(data + 32));
+        m3 = BSWAP128(LOADU(data + 48));
+
+        /* rounds 0-11 start the schedule */
+        e0 += m0;
+        e1 = abcd;
+        abcd = __builtin_ia32_sha1rnds4(abcd, e0, 0);
+
+        e1 = __builtin_ia32_sha1nexte(e1, m1);
+        e0 = abcd;
+        abcd = __builtin_ia32_sha1rnds4(abcd, e1, 0);
+        m0 = __builtin_ia32_sha1msg1(m0, m1);
+
+        e0 = __builtin_ia32_sha1nexte(e0, m2);
+        e1 = abcd;
+        abcd = __builtin_ia32_sha1rnds4(abcd, e0, 0);
+        m1 = __builtin_ia32_sha1msg1(m1, m2);
+        m0 ^= m2;
+
+        /* the schedule work left over in rounds 68-79 is optimized away */
+        SHA1_RNDS4(e1, e0, m3, m0, m1, m2, 0);      /* 12-15 */
+        SHA1_RNDS4(e0, e1, m0, m1, m2, m3, 0);      /* 16-19 */
+        SHA1_RNDS4(e1, e0, m1, m2, m3, m0, 1);
+        SHA1_RNDS4(e0, e1, m2, m3, m0, m1, 1);
+        SHA1_RNDS4(e1, e0, m3, m0, m1, m2, 1);
+        SHA1_RNDS4(e0, e1, m0, m1, m2, m3, 1);
+        SHA1_RNDS4(e1, e0, m1, m2, m3, m0, 1);      /* 36-39 */
+        SHA1_RNDS4(e0, e1, m2, m3, m0, m1, 2);
+        SHA1_RNDS4(e1, e0, m3, m0, m1, m2, 2);
+        SHA1_RNDS4(e0, e1, m0, m1, m2, m3, 2);
+        SHA1_RNDS4(e1, e0, m1, m2, m3, m0, 2);
+        SHA1_RNDS4(e0, e1, m2, m3, m0, m1, 2);      /* 56-59 */
+        SHA1_RNDS4(e1, e0, m3, m0, m1, m2, 3);
+        SHA1_RNDS4(e0, e1, m0, m1, m2, m3, 3);
+        SHA1_RNDS4(e1, e0, m1, m2, m3, m0, 3);
+        SHA1_RNDS4(e0, e1, m2, m3, m0, m1, 3);
+        SHA1_RNDS4(e1, e0, m3, m0, m1, m2, 3);      /* 76-79 */
+
+        e0 = __builtin_ia32_sha1nexte(e0, e0_save);
+        abcd += abcd_save;
+    }
+
+    STOREU(h, __builtin_shuffle(abcd, (v4si){ 3, 2, 1, 0 }));
+    h[4] = (uint32_t)e0[3];
+}
+
+/*
+ * SSSE3 versions for CPUs without the SHA extensions: the message
+ * schedule is computed four words at a time in vector registers, with
+ * the round constants added, and the rounds run on the scalar side.
+ */
+
+#define SSE_Ch(x, y, z)     ((z) ^ ((x) & ((y) ^ (z))))
+#define SSE_Maj(x, y, z)    (((x) & (y)) | ((z) & ((x) | (y))))
+#define SSE_Parity(x, y, z) ((x) ^ (y) ^ (z))
+#define Sigma0_256(x)       (ROR32(x, 2) ^ ROR32(x, 13) ^ ROR32(x, 22))
+#define Sigma1_256(x)       (ROR32(x, 6) ^ ROR32(x, 11) ^ ROR32(x, 25))
+#define sigma0_256(x)       (VROR(x, 7) ^ VROR(x, 18) ^ \
+                             (v4si)((v4su)(x) >> 3))
+#define sigma1_256(x)       (VROR(x, 17) ^ VROR(x, 19) ^ \
+                             (v4si)((v4su)(x) >> 10))
+
+/* the round function of sha256.c, with W[i] + K[i] precomputed */
+#define SSE_RND256(a, b, c, d, e, f, g, h, i) \
+    tmp = h + Sigma1_256(e) + SSE_Ch(e, f, g) + wk.w[i]; \
+    d += tmp; \
+    h = tmp + Sigma0_256(a) + SSE_Maj(a, b, c);
+
+SHA_X86_ENTRY("ssse3")
+void sha256_blocks_ssse3(u32 *state, const unsigned char *buf, size_t n)
+{
+    union {
+        v4si v[16];
+        u32 w[64];
+    } wk;
+    v4si x[4], t0, t1;
+    u32 a, b, c, d, e, f, g, hh, tmp;
+    int t;
+
+    for ( ; n > 0; n--, buf += 64) {
+        for ( t = 0; t < 4; t++ ) {
+            x[t] = BSWAP32(LOADU(buf + 16 * t));
+            wk.v[t] = x[t] + *(const v4si *)&K256[4 * t];
+        }
+
+        /*
+         * W[t] = s1(W[t-2]) + W[t-7] + s0(W[t-15]) + W[t-16]; W[t-2] of
+         * the upper two lanes is only known once the lower two are done.
+         */
+        for ( t = 4; t < 16; t++ ) {
+            t0 = x[0] +
+                 sigma0_256(__builtin_shuffle(x[0], x[1], (v4si){ 1, 2, 3, 4 })) +
+                 __builtin_shuffle(x[2], x[3], (v4si){ 1, 2, 3, 4 });
+            t1 = t0 + sigma1_256(__builtin_shuffle(x[3], (v4si){ 2, 3, 2, 3 }));
+            t0 += sigma1_256(__builtin_shuffle(t1, (v4si){ 0, 1, 0, 1 }));
+            x[0] = x[1];
+            x[1] = x[2];
+            x[2] = x[3];
+            x[3] = __builtin_shuffle(t1, t0, (v4si){ 0, 1, 6, 7 });
+            wk.v[t] = x[3] + *(const v4si *)&K256[4 * t];
+        }
+
+        a = state[0]; b = state[1]; c = state[2]; d = state[3];
+        e = state[4]; f = state[5]; g = state[6]; hh = state[7];
+
+        for ( t = 0; t < 64; t += 8 ) {
+            SSE_RND256(a, b, c, d, e, f, g, hh, t);
+            SSE_RND256(hh, a, b, c, d, e, f, g, t + 1);
+            SSE_RND256(g, hh, a, b, c, d, e, f, t + 2);
+            SSE_RND256(f, g, hh, a, b, c, d, e, t + 3);
+            SSE_RND256(e, f, g, hh, a, b, c, d, t + 4);
+            SSE_RND256(d, e, f, g, hh, a, b, c, t + 5);
+            SSE_RND256(c, d, e, f, g, hh, a, b, t + 6);
+            SSE_RND256(b, c, d, e, f, g, hh, a, t + 7);
+        }
+
+        state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+        state[4] += e; state[5] += f; state[6] += g; state[7] += hh;
+    }
+}
+
+/* five rounds of F, renaming the variables rather than moving them */
+#define SSE_RND160(F, a, b, c, d, e, i) \
+    e += ROL32(a, 5) + F(b, c, d) + wk.w[i]; \
+    b = ROL32(b, 30);
+
+#define SSE_RND160_5(F, i) { \
+    SSE_RND160(F, a, b, c, d, e, (i)); \
+    SSE_RND160(F, e, a, b, c, d, (i) + 1); \
+    SSE_RND160(F, d, e, a, b, c, (i) + 2); \
+    SSE_RND160(F, c, d, e, a, b, (i) + 3); \
+    SSE_RND160(F, b, c, d, e, a, (i) + 4); \
+}
+
+SHA_X86_ENTRY("ssse3")
+void sha1_blocks_ssse3(uint32_t *h, const uint8_t *data, size_t n)
+{
+    union {
+        v4si v[20];
+        u32 w[80];
+    } w, wk;
+    v4si x;
+    u32 a, b, c, d, e, k;
+    int t;
+
+    for ( ; n > 0; n--, data += 64) {
+        for ( t = 0; t < 4; t++ )
+            w.v[t] = BSWAP32(LOADU(data + 16 * t));
+
+        /*
+         * W[t] = rol1(W[t-3] ^ W[t-8] ^ W[t-14] ^ W[t-16]); the top lane
+         * needs W[t] of the bottom lane, patched in afterwards.
+         */
+        for ( t = 4; t < 8; t++ ) {
+            x = w.v[t - 4] ^
+                __builtin_shuffle(w.v[t - 4], w.v[t - 3], (v4si){ 2, 3, 4, 5 }) ^
+                w.v[t - 2] ^
+                __builtin_shuffle(w.v[t - 1], (v4si){ 0, 0, 0, 0 },
+                                  (v4si){ 1, 2, 3, 4 });
+            w.v[t] = VROL(x, 1) ^
+                     __builtin_shuffle(VROL(x, 2), (v4si){ 0, 0, 0, 0 },
+                                       (v4si){ 4, 5, 6, 0 });
+        }
+
+        /* from 32 on, W[t] = rol2(W[t-6] ^ W[t-16] ^ W[t-28] ^ W[t-32]) */
+        for ( t = 8; t < 20; t++ ) {
+            x = __builtin_shuffle(w.v[t - 2], w.v[t - 1], (v4si){ 2, 3, 4, 5 }) ^
+                w.v[t - 4] ^ w.v[t - 7] ^ w.v[t - 8];
+            w.v[t] = VROL(x, 2);
+        }
+
+        for ( t = 0; t < 20; t++ ) {
+            k = K160[t / 5];
+            wk.v[t] = w.v[t] + (v4si){ k, k, k, k };
+        }
+
+        a = h[0]; b = h[1]; c = h[2]; d = h[3]; e = h[4];
+
+        for ( t = 0; t < 20; t += 5 )
+            SSE_RND160_5(SSE_Ch, t);
+        for ( ; t < 40; t += 5 )
+            SSE_RND160_5(SSE_Parity, t);
+        for ( ; t < 60; t += 5 )
+            SSE_RND160_5(SSE_Maj, t);
+        for ( ; t < 80; t += 5 )
+            SSE_RND160_5(SSE_Parity, t);
+
+        h[0] += a; h[1] += b; h[2] += c; h[3] += d; h[4] += e;
+    }
+}
@@ -0,0 +1,173 @@
+#include <types.h>
+#include <stdbool.h>
+#include <string.h>
+#include <sha256.h>
+#include <sm3.h>
+
+/*
+ * SM3 (GB/T 32905-2016), in the style of sha256.c. The padding and the
+ * big endian message and length layout are those of SHA-256; the message
+ * expansion and compression are SM3's own.
+ */
+
+/* rotate left, n may be 0; x is cut to 32 bits first, as sums may carry */
+#define ROL(x, n)       ((u32)(((u32)(x) << (n)) | \
+                               ((u32)(x) >> ((32 - (n)) & 31))))
+#define P0(x)           ((x) ^ ROL((x), 9) ^ ROL((x), 17))
+#define P1(x)           ((x) ^ ROL((x), 15) ^ ROL((x), 23))
+#define FF0(x,y,z)      ((x) ^ (y) ^ (z))
+#define FF1(x,y,z)      (((x) & (y)) | ((x) & (z)) | ((y) & (z)))
+#define GG0(x,y,z)      ((x) ^ (y) ^ (z))
+#define GG1(x,y,z)      ((z) ^ ((x) & ((y) ^ (z))))
+
+#define T0              0x79CC4519UL
+#define T1              0x7A879D8AUL
+
+/* compress 512-bits */
+static void sm3_compress(sm3_state *md, const unsigned char *buf)
+{
+    u32 W[68], A, B, C, D, E, F, G, H, SS1, SS2, TT1, TT2, x;
+    int j;
+
+    /* copy the state into 512-bits into W[0..15] */
+    for (j = 0; j < 16; j++) {
+        LOAD32H(W[j], buf + (4*j));
+    }
+
+    /* expand into W[16..67], W'[j] is W[j] ^ W[j+4] */
+    for (j = 16; j < 68; j++) {
+        x = W[j - 16] ^ W[j - 9] ^ ROL(W[j - 3], 15);
+        W[j] = P1(x) ^ ROL(W[j - 13], 7) ^ W[j - 6];
+    }
+
+    A = md->state[0]; B = md->state[1]; C = md->state[2]; D = md->state[3];
+    E = md->state[4]; F = md->state[5]; G = md->state[6]; H = md->state[7];
+
+#define RND(FF, GG, T)                                      \
+    SS1 = ROL(ROL(A, 12) + E + ROL(T, j % 32), 7);          \
+    SS2 = SS1 ^ ROL(A, 12);                                 \
+    TT1 = FF(A, B, C) + D + SS2 + (W[j] ^ W[j + 4]);        \
+    TT2 = GG(E, F, G) + H + SS1 + W[j];                     \
+    D = C; C = ROL(B, 9); B = A; A = TT1;                   \
+    H = G; G = ROL(F, 19); F = E; E = P0(TT2);
+
+    for (j = 0; j < 16; j++) {
+        RND(FF0, GG0, T0);
+    }
+    for (; j < 64; j++) {
+        RND(FF1, GG1, T1);
+    }
+#undef RND
+
+    /* feedback, SM3 chains with xor rather than addition */
+    md->state[0] ^= A; md->state[1] ^= B; md->state[2] ^= C;
+    md->state[3] ^= D; md->state[4] ^= E; md->state[5] ^= F;
+    md->state[6] ^= G; md->state[7] ^= H;
+}
+
+#define MIN(x, y) ( ((x)<(y))?(x):(y) )
+int sm3_process(sm3_state * md, const unsigned char *in, unsigned long inlen)
+{
+    unsigned long n;
+
+    if (md == NULL || in == NULL)
+        return -1;
+    if (md->curlen > sizeof(md->buf))
+        return -1;
+
+    while (inlen > 0) {
+        if (md->curlen == 0 && inlen >= SM3_BLOCK_SIZE) {
+            sm3_compress(md, in);
+            md->length += SM3_BLOCK_SIZE * 8;
+            in += SM3_BLOCK_SIZE;
+            inlen -= SM3_BLOCK_SIZE;
+        } else {
+            n = MIN(inlen, (SM3_BLOCK_SIZE - md->curlen));
+            tb_memcpy(md->buf + md->curlen, in, (size_t)n);
+            md->curlen += n;
+            in += n;
+            inlen -= n;
+            if (md->curlen == SM3_BLOCK_SIZE) {
+                sm3_compress(md, md->buf);
+                md->length += 8*SM3_BLOCK_SIZE;
+                md->curlen = 0;
+            }
+        }
+    }
+    return 0;
+}
+
+void sm3_init(sm3_state * md)
+{
+    if (md == NULL)
+        return;
+
+    md->curlen = 0;
+    md->length = 0;
+    md->state[0] = 0x7380166FUL;
+    md->state[1] = 0x4914B2B9UL;
+    md->state[2] = 0x172442D7UL;
+    md->state[3] = 0xDA8A0600UL;
+    md->state[4] = 0xA96F30BCUL;
+    md->state[5] = 0x163138AAUL;
+    md->state[6] = 0xE38DEE4DUL;
+    md->state[7] = 0xB0FB0E4EUL;
+}
+
+/**
+   Terminate the hash to get the digest
+   @param md  The hash state
+   @param out [out] The destination of the hash (32 bytes)
+   @return 0 if successful
+*/
+int sm3_done(sm3_state * md, unsigned char *out)
+{
+    int i;
+
+    if (md == NULL || out == NULL)
+        return -1;
+
+    if (md->curlen >= sizeof(md->buf))
+        return -1;
+
+    /* increase the length of the message */
+    md->length += md->curlen * 8;
+
+    /* append the '1' bit */
+    md->buf[md->curlen++] = (unsigned char)0x80;
+
+    /* no room for the length, pad out this block and start another */
+    if (md->curlen > 56) {
+        while (md->curlen < 64) {
+            md->buf[md->curlen++] = (unsigned char)0;
+        }
+        sm3_compress(md, md->buf);
+        md->curlen = 0;
+    }
+
+    /* pad upto 56 bytes of zeroes */
+    while (md->curlen < 56) {
+        md->buf[md->curlen++] = (unsigned char)0;
+    }
+
+    /* store length */
+    STORE64H(md->length, md->buf+56);
+    sm3_compress(md, md->buf);
+
+    /* copy output */
+    for (i = 0; i < 8; i++) {
+        STORE32H(md->state[i], out+(4*i));
+    }
+
+    return 0;
+}
+
+void sm3_buffer(const unsigned char *buffer, size_t len,
+                unsigned char hash[32])
+{
+    sm3_state md;
+
+    sm3_init(&md);
+    sm3_process(&md, buffer, len);
+    sm3_done(&md, hash);
+}
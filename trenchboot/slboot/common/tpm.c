@@ -54,7 +54,9 @@ __data struct tpm_if g_tpm = {
     .timeout.timeout_d = TIMEOUT_D,
 };
 
-u16 tboot_alg_list[] = {TB_HALG_SHA1, TB_HALG_SHA256};
+u16 tboot_alg_list[] = {TB_HALG_SHA1, TB_HALG_SHA256, TB_HALG_SHA384,
+                        TB_HALG_SHA512, TB_HALG_SM3};
+unsigned int tboot_alg_count = ARRAY_SIZE(tboot_alg_list);
 
 /* Global variables for TPM status register */
 static tpm20_reg_sts_t       g_reg_sts, *g_reg_sts_20 = &g_reg_sts;
@@ -408,9 +410,17 @@ RelinquishControl:
     return false;
 }
 
-bool tpm_submit_cmd(u32 locality, u8 *in, u32 in_size,  u8 *out, u32 *out_size)
+/*
+ * The command sent is in[] followed by data[], which lets a large payload go
+ * to the TPM straight from where it lives rather than being marshalled into
+ * the command buffer first. data may be NULL when data_size is 0.
+ */
+bool tpm_submit_cmd_data(u32 locality, u8 *in, u32 in_size,
+                         const u8 *data, u32 data_size,
+                         u8 *out, u32 *out_size)
 {
-    u32 i, rsp_size, offset;
+    u32 i, rsp_size, offset, cmd_size;
+    const u8 *cmd_byte;
     u16 row_size;
     tpm_reg_access_t    reg_acc;
     bool ret = true;
@@ -419,7 +429,8 @@ bool tpm_submit_cmd(u32 locality, u8 *in, u32 in_size,  u8 *out, u32 *out_size)
         printk(TBOOT_WARN"TPM: Invalid locality for tpm_write_cmd_fifo()\n");
         return false;
     }
-    if ( in == NULL || out == NULL || out_size == NULL ) {
+    if ( in == NULL || out == NULL || out_size == NULL ||
+         (data == NULL && data_size != 0) ) {
         printk(TBOOT_WARN"TPM: Invalid parameter for tpm_write_cmd_fifo()\n");
         return false;
     }
@@ -437,12 +448,15 @@ bool tpm_submit_cmd(u32 locality, u8 *in, u32 in_size,  u8 *out, u32 *out_size)
 
 #ifdef TPM_TRACE
     {
-        printk(TBOOT_DETA"TPM: cmd size = 0x%x\nTPM: cmd content: ", in_size);
+        printk(TBOOT_DETA"TPM: cmd size = 0x%x\nTPM: cmd content: ", in_size + data_size);
         print_hex("TPM: \t", in, in_size);
+        if ( data_size > 0 )
+            print_hex("TPM: \t", data, data_size);
     }
 #endif
 
     /* write the command to the TPM FIFO */
+    cmd_size = in_size + data_size;
     offset = 0;
     do {
         i = 0;
@@ -459,8 +473,11 @@ bool tpm_submit_cmd(u32 locality, u8 *in, u32 in_size,  u8 *out, u32 *out_size)
             goto RelinquishControl;
         }
 
-        for ( ; row_size > 0 && offset < in_size; row_size--, offset++ )  write_tpm_reg(locality, TPM_REG_DATA_FIFO,  (tpm_reg_data_fifo_t *)&in[offset]);
-    } while ( offset < in_size );
+        for ( ; row_size > 0 && offset < cmd_size; row_size--, offset++ ) {
+            cmd_byte = (offset < in_size) ? &in[offset] : &data[offset - in_size];
+            write_tpm_reg(locality, TPM_REG_DATA_FIFO,  (tpm_reg_data_fifo_t *)cmd_byte);
+        }
+    } while ( offset < cmd_size );
 
     i = 0;
     do {
@@ -543,8 +560,15 @@ RelinquishControl:
     return ret;
 }
 
+bool tpm_submit_cmd(u32 locality, u8 *in, u32 in_size,  u8 *out, u32 *out_size)
+{
+    return tpm_submit_cmd_data(locality, in, in_size, NULL, 0, out, out_size);
+}
 
-bool tpm_submit_cmd_crb(u32 locality, u8 *in, u32 in_size,  u8 *out, u32 *out_size)
+/* as tpm_submit_cmd_data(), for the CRB interface */
+bool tpm_submit_cmd_crb_data(u32 locality, u8 *in, u32 in_size,
+                             const u8 *data, u32 data_size,
+                             u8 *out, u32 *out_size)
 {
     uint32_t i;
     bool ret = true;
@@ -560,7 +584,8 @@ bool tpm_submit_cmd_crb(u32 locality, u8 *in, u32 in_size,  u8 *out, u32 *out_si
         printk(TBOOT_WARN"TPM: Invalid locality for tpm_submit_cmd_crb()\n");
         return false;
     }
-    if ( in == NULL || out == NULL || out_size == NULL ) {
+    if ( in == NULL || out == NULL || out_size == NULL ||
+         (data == NULL && data_size != 0) ) {
         printk(TBOOT_WARN"TPM: Invalid parameter for tpm_submit_cmd_crb()\n");
         return false;
     }
@@ -581,8 +606,10 @@ bool tpm_submit_cmd_crb(u32 locality, u8 *in, u32 in_size,  u8 *out, u32 *out_si
 
 #ifdef TPM_TRACE
     {
-        printk(TBOOT_DETA"TPM: Before submit, cmd size = 0x%x\nTPM: Before submit, cmd content: ", in_size);
+        printk(TBOOT_DETA"TPM: Before submit, cmd size = 0x%x\nTPM: Before submit, cmd content: ", in_size + data_size);
         print_hex("TPM: \t", in, in_size);
+        if ( data_size > 0 )
+            print_hex("TPM: \t", data, data_size);
     }
 #endif
 
@@ -614,6 +641,8 @@ bool tpm_submit_cmd_crb(u32 locality, u8 *in, u32 in_size,  u8 *out, u32 *out_si
         write_tpm_reg(locality, tpm_crb_data_buffer_base++,  (tpm_reg_data_crb_t *)&in[i]);
         //tpm_crb_data_buffer_base++;
     }
+    for ( i = 0 ; i< data_size; i++ )
+        write_tpm_reg(locality, tpm_crb_data_buffer_base++,  (tpm_reg_data_crb_t *)&data[i]);
 
     /* command has been written to the TPM, it is time to execute it. */
     start.start = 1;
@@ -663,6 +692,11 @@ RelinquishControl:
     return ret;
 }
 
+bool tpm_submit_cmd_crb(u32 locality, u8 *in, u32 in_size,  u8 *out, u32 *out_size)
+{
+    return tpm_submit_cmd_crb_data(locality, in, in_size, NULL, 0, out, out_size);
+}
+
 bool release_locality(uint32_t locality)
 {
     uint32_t i;
@@ -1310,7 +1310,7 @@ static uint32_t _tpm20_sequence_update(uint32_t locality,
                                        tpm_sequence_update_out *out)
 {
     u32 ret;
-    u32 cmd_size, rsp_size;
+    u32 cmd_size, head_size, rsp_size;
     u16 rsp_tag;
     void *other;
     
@@ -1322,19 +1322,28 @@ static uint32_t _tpm20_sequence_update(uint32_t locality,
 
     reverse_copy_sessions_in(&other, &in->sessions);
 
-    other += reverse_copy_sized_buf_in((TPM2B *)other, (TPM2B *)&(in->buf));
+    /*
+     * Only the size of the TPM2B is marshalled, its buffer follows the
+     * command head into the TPM straight from in->data.
+     */
+    if ( in->size > MAX_DIGEST_BUFFER || (in->data == NULL && in->size != 0) )
+        return TPM_RC_FAILURE;
+    reverse_copy_in(other, in->size);
 
     /* Now set the command size field, now that we know the size of the whole command */
-    cmd_size = (u8 *)other - cmd_buf;
+    head_size = (u8 *)other - cmd_buf;
+    cmd_size = head_size + in->size;
     reverse_copy(cmd_buf + CMD_SIZE_OFFSET, &cmd_size, sizeof(cmd_size));
 
     rsp_size = sizeof(*out);
     if (g_tpm_family == TPM_IF_20_FIFO) {
-        if (!tpm_submit_cmd(locality, cmd_buf, cmd_size, rsp_buf, &rsp_size))
+        if (!tpm_submit_cmd_data(locality, cmd_buf, head_size, in->data,
+                                 in->size, rsp_buf, &rsp_size))
             return TPM_RC_FAILURE;
         }
     if (g_tpm_family == TPM_IF_20_CRB) {
-        if (!tpm_submit_cmd_crb(locality, cmd_buf, cmd_size, rsp_buf, &rsp_size))
+        if (!tpm_submit_cmd_crb_data(locality, cmd_buf, head_size, in->data,
+                                     in->size, rsp_buf, &rsp_size))
             return TPM_RC_FAILURE;
         }
 
@@ -2237,10 +2246,8 @@ static bool tpm20_hash(struct tpm_if *ti, u32 locality, const u8 *data,
             chunk_size = data_size - i;
         }
 
-        buffer.t.size = chunk_size;
-        tb_memcpy( &(buffer.t.buffer[0]), &(data[i] ), chunk_size );
-
-        update_in.buf = buffer;
+        update_in.data = &data[i];
+        update_in.size = chunk_size;
         ret = _tpm20_sequence_update(locality, &update_in, &update_out);
         if (ret != TPM_RC_SUCCESS) {
             printk(TBOOT_WARN"TPM: SequenceUpdate return value = %08X\n", ret);
@@ -2569,7 +2576,7 @@ static uint32_t tpm20_save_state(struct tpm_if *ti, uint32_t locality)
 
 static bool alg_is_supported(u16 alg)
 {
-    for (int i=0; i<2; i++) {
+    for (unsigned int i=0; i<tboot_alg_count; i++) {
         if (alg == tboot_alg_list[i])
             return true;
     }
@@ -96,12 +96,27 @@ static inline unsigned int get_hash_size(uint16_t hash_alg)
         return 0;
 }
 
+#define MAX_ALG_NUM 5
+
+typedef struct {
+    uint16_t  alg;
+    tb_hash_t hash;
+} hash_entry_t;
+
+typedef struct {
+    uint32_t  count;
+    hash_entry_t entries[MAX_ALG_NUM];
+} hash_list_t;
+
 extern bool are_hashes_equal(const tb_hash_t *hash1, const tb_hash_t *hash2,
                              uint16_t hash_alg);
 extern bool hash_buffer(const unsigned char* buf, size_t size, tb_hash_t *hash,
                         uint16_t hash_alg);
 extern bool extend_hash(tb_hash_t *hash1, const tb_hash_t *hash2,
                         uint16_t hash_alg);
+extern bool hash_buffer_multi(const unsigned char *buf, size_t size,
+                              const uint16_t *algs, unsigned int count,
+                              hash_list_t *hl);
 extern void print_hash(const tb_hash_t *hash, uint16_t hash_alg);
 extern void copy_hash(tb_hash_t *dest_hash, const tb_hash_t *src_hash,
                       uint16_t hash_alg);
@@ -164,6 +164,16 @@ static always_inline uint32_t cpuid_edx(unsigned int op)
 #define CPUID_X86_FEATURE_XMM3   (1<<0)
 #define CPUID_X86_FEATURE_VMX    (1<<5)
 #define CPUID_X86_FEATURE_SMX    (1<<6)
+#define CPUID_X86_FEATURE_SSSE3  (1<<9)
+#define CPUID_X86_FEATURE_SSE4_1 (1<<19)
+
+/* CPUID.1:EDX */
+#define CPUID_X86_FEATURE_FXSR   (1<<24)
+#define CPUID_X86_FEATURE_XMM    (1<<25)
+#define CPUID_X86_FEATURE_XMM2   (1<<26)
+
+/* CPUID.(EAX=7,ECX=0):EBX */
+#define CPUID_X86_FEATURE_SHA    (1<<29)
 
 static inline unsigned long read_cr0(void)
 {
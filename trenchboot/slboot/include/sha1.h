@@ -58,6 +58,12 @@ struct sha1_ctxt {
     uint8_t count;
 };
 
+/* compress n consecutive 64 byte blocks into the five state words */
+typedef void (*sha1_blocks_t)(uint32_t *h, const uint8_t *data, size_t n);
+
+extern sha1_blocks_t sha1_blocks;
+extern void sha1_blocks_generic(uint32_t *h, const uint8_t *data, size_t n);
+
 extern void sha1_init(struct sha1_ctxt *);
 extern void sha1_pad(struct sha1_ctxt *);
 extern void sha1_loop(struct sha1_ctxt *, const uint8_t *, size_t);
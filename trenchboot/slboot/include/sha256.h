@@ -23,6 +23,18 @@ typedef struct {
     unsigned char buf[64];
 }sha256_state;
 
+/* compress n consecutive 64 byte blocks into the eight state words */
+typedef void (*sha256_blocks_t)(u32 *state, const unsigned char *buf,
+                                size_t n);
+
+extern sha256_blocks_t sha256_blocks;
+void sha256_blocks_generic(u32 *state, const unsigned char *buf, size_t n);
+
+void sha256_init(sha256_state *md);
+int sha256_process(sha256_state *md, const unsigned char *in,
+                   unsigned long inlen);
+int sha256_done(sha256_state *md, unsigned char *out);
+
 void sha256_buffer(const unsigned char *buffer, size_t len,
                   unsigned char hash[32]);
 
@@ -0,0 +1,31 @@
+#ifndef __SHA512_H__
+#define __SHA512_H__
+
+#define SHA512_BLOCK_SIZE   128
+
+#define LOAD64H(x, y)                                                      \
+     { x = (((u64)((y)[0] & 255))<<56)|(((u64)((y)[1] & 255))<<48) |       \
+           (((u64)((y)[2] & 255))<<40)|(((u64)((y)[3] & 255))<<32) |       \
+           (((u64)((y)[4] & 255))<<24)|(((u64)((y)[5] & 255))<<16) |       \
+           (((u64)((y)[6] & 255))<<8)|(((u64)((y)[7] & 255))); }
+
+/* shared by SHA-384, which is SHA-512 with another IV, truncated */
+typedef struct {
+    u64 length;
+    u64 state[8];
+    u32 curlen;
+    unsigned char buf[SHA512_BLOCK_SIZE];
+} sha512_state;
+
+void sha384_init(sha512_state *md);
+void sha512_init(sha512_state *md);
+int sha512_process(sha512_state *md, const unsigned char *in,
+                   unsigned long inlen);
+int sha512_done(sha512_state *md, unsigned char *out);
+
+void sha384_buffer(const unsigned char *buffer, size_t len,
+                   unsigned char hash[48]);
+void sha512_buffer(const unsigned char *buffer, size_t len,
+                   unsigned char hash[64]);
+
+#endif /* __SHA512_H__ */
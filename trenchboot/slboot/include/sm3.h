@@ -0,0 +1,19 @@
+#ifndef __SM3_H__
+#define __SM3_H__
+
+#define SM3_BLOCK_SIZE   64
+
+typedef struct {
+    u64 length;
+    u32 state[8], curlen;
+    unsigned char buf[SM3_BLOCK_SIZE];
+} sm3_state;
+
+void sm3_init(sm3_state *md);
+int sm3_process(sm3_state *md, const unsigned char *in, unsigned long inlen);
+int sm3_done(sm3_state *md, unsigned char *out);
+
+void sm3_buffer(const unsigned char *buffer, size_t len,
+                unsigned char hash[32]);
+
+#endif /* __SM3_H__ */
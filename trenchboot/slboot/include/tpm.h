@@ -157,18 +157,6 @@ typedef struct __packed {
 #define TPM_ALG_LAST              0x0044
 #define TPM_ALG_MAX_NUM           (TPM_ALG_LAST - TPM_ALG_ERROR)
 
-#define MAX_ALG_NUM 5
-
-typedef struct {
-    uint16_t  alg;
-    tb_hash_t hash;
-} hash_entry_t;
-
-typedef struct {
-    uint32_t  count;
-    hash_entry_t entries[MAX_ALG_NUM];
-} hash_list_t;
-
 
 // move from tpm.c
 
@@ -425,6 +413,7 @@ static inline void _reverse_copy(uint8_t *out, uint8_t *in, uint32_t count)
 
 /* alg id list supported by Tboot */
 extern u16 tboot_alg_list[];
+extern unsigned int tboot_alg_count;
 
 typedef tb_hash_t tpm_digest_t;
 typedef tpm_digest_t tpm_pcr_value_t;
@@ -516,6 +505,12 @@ extern bool tpm_detect(void);
 extern void tpm_print(struct tpm_if *ti);
 extern bool tpm_submit_cmd(u32 locality, u8 *in, u32 in_size, u8 *out, u32 *out_size);
 extern bool tpm_submit_cmd_crb(u32 locality, u8 *in, u32 in_size, u8 *out, u32 *out_size);
+extern bool tpm_submit_cmd_data(u32 locality, u8 *in, u32 in_size,
+                                const u8 *data, u32 data_size,
+                                u8 *out, u32 *out_size);
+extern bool tpm_submit_cmd_crb_data(u32 locality, u8 *in, u32 in_size,
+                                    const u8 *data, u32 data_size,
+                                    u8 *out, u32 *out_size);
 extern bool tpm_wait_cmd_ready(uint32_t locality);
 extern bool tpm_request_locality_crb(uint32_t locality);
 extern bool tpm_relinquish_locality_crb(uint32_t locality);
@@ -1366,7 +1366,9 @@ typedef struct {
 typedef struct {
     u32 handle;
     TPM_CMD_SESSIONS_IN sessions;
-    TPM2B_MAX_BUFFER buf;
+    /* not copied, the payload is sent to the TPM from here */
+    const u8 *data;
+    u16 size;
 } tpm_sequence_update_in;
 
 typedef struct {
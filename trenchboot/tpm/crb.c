@@ -5,11 +5,13 @@
  *      Daniel P. Smith <dpsmith@apertussolutions.com>
  */
 
+#include <mem.h>
 #include <tpm.h>
 #include <tpmbuff.h>
 
 #include "crb.h"
 #include "tpm_common.h"
+#include "tpm_stats.h"
 
 #define TPM_LOC_STATE		0x0000
 #define TPM_LOC_CTRL		0x0008
@@ -29,10 +31,27 @@
 #define TPM_CRB_CTRL_RSP_ADDR	0x0068
 #define TPM_CRB_DATA_BUFFER	0x0080
 
-#define REGISTER(l, r)		(((l) << 12) | r)
+#define REGISTER(l, r)		(((l) << 12) | (r))
+/* control area registers, at the offset the TPM2 table gives */
+#define CTRL(l, r)		(ctrl_area + REGISTER(l, (r) - TPM_CRB_CTRL_REQ))
+/* CTRL_REQ through CTRL_RSP_ADDR */
+#define TPM_CRB_CTRL_AREA_SIZE	0x30
 
 static u8 locality = TPM_NO_LOCALITY;
 
+/*
+ * Offset of locality 0's control area in the register window, the others
+ * following a page apart as on any PTP CRB.
+ */
+static u32 ctrl_area = TPM_CRB_CTRL_REQ;
+
+/* the command and response buffers the control area points locality at */
+static u8 *cmd_buf;
+static u8 *rsp_buf;
+static u32 cmd_size;
+static u32 rsp_size;
+static u8 buffers_locality = TPM_NO_LOCALITY;
+
 struct tpm_loc_state {
 	union {
 		u8 val;
@@ -102,96 +121,48 @@ struct tpm_crb_intf_id_ext {
 	};
 } __packed;
 
-/*
- * Durations derived from Table 15 of the PTP but is purely an artifact of this
- * implementation.
- */
-
-/* TPM Duration A: 20ms */
-static void duration_a(void)
-{
-	tpm_udelay(20);
-}
-
-/* TPM Duration B: 750ms */
-static void duration_b(void)
-{
-	tpm_udelay(750);
-}
-
-/* TPM Duration C: 1000ms */
-static void duration_c(void)
-{
-	tpm_udelay(1000);
-}
-
-/* Timeouts defined in Table 16 of the PTP */
-
-/* TPM Timeout A: 750ms */
-static void timeout_a(void)
-{
-	tpm_udelay(750);
-}
-
-/* TPM Timeout B: 2000ms */
-static void timeout_b(void)
-{
-	tpm_udelay(2000);
-}
-
-/* TPM Timeout C: 200ms */
-static void timeout_c(void)
-{
-	tpm_udelay(200);
-}
-
-/* TPM Timeout D: 30ms */
-static void timeout_d(void)
-{
-	tpm_udelay(30);
-}
-
 static u8 is_idle(void)
 {
 	struct tpm_crb_ctrl_sts ctl_sts;
 
-	ctl_sts.val = tpm_read32(REGISTER(locality, TPM_CRB_CTRL_STS));
+	ctl_sts.val = tpm_read32(CTRL(locality, TPM_CRB_CTRL_STS));
 	if (ctl_sts.tpm_idle == 1)
 		return 1;
 
 	return 0;
 }
 
-static u8 is_ready(void)
-{
-	struct tpm_crb_ctrl_sts ctl_sts;
-
-	ctl_sts.val = tpm_read32(REGISTER(locality, TPM_CRB_CTRL_STS));
-
-	return ctl_sts.val == 0;
-}
-
 static u8 is_cmd_exec(void)
 {
 	u32 ctrl_start;
 
-	ctrl_start = tpm_read32(REGISTER(locality, TPM_CRB_CTRL_START));
+	ctrl_start = tpm_read32(CTRL(locality, TPM_CRB_CTRL_START));
 	if (ctrl_start == 1)
 		return 1;
 
 	return 0;
 }
 
+static u8 is_not_idle(void)
+{
+	return !is_idle();
+}
+
+static u8 is_cmd_done(void)
+{
+	return !is_cmd_exec();
+}
+
 static u8 cmd_ready(void)
 {
 	struct tpm_crb_ctrl_req ctl_req;
 
 	if (is_idle()) {
+		ctl_req.val = 0;
 		ctl_req.cmd_ready = 1;
-		tpm_write32(REGISTER(locality, TPM_CRB_CTRL_REQ), ctl_req.val);
-		timeout_c();
+		tpm_write32(ctl_req.val, CTRL(locality, TPM_CRB_CTRL_REQ));
 
-		if (is_idle())
+		if (!tpm_poll(is_not_idle, TPM_TIMEOUT_C))
 			return -1;
 	}
 
@@ -205,67 +176,165 @@ static void go_idle(void)
 	if (is_idle())
 		return;
 
+	ctl_req.val = 0;
 	ctl_req.go_idle = 1;
-	tpm_write32(REGISTER(locality, TPM_CRB_CTRL_REQ), ctl_req.val);
+	tpm_write32(ctl_req.val, CTRL(locality, TPM_CRB_CTRL_REQ));
 
-	/* pause to give tpm time to complete the request */
-	timeout_c();
+	tpm_poll(is_idle, TPM_TIMEOUT_C);
+}
+
+static u8 *data_buffer(void)
+{
+	return (u8 *)(u64)(TPM_MMIO_BASE |
+			   REGISTER(locality, TPM_CRB_DATA_BUFFER));
+}
+
+static u64 read64(u32 reg)
+{
+	return (u64)tpm_read32(CTRL(locality, reg + 4)) << 32 |
+	       tpm_read32(CTRL(locality, reg));
+}
+
+/*
+ * Take the buffer addresses from the control area rather than assuming
+ * they follow it, falling back to the data buffer when they read as zero.
+ */
+static void load_buffers(void)
+{
+	cmd_buf = (u8 *)read64(TPM_CRB_CTRL_CMD_LADDR);
+	cmd_size = tpm_read32(CTRL(locality, TPM_CRB_CTRL_CMD_SIZE));
+	if (!cmd_buf || !cmd_size) {
+		cmd_buf = data_buffer();
+		cmd_size = TPM_CRB_DATA_BUFFER_SIZE;
+	}
+
+	rsp_buf = (u8 *)read64(TPM_CRB_CTRL_RSP_ADDR);
+	rsp_size = tpm_read32(CTRL(locality, TPM_CRB_CTRL_RSP_SIZE));
+	if (!rsp_buf || !rsp_size) {
+		rsp_buf = data_buffer();
+		rsp_size = TPM_CRB_DATA_BUFFER_SIZE;
+	}
+}
+
+/* the buffers only need reading the first time a locality is used */
+static void set_locality(u8 l)
+{
+	locality = l;
+	if (l == buffers_locality)
+		return;
+
+	load_buffers();
+	buffers_locality = l;
 }
 
 static void crb_relinquish_locality_internal(u16 l)
 {
 	struct tpm_loc_ctrl loc_ctrl;
 
+	loc_ctrl.val = 0;
 	loc_ctrl.relinquish = 1;
 
-	tpm_write32(REGISTER(l, TPM_LOC_CTRL), loc_ctrl.val);
+	tpm_write32(loc_ctrl.val, REGISTER(l, TPM_LOC_CTRL));
+}
+
+/* the locality crb_request_locality is waiting on */
+static u8 requested = TPM_NO_LOCALITY;
+
+static u8 locality_granted(void)
+{
+	struct tpm_loc_sts loc_sts;
+
+	loc_sts.val = tpm_read32(REGISTER(requested, TPM_LOC_STS));
+
+	return loc_sts.granted == 1;
 }
 
+/*
+ * Take locality l, keeping it if it is already held so back to back
+ * commands do not cycle it. The grant is polled with backoff for up to
+ * TIMEOUT_A, after which the request is withdrawn and -ETIMEDOUT returned.
+ */
 s8 crb_request_locality(u8 l)
 {
 	struct tpm_loc_state loc_state;
 	struct tpm_loc_ctrl loc_ctrl;
-	struct tpm_loc_sts loc_sts;
+
+	if (l > TPM_MAX_LOCALITY)
+		return -EINVAL;
+
+	if (l == locality) {
+		tpm_stats_add(locality_hits, 1);
+		return 0;
+	}
 
 	/* TPM_LOC_STATE is aliased across all localities */
 	loc_state.val = tpm_read8(REGISTER(0, TPM_LOC_STATE));
 
 	if (loc_state.loc_assigned == 1) {
-		if (loc_state.active_locality == l) {
-			locality = l;
-			return 0;
-		}
+		if (loc_state.active_locality == l)
+			goto granted;
 
-		crb_relinquish_locality_internal(loc_state.loc_assigned);
+		crb_relinquish_locality_internal(loc_state.active_locality);
 	}
 
+	loc_ctrl.val = 0;
 	loc_ctrl.request_access = 1;
-	tpm_write32(REGISTER(l, TPM_LOC_CTRL), loc_ctrl.val);
+	tpm_write32(loc_ctrl.val, REGISTER(l, TPM_LOC_CTRL));
 
-	loc_sts.val = tpm_read32(REGISTER(l, TPM_LOC_STS));
-	if (loc_sts.granted != 1) {
+	requested = l;
+	if (!tpm_poll_backoff(locality_granted, TPM_TIMEOUT_A)) {
+		crb_relinquish_locality_internal(l);
 		locality = TPM_NO_LOCALITY;
-		return -EAGAIN;
+		tpm_stats_add(locality_timeouts, 1);
+		return -ETIMEDOUT;
+	}
+
+granted:
+	set_locality(l);
+
+	/* a TPM left idle by the previous owner takes no commands */
+	if (cmd_ready() != 0) {
+		crb_relinquish_locality_internal(l);
+		locality = TPM_NO_LOCALITY;
+		return -ETIMEDOUT;
 	}
 
-	locality = l;
 	return 0;
 }
 
 void crb_relinquish_locality(void)
 {
+	if (locality > TPM_MAX_LOCALITY)
+		return;
+
 	crb_relinquish_locality_internal(locality);
+	locality = TPM_NO_LOCALITY;
 }
 
-u8 crb_init(struct tpm *t)
+/*
+ * ctrl is the control area address from the TPM2 table, 0 for the PTP
+ * default. Every locality's control area has to fall in the register
+ * window, which is all tpm_read32 and tpm_write32 can reach.
+ */
+u8 crb_init(struct tpm *t, u64 ctrl)
 {
 	u8 i;
 	struct tpm_crb_intf_id_ext id;
 
+	if (ctrl == 0)
+		ctrl = TPM_MMIO_BASE | TPM_CRB_CTRL_REQ;
+	if (ctrl < TPM_MMIO_BASE || (ctrl & 3) ||
+	    ctrl - TPM_MMIO_BASE + REGISTER(TPM_MAX_LOCALITY,
+			TPM_CRB_CTRL_AREA_SIZE) > TPM_MMIO_SIZE)
+		return 0;
+
+	ctrl_area = ctrl - TPM_MMIO_BASE;
+	buffers_locality = TPM_NO_LOCALITY;
+
 	for (i = 0; i <= TPM_MAX_LOCALITY; i++)
 		crb_relinquish_locality_internal(i);
 
-	if (crb_request_locality(0) == TPM_NO_LOCALITY)
+	if (crb_request_locality(0) != 0)
 		return 0;
 
 	id.val = tpm_read32(REGISTER(0, TPM_CRB_INTF_ID + 4));
@@ -285,44 +354,85 @@ u8 crb_init(struct tpm *t)
 static void cancel_send(void)
 {
 	if (is_cmd_exec()) {
-		tpm_write32(REGISTER(locality, TPM_CRB_CTRL_CANCEL), 1);
-		timeout_b();
+		tpm_write32(1, CTRL(locality, TPM_CRB_CTRL_CANCEL));
+		tpm_poll(is_cmd_done, TPM_TIMEOUT_B);
 
-		tpm_write32(REGISTER(locality, TPM_CRB_CTRL_CANCEL), 0);
+		tpm_write32(0, CTRL(locality, TPM_CRB_CTRL_CANCEL));
 	}
 }
 
 size_t crb_send(struct tpmbuff *buf)
 {
+	struct tpmbuff_seg *seg;
 	u32 ctrl_start = 1;
-	u8 count = 0;
+	u8 *dst = cmd_buf;
 
 	if (is_idle())
 		return 0;
 
-	tpm_write32(REGISTER(locality, TPM_CRB_CTRL_START), ctrl_start);
-
-	/*
-	 * Most command sequences this code is interested with operates with
-	 * 20/750 duration/timeout schedule.
-	 */
-	duration_a();
-	ctrl_start = tpm_read32(REGISTER(locality, TPM_CRB_CTRL_START));
-	if (ctrl_start != 0) {
-		timeout_a();
-		ctrl_start = tpm_read32(REGISTER(locality, TPM_CRB_CTRL_START));
-		if (ctrl_start != 0) {
-			cancel_send();
-			/* minimum response is header with cancel ord */
-			return sizeof(struct tpm_header);
-		}
+	if (tpmb_size(buf) > cmd_size)
+		return 0;
+
+	/* drain the head area then the overflow segments into the window */
+	memcpy(dst, buf->head, tpmb_head_len(buf));
+	dst += tpmb_head_len(buf);
+	for (seg = buf->overflow; seg; seg = seg->next) {
+		memcpy(dst, seg->data, seg->len);
+		dst += seg->len;
 	}
 
+	tpm_stats_add(fifo_bytes_out, tpmb_size(buf));
+	tpm_write32(ctrl_start, CTRL(locality, TPM_CRB_CTRL_START));
+
 	return buf->len;
 }
 
-size_t crb_recv(struct tpmbuff *buf)
+/*
+ * Wait up to duration microseconds for the TPM to clear start, which marks
+ * the command sent by crb_send as complete. A command that overruns is
+ * cancelled. Returns 1 once a response is available.
+ */
+u8 crb_wait_response(u32 duration)
 {
-	/* noop, currently send waits until execution is complete*/
+	if (tpm_poll(is_cmd_done, duration))
+		return 1;
+
+	cancel_send();
 	return 0;
 }
+
+/*
+ * Copy the response out of the data buffer into buf, which must be
+ * reserved. As with TIS the header is converted to host order.
+ */
+size_t crb_recv(struct tpmbuff *buf)
+{
+	struct tpm_header *hdr = (struct tpm_header *)buf->head;
+	u8 *src = rsp_buf;
+	size_t size, chunk;
+	u8 *ptr;
+
+	/* crb_wait_response has seen the command complete */
+	memcpy(hdr, src, sizeof(*hdr));
+	hdr->tag = be16_to_cpu(hdr->tag);
+	hdr->size = be32_to_cpu(hdr->size);
+	hdr->code = be32_to_cpu(hdr->code);
+
+	if (hdr->size < sizeof(*hdr) || hdr->size > rsp_size)
+		return 0;
+
+	for (size = sizeof(*hdr); size < hdr->size; size += chunk) {
+		chunk = hdr->size - size;
+		if (chunk > TPMB_SEG_SIZE)
+			chunk = TPMB_SEG_SIZE;
+
+		ptr = tpmb_put(buf, chunk);
+		if (!ptr)
+			return 0;
+
+		memcpy(ptr, src + size, chunk);
+	}
+
+	tpm_stats_add(fifo_bytes_in, hdr->size);
+	return hdr->size;
+}
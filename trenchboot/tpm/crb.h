@@ -16,11 +16,13 @@
 #include <tpm.h>
 
 #define STATIC_TIS_BUFFER_SIZE 1024
+#define TPM_CRB_DATA_BUFFER_SIZE	3966
 /* TPM Interface Specification functions */
 s8 crb_request_locality(u8 l);
 void crb_relinquish_locality(void);
-u8 crb_init(struct tpm *t);
+u8 crb_init(struct tpm *t, u64 ctrl);
 size_t crb_send(struct tpmbuff *buf);
+u8 crb_wait_response(u32 duration);
 size_t crb_recv(struct tpmbuff *buf);
 
 #endif
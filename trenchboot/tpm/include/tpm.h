@@ -10,6 +10,8 @@
 #define _TPM_H
 
 #define TPM_NO_LOCALITY		0xFF
+/* tell tpm_set_rsdp there are no ACPI tables to search */
+#define TPM_NO_RSDP		(~0ULL)
 
 enum tpm_hw_intf {
 	TPM_DEVNODE,
@@ -25,17 +27,117 @@ enum tpm_family {
 
 struct tpmbuff;
 
+/*
+ * Table 72  Definition of TPMT_HA Structure
+ * A list holds count of these back to back, each digest sized by its alg.
+ */
+struct tpmt_ha {
+	u16 alg;	/* TPMI_ALG_HASH	*/
+	u8 digest[0];	/* TPMU_HA		*/
+};
+
+/* Table 100  Definition of TPML_DIGEST_VALUES Structure */
+struct tpml_digest_values {
+	u32 count;
+	struct tpmt_ha digests[0];
+};
+
+/* room for a TPML_DIGEST_VALUES of five banks at the SHA512 digest size */
+#define TPM_MAX_DIGEST_LIST_SIZE	(4 + 5 * (2 + 64))
+
+enum tpm_hash_mode {
+	TPM_HASH_AUTO,
+	TPM_HASH_TPM,
+	TPM_HASH_CPU
+};
+
+/*
+ * How tpm_hash_extend measures a range. TPM hashing streams the range
+ * through an event sequence and fills every active bank. CPU hashing runs
+ * cpu_hash for each active bank and does one extend, which is quicker on
+ * slow TPMs but needs banks to list every active bank's alg. In auto mode
+ * the TPM is used when banks falls short, otherwise the path with the
+ * better rate wins, and when a clock is available the rates are measured
+ * on the fly, trying each path once before settling.
+ */
+struct tpm_hash_policy {
+	enum tpm_hash_mode mode;
+	/* returns 0, or a negative errno if alg is not supported */
+	int (*cpu_hash)(u16 alg, const u8 *data, size_t len, u8 *digest);
+	u16 banks[5];
+	u8 bank_count;
+	/* any monotonic tick counter, the calibrated TSC if NULL */
+	u64 (*now)(void);
+	/* bytes per 1024 ticks of the clock, 0 until known */
+	u64 cpu_rate;
+	u64 tpm_rate;
+};
+
+/*
+ * Driver instrumentation, filled in when built with CONFIG_TPM_STATS. It
+ * is a fixed block the loader can dump or hand on to the kernel as is.
+ * Times are in TSC cycles, or in microseconds when tsc_khz is 0.
+ */
+#define TPM_STATS_VERSION	2
+#define TPM_STATS_MAX_CMDS	16
+/*
+ * Bucket i counts times in [2^(i + SHIFT), 2^(i + SHIFT + 1)), except that
+ * the first bucket takes everything below 2^(SHIFT + 1) and the last one
+ * everything from 2^(BUCKETS - 1 + SHIFT) up.
+ */
+#define TPM_STATS_HIST_BUCKETS	20
+#define TPM_STATS_HIST_SHIFT	12
+
+struct tpm_cmd_stats {
+	u32 code;		/* command code, 0 for a free slot */
+	u32 count;
+	u32 errors;		/* failed exchanges and non-zero responses */
+	u32 timeouts;
+	u64 bytes_out;
+	u64 bytes_in;
+	u64 time;		/* submit to response read */
+	u64 time_max;
+	u32 hist[TPM_STATS_HIST_BUCKETS];
+};
+
+struct tpm_stats {
+	u32 version;
+	u32 tsc_khz;
+	u32 locality_requests;
+	u32 locality_hits;	/* requests for the locality already held */
+	u32 locality_timeouts;
+	u32 dropped;		/* commands without a free slot */
+	u64 locality_time;
+	u64 polls;		/* status reads waiting on the TPM */
+	u64 burst_waits;
+	u64 burst_polls;
+	u64 burst_time;
+	u64 fifo_bytes_out;	/* moved through the TIS FIFO or CRB buffer */
+	u64 fifo_bytes_in;
+	struct tpm_cmd_stats cmds[TPM_STATS_MAX_CMDS];
+};
+
 struct tpm {
 	u32 vendor;
 	enum tpm_family family;
 	enum tpm_hw_intf intf;
 	struct tpmbuff *buff;
+	/* the allocated PCR banks, read at enable, none if unknown */
+	u16 pcr_banks[5];
+	u8 pcr_bank_count;
 };
 
+void tpm_set_rsdp(u64 rsdp);
 struct tpm *enable_tpm(void);
 s8 tpm_request_locality(struct tpm *t, u8 l);
 void tpm_relinquish_locality(struct tpm *t);
 int tpm_extend_pcr(struct tpm *t, u32 pcr, u16 algo,
 		u8 *digest);
+int tpm_extend_pcr_digests(struct tpm *t, u32 pcr,
+		struct tpml_digest_values *digests);
+int tpm_hash_extend(struct tpm *t, u32 pcr, const u8 *data, size_t len,
+		struct tpm_hash_policy *policy,
+		struct tpml_digest_values *digests, size_t size);
+struct tpm_stats *tpm_get_stats(void);
 void free_tpm(struct tpm *t);
 #endif
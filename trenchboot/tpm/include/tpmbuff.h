@@ -9,6 +9,16 @@
 #ifndef _TPMBUFF_H
 #define _TPMBUFF_H
 
+/* overflow segments chained behind a full head area */
+#define TPMB_SEG_SIZE		1024
+#define TPMB_SEG_COUNT		8
+
+struct tpmbuff_seg {
+	struct tpmbuff_seg *next;
+	size_t len;
+	u8 data[TPMB_SEG_SIZE];
+};
+
 /* mirroring Linux SKB */
 struct tpmbuff {
 	size_t truesize;
@@ -20,6 +30,12 @@ struct tpmbuff {
 	u8 *data;
 	u8 *tail;
 	u8 *end;
+
+	/*
+	 * Once the head area is full further puts land in these, in order.
+	 * The contents are the head area up to tail followed by each segment.
+	 */
+	struct tpmbuff_seg *overflow;
 };
 
 u8 *tpmb_reserve(struct tpmbuff *b);
@@ -27,6 +43,7 @@ void tpmb_free(struct tpmbuff *b);
 u8 *tpmb_put(struct tpmbuff *b, size_t size);
 size_t tpmb_trim(struct tpmbuff *b, size_t size);
 size_t tpmb_size(struct tpmbuff *b);
+size_t tpmb_head_len(struct tpmbuff *b);
 struct tpmbuff *alloc_tpmbuff(enum tpm_hw_intf i, u8 locality);
 void free_tpmbuff(struct tpmbuff *b, enum tpm_hw_intf i);
 
@@ -9,12 +9,6 @@ void tpm_io_delay(void)
 	asm volatile ("outb %al, $0x80");
 }
 
-void tpm_udelay(int loops)
-{
-	while (loops--)
-		tpm_io_delay();	/* Approximately 1 us */
-}
-
 u8 tpm_read8(u32 field)
 {
 	void *addr = (void *)(u64)(TPM_MMIO_BASE | field);
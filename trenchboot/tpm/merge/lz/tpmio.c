@@ -8,12 +8,6 @@ void tpm_io_delay(void)
 	io_delay();
 }
 
-void tpm_udelay(int loops)
-{
-	while (loops--)
-		tpm_io_delay();	/* Approximately 1 us */
-}
-
 u8 tpm_read8(u32 field)
 {
 	return ioread8((void*)(u64)(TPM_MMIO_BASE | field));
@@ -54,6 +54,10 @@ echo "Finished tpm.h"
 ./process_file.awk -v header=1 ../tpm2_constants.h >> ${mdir}/early_tpm.h
 #echo "/*** tpm2_auth.h ***/" >> ${mdir}/early_tpm.h
 ./process_file.awk -v header=1 ../tpm2_auth.h >> ${mdir}/early_tpm.h
+#echo "/*** tpm_acpi.h ***/" >> ${mdir}/early_tpm.h
+./process_file.awk -v header=1 ../tpm_acpi.h >> ${mdir}/early_tpm.h
+#echo "/*** tpm_stats.h ***/" >> ${mdir}/early_tpm.h
+./process_file.awk ../tpm_stats.h >> ${mdir}/early_tpm.h
 echo "" >> ${mdir}/early_tpm.h
 echo "#endif" >> ${mdir}/early_tpm.h
 echo "Finished early_tpm.h"
@@ -64,6 +68,12 @@ echo "Finished early_tpm.h"
 #echo "/*** tpmio.c ***/" >> ${mdir}/early_tpm.c
 ./process_file.awk ${mdir}/tpmio.c >> ${mdir}/early_tpm.c
 #echo "" >> ${mdir}/early_tpm.c
+#echo "/*** tpm_time.c ***/" >> ${mdir}/early_tpm.c
+./process_file.awk ../tpm_time.c >> ${mdir}/early_tpm.c
+#echo "" >> ${mdir}/early_tpm.c
+#echo "/*** tpm_stats.c ***/" >> ${mdir}/early_tpm.c
+./process_file.awk ../tpm_stats.c >> ${mdir}/early_tpm.c
+#echo "" >> ${mdir}/early_tpm.c
 #echo "/*** tis.c ***/" >> ${mdir}/early_tpm.c
 ./process_file.awk ../tis.c >> ${mdir}/early_tpm.c
 #echo "" >> ${mdir}/early_tpm.c
@@ -79,6 +89,9 @@ echo "Finished early_tpm.h"
 #echo "/*** tpm2_cmds.c ***/" >> ${mdir}/early_tpm.c
 ./process_file.awk ../tpm2_cmds.c >> ${mdir}/early_tpm.c
 #echo "" >> ${mdir}/early_tpm.c
+#echo "/*** tpm_acpi.c ***/" >> ${mdir}/early_tpm.c
+./process_file.awk ../tpm_acpi.c >> ${mdir}/early_tpm.c
+#echo "" >> ${mdir}/early_tpm.c
 #echo "/*** tpm.c ***/" >> ${mdir}/early_tpm.c
 ./process_file.awk ../tpm.c >> ${mdir}/early_tpm.c
 echo "Finished early_tpm.c"
@@ -0,0 +1,14 @@
+/*
+ * Copyright (c) 2019 Apertus Solutions, LLC
+ *
+ * Author(s):
+ *      Daniel P. Smith <dpsmith@apertussolutions.com>
+ *
+ */
+
+#ifndef _SIM_MEM_H
+#define _SIM_MEM_H
+
+#include <string.h>
+
+#endif
@@ -0,0 +1,699 @@
+/*
+ * Copyright (c) 2019 Apertus Solutions, LLC
+ *
+ * Author(s):
+ *      Daniel P. Smith <dpsmith@apertussolutions.com>
+ *
+ * The register file. TIS and CRB share one command engine; each register
+ * access costs access_ns of virtual time and a command completes exec_us
+ * after it is started, observed on the next access once the clock gets
+ * there. Locality, status and FIFO rules that the driver breaks are
+ * counted as protocol errors.
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include <tpm.h>
+
+#include "../tpm_common.h"
+#include "../tpm_stats.h"
+#include "tpm_sim.h"
+
+#define MMIO_SIZE		0x5000
+#define LOCALITIES		5
+
+/* TIS registers */
+#define TIS_ACCESS		0x000
+#define TIS_INTF_CAPABILITY	0x014
+#define TIS_STS			0x018
+#define TIS_DATA_FIFO		0x024
+#define TIS_INTERFACE_ID	0x030
+#define TIS_XDATA_FIFO		0x080
+#define TIS_DID_VID		0xF00
+
+#define ACCESS_REQUEST_USE	0x02
+#define ACCESS_ACTIVE_LOCALITY	0x20
+#define ACCESS_REG_VALID	0x80
+
+#define STS_VALID		0x80
+#define STS_COMMAND_READY	0x40
+#define STS_GO			0x20
+#define STS_DATA_AVAIL		0x10
+#define STS_DATA_EXPECT		0x08
+
+/* CRB registers */
+#define CRB_LOC_STATE		0x000
+#define CRB_LOC_CTRL		0x008
+#define CRB_LOC_STS		0x00C
+#define CRB_INTF_ID		0x030
+#define CRB_CTRL_REQ		0x040
+#define CRB_CTRL_STS		0x044
+#define CRB_CTRL_CANCEL		0x048
+#define CRB_CTRL_START		0x04C
+#define CRB_CTRL_CMD_SIZE	0x058
+#define CRB_CTRL_CMD_LADDR	0x05C
+#define CRB_CTRL_CMD_HADDR	0x060
+#define CRB_CTRL_RSP_SIZE	0x064
+#define CRB_CTRL_RSP_ADDR	0x068
+#define CRB_DATA_BUFFER		0x080
+#define CRB_DATA_BUFFER_SIZE	3966
+
+#define SIM_VID_DID		0x001A15D1
+#define TPM_RC_CANCELED		0x909
+#define MAX_REPORTED_ERRORS	20
+
+enum sim_state {
+	SIM_IDLE,
+	SIM_READY,
+	SIM_RECEPTION,
+	SIM_EXECUTION,
+	SIM_COMPLETE
+};
+
+static struct sim_config cfg;
+static struct sim_counters counters;
+static u64 now_ns;
+
+static int active = -1;
+static u8 pending[LOCALITIES];
+/* a locality on its way to active after grant_us */
+static int granting = -1;
+static u64 grant_at;
+
+static enum sim_state state;
+static u8 cmd[SIM_MAX_CMD];
+static size_t cmd_len;
+static u8 rsp[SIM_MAX_CMD];
+static size_t rsp_len, rsp_pos;
+static u64 done_at;
+
+/* the MMIO window, only backed by memory for the CRB data buffers */
+static u8 *mmio;
+/* the PM timer port the driver calibrated with */
+static u16 pm_port;
+
+void sim_error(const char *fmt, ...)
+{
+	va_list ap;
+
+	if (counters.protocol_errors++ >= MAX_REPORTED_ERRORS)
+		return;
+
+	fprintf(stderr, "sim: ");
+	va_start(ap, fmt);
+	vfprintf(stderr, fmt, ap);
+	va_end(ap);
+	fprintf(stderr, "\n");
+}
+
+u64 sim_now_ns(void)
+{
+	return now_ns;
+}
+
+void sim_counters(struct sim_counters *c)
+{
+	*c = counters;
+}
+
+u16 sim_pm_tmr_port(void)
+{
+	return pm_port;
+}
+
+static u8 *crb_buffer(int l)
+{
+	return mmio + (l << 12) + CRB_DATA_BUFFER;
+}
+
+static void reset_engine(enum sim_state s)
+{
+	state = s;
+	cmd_len = 0;
+	rsp_len = 0;
+	rsp_pos = 0;
+}
+
+static void complete(void)
+{
+	rsp_len = sim_cmd_execute(cmd, cmd_len, rsp, sizeof(rsp));
+	rsp_pos = 0;
+	counters.commands++;
+	counters.bytes_in += cmd_len;
+	counters.bytes_out += rsp_len;
+
+	if (cfg.intf == SIM_CRB)
+		memcpy(crb_buffer(active), rsp, rsp_len);
+
+	state = SIM_COMPLETE;
+}
+
+static void set_active(int l)
+{
+	if (active != l)
+		reset_engine(SIM_IDLE);
+
+	active = l;
+}
+
+/* every access moves the clock and may let a command finish */
+static void tick(void)
+{
+	now_ns += cfg.access_ns;
+
+	if (granting >= 0 && now_ns >= grant_at) {
+		set_active(granting);
+		granting = -1;
+	}
+
+	if (state == SIM_EXECUTION && now_ns >= done_at)
+		complete();
+}
+
+static void start(void)
+{
+	state = SIM_EXECUTION;
+	done_at = now_ns + cfg.exec_us * 1000;
+	if (cfg.exec_us == 0)
+		complete();
+}
+
+static u32 cmd_size(void)
+{
+	if (cmd_len < 6)
+		return 0;
+
+	return (u32)cmd[2] << 24 | cmd[3] << 16 | cmd[4] << 8 | cmd[5];
+}
+
+static u8 expecting(void)
+{
+	return state == SIM_RECEPTION && (cmd_len < 6 || cmd_len < cmd_size());
+}
+
+static void grant(int l)
+{
+	if (cfg.grant_us == 0) {
+		set_active(l);
+		return;
+	}
+
+	granting = l;
+	grant_at = now_ns + cfg.grant_us * 1000;
+}
+
+static void request_locality(int l)
+{
+	if (active < 0 && granting < 0)
+		grant(l);
+	else if (active != l && granting != l)
+		pending[l] = 1;
+}
+
+static void relinquish_locality(int l)
+{
+	int i;
+
+	pending[l] = 0;
+	if (granting == l)
+		granting = -1;
+	if (active != l)
+		return;
+
+	active = -1;
+	for (i = LOCALITIES - 1; i >= 0; i--) {
+		if (pending[i]) {
+			pending[i] = 0;
+			grant(i);
+			break;
+		}
+	}
+}
+
+static u8 owns(int l, const char *what)
+{
+	if (l == active)
+		return 1;
+
+	sim_error("%s at locality %d, active locality is %d", what, l,
+		  active);
+	return 0;
+}
+
+/* TIS */
+
+static u32 burst_count(void)
+{
+	u32 count;
+
+	switch (state) {
+	case SIM_READY:
+	case SIM_RECEPTION:
+		count = sizeof(cmd) - cmd_len;
+		break;
+	case SIM_COMPLETE:
+		count = rsp_len - rsp_pos;
+		break;
+	default:
+		return 0;
+	}
+
+	if (cfg.burst && count > cfg.burst)
+		count = cfg.burst;
+	if (count > 0xFFFF)
+		count = 0xFFFF;
+
+	return count;
+}
+
+static u32 tis_sts(void)
+{
+	u32 sts = STS_VALID;
+
+	if (state == SIM_READY)
+		sts |= STS_COMMAND_READY;
+	if (state == SIM_COMPLETE && rsp_pos < rsp_len)
+		sts |= STS_DATA_AVAIL;
+	if (expecting())
+		sts |= STS_DATA_EXPECT;
+
+	return sts | burst_count() << 8;
+}
+
+static void tis_sts_write(u8 val)
+{
+	if (val & STS_COMMAND_READY) {
+		/* also aborts a command or discards a response */
+		reset_engine(SIM_READY);
+		return;
+	}
+
+	if (val & STS_GO) {
+		if (state != SIM_RECEPTION || expecting()) {
+			sim_error("tpmGo without a complete command");
+			return;
+		}
+		start();
+	}
+}
+
+static void fifo_write(u8 val)
+{
+	if (state == SIM_READY)
+		state = SIM_RECEPTION;
+
+	if (state != SIM_RECEPTION) {
+		sim_error("FIFO write outside of command reception");
+		return;
+	}
+
+	if (!expecting() && cmd_len >= 6) {
+		sim_error("FIFO write past the %u byte command", cmd_size());
+		return;
+	}
+
+	if (cmd_len == sizeof(cmd)) {
+		sim_error("command larger than the FIFO");
+		return;
+	}
+
+	cmd[cmd_len++] = val;
+}
+
+static u8 fifo_read(void)
+{
+	if (state != SIM_COMPLETE || rsp_pos == rsp_len) {
+		sim_error("FIFO read without dataAvail");
+		return 0xFF;
+	}
+
+	return rsp[rsp_pos++];
+}
+
+static u32 tis_read(int l, u32 reg, int width)
+{
+	u32 val = 0;
+	int i;
+
+	switch (reg) {
+	case TIS_ACCESS:
+		return ACCESS_REG_VALID |
+		       (active == l ? ACCESS_ACTIVE_LOCALITY : 0) |
+		       (pending[l] ? ACCESS_REQUEST_USE : 0);
+	case TIS_INTF_CAPABILITY:
+		if (cfg.tpm12)
+			return TPM12_TIS_INTF_13 << 28;
+		return TPM20_TIS_INTF_13 << 28 |
+		       (cfg.xfer32 ? TPM_XFER_SIZE_32 : TPM_XFER_SIZE_LEGACY)
+		       << 9;
+	case TIS_INTERFACE_ID:
+		/* absent on TIS 1.3, a FIFO interface on the PTP */
+		return cfg.tpm12 ? 0xFFFFFFFF : 0;
+	case TIS_DID_VID:
+		return SIM_VID_DID;
+	case TIS_STS:
+	case TIS_STS + 1:
+	case TIS_STS + 2:
+	case TIS_STS + 3:
+		if (!owns(l, "STS read"))
+			return 0xFF;
+		return tis_sts() >> ((reg - TIS_STS) * 8);
+	case TIS_DATA_FIFO:
+	case TIS_XDATA_FIFO:
+		if (!owns(l, "FIFO read"))
+			return 0xFF;
+		if (width == 4 && !cfg.xfer32)
+			sim_error("32-bit FIFO read on a legacy FIFO");
+		for (i = 0; i < width; i++)
+			val |= fifo_read() << (i * 8);
+		return val;
+	default:
+		return 0xFFFFFFFF;
+	}
+}
+
+static void tis_write(int l, u32 reg, u32 val, int width)
+{
+	int i;
+
+	switch (reg) {
+	case TIS_ACCESS:
+		if (val & ACCESS_ACTIVE_LOCALITY)
+			relinquish_locality(l);
+		if (val & ACCESS_REQUEST_USE)
+			request_locality(l);
+		break;
+	case TIS_STS:
+		if (owns(l, "STS write"))
+			tis_sts_write(val);
+		break;
+	case TIS_DATA_FIFO:
+	case TIS_XDATA_FIFO:
+		if (!owns(l, "FIFO write"))
+			break;
+		if (width == 4 && !cfg.xfer32)
+			sim_error("32-bit FIFO write on a legacy FIFO");
+		for (i = 0; i < width; i++)
+			fifo_write(val >> (i * 8));
+		break;
+	default:
+		sim_error("write to TIS register %#x", reg);
+		break;
+	}
+}
+
+/* CRB */
+
+static void crb_start(int l)
+{
+	u8 *buf = crb_buffer(l);
+
+	if (state == SIM_IDLE || state == SIM_EXECUTION) {
+		sim_error("start while the TPM is %s",
+			  state == SIM_IDLE ? "idle" : "executing");
+		return;
+	}
+
+	cmd_len = (u32)buf[2] << 24 | buf[3] << 16 | buf[4] << 8 | buf[5];
+	if (cmd_len < 10 || cmd_len > CRB_DATA_BUFFER_SIZE) {
+		sim_error("command size %zu in the CRB buffer", cmd_len);
+		cmd_len = 0;
+		return;
+	}
+
+	memcpy(cmd, buf, cmd_len);
+	start();
+}
+
+static void crb_cancel(void)
+{
+	static const u8 canceled[] = {
+		0x80, 0x01, 0, 0, 0, 10, 0, 0,
+		TPM_RC_CANCELED >> 8, TPM_RC_CANCELED & 0xFF
+	};
+
+	if (state != SIM_EXECUTION)
+		return;
+
+	memcpy(crb_buffer(active), canceled, sizeof(canceled));
+	rsp_len = sizeof(canceled);
+	state = SIM_COMPLETE;
+}
+
+static u32 crb_read(int l, u32 reg)
+{
+	switch (reg) {
+	case CRB_LOC_STATE:
+		return 0x80 | (active >= 0 ? 0x02 | active << 2 : 0);
+	case CRB_LOC_STS:
+		return active == l;
+	case CRB_INTF_ID:
+		/* CRB active, version 1, CRB capable */
+		return TPM_CRB_INTF_ACTIVE | 1 << 4 | 1 << 14;
+	case CRB_INTF_ID + 4:
+		return SIM_VID_DID;
+	case CRB_CTRL_REQ:
+		return 0;
+	case CRB_CTRL_STS:
+		if (!owns(l, "CTRL_STS read"))
+			return 0;
+		return state == SIM_IDLE ? 0x2 : 0;
+	case CRB_CTRL_START:
+		if (!owns(l, "CTRL_START read"))
+			return 0;
+		return state == SIM_EXECUTION;
+	case CRB_CTRL_CMD_SIZE:
+	case CRB_CTRL_RSP_SIZE:
+		return CRB_DATA_BUFFER_SIZE;
+	/* both buffers are the locality's data buffer */
+	case CRB_CTRL_CMD_LADDR:
+	case CRB_CTRL_RSP_ADDR:
+		return (u32)(uintptr_t)crb_buffer(l);
+	case CRB_CTRL_CMD_HADDR:
+	case CRB_CTRL_RSP_ADDR + 4:
+		return (u64)(uintptr_t)crb_buffer(l) >> 32;
+	default:
+		return 0;
+	}
+}
+
+static void crb_write(int l, u32 reg, u32 val)
+{
+	switch (reg) {
+	case CRB_LOC_CTRL:
+		if (val & ~0xFu)
+			sim_error("reserved LOC_CTRL bits %#x", val);
+		if (val & 0x2)
+			relinquish_locality(l);
+		if (val & 0x1)
+			request_locality(l);
+		break;
+	case CRB_CTRL_REQ:
+		if (!owns(l, "CTRL_REQ write"))
+			break;
+		if (val & ~0x3u)
+			sim_error("reserved CTRL_REQ bits %#x", val);
+		if (val & 0x2)
+			reset_engine(SIM_IDLE);
+		else if ((val & 0x1) && state == SIM_IDLE)
+			reset_engine(SIM_READY);
+		break;
+	case CRB_CTRL_CANCEL:
+		if (owns(l, "CTRL_CANCEL write") && val == 1)
+			crb_cancel();
+		break;
+	case CRB_CTRL_START:
+		if (owns(l, "CTRL_START write") && val == 1)
+			crb_start(l);
+		break;
+	default:
+		sim_error("write to CRB register %#x", reg);
+		break;
+	}
+}
+
+static u32 sim_read(u32 field, int width)
+{
+	int l = (field >> 12) & 0xF;
+	u32 reg = field & 0xFFF;
+
+	tick();
+	counters.reads++;
+
+	if (l >= LOCALITIES) {
+		sim_error("read of %#x outside the localities", field);
+		return 0xFFFFFFFF;
+	}
+
+	if (cfg.intf == SIM_CRB)
+		return crb_read(l, reg);
+
+	return tis_read(l, reg, width);
+}
+
+static void sim_write(u32 field, u32 val, int width)
+{
+	int l = (field >> 12) & 0xF;
+	u32 reg = field & 0xFFF;
+
+	tick();
+	counters.writes++;
+
+	if (l >= LOCALITIES) {
+		sim_error("write of %#x outside the localities", field);
+		return;
+	}
+
+	if (cfg.intf == SIM_CRB)
+		crb_write(l, reg, val);
+	else
+		tis_write(l, reg, val, width);
+}
+
+int sim_init(const struct sim_config *c)
+{
+	cfg = *c;
+	if (cfg.access_ns == 0)
+		cfg.access_ns = 1;
+
+	memset(&counters, 0, sizeof(counters));
+	memset(pending, 0, sizeof(pending));
+	now_ns = 0;
+	pm_port = 0;
+	active = -1;
+	granting = -1;
+	reset_engine(SIM_IDLE);
+
+	if (cfg.intf == SIM_CRB && !mmio) {
+		/* crb.c copies to and from the data buffer directly */
+		mmio = mmap((void *)(uintptr_t)TPM_MMIO_BASE, MMIO_SIZE,
+			    PROT_READ | PROT_WRITE,
+			    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (mmio == MAP_FAILED || mmio != (u8 *)TPM_MMIO_BASE) {
+			fprintf(stderr, "cannot map the CRB window at %#x\n",
+				TPM_MMIO_BASE);
+			if (mmio != MAP_FAILED)
+				munmap(mmio, MMIO_SIZE);
+			mmio = NULL;
+			return -ENOMEM;
+		}
+	}
+
+	return sim_cmd_init(&cfg);
+}
+
+void sim_exit(void)
+{
+	sim_cmd_exit();
+
+	if (mmio) {
+		munmap(mmio, MMIO_SIZE);
+		mmio = NULL;
+	}
+}
+
+/* tpmio.c */
+
+void tpm_io_delay(void)
+{
+	now_ns += 1000;
+}
+
+u8 tpm_read8(u32 field)
+{
+	return sim_read(field, 1);
+}
+
+void tpm_write8(unsigned char val, u32 field)
+{
+	sim_write(field, val, 1);
+}
+
+u32 tpm_read32(u32 field)
+{
+	return sim_read(field, 4);
+}
+
+void tpm_write32(unsigned int val, u32 field)
+{
+	sim_write(field, val, 4);
+}
+
+/* tpm_time.c, ticks are nanoseconds of virtual time */
+
+u8 tpm_time_init(u16 pm_tmr_port)
+{
+	pm_port = pm_tmr_port;
+	return 1;
+}
+
+u8 tpm_time_calibrated(void)
+{
+	return 1;
+}
+
+u32 tpm_time_khz(void)
+{
+	return 1000000;
+}
+
+u64 tpm_now(void)
+{
+	return now_ns;
+}
+
+void tpm_udelay(u32 usecs)
+{
+	now_ns += (u64)usecs * 1000;
+}
+
+u64 tpm_deadline(u32 usecs)
+{
+	return now_ns + (u64)usecs * 1000;
+}
+
+u8 tpm_deadline_passed(u64 deadline)
+{
+	return now_ns >= deadline;
+}
+
+u64 tpm_elapsed_us(u64 start)
+{
+	return (now_ns - start) / 1000;
+}
+
+u8 tpm_poll(u8 (*done)(void), u32 timeout)
+{
+	u64 deadline = tpm_deadline(timeout);
+
+	while (!done()) {
+		tpm_stats_add(polls, 1);
+		if (tpm_deadline_passed(deadline))
+			return done();
+
+		tpm_udelay(TPM_POLL_INTERVAL);
+	}
+
+	return 1;
+}
+
+u8 tpm_poll_backoff(u8 (*done)(void), u32 timeout)
+{
+	u64 deadline = tpm_deadline(timeout);
+	u32 delay = TPM_BACKOFF_MIN;
+
+	while (!done()) {
+		tpm_stats_add(polls, 1);
+		if (tpm_deadline_passed(deadline))
+			return done();
+
+		tpm_udelay(delay);
+		if (delay < TPM_BACKOFF_MAX)
+			delay <<= 1;
+	}
+
+	return 1;
+}
@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2019 Apertus Solutions, LLC
+ *
+ * Author(s):
+ *      Daniel P. Smith <dpsmith@apertussolutions.com>
+ *
+ * Simulated TIS/CRB register file and TPM for running the early driver on
+ * the host. The simulator stands in for tpmio.c and tpm_time.c: register
+ * accesses land in a software model and time is a virtual clock that
+ * advances with each access, each delay and each command executed.
+ */
+
+#ifndef _TPM_SIM_H
+#define _TPM_SIM_H
+
+#include <types.h>
+
+#define SIM_MAX_BANKS		5
+#define SIM_MAX_PCRS		24
+#define SIM_MAX_DIGEST		64
+/* bytes a TIS command or response may hold, the CRB buffer is smaller */
+#define SIM_MAX_CMD		4096
+/* the PM timer block the simulated FADT advertises */
+#define SIM_PM_TMR_PORT		0x408
+
+enum sim_intf {
+	SIM_TIS,
+	SIM_CRB
+};
+
+struct sim_config {
+	enum sim_intf intf;
+	u8 tpm12;		/* TIS 1.3 TPM 1.2 rather than a 2.0 PTP TPM */
+	u8 xfer32;		/* advertise 32-bit FIFO transfers */
+	u32 burst;		/* burstCount offered, 0 for the whole FIFO */
+	u8 acpi;		/* publish TPM2 or TCPA, and FADT tables */
+	u64 access_ns;		/* virtual time per register access */
+	u64 exec_us;		/* virtual time per command executed */
+	u64 grant_us;		/* virtual time to grant a locality */
+	u16 banks[SIM_MAX_BANKS];
+	int bank_count;
+};
+
+struct sim_counters {
+	u64 reads;
+	u64 writes;
+	u64 bytes_in;		/* command bytes the TPM received */
+	u64 bytes_out;		/* response bytes the TPM returned */
+	u64 commands;
+	u64 protocol_errors;
+};
+
+int sim_init(const struct sim_config *cfg);
+void sim_exit(void);
+
+/* the virtual clock, in nanoseconds */
+u64 sim_now_ns(void);
+void sim_counters(struct sim_counters *c);
+/* the port passed to tpm_time_init, 0 if none */
+u16 sim_pm_tmr_port(void);
+
+/*
+ * Current value of pcr in the bank for alg, NULL if the bank is not
+ * active. TPM 1.2 has only the SHA1 bank.
+ */
+const u8 *sim_pcr(u16 alg, u32 pcr);
+
+/* report a driver protocol violation */
+void sim_error(const char *fmt, ...)
+	__attribute__((format(printf, 1, 2)));
+
+/* tpm_sim_acpi.c, returns the RSDP address */
+u64 sim_acpi_tables(const struct sim_config *cfg);
+
+/* tpm_sim_cmd.c */
+int sim_cmd_init(const struct sim_config *cfg);
+void sim_cmd_exit(void);
+size_t sim_cmd_execute(const u8 *cmd, size_t len, u8 *rsp, size_t size);
+const char *sim_alg_name(u16 alg);
+u16 sim_alg_by_name(const char *name);
+u16 sim_alg_size(u16 alg);
+int sim_hash(u16 alg, const u8 *data, size_t len, u8 *digest);
+
+#endif
@@ -0,0 +1,105 @@
+/*
+ * Copyright (c) 2019 Apertus Solutions, LLC
+ *
+ * Author(s):
+ *      Daniel P. Smith <dpsmith@apertussolutions.com>
+ *
+ * ACPI tables describing the simulated TPM, for exercising tpm_acpi.c: an
+ * RSDP and XSDT pointing at a FADT with a PM timer and at a TPM2 table
+ * for the configured interface, or a TCPA table for a 1.2 TPM.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include <tpm.h>
+
+#include "../tpm_common.h"
+#include "../tpm_acpi.h"
+#include "tpm_sim.h"
+
+#define RSDP_LEN	36
+#define HEADER_LEN	36
+#define XSDT_LEN	(HEADER_LEN + 2 * 8)
+#define FADT_LEN	116
+#define TPM2_LEN	76
+#define TCPA_LEN	50
+
+/* one image holding every table, the RSDP on a 16 byte boundary */
+static u8 tables[RSDP_LEN + XSDT_LEN + FADT_LEN + TPM2_LEN]
+	__attribute__((aligned(16)));
+
+static void put32(u8 *p, u32 v)
+{
+	memcpy(p, &v, sizeof(v));
+}
+
+static void put64(u8 *p, u64 v)
+{
+	memcpy(p, &v, sizeof(v));
+}
+
+static u8 checksum(const u8 *p, size_t len)
+{
+	u8 sum = 0;
+
+	while (len--)
+		sum += *p++;
+
+	return -sum;
+}
+
+static void header(u8 *p, const char *sig, u32 len, u8 rev)
+{
+	memcpy(p, sig, 4);
+	put32(p + 4, len);
+	p[8] = rev;
+	memcpy(p + 10, "TBSIM ", 6);
+	memcpy(p + 16, "TPMSIM  ", 8);
+}
+
+u64 sim_acpi_tables(const struct sim_config *cfg)
+{
+	u8 *rsdp = tables;
+	u8 *xsdt = rsdp + RSDP_LEN;
+	u8 *fadt = xsdt + XSDT_LEN;
+	u8 *tpm = fadt + FADT_LEN;
+	u32 tpm_len = cfg->tpm12 ? TCPA_LEN : TPM2_LEN;
+
+	memset(tables, 0, sizeof(tables));
+
+	/* FADT, only the PM timer block matters */
+	header(fadt, "FACP", FADT_LEN, 1);
+	put32(fadt + 76, SIM_PM_TMR_PORT);
+	fadt[9] = checksum(fadt, FADT_LEN);
+
+	if (cfg->tpm12) {
+		/* a client TCPA, with no log */
+		header(tpm, "TCPA", TCPA_LEN, 2);
+	} else {
+		header(tpm, "TPM2", TPM2_LEN, 4);
+		if (cfg->intf == SIM_CRB) {
+			put64(tpm + 40, TPM_MMIO_BASE | 0x40);
+			put32(tpm + 48, ACPI_TPM2_START_CRB);
+		} else {
+			put64(tpm + 40, TPM_MMIO_BASE);
+			put32(tpm + 48, ACPI_TPM2_START_TIS);
+		}
+	}
+	tpm[9] = checksum(tpm, tpm_len);
+
+	header(xsdt, "XSDT", XSDT_LEN, 1);
+	put64(xsdt + HEADER_LEN, (uintptr_t)fadt);
+	put64(xsdt + HEADER_LEN + 8, (uintptr_t)tpm);
+	xsdt[9] = checksum(xsdt, XSDT_LEN);
+
+	memcpy(rsdp, "RSD PTR ", 8);
+	memcpy(rsdp + 9, "TBSIM ", 6);
+	rsdp[15] = 2;
+	put32(rsdp + 20, RSDP_LEN);
+	put64(rsdp + 24, (uintptr_t)xsdt);
+	rsdp[8] = checksum(rsdp, 20);
+	rsdp[32] = checksum(rsdp, RSDP_LEN);
+
+	return (uintptr_t)rsdp;
+}
@@ -0,0 +1,732 @@
+/*
+ * Copyright (c) 2019 Apertus Solutions, LLC
+ *
+ * Author(s):
+ *      Daniel P. Smith <dpsmith@apertussolutions.com>
+ *
+ * A minimal TPM behind the simulated register file: TPM2_PCR_Extend, the
+ * event sequence commands, TPM2_FlushContext and the PCR allocation from
+ * TPM2_GetCapability, or TPM_Extend for 1.2.
+ * Commands are checked strictly against the specification's marshalling
+ * and anything the driver gets wrong is reported as a protocol error.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <openssl/evp.h>
+
+#include "tpm_sim.h"
+
+/* TPM 2.0 Part 2 */
+#define TPM_ST_NO_SESSIONS		0x8001
+#define TPM_ST_SESSIONS			0x8002
+
+#define TPM_CC_SEQUENCE_UPDATE		0x0000015C
+#define TPM_CC_FLUSH_CONTEXT		0x00000165
+#define TPM_CC_GET_CAPABILITY		0x0000017A
+#define TPM_CC_PCR_EXTEND		0x00000182
+#define TPM_CC_EVENT_SEQUENCE_COMPLETE	0x00000185
+#define TPM_CC_HASH_SEQUENCE_START	0x00000186
+
+#define TPM_ALG_SHA1			0x0004
+#define TPM_ALG_SHA256			0x000B
+#define TPM_ALG_SHA384			0x000C
+#define TPM_ALG_SHA512			0x000D
+#define TPM_ALG_NULL			0x0010
+#define TPM_ALG_SM3_256			0x0012
+
+#define TPM_CAP_PCRS			0x00000005
+
+#define TPM_RH_NULL			0x40000007
+#define TPM_RS_PW			0x40000009
+#define TPM_HR_TRANSIENT		0x80000000
+
+#define TPM_RC_SUCCESS			0x000
+#define TPM_RC_BAD_TAG			0x01E
+#define TPM_RC_HASH			0x083
+#define TPM_RC_VALUE			0x084
+#define TPM_RC_HANDLE			0x08B
+#define TPM_RC_SIZE			0x095
+#define TPM_RC_AUTH_MISSING		0x125
+#define TPM_RC_COMMAND_SIZE		0x142
+#define TPM_RC_COMMAND_CODE		0x143
+#define TPM_RC_AUTHSIZE			0x144
+#define TPM_RC_OBJECT_MEMORY		0x902
+
+#define MAX_DIGEST_BUFFER		1024
+
+/* TPM 1.2 Part 2 */
+#define TPM_TAG_RQU_COMMAND		0x00C1
+#define TPM_TAG_RSP_COMMAND		0x00C4
+#define TPM_ORD_EXTEND			0x00000014
+#define TPM_BADINDEX			2
+#define TPM_BAD_PARAMETER		3
+#define TPM_BAD_ORDINAL			10
+#define TPM_BADTAG			30
+
+#define SIM_SEQUENCES			3
+
+struct sim_bank {
+	u16 alg;
+	const EVP_MD *md;
+	u8 pcrs[SIM_MAX_PCRS][SIM_MAX_DIGEST];
+};
+
+static const struct {
+	u16 alg;
+	const char *name;
+	const char *openssl;
+	u16 size;
+} algs[] = {
+	{ TPM_ALG_SHA1, "sha1", "SHA1", 20 },
+	{ TPM_ALG_SHA256, "sha256", "SHA256", 32 },
+	{ TPM_ALG_SHA384, "sha384", "SHA384", 48 },
+	{ TPM_ALG_SHA512, "sha512", "SHA512", 64 },
+	{ TPM_ALG_SM3_256, "sm3_256", "SM3", 32 },
+};
+
+static struct sim_bank banks[SIM_MAX_BANKS];
+static int bank_count;
+static u8 tpm12;
+
+/* event sequences, one context per bank */
+static struct {
+	u8 in_use;
+	EVP_MD_CTX *ctx[SIM_MAX_BANKS];
+} sequences[SIM_SEQUENCES];
+
+struct reader {
+	const u8 *p;
+	const u8 *end;
+	int err;
+};
+
+struct writer {
+	u8 *start;
+	u8 *p;
+	u8 *end;
+};
+
+const char *sim_alg_name(u16 alg)
+{
+	size_t i;
+
+	for (i = 0; i < sizeof(algs) / sizeof(algs[0]); i++)
+		if (algs[i].alg == alg)
+			return algs[i].name;
+
+	return "unknown";
+}
+
+u16 sim_alg_by_name(const char *name)
+{
+	size_t i;
+
+	for (i = 0; i < sizeof(algs) / sizeof(algs[0]); i++)
+		if (!strcmp(algs[i].name, name))
+			return algs[i].alg;
+
+	return 0;
+}
+
+u16 sim_alg_size(u16 alg)
+{
+	size_t i;
+
+	for (i = 0; i < sizeof(algs) / sizeof(algs[0]); i++)
+		if (algs[i].alg == alg)
+			return algs[i].size;
+
+	return 0;
+}
+
+static const EVP_MD *alg_md(u16 alg)
+{
+	size_t i;
+
+	for (i = 0; i < sizeof(algs) / sizeof(algs[0]); i++)
+		if (algs[i].alg == alg)
+			return EVP_get_digestbyname(algs[i].openssl);
+
+	return NULL;
+}
+
+int sim_hash(u16 alg, const u8 *data, size_t len, u8 *digest)
+{
+	const EVP_MD *md = alg_md(alg);
+
+	if (md == NULL)
+		return -EINVAL;
+
+	return EVP_Digest(data, len, digest, NULL, md, NULL) ? 0 : -EIO;
+}
+
+static struct sim_bank *find_bank(u16 alg)
+{
+	int i;
+
+	for (i = 0; i < bank_count; i++)
+		if (banks[i].alg == alg)
+			return &banks[i];
+
+	return NULL;
+}
+
+const u8 *sim_pcr(u16 alg, u32 pcr)
+{
+	struct sim_bank *bank = find_bank(alg);
+
+	if (bank == NULL || pcr >= SIM_MAX_PCRS)
+		return NULL;
+
+	return bank->pcrs[pcr];
+}
+
+static int extend(struct sim_bank *bank, u32 pcr, const u8 *digest)
+{
+	u16 size = EVP_MD_size(bank->md);
+	EVP_MD_CTX *ctx = EVP_MD_CTX_new();
+	int ok;
+
+	ok = ctx && EVP_DigestInit_ex(ctx, bank->md, NULL) &&
+	     EVP_DigestUpdate(ctx, bank->pcrs[pcr], size) &&
+	     EVP_DigestUpdate(ctx, digest, size) &&
+	     EVP_DigestFinal_ex(ctx, bank->pcrs[pcr], NULL);
+
+	EVP_MD_CTX_free(ctx);
+	return ok ? 0 : -EIO;
+}
+
+int sim_cmd_init(const struct sim_config *cfg)
+{
+	int i;
+
+	memset(banks, 0, sizeof(banks));
+	memset(sequences, 0, sizeof(sequences));
+	tpm12 = cfg->tpm12;
+
+	if (tpm12) {
+		banks[0].alg = TPM_ALG_SHA1;
+		banks[0].md = alg_md(TPM_ALG_SHA1);
+		bank_count = 1;
+		return 0;
+	}
+
+	bank_count = cfg->bank_count;
+	for (i = 0; i < bank_count; i++) {
+		banks[i].alg = cfg->banks[i];
+		banks[i].md = alg_md(cfg->banks[i]);
+		if (banks[i].md == NULL) {
+			fprintf(stderr, "no %s support in this OpenSSL\n",
+				sim_alg_name(cfg->banks[i]));
+			return -EINVAL;
+		}
+	}
+
+	return 0;
+}
+
+static void free_sequence(int i)
+{
+	int b;
+
+	for (b = 0; b < bank_count; b++) {
+		EVP_MD_CTX_free(sequences[i].ctx[b]);
+		sequences[i].ctx[b] = NULL;
+	}
+
+	sequences[i].in_use = 0;
+}
+
+void sim_cmd_exit(void)
+{
+	int i;
+
+	for (i = 0; i < SIM_SEQUENCES; i++)
+		if (sequences[i].in_use)
+			free_sequence(i);
+}
+
+static u16 get16(struct reader *r)
+{
+	u16 v;
+
+	if (r->end - r->p < 2) {
+		r->err = 1;
+		return 0;
+	}
+
+	v = r->p[0] << 8 | r->p[1];
+	r->p += 2;
+	return v;
+}
+
+static u32 get32(struct reader *r)
+{
+	u32 v;
+
+	if (r->end - r->p < 4) {
+		r->err = 1;
+		return 0;
+	}
+
+	v = (u32)r->p[0] << 24 | r->p[1] << 16 | r->p[2] << 8 | r->p[3];
+	r->p += 4;
+	return v;
+}
+
+static const u8 *get_bytes(struct reader *r, size_t len)
+{
+	const u8 *p = r->p;
+
+	if ((size_t)(r->end - r->p) < len) {
+		r->err = 1;
+		return NULL;
+	}
+
+	r->p += len;
+	return p;
+}
+
+static void put16(struct writer *w, u16 v)
+{
+	w->p[0] = v >> 8;
+	w->p[1] = v;
+	w->p += 2;
+}
+
+static void put32(struct writer *w, u32 v)
+{
+	w->p[0] = v >> 24;
+	w->p[1] = v >> 16;
+	w->p[2] = v >> 8;
+	w->p[3] = v;
+	w->p += 4;
+}
+
+static void put_bytes(struct writer *w, const u8 *data, size_t len)
+{
+	memcpy(w->p, data, len);
+	w->p += len;
+}
+
+/* close the response: fill in the size and return it */
+static size_t finish(struct writer *w)
+{
+	size_t size = w->p - w->start;
+	u8 *p = w->start + 2;
+
+	p[0] = size >> 24;
+	p[1] = size >> 16;
+	p[2] = size >> 8;
+	p[3] = size;
+
+	return size;
+}
+
+static size_t rc_only(struct writer *w, u16 tag, u32 rc)
+{
+	w->p = w->start;
+	put16(w, tag);
+	put32(w, 0);
+	put32(w, rc);
+
+	return finish(w);
+}
+
+/*
+ * Check the authorization area holds exactly count password sessions,
+ * leaving the reader at the parameters.
+ */
+static u32 check_auth(struct reader *r, int count)
+{
+	u32 size = get32(r);
+	struct reader a;
+	int n = 0;
+
+	if (r->err || size > (size_t)(r->end - r->p)) {
+		sim_error("authorizationSize %u overruns the command", size);
+		return TPM_RC_AUTHSIZE;
+	}
+
+	a.p = r->p;
+	a.end = r->p + size;
+	a.err = 0;
+	r->p += size;
+
+	while (a.p < a.end) {
+		u32 handle = get32(&a);
+		u16 nonce = get16(&a);
+
+		get_bytes(&a, nonce);
+		get_bytes(&a, 1);
+		get_bytes(&a, get16(&a));
+		if (a.err) {
+			sim_error("session overruns authorizationSize");
+			return TPM_RC_AUTHSIZE;
+		}
+
+		if (handle != TPM_RS_PW) {
+			sim_error("session handle %#x is not TPM_RS_PW", handle);
+			return TPM_RC_HANDLE;
+		}
+		n++;
+	}
+
+	if (n != count) {
+		sim_error("%d sessions where %d are required", n, count);
+		return n < count ? TPM_RC_AUTH_MISSING : TPM_RC_AUTHSIZE;
+	}
+
+	return TPM_RC_SUCCESS;
+}
+
+/* start a response with sessions; parameterSize is patched by end_params */
+static u8 *begin_params(struct writer *w)
+{
+	u8 *size;
+
+	w->p = w->start;
+	put16(w, TPM_ST_SESSIONS);
+	put32(w, 0);
+	put32(w, TPM_RC_SUCCESS);
+	size = w->p;
+	put32(w, 0);
+
+	return size;
+}
+
+static size_t end_params(struct writer *w, u8 *size, int sessions)
+{
+	u32 len = w->p - size - 4;
+	struct writer s = { size, size, size + 4 };
+
+	put32(&s, len);
+
+	/* empty nonce, continueSession, empty hmac */
+	while (sessions--) {
+		put16(w, 0);
+		*w->p++ = 0x01;
+		put16(w, 0);
+	}
+
+	return finish(w);
+}
+
+static size_t pcr_extend(struct reader *r, struct writer *w)
+{
+	struct sim_bank *bank;
+	u32 pcr, count, i, rc;
+	u16 alg, size;
+	const u8 *digest;
+	u8 *params;
+
+	pcr = get32(r);
+	rc = check_auth(r, 1);
+	if (rc)
+		return rc_only(w, TPM_ST_NO_SESSIONS, rc);
+	if (pcr >= SIM_MAX_PCRS)
+		return rc_only(w, TPM_ST_NO_SESSIONS, TPM_RC_VALUE);
+
+	count = get32(r);
+	if (count > SIM_MAX_BANKS)
+		return rc_only(w, TPM_ST_NO_SESSIONS, TPM_RC_SIZE);
+
+	for (i = 0; i < count; i++) {
+		alg = get16(r);
+		size = sim_alg_size(alg);
+		bank = find_bank(alg);
+		if (size == 0 || bank == NULL)
+			return rc_only(w, TPM_ST_NO_SESSIONS, TPM_RC_HASH);
+
+		digest = get_bytes(r, size);
+		if (r->err)
+			break;
+
+		extend(bank, pcr, digest);
+	}
+
+	if (r->err || r->p != r->end) {
+		sim_error("PCR_Extend digests do not fill the command");
+		return rc_only(w, TPM_ST_NO_SESSIONS, TPM_RC_COMMAND_SIZE);
+	}
+
+	params = begin_params(w);
+	return end_params(w, params, 1);
+}
+
+static int sequence_index(u32 handle)
+{
+	u32 i = handle - TPM_HR_TRANSIENT;
+
+	if (handle < TPM_HR_TRANSIENT || i >= SIM_SEQUENCES ||
+	    !sequences[i].in_use)
+		return -1;
+
+	return i;
+}
+
+static size_t hash_sequence_start(struct reader *r, struct writer *w)
+{
+	u16 auth = get16(r);
+	int i, b;
+
+	get_bytes(r, auth);
+	if (get16(r) != TPM_ALG_NULL) {
+		/* only event sequences are modelled */
+		return rc_only(w, TPM_ST_NO_SESSIONS, TPM_RC_HASH);
+	}
+
+	if (r->err || r->p != r->end) {
+		sim_error("malformed HashSequenceStart");
+		return rc_only(w, TPM_ST_NO_SESSIONS, TPM_RC_COMMAND_SIZE);
+	}
+
+	for (i = 0; i < SIM_SEQUENCES; i++)
+		if (!sequences[i].in_use)
+			break;
+
+	if (i == SIM_SEQUENCES) {
+		sim_error("sequence slots exhausted, handles are leaking");
+		return rc_only(w, TPM_ST_NO_SESSIONS, TPM_RC_OBJECT_MEMORY);
+	}
+
+	sequences[i].in_use = 1;
+	for (b = 0; b < bank_count; b++) {
+		sequences[i].ctx[b] = EVP_MD_CTX_new();
+		EVP_DigestInit_ex(sequences[i].ctx[b], banks[b].md, NULL);
+	}
+
+	w->p = w->start;
+	put16(w, TPM_ST_NO_SESSIONS);
+	put32(w, 0);
+	put32(w, TPM_RC_SUCCESS);
+	put32(w, TPM_HR_TRANSIENT + i);
+
+	return finish(w);
+}
+
+/* read a TPM2B_MAX_BUFFER and feed it to every bank of sequence i */
+static u32 sequence_data(struct reader *r, int i)
+{
+	u16 size = get16(r);
+	const u8 *data;
+	int b;
+
+	if (size > MAX_DIGEST_BUFFER) {
+		sim_error("sequence buffer of %u bytes", size);
+		return TPM_RC_SIZE;
+	}
+
+	data = get_bytes(r, size);
+	if (r->err || r->p != r->end) {
+		sim_error("sequence buffer does not fill the command");
+		return TPM_RC_COMMAND_SIZE;
+	}
+
+	for (b = 0; b < bank_count; b++)
+		EVP_DigestUpdate(sequences[i].ctx[b], data, size);
+
+	return TPM_RC_SUCCESS;
+}
+
+static size_t sequence_update(struct reader *r, struct writer *w)
+{
+	int i = sequence_index(get32(r));
+	u32 rc;
+	u8 *params;
+
+	rc = check_auth(r, 1);
+	if (rc)
+		return rc_only(w, TPM_ST_NO_SESSIONS, rc);
+	if (i < 0)
+		return rc_only(w, TPM_ST_NO_SESSIONS, TPM_RC_HANDLE);
+
+	rc = sequence_data(r, i);
+	if (rc)
+		return rc_only(w, TPM_ST_NO_SESSIONS, rc);
+
+	params = begin_params(w);
+	return end_params(w, params, 1);
+}
+
+static size_t event_sequence_complete(struct reader *r, struct writer *w)
+{
+	u8 digest[SIM_MAX_DIGEST];
+	u32 pcr = get32(r);
+	int i = sequence_index(get32(r));
+	u32 rc;
+	u8 *params;
+	int b;
+
+	rc = check_auth(r, 2);
+	if (rc)
+		return rc_only(w, TPM_ST_NO_SESSIONS, rc);
+	if (i < 0)
+		return rc_only(w, TPM_ST_NO_SESSIONS, TPM_RC_HANDLE);
+	if (pcr >= SIM_MAX_PCRS && pcr != TPM_RH_NULL)
+		return rc_only(w, TPM_ST_NO_SESSIONS, TPM_RC_VALUE);
+
+	rc = sequence_data(r, i);
+	if (rc)
+		return rc_only(w, TPM_ST_NO_SESSIONS, rc);
+
+	params = begin_params(w);
+	put32(w, bank_count);
+	for (b = 0; b < bank_count; b++) {
+		EVP_DigestFinal_ex(sequences[i].ctx[b], digest, NULL);
+		put16(w, banks[b].alg);
+		put_bytes(w, digest, EVP_MD_size(banks[b].md));
+
+		if (pcr != TPM_RH_NULL)
+			extend(&banks[b], pcr, digest);
+	}
+
+	free_sequence(i);
+
+	return end_params(w, params, 2);
+}
+
+static size_t flush_context(struct reader *r, struct writer *w)
+{
+	int i = sequence_index(get32(r));
+
+	if (r->err || r->p != r->end) {
+		sim_error("malformed FlushContext");
+		return rc_only(w, TPM_ST_NO_SESSIONS, TPM_RC_COMMAND_SIZE);
+	}
+
+	if (i < 0)
+		return rc_only(w, TPM_ST_NO_SESSIONS, TPM_RC_HANDLE);
+
+	free_sequence(i);
+	return rc_only(w, TPM_ST_NO_SESSIONS, TPM_RC_SUCCESS);
+}
+
+/* only the PCR allocation, every PCR in each configured bank */
+static size_t get_capability(struct reader *r, struct writer *w)
+{
+	u32 cap = get32(r);
+	int b;
+
+	get32(r);
+	get32(r);
+	if (r->err || r->p != r->end) {
+		sim_error("malformed GetCapability");
+		return rc_only(w, TPM_ST_NO_SESSIONS, TPM_RC_COMMAND_SIZE);
+	}
+
+	if (cap != TPM_CAP_PCRS)
+		return rc_only(w, TPM_ST_NO_SESSIONS, TPM_RC_VALUE);
+
+	w->p = w->start;
+	put16(w, TPM_ST_NO_SESSIONS);
+	put32(w, 0);
+	put32(w, TPM_RC_SUCCESS);
+	*w->p++ = 0;
+	put32(w, TPM_CAP_PCRS);
+	put32(w, bank_count);
+	for (b = 0; b < bank_count; b++) {
+		put16(w, banks[b].alg);
+		*w->p++ = SIM_MAX_PCRS / 8;
+		memset(w->p, 0xFF, SIM_MAX_PCRS / 8);
+		w->p += SIM_MAX_PCRS / 8;
+	}
+
+	return finish(w);
+}
+
+static size_t tpm12_extend(struct reader *r, struct writer *w)
+{
+	u32 pcr = get32(r);
+	const u8 *digest = get_bytes(r, 20);
+
+	if (r->err || r->p != r->end) {
+		sim_error("malformed TPM_Extend");
+		return rc_only(w, TPM_TAG_RSP_COMMAND, TPM_BAD_PARAMETER);
+	}
+
+	if (pcr >= SIM_MAX_PCRS)
+		return rc_only(w, TPM_TAG_RSP_COMMAND, TPM_BADINDEX);
+
+	extend(&banks[0], pcr, digest);
+
+	w->p = w->start;
+	put16(w, TPM_TAG_RSP_COMMAND);
+	put32(w, 0);
+	put32(w, TPM_RC_SUCCESS);
+	put_bytes(w, banks[0].pcrs[pcr], 20);
+
+	return finish(w);
+}
+
+/*
+ * Execute the command in cmd, len bytes as received, writing the response
+ * to rsp, which has room for size bytes. Returns the response length.
+ */
+size_t sim_cmd_execute(const u8 *cmd, size_t len, u8 *rsp, size_t size)
+{
+	struct reader r = { cmd, cmd + len, 0 };
+	struct writer w = { rsp, rsp, rsp + size };
+	u16 tag = get16(&r);
+	u32 cmd_size = get32(&r);
+	u32 code = get32(&r);
+
+	if (r.err || cmd_size != len) {
+		sim_error("command size %u but %zu bytes received", cmd_size,
+			  len);
+		return rc_only(&w, tpm12 ? TPM_TAG_RSP_COMMAND :
+			       TPM_ST_NO_SESSIONS,
+			       tpm12 ? TPM_BAD_PARAMETER : TPM_RC_COMMAND_SIZE);
+	}
+
+	if (tpm12) {
+		if (tag != TPM_TAG_RQU_COMMAND) {
+			sim_error("TPM 1.2 tag %#x", tag);
+			return rc_only(&w, TPM_TAG_RSP_COMMAND, TPM_BADTAG);
+		}
+		if (code == TPM_ORD_EXTEND)
+			return tpm12_extend(&r, &w);
+
+		return rc_only(&w, TPM_TAG_RSP_COMMAND, TPM_BAD_ORDINAL);
+	}
+
+	switch (code) {
+	case TPM_CC_PCR_EXTEND:
+	case TPM_CC_SEQUENCE_UPDATE:
+	case TPM_CC_EVENT_SEQUENCE_COMPLETE:
+		if (tag != TPM_ST_SESSIONS) {
+			sim_error("command %#x needs sessions, tag %#x", code,
+				  tag);
+			return rc_only(&w, TPM_ST_NO_SESSIONS, TPM_RC_BAD_TAG);
+		}
+		break;
+	case TPM_CC_HASH_SEQUENCE_START:
+	case TPM_CC_FLUSH_CONTEXT:
+	case TPM_CC_GET_CAPABILITY:
+		if (tag != TPM_ST_NO_SESSIONS) {
+			sim_error("command %#x takes no sessions, tag %#x",
+				  code, tag);
+			return rc_only(&w, TPM_ST_NO_SESSIONS, TPM_RC_BAD_TAG);
+		}
+		break;
+	default:
+		return rc_only(&w, TPM_ST_NO_SESSIONS, TPM_RC_COMMAND_CODE);
+	}
+
+	switch (code) {
+	case TPM_CC_PCR_EXTEND:
+		return pcr_extend(&r, &w);
+	case TPM_CC_SEQUENCE_UPDATE:
+		return sequence_update(&r, &w);
+	case TPM_CC_EVENT_SEQUENCE_COMPLETE:
+		return event_sequence_complete(&r, &w);
+	case TPM_CC_HASH_SEQUENCE_START:
+		return hash_sequence_start(&r, &w);
+	case TPM_CC_GET_CAPABILITY:
+		return get_capability(&r, &w);
+	default:
+		return flush_context(&r, &w);
+	}
+}
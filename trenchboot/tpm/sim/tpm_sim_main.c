@@ -0,0 +1,510 @@
+/*
+ * Copyright (c) 2019 Apertus Solutions, LLC
+ *
+ * Author(s):
+ *      Daniel P. Smith <dpsmith@apertussolutions.com>
+ *
+ * Drive the early TPM driver against the simulator: bring the TPM up,
+ * extend a PCR repeatedly and optionally measure buffers on the TPM, on
+ * the CPU and in auto mode, checking every result against PCR values
+ * replayed on the host. Prints a YAML report of the cost per operation and exits non-zero
+ * on a protocol error, a failed call or a PCR mismatch.
+ */
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <tpm.h>
+
+#include "../tpm_common.h"
+#include "../tpm2_constants.h"
+#include "tpm_sim.h"
+
+/* the DRTM PCRs, extended from locality 2 as the loader does */
+#define EXTEND_LOCALITY	2
+#define EXTEND_PCR	17
+#define SEQUENCE_PCR	18
+
+struct phase {
+	const char *name;
+	unsigned count;
+	u64 host_ns;
+	u64 sim_ns;
+	struct sim_counters before;
+	struct sim_counters after;
+};
+
+static struct sim_config cfg = {
+	.intf = SIM_TIS,
+	.burst = 32,
+	.access_ns = 1000,
+	.banks = { TPM_ALG_SHA1, TPM_ALG_SHA256 },
+	.bank_count = 2,
+};
+
+/* the PCR values the TPM should hold, replayed on the host */
+static u8 expected[SIM_MAX_BANKS][SIM_MAX_PCRS][SIM_MAX_DIGEST];
+static unsigned failures;
+
+static u64 host_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (u64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void phase_begin(struct phase *p, const char *name)
+{
+	memset(p, 0, sizeof(*p));
+	p->name = name;
+	sim_counters(&p->before);
+	p->sim_ns = sim_now_ns();
+	p->host_ns = host_ns();
+}
+
+static void phase_end(struct phase *p)
+{
+	p->host_ns = host_ns() - p->host_ns;
+	p->sim_ns = sim_now_ns() - p->sim_ns;
+	sim_counters(&p->after);
+}
+
+static void phase_report(struct phase *p)
+{
+	double n = p->count ? p->count : 1;
+
+	printf("  - phase: %s\n"
+	       "    count: %u\n"
+	       "    host-ns/op: %.0f\n"
+	       "    sim-us/op: %.1f\n"
+	       "    accesses/op: %.1f\n"
+	       "    bytes/op: %.1f\n",
+	       p->name, p->count, p->host_ns / n, p->sim_ns / n / 1000,
+	       (p->after.reads + p->after.writes -
+		p->before.reads - p->before.writes) / n,
+	       (p->after.bytes_in + p->after.bytes_out -
+		p->before.bytes_in - p->before.bytes_out) / n);
+}
+
+static void fail(const char *fmt, const char *what, long val)
+{
+	failures++;
+	fprintf(stderr, fmt, what, val);
+	fprintf(stderr, "\n");
+}
+
+static void replay(int bank, u32 pcr, const u8 *digest)
+{
+	u16 alg = cfg.tpm12 ? TPM_ALG_SHA1 : cfg.banks[bank];
+	u16 size = sim_alg_size(alg);
+	u8 buf[2 * SIM_MAX_DIGEST];
+
+	memcpy(buf, expected[bank][pcr], size);
+	memcpy(buf + size, digest, size);
+	sim_hash(alg, buf, 2 * size, expected[bank][pcr]);
+}
+
+static void check_pcr(u32 pcr)
+{
+	int banks = cfg.tpm12 ? 1 : cfg.bank_count;
+	const u8 *actual;
+	u16 alg;
+	int b;
+
+	for (b = 0; b < banks; b++) {
+		alg = cfg.tpm12 ? TPM_ALG_SHA1 : cfg.banks[b];
+		actual = sim_pcr(alg, pcr);
+		if (!actual || memcmp(actual, expected[b][pcr],
+				      sim_alg_size(alg)))
+			fail("%s PCR%ld does not match the replay",
+			     sim_alg_name(alg), pcr);
+	}
+}
+
+static void run_extends(struct tpm *t, unsigned n, struct phase *p)
+{
+	u32 list[TPM_MAX_DIGEST_LIST_SIZE / sizeof(u32)];
+	struct tpml_digest_values *digests = (void *)list;
+	u8 digest[SIM_MAX_DIGEST];
+	u8 *dst;
+	unsigned i;
+	int b, ret;
+
+	phase_begin(p, "extend");
+
+	for (i = 0; i < n; i++) {
+		memset(digest, 0, sizeof(digest));
+		memcpy(digest, &i, sizeof(i));
+
+		/* callers that ask every time should not cycle the locality */
+		ret = tpm_request_locality(t, EXTEND_LOCALITY);
+		if (ret != 0) {
+			fail("%s failed: %ld", "locality request", ret);
+			break;
+		}
+
+		if (cfg.tpm12) {
+			ret = tpm_extend_pcr(t, EXTEND_PCR, TPM_ALG_SHA1,
+					     digest);
+			if (ret == 0)
+				replay(0, EXTEND_PCR, digest);
+		} else {
+			digests->count = cfg.bank_count;
+			dst = (u8 *)digests->digests;
+			for (b = 0; b < cfg.bank_count; b++) {
+				((struct tpmt_ha *)dst)->alg = cfg.banks[b];
+				memcpy(((struct tpmt_ha *)dst)->digest, digest,
+				       sim_alg_size(cfg.banks[b]));
+				dst += sizeof(u16) + sim_alg_size(cfg.banks[b]);
+			}
+
+			ret = tpm_extend_pcr_digests(t, EXTEND_PCR, digests);
+			if (ret == 0)
+				for (b = 0; b < cfg.bank_count; b++)
+					replay(b, EXTEND_PCR, digest);
+		}
+
+		if (ret != 0) {
+			fail("%s failed: %ld", "extend", ret);
+			break;
+		}
+		p->count++;
+	}
+
+	phase_end(p);
+	check_pcr(EXTEND_PCR);
+}
+
+static int cpu_hash(u16 alg, const u8 *data, size_t len, u8 *digest)
+{
+	return sim_hash(alg, data, len, digest);
+}
+
+/* check a returned digest list covers every bank with the right digests */
+static void check_digests(struct tpml_digest_values *digests, const u8 *buf,
+			  size_t size)
+{
+	u8 *p = (u8 *)digests->digests;
+	u8 want[SIM_MAX_DIGEST];
+	struct tpmt_ha *h;
+	u32 i;
+
+	if (digests->count != (u32)cfg.bank_count) {
+		fail("%s returned %ld digests", "hash", digests->count);
+		return;
+	}
+
+	for (i = 0; i < digests->count; i++) {
+		h = (struct tpmt_ha *)p;
+		if (h->alg != cfg.banks[i]) {
+			fail("%s bank %ld out of order", "hash", i);
+			return;
+		}
+
+		sim_hash(h->alg, buf, size, want);
+		if (memcmp(want, h->digest, sim_alg_size(h->alg)))
+			fail("%s digest of a %ld byte buffer is wrong",
+			     sim_alg_name(h->alg), size);
+
+		replay(i, SEQUENCE_PCR, h->digest);
+		p += sizeof(u16) + sim_alg_size(h->alg);
+	}
+}
+
+/*
+ * Measure n buffers of size bytes into SEQUENCE_PCR with a policy listing
+ * the first policy_banks active banks. Auto mode alternates with buffers
+ * too small to rate, so both paths get picked as the rates settle.
+ */
+static void run_hashes(struct tpm *t, unsigned n, size_t size,
+		       enum tpm_hash_mode mode, int policy_banks,
+		       const char *name, struct phase *p)
+{
+	u32 list[TPM_MAX_DIGEST_LIST_SIZE / sizeof(u32)];
+	struct tpml_digest_values *digests = (void *)list;
+	struct tpm_hash_policy policy = {
+		.mode = mode,
+		.cpu_hash = cpu_hash,
+		.bank_count = policy_banks,
+	};
+	u8 *buf = malloc(size ? size : 1);
+	size_t len = size;
+	unsigned i;
+	size_t j;
+	int ret;
+
+	memcpy(policy.banks, cfg.banks, sizeof(policy.banks));
+	for (j = 0; j < size; j++)
+		buf[j] = j * 131 + 7;
+
+	phase_begin(p, name);
+
+	for (i = 0; i < n; i++) {
+		if (mode == TPM_HASH_AUTO)
+			len = i & 1 && size > 64 ? 64 : size;
+
+		buf[0] = i;
+		ret = tpm_hash_extend(t, SEQUENCE_PCR, buf, len, &policy,
+				      digests, sizeof(list));
+		if (ret != 0) {
+			fail("%s failed: %ld", p->name, ret);
+			break;
+		}
+
+		/* every active bank is extended whichever path ran */
+		check_digests(digests, buf, len);
+		p->count++;
+	}
+
+	phase_end(p);
+	check_pcr(SEQUENCE_PCR);
+	free(buf);
+}
+
+static void report_stats(void)
+{
+	struct tpm_stats *s = tpm_get_stats();
+	struct tpm_cmd_stats *c;
+	int i;
+
+	if (!s)
+		return;
+
+	printf("driver:\n"
+	       "  locality-requests: %u\n"
+	       "  locality-hits: %u\n"
+	       "  locality-timeouts: %u\n"
+	       "  locality-us: %.1f\n"
+	       "  polls: %llu\n"
+	       "  burst-waits: %llu\n"
+	       "  burst-polls: %llu\n"
+	       "  fifo-bytes-out: %llu\n"
+	       "  fifo-bytes-in: %llu\n"
+	       "  commands:\n",
+	       s->locality_requests, s->locality_hits, s->locality_timeouts,
+	       s->locality_time / 1000.0,
+	       (unsigned long long)s->polls,
+	       (unsigned long long)s->burst_waits,
+	       (unsigned long long)s->burst_polls,
+	       (unsigned long long)s->fifo_bytes_out,
+	       (unsigned long long)s->fifo_bytes_in);
+
+	for (i = 0; i < TPM_STATS_MAX_CMDS; i++) {
+		c = &s->cmds[i];
+		if (c->code == 0)
+			break;
+
+		/* the simulator's ticks are nanoseconds */
+		printf("    - code: 0x%x\n"
+		       "      count: %u\n"
+		       "      errors: %u\n"
+		       "      timeouts: %u\n"
+		       "      avg-us: %.1f\n"
+		       "      max-us: %.1f\n",
+		       c->code, c->count, c->errors, c->timeouts,
+		       c->count ? c->time / 1000.0 / c->count : 0.0,
+		       c->time_max / 1000.0);
+	}
+}
+
+static int parse_banks(char *arg)
+{
+	char *name;
+
+	cfg.bank_count = 0;
+	for (name = strtok(arg, ","); name; name = strtok(NULL, ",")) {
+		if (cfg.bank_count == SIM_MAX_BANKS ||
+		    !(cfg.banks[cfg.bank_count] = sim_alg_by_name(name))) {
+			fprintf(stderr, "bad bank: %s\n", name);
+			return -1;
+		}
+		cfg.bank_count++;
+	}
+
+	return cfg.bank_count ? 0 : -1;
+}
+
+static void usage(void)
+{
+	printf("Usage: tpm_sim [options]\n"
+	       "  -i, --interface tis|crb  register interface (default tis)\n"
+	       "  -1, --tpm12              TPM 1.2 on TIS\n"
+	       "  -w, --xfer32             advertise 32-bit FIFO transfers\n"
+	       "  -A, --acpi               describe the TPM in ACPI tables\n"
+	       "  -u, --burst N            burstCount offered (default 32)\n"
+	       "  -B, --banks LIST         active banks (default sha1,sha256)\n"
+	       "  -n, --count N            operations per phase (default 100)\n"
+	       "  -s, --size N             bytes per hash sequence, none by default\n"
+	       "  -a, --access-ns N        virtual ns per register access (default 1000)\n"
+	       "  -e, --exec-us N          virtual us per command (default 0)\n"
+	       "  -g, --grant-us N         virtual us to grant a locality (default 0)\n");
+}
+
+int main(int argc, char *argv[])
+{
+	static const struct option long_options[] = {
+		{ "interface", required_argument, NULL, 'i' },
+		{ "tpm12",     no_argument,       NULL, '1' },
+		{ "xfer32",    no_argument,       NULL, 'w' },
+		{ "acpi",      no_argument,       NULL, 'A' },
+		{ "burst",     required_argument, NULL, 'u' },
+		{ "banks",     required_argument, NULL, 'B' },
+		{ "count",     required_argument, NULL, 'n' },
+		{ "size",      required_argument, NULL, 's' },
+		{ "access-ns", required_argument, NULL, 'a' },
+		{ "exec-us",   required_argument, NULL, 'e' },
+		{ "grant-us",  required_argument, NULL, 'g' },
+		{ "help",      no_argument,       NULL, 'h' },
+		{ NULL,        0,                 NULL, 0   },
+	};
+	struct phase phases[6];
+	struct sim_counters counters;
+	unsigned n = 100, nphases = 0, i;
+	long size = -1;
+	struct tpm *t;
+	int c, b;
+
+	while ((c = getopt_long(argc, argv, "i:1wAu:B:n:s:a:e:g:h", long_options,
+				NULL)) != -1) {
+		switch (c) {
+		case 'i':
+			if (!strcmp(optarg, "tis")) {
+				cfg.intf = SIM_TIS;
+			} else if (!strcmp(optarg, "crb")) {
+				cfg.intf = SIM_CRB;
+			} else {
+				usage();
+				return 1;
+			}
+			break;
+		case '1':
+			cfg.tpm12 = 1;
+			break;
+		case 'w':
+			cfg.xfer32 = 1;
+			break;
+		case 'A':
+			cfg.acpi = 1;
+			break;
+		case 'u':
+			cfg.burst = strtoul(optarg, NULL, 0);
+			break;
+		case 'B':
+			if (parse_banks(optarg))
+				return 1;
+			break;
+		case 'n':
+			n = strtoul(optarg, NULL, 0);
+			break;
+		case 's':
+			size = strtol(optarg, NULL, 0);
+			break;
+		case 'a':
+			cfg.access_ns = strtoull(optarg, NULL, 0);
+			break;
+		case 'e':
+			cfg.exec_us = strtoull(optarg, NULL, 0);
+			break;
+		case 'g':
+			cfg.grant_us = strtoull(optarg, NULL, 0);
+			break;
+		default:
+			usage();
+			return 1;
+		}
+	}
+
+	if (cfg.tpm12 && (cfg.intf == SIM_CRB || cfg.xfer32 || size >= 0)) {
+		fprintf(stderr, "TPM 1.2 is TIS only, with a byte FIFO and "
+			"no hash sequences\n");
+		return 1;
+	}
+
+	if (sim_init(&cfg))
+		return 1;
+
+	tpm_set_rsdp(cfg.acpi ? sim_acpi_tables(&cfg) : TPM_NO_RSDP);
+
+	phase_begin(&phases[nphases], "enable");
+	t = enable_tpm();
+	phases[nphases].count = 1;
+	phase_end(&phases[nphases++]);
+	if (!t) {
+		fprintf(stderr, "enable_tpm failed\n");
+		sim_exit();
+		return 1;
+	}
+
+	if ((t->family == TPM12) != cfg.tpm12 ||
+	    (t->intf == TPM_CRB) != (cfg.intf == SIM_CRB))
+		fail("%s detected the wrong TPM%ld", "enable_tpm", 0);
+	if (!cfg.tpm12 && t->pcr_bank_count != cfg.bank_count)
+		fail("%s found %ld banks", "enable_tpm", t->pcr_bank_count);
+	if (sim_pm_tmr_port() != (cfg.acpi ? SIM_PM_TMR_PORT : 0))
+		fail("%s calibrated against port %#lx", "enable_tpm",
+		     sim_pm_tmr_port());
+
+	run_extends(t, n, &phases[nphases++]);
+	if (size >= 0) {
+		run_hashes(t, n, size, TPM_HASH_TPM, cfg.bank_count,
+			   "hash-sequence", &phases[nphases++]);
+		run_hashes(t, n, size, TPM_HASH_CPU, cfg.bank_count,
+			   "hash-cpu", &phases[nphases++]);
+		run_hashes(t, n, size, TPM_HASH_AUTO, cfg.bank_count,
+			   "hash-auto", &phases[nphases++]);
+		/* a policy short of a bank must keep to the TPM */
+		if (cfg.bank_count > 1)
+			run_hashes(t, n, size, TPM_HASH_AUTO,
+				   cfg.bank_count - 1, "hash-auto-partial",
+				   &phases[nphases++]);
+	}
+
+	free_tpm(t);
+
+	printf("---\n"
+	       "sim:\n"
+	       "  interface: %s\n"
+	       "  family: %s\n"
+	       "  fifo: %s\n"
+	       "  acpi: %s\n"
+	       "  burst: %u\n"
+	       "  access-ns: %llu\n"
+	       "  exec-us: %llu\n"
+	       "  grant-us: %llu\n"
+	       "  banks:\n",
+	       cfg.intf == SIM_CRB ? "crb" : "tis",
+	       cfg.tpm12 ? "1.2" : "2.0",
+	       cfg.xfer32 ? "32-bit" : "8-bit", cfg.acpi ? "yes" : "no",
+	       cfg.burst,
+	       (unsigned long long)cfg.access_ns,
+	       (unsigned long long)cfg.exec_us,
+	       (unsigned long long)cfg.grant_us);
+	if (cfg.tpm12)
+		printf("    - sha1\n");
+	else
+		for (b = 0; b < cfg.bank_count; b++)
+			printf("    - %s\n", sim_alg_name(cfg.banks[b]));
+
+	printf("results:\n");
+	for (i = 0; i < nphases; i++)
+		phase_report(&phases[i]);
+
+	report_stats();
+
+	sim_counters(&counters);
+	printf("commands: %llu\n"
+	       "protocol-errors: %llu\n"
+	       "failures: %u\n"
+	       "result: %s\n",
+	       (unsigned long long)counters.commands,
+	       (unsigned long long)counters.protocol_errors, failures,
+	       counters.protocol_errors || failures ? "fail" : "pass");
+
+	sim_exit();
+
+	return counters.protocol_errors || failures ? 1 : 0;
+}
@@ -14,53 +14,161 @@
 
 #include "tpm_common.h"
 #include "tis.h"
+#include "tpm_stats.h"
 
 static u8 locality = TPM_NO_LOCALITY;
 
+/* bytes moved per FIFO access, 4 when the TPM takes 32-bit transfers */
+static u8 fifo_width = 1;
+
+/* burstCount, or 0 if the FIFO did not drain within TIMEOUT_D */
 static u32 burst_wait(void)
 {
+	u64 deadline = tpm_deadline(TPM_TIMEOUT_D);
+	u64 start = tpm_stats_start();
 	u32 count = 0;
 
+	tpm_stats_add(burst_waits, 1);
 	while (count == 0) {
-		count = tpm_read8(STS(locality) + 1);
-		count += tpm_read8(STS(locality) + 2) << 8;
+		tpm_stats_add(burst_polls, 1);
+		if (fifo_width == 4) {
+			count = (tpm_read32(STS(locality)) >> 8) & 0xFFFF;
+		} else {
+			count = tpm_read8(STS(locality) + 1);
+			count += tpm_read8(STS(locality) + 2) << 8;
+		}
 
-		if (count == 0)
-			tpm_io_delay(); /* wait for FIFO to drain */
+		if (count == 0) {
+			if (tpm_deadline_passed(deadline))
+				break;
+			tpm_udelay(TPM_POLL_INTERVAL); /* wait for FIFO to drain */
+		}
 	}
 
+	tpm_stats_time(burst_time, start);
 	return count;
 }
 
+/* the STS value status_valid last read */
+static u8 last_status;
+
+static u8 status_valid(void)
+{
+	last_status = tpm_read8(STS(locality));
+
+	return (last_status & STS_VALID) != 0;
+}
+
+/*
+ * STS once stsValid is set, 0 if it does not settle within TIMEOUT_C. The
+ * wait goes through tpm_poll so that time also passes without a TSC.
+ */
+static u8 valid_status(void)
+{
+	if (!tpm_poll(status_valid, TPM_TIMEOUT_C))
+		return 0;
+
+	return last_status;
+}
+
+static u32 fifo_port(void)
+{
+	if (fifo_width == 4)
+		return XDATA_FIFO(locality);
+
+	return DATA_FIFO(locality);
+}
+
+/* write len bytes of one burst, a word at a time then the tail bytewise */
+static void fifo_write(const u8 *buf, u32 len)
+{
+	u32 port = fifo_port();
+
+	tpm_stats_add(fifo_bytes_out, len);
+	if (fifo_width == 4) {
+		for (; len >= 4; len -= 4, buf += 4)
+			tpm_write32(buf[0] | buf[1] << 8 | buf[2] << 16 |
+				    (u32)buf[3] << 24, port);
+	}
+
+	for (; len > 0; len--, buf++)
+		tpm_write8(*buf, port);
+}
+
+static void fifo_read(u8 *buf, u32 len)
+{
+	u32 port = fifo_port();
+	u32 val;
+
+	tpm_stats_add(fifo_bytes_in, len);
+	if (fifo_width == 4) {
+		for (; len >= 4; len -= 4, buf += 4) {
+			val = tpm_read32(port);
+			buf[0] = val;
+			buf[1] = val >> 8;
+			buf[2] = val >> 16;
+			buf[3] = val >> 24;
+		}
+	}
+
+	for (; len > 0; len--, buf++)
+		*buf = tpm_read8(port);
+}
+
 void tis_relinquish_locality(void)
 {
-	if (locality < TPM_MAX_LOCALITY)
+	if (locality <= TPM_MAX_LOCALITY)
 		tpm_write8(ACCESS_RELINQUISH_LOCALITY, ACCESS(locality));
 
 	locality = TPM_NO_LOCALITY;
 }
 
+/* the locality tis_request_locality is waiting on */
+static u8 requested = TPM_NO_LOCALITY;
+
+static u8 locality_granted(void)
+{
+	u8 access = tpm_read8(ACCESS(requested));
+
+	return (access & (ACCESS_VALID | ACCESS_ACTIVE_LOCALITY)) ==
+	       (ACCESS_VALID | ACCESS_ACTIVE_LOCALITY);
+}
+
+/*
+ * Take locality l, keeping it if it is already held so back to back
+ * commands do not cycle it. The grant is polled with backoff for up to
+ * TIMEOUT_A, after which the request is withdrawn and -ETIMEDOUT returned
+ * rather than carrying on without a locality.
+ */
 s8 tis_request_locality(u8 l)
 {
 	if (l > TPM_MAX_LOCALITY)
 		return -EINVAL;
 
-	if (l == locality)
+	if (l == locality) {
+		tpm_stats_add(locality_hits, 1);
 		return 0;
+	}
 
 	tis_relinquish_locality();
 
 	tpm_write8(ACCESS_REQUEST_USE, ACCESS(l));
 
-	/* wait for locality to be granted */
-	if (tpm_read8(ACCESS(l)) & ACCESS_ACTIVE_LOCALITY)
-		locality = l;
+	requested = l;
+	if (!tpm_poll_backoff(locality_granted, TPM_TIMEOUT_A)) {
+		/* an active locality write clears a pending request */
+		tpm_write8(ACCESS_RELINQUISH_LOCALITY, ACCESS(l));
+		tpm_stats_add(locality_timeouts, 1);
+		return -ETIMEDOUT;
+	}
 
+	locality = l;
 	return 0;
 }
 
 u8 tis_init(struct tpm *t)
 {
+	struct tpm_intf_capability intf_cap;
 	u8 i;
 
 	for (i = 0; i <= TPM_MAX_LOCALITY; i++)
@@ -75,70 +183,126 @@ u8 tis_init(struct tpm *t)
 	if ((t->vendor & 0xFFFF) == 0xFFFF)
 		return 0;
 
+	/* TPM 2.0 FIFOs that take more than legacy byte transfers */
+	intf_cap.val = tpm_read32(TPM_INTF_CAPABILITY_0);
+	if (intf_cap.interface_version == TPM20_TIS_INTF_13 &&
+	    intf_cap.data_transfer_size_support != TPM_XFER_SIZE_LEGACY)
+		fifo_width = 4;
+	else
+		fifo_width = 1;
+
 	return 1;
 }
 
-size_t tis_send(struct tpmbuff *buf)
+/* stream len bytes in bursts, the TPM must still expect more afterwards */
+static u8 send_data(const u8 *buf, size_t len)
 {
-	u8 status, *buf_ptr;
+	size_t count = 0;
 	u32 burstcnt = 0;
-	u32 count = 0;
+	u8 status;
+
+	while (count < len) {
+		burstcnt = burst_wait();
+		if (burstcnt == 0)
+			return 0;
+		if (burstcnt > len - count)
+			burstcnt = len - count;
+
+		fifo_write(buf + count, burstcnt);
+		count += burstcnt;
+
+		/* check for overflow */
+		status = valid_status();
+		if ((status & STS_DATA_EXPECT) == 0)
+			return 0;
+	}
+
+	return 1;
+}
+
+size_t tis_send(struct tpmbuff *buf)
+{
+	struct tpmbuff_seg *seg;
+	size_t head_len = tpmb_head_len(buf);
+	u8 status, last;
 
 	if (locality > TPM_MAX_LOCALITY)
 		return 0;
 
 	tpm_write8(STS_COMMAND_READY, STS(locality));
 
-	buf_ptr = buf->head;
+	/*
+	 * send all but the last byte, the head area then each overflow
+	 * segment in order
+	 */
+	if (!buf->overflow) {
+		if (!send_data(buf->head, head_len - 1))
+			return 0;
+		last = buf->head[head_len - 1];
+	} else {
+		if (!send_data(buf->head, head_len))
+			return 0;
 
-	/* send all but the last byte */
-	while (count < (buf->len - 1)) {
-		burstcnt = burst_wait();
-		for (; burstcnt > 0 && count < (buf->len - 1); burstcnt--) {
-			tpm_write8(buf_ptr[count], DATA_FIFO(locality));
-			count++;
+		for (seg = buf->overflow; seg->next; seg = seg->next) {
+			if (!send_data(seg->data, seg->len))
+				return 0;
 		}
 
-		/* check for overflow */
-		for (status = 0; (status & STS_VALID) == 0; )
-			status = tpm_read8(STS(locality));
-
-		if ((status & STS_DATA_EXPECT) == 0)
+		if (!send_data(seg->data, seg->len - 1))
 			return 0;
+		last = seg->data[seg->len - 1];
 	}
 
 	/* write last byte */
-	tpm_write8(buf_ptr[buf->len - 1], DATA_FIFO(locality));
-	count++;
+	tpm_write8(last, DATA_FIFO(locality));
 
 	/* make sure it stuck */
-	for (status = 0; (status & STS_VALID) == 0; )
-		status = tpm_read8(STS(locality));
-
-	if ((status & STS_DATA_EXPECT) != 0)
+	status = valid_status();
+	if ((status & STS_VALID) == 0 || (status & STS_DATA_EXPECT) != 0)
 		return 0;
 
 	/* go and do it */
 	tpm_write8(STS_GO, STS(locality));
 
-	return (size_t)count;
+	return tpmb_size(buf);
+}
+
+static u8 response_ready(void)
+{
+	return tis_data_available(locality);
+}
+
+/*
+ * Wait up to duration microseconds for the command sent by tis_send to
+ * complete, aborting it with commandReady if it overruns. Returns 1 once a
+ * response is available.
+ */
+u8 tis_wait_response(u32 duration)
+{
+	if (locality > TPM_MAX_LOCALITY)
+		return 0;
+
+	if (tpm_poll(response_ready, duration))
+		return 1;
+
+	tpm_write8(STS_COMMAND_READY, STS(locality));
+	return 0;
 }
 
 static size_t recv_data(unsigned char *buf, size_t len)
 {
 	size_t size = 0;
-	u8 status, *bufptr;
 	u32 burstcnt = 0;
 
-	bufptr = (u8 *)buf;
-
 	while (tis_data_available(locality) && size < len) {
 		burstcnt = burst_wait();
-		for (; burstcnt > 0 && size < len; burstcnt--) {
-			*bufptr = tpm_read8(DATA_FIFO(locality));
-			bufptr++;
-			size++;
-		}
+		if (burstcnt == 0)
+			break;
+		if (burstcnt > len - size)
+			burstcnt = len - size;
+
+		fifo_read(buf + size, burstcnt);
+		size += burstcnt;
 	}
 
 	return size;
@@ -146,8 +310,8 @@ static size_t recv_data(unsigned char *buf, size_t len)
 
 size_t tis_recv(struct tpmbuff *buf)
 {
-	u32 expected;
-	u8 status, *buf_ptr;
+	u32 expected, chunk = 0, len;
+	u8 *buf_ptr = NULL;
 	struct tpm_header *hdr;
 
 	if (locality > TPM_MAX_LOCALITY)
@@ -168,23 +332,37 @@ size_t tis_recv(struct tpmbuff *buf)
 	hdr->size = be32_to_cpu(hdr->size);
 	hdr->code = be32_to_cpu(hdr->code);
 
-	/* hdr->size = header + data */
-	expected = hdr->size - expected;
-	buf_ptr = tpmb_put(buf, expected);
-	if (!buf_ptr)
+	if (hdr->size < expected)
 		goto err;
 
-	/* read all data, except last byte */
-	if (recv_data(buf_ptr, expected - 1) < (expected - 1))
-		goto err;
+	/*
+	 * hdr->size = header + data, read in chunks that tpmb_put can place
+	 * in the head area or an overflow segment, holding back the last byte
+	 */
+	expected = hdr->size - expected;
+	while (expected > 0) {
+		chunk = expected > TPMB_SEG_SIZE ? TPMB_SEG_SIZE : expected;
+		buf_ptr = tpmb_put(buf, chunk);
+		if (!buf_ptr)
+			goto err;
 
-	/* check for receive underflow */
-	if (!tis_data_available(locality))
-		goto err;
+		len = chunk == expected ? chunk - 1 : chunk;
+		if (recv_data(buf_ptr, len) < len)
+			goto err;
 
-	/* read last byte */
-	if (recv_data(buf_ptr, 1) != 1)
-		goto err;
+		expected -= chunk;
+	}
+
+	/* error responses are only a header */
+	if (chunk > 0) {
+		/* check for receive underflow */
+		if (!tis_data_available(locality))
+			goto err;
+
+		/* read last byte */
+		if (recv_data(buf_ptr + chunk - 1, 1) != 1)
+			goto err;
+	}
 
 	/* make sure we read everything */
 	if (tis_data_available(locality))
@@ -23,8 +23,10 @@
 #define ACCESS(l)			(0x0000 | ((l) << 12))
 #define STS(l)				(0x0018 | ((l) << 12))
 #define DATA_FIFO(l)			(0x0024 | ((l) << 12))
+#define XDATA_FIFO(l)			(0x0080 | ((l) << 12))
 #define DID_VID(l)			(0x0F00 | ((l) << 12))
 /* access bits */
+#define ACCESS_VALID			0x80 /* (R) */
 #define ACCESS_ACTIVE_LOCALITY		0x20 /* (R)*/
 #define ACCESS_RELINQUISH_LOCALITY	0x20 /* (W) */
 #define ACCESS_REQUEST_USE		0x02 /* (W) */
@@ -49,6 +51,7 @@ s8 tis_request_locality(u8 l);
 void tis_relinquish_locality(void);
 u8 tis_init(struct tpm *t);
 size_t tis_send(struct tpmbuff *buf);
+u8 tis_wait_response(u32 duration);
 size_t tis_recv(struct tpmbuff *buf);
 
 #endif
@@ -7,6 +7,7 @@
  */
 
 #include <tpm.h>
+#include <tpmbuff.h>
 
 #include "tis.h"
 #include "crb.h"
@@ -14,6 +15,8 @@
 #include "tpm1.h"
 #include "tpm2.h"
 #include "tpm2_constants.h"
+#include "tpm_acpi.h"
+#include "tpm_stats.h"
 
 static struct tpm tpm;
 
@@ -22,6 +25,17 @@ static void find_interface_and_family(struct tpm *t)
 	struct tpm_interface_id intf_id;
 	struct tpm_intf_capability intf_cap;
 
+	/*
+	 * CRB is only found on 2.0, and its register space has nothing at
+	 * the TIS capability offset, so check for it first
+	 */
+	intf_id.val = tpm_read32(TPM_INTERFACE_ID_0);
+	if (intf_id.interface_type == TPM_CRB_INTF_ACTIVE) {
+		t->family = TPM20;
+		t->intf = TPM_CRB;
+		return;
+	}
+
 	/* Sort out whether if it is 1.2 */
 	intf_cap.val = tpm_read32(TPM_INTF_CAPABILITY_0);
 	if ((intf_cap.interface_version == TPM12_TIS_INTF_12) ||
@@ -31,21 +45,34 @@ static void find_interface_and_family(struct tpm *t)
 		return;
 	}
 
-	/* Assume that it is 2.0 and TIS */
+	/* Otherwise it is 2.0 and TIS */
 	t->family = TPM20;
 	t->intf = TPM_TIS;
-
-	/* Check if the interface is CRB */
-	intf_id.val = tpm_read32(TPM_INTERFACE_ID_0);
-	if (intf_id.interface_type == TPM_CRB_INTF_ACTIVE)
-		t->intf = TPM_CRB;
 }
 
 struct tpm *enable_tpm(void)
 {
 	struct tpm *t = &tpm;
+	struct tpm_acpi acpi;
+	int ret;
+
+	/*
+	 * Register probing is only for when there is no table. A TPM the
+	 * tables describe but the driver cannot run is refused, as probing
+	 * would find its registers and drive it the wrong way.
+	 */
+	ret = tpm_acpi_discover(&acpi);
+	if (ret == 0) {
+		t->family = acpi.family;
+		t->intf = acpi.intf;
+	} else if (ret == -ENOENT) {
+		find_interface_and_family(t);
+	} else {
+		goto err;
+	}
 
-	find_interface_and_family(t);
+	/* a no-op if the loader already calibrated against the PM timer */
+	tpm_time_init(acpi.pm_tmr_port);
 
 	switch (t->intf) {
 	case TPM_DEVNODE:
@@ -56,7 +83,7 @@ struct tpm *enable_tpm(void)
 			goto err;
 		break;
 	case TPM_CRB:
-		if (!crb_init(t))
+		if (!crb_init(t, acpi.control_area))
 			goto err;
 		break;
 	case TPM_UEFI:
@@ -64,7 +91,16 @@ struct tpm *enable_tpm(void)
 		break;
 	}
 
-	/* TODO: ACPI TPM discovery */
+	if (!t->buff)
+		t->buff = alloc_tpmbuff(t->intf, 0);
+	if (!t->buff)
+		goto err;
+
+	/* CPU hashing has to know which banks it must cover */
+	t->pcr_bank_count = sizeof(t->pcr_banks) / sizeof(t->pcr_banks[0]);
+	if (t->family != TPM20 ||
+	    tpm2_pcr_banks(t, t->pcr_banks, &t->pcr_bank_count) != 0)
+		t->pcr_bank_count = 0;
 
 	return t;
 
@@ -74,8 +110,11 @@ err:
 
 s8 tpm_request_locality(struct tpm *t, u8 l)
 {
+	u64 start = tpm_stats_start();
 	s8 err = 0;
 
+	tpm_stats_add(locality_requests, 1);
+
 	switch (t->intf) {
 	case TPM_DEVNODE:
 		/* Not implemented yet */
@@ -91,6 +130,7 @@ s8 tpm_request_locality(struct tpm *t, u8 l)
 		break;
 	}
 
+	tpm_stats_time(locality_time, start);
 	return err;
 }
 
@@ -118,8 +158,7 @@ int tpm_extend_pcr(struct tpm *t, u32 pcr, u16 algo,
 {
 	int ret = 0;
 
-	if (t->family == TPM12 ||
-	    (t->family == TPM20 && t->intf == TPM_TIS)) {
+	if (t->family == TPM12) {
 		struct tpm_digest d;
 
 		if (algo != TPM_ALG_SHA1) {
@@ -131,40 +170,23 @@ int tpm_extend_pcr(struct tpm *t, u32 pcr, u16 algo,
 		memcpy((void *)d.digest.sha1.digest,
 			digest, SHA1_DIGEST_SIZE);
 
-		ret = tpm1_pcr_extend(t, &d);
+		ret = tpm1_pcr_extend(t, &d) ? 0 : -EIO;
 	} else if (t->family == TPM20) {
 		struct tpml_digest_values *d;
-		u8 buf[MAX_TPM_EXTEND_SIZE];
+		u32 buf[MAX_TPM_EXTEND_SIZE / sizeof(u32) + 1];
+		u16 size = tpm2_digest_size(algo);
 
-		d = (struct tpml_digest_values *) buf;
-		d->count = 1;
-		switch (algo) {
-		case TPM_ALG_SHA1:
-			d->digests->alg = TPM_ALG_SHA1;
-			memcpy(d->digests->digest, digest, SHA1_SIZE);
-			break;
-		case TPM_ALG_SHA256:
-			d->digests->alg = TPM_ALG_SHA256;
-			memcpy(d->digests->digest, digest, SHA256_SIZE);
-			break;
-		case TPM_ALG_SHA384:
-			d->digests->alg = TPM_ALG_SHA384;
-			memcpy(d->digests->digest, digest, SHA384_SIZE);
-			break;
-		case TPM_ALG_SHA512:
-			d->digests->alg = TPM_ALG_SHA512;
-			memcpy(d->digests->digest, digest, SHA512_SIZE);
-			break;
-		case TPM_ALG_SM3_256:
-			d->digests->alg = TPM_ALG_SM3_256;
-			memcpy(d->digests->digest, digest, SM3256_SIZE);
-			break;
-		default:
+		if (size == 0) {
 			ret = -EINVAL;
 			goto out;
 		}
 
-		ret = tpm2_extend_pcr(t, pcr, d);
+		d = (struct tpml_digest_values *) buf;
+		d->count = 1;
+		d->digests->alg = algo;
+		memcpy(d->digests->digest, digest, size);
+
+		ret = tpm_extend_pcr_digests(t, pcr, d);
 	} else {
 		ret = -EINVAL;
 	}
@@ -172,7 +194,201 @@ out:
 	return ret;
 }
 
+/*
+ * Extend pcr in every bank of digests with one TPM2_PCR_Extend, whether the
+ * TPM sits behind TIS or CRB. digests is in host byte order. Returns 0 on
+ * success, the TPM response code if the TPM failed the command, or a
+ * negative errno.
+ */
+int tpm_extend_pcr_digests(struct tpm *t, u32 pcr,
+		struct tpml_digest_values *digests)
+{
+	if (t->family != TPM20)
+		return -EINVAL;
+
+	switch (t->intf) {
+	case TPM_TIS:
+	case TPM_CRB:
+		return tpm2_extend_pcr(t, pcr, digests);
+	default:
+		/* Not implemented yet */
+		return -EINVAL;
+	}
+}
+
+/* ranges shorter than this say more about command overhead than rate */
+#define TPM_HASH_RATE_MIN	(64 * 1024)
+
+/* the policy's clock, else the calibrated TSC, else none */
+static u64 (*hash_clock(struct tpm_hash_policy *p))(void)
+{
+	if (p && p->now)
+		return p->now;
+
+	if (tpm_time_calibrated())
+		return tpm_now;
+
+	return NULL;
+}
+
+static int policy_has_bank(struct tpm_hash_policy *p, u16 alg)
+{
+	int i;
+
+	for (i = 0; i < p->bank_count && i < 5; i++)
+		if (p->banks[i] == alg)
+			return 1;
+
+	return 0;
+}
+
+/* whether the CPU can produce a digest for every active bank */
+static int cpu_covers_banks(struct tpm *t, struct tpm_hash_policy *p)
+{
+	int i;
+
+	if (t->pcr_bank_count == 0)
+		return 0;
+
+	for (i = 0; i < t->pcr_bank_count; i++)
+		if (!policy_has_bank(p, t->pcr_banks[i]))
+			return 0;
+
+	return 1;
+}
+
+static int use_cpu_hash(struct tpm *t, struct tpm_hash_policy *p)
+{
+	if (p == NULL || p->cpu_hash == NULL || p->bank_count == 0)
+		return 0;
+
+	switch (p->mode) {
+	case TPM_HASH_TPM:
+		return 0;
+	case TPM_HASH_CPU:
+		return 1;
+	default:
+		break;
+	}
+
+	/* a bank the CPU skips would be left unextended */
+	if (!cpu_covers_banks(t, p))
+		return 0;
+
+	if (p->cpu_rate == 0)
+		return 1;
+	/* only sample the TPM if it can be timed */
+	if (p->tpm_rate == 0)
+		return hash_clock(p) == NULL;
+
+	return p->cpu_rate >= p->tpm_rate;
+}
+
+static int cpu_hash_extend(struct tpm *t, u32 pcr, const u8 *data,
+		size_t len, struct tpm_hash_policy *p,
+		struct tpml_digest_values *digests, size_t size)
+{
+	u8 *dst = (u8 *)digests->digests;
+	u16 alg, dsize;
+	int i, ret;
+
+	if (!cpu_covers_banks(t, p))
+		return -EINVAL;
+
+	size -= sizeof(u32);
+	for (i = 0; i < t->pcr_bank_count; i++) {
+		alg = t->pcr_banks[i];
+		dsize = tpm2_digest_size(alg);
+		if (dsize == 0)
+			return -EINVAL;
+		if (sizeof(u16) + dsize > size)
+			return -ENOMEM;
+
+		((struct tpmt_ha *)dst)->alg = alg;
+		ret = p->cpu_hash(alg, data, len,
+				((struct tpmt_ha *)dst)->digest);
+		if (ret < 0)
+			return ret;
+
+		dst += sizeof(u16) + dsize;
+		size -= sizeof(u16) + dsize;
+	}
+
+	digests->count = t->pcr_bank_count;
+
+	return tpm_extend_pcr_digests(t, pcr, digests);
+}
+
+static void update_rate(u64 *rate, size_t len, u64 start, u64 end)
+{
+	u64 ticks = end - start;
+
+	if (len < TPM_HASH_RATE_MIN)
+		return;
+
+	*rate = ((u64)len << 10) / (ticks ? ticks : 1);
+}
+
+/*
+ * Measure len bytes at data into pcr, hashing on the TPM or the CPU as
+ * policy selects; a NULL policy always hashes on the TPM. The digests
+ * extended are returned in digests, host order, which has room for size
+ * bytes, TPM_MAX_DIGEST_LIST_SIZE being always enough. Returns 0 on
+ * success, the TPM response code if the TPM failed a command, or a
+ * negative errno.
+ */
+int tpm_hash_extend(struct tpm *t, u32 pcr, const u8 *data, size_t len,
+		struct tpm_hash_policy *policy,
+		struct tpml_digest_values *digests, size_t size)
+{
+	u64 (*now)(void) = hash_clock(policy);
+	int cpu = use_cpu_hash(t, policy);
+	u64 start = 0;
+	int ret;
+
+	if (t->family != TPM20 || size < sizeof(u32))
+		return -EINVAL;
+
+	if (cpu) {
+		if (now)
+			start = now();
+
+		ret = cpu_hash_extend(t, pcr, data, len, policy, digests,
+				size);
+		/* in auto mode a bank the loader cannot hash goes to the TPM */
+		if (ret == -EINVAL && policy->mode == TPM_HASH_AUTO)
+			cpu = 0;
+		else if (ret == 0 && now)
+			update_rate(&policy->cpu_rate, len, start, now());
+		if (cpu)
+			return ret;
+	}
+
+	if (now)
+		start = now();
+
+	switch (t->intf) {
+	case TPM_TIS:
+	case TPM_CRB:
+		ret = tpm2_hash_sequence(t, pcr, data, len, digests, size);
+		break;
+	default:
+		/* Not implemented yet */
+		return -EINVAL;
+	}
+
+	if (ret == 0 && policy && now)
+		update_rate(&policy->tpm_rate, len, start, now());
+
+	return ret;
+}
+
 void free_tpm(struct tpm *t)
 {
+	if (t->buff) {
+		free_tpmbuff(t->buff, t->intf);
+		t->buff = NULL;
+	}
+
 	tpm_relinquish_locality(t);
 }
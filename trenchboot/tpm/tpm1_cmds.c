@@ -22,33 +22,35 @@ u8 tpm1_pcr_extend(struct tpm *t, struct tpm_digest *d)
 	struct tpmbuff *b = t->buff;
 	struct tpm_header *hdr;
 	struct tpm_extend_cmd *cmd;
-	struct tpm_extend_resp *resp;
-	size_t bytes;
+	size_t size = 0;
 
 	if (!tpmb_reserve(b))
 		goto out;
 
 	hdr = (struct tpm_header *)b->head;
 
-	hdr->tag = TPM_TAG_RQU_COMMAND;
-	hdr->code = TPM_ORD_EXTEND;
+	/* TPM 1.2 commands are big endian on the wire */
+	hdr->tag = cpu_to_be16(TPM_TAG_RQU_COMMAND);
+	hdr->code = cpu_to_be32(TPM_ORD_EXTEND);
 
 	cmd = (struct tpm_extend_cmd *)
 		tpmb_put(b, sizeof(struct tpm_extend_cmd));
 	if (cmd == NULL)
 		goto free;
 
-	cmd->pcr_num = d->pcr;
+	cmd->pcr_num = cpu_to_be32(d->pcr);
 	memcpy(&(cmd->digest), &(d->digest), sizeof(TPM_DIGEST));
 
-	hdr->size = tpmb_size(b);
+	hdr->size = cpu_to_be32(tpmb_size(b));
 
 	switch (t->intf) {
 	case TPM_DEVNODE:
 		/* Not implemented yet */
 		break;
 	case TPM_TIS:
-		if (hdr->size != tis_send(b))
+		if (tpmb_size(b) != tis_send(b))
+			goto free;
+		if (!tis_wait_response(TPM_DURATION_MEDIUM))
 			goto free;
 		break;
 	case TPM_CRB:
@@ -65,19 +67,13 @@ u8 tpm1_pcr_extend(struct tpm *t, struct tpm_digest *d)
 	if (!tpmb_reserve(b))
 		goto out;
 
-	hdr = (struct tpm_header *)b->head;
-	resp = (struct tpm_extend_resp *)
-		tpmb_put(b, sizeof(struct tpm_extend_resp));
-	if (resp == NULL)
-		goto free;
-
 	switch (t->intf) {
 	case TPM_DEVNODE:
 		/* Not implemented yet */
 		break;
 	case TPM_TIS:
-		if (tpmb_size(b) != tis_recv(b))
-			goto free;
+		/* receive converts the header to host order */
+		size = tis_recv(b);
 		break;
 	case TPM_CRB:
 		/* Not valid for TPM 1.2 */
@@ -87,10 +83,13 @@ u8 tpm1_pcr_extend(struct tpm *t, struct tpm_digest *d)
 		break;
 	}
 
-	tpmb_free(b);
+	/* a successful response carries the new PCR value */
+	hdr = (struct tpm_header *)b->head;
+	if (size != sizeof(struct tpm_header) + sizeof(TPM_PCRVALUE) ||
+	    hdr->code != TPM_SUCCESS)
+		goto free;
 
-	if (resp->ordinal != TPM_SUCCESS)
-		goto out;
+	tpmb_free(b);
 
 	return 1;
 free:
@@ -39,18 +39,6 @@ struct tpma_session {
 };
 
 
-/* Table 72  Definition of TPMT_HA Structure <  IN/OUT> */
-struct tpmt_ha {
-	u16 alg;	/* TPMI_ALG_HASH	*/
-	u8 digest[0];	/* TPMU_HA		*/
-};
-
-/* Table 100  Definition of TPML_DIGEST_VALUES Structure */
-struct tpml_digest_values {
-	u32 count;
-	struct tpmt_ha digests[0];
-};
-
 
 /* Table 124  Definition of TPMS_AUTH_COMMAND Structure <  IN> */
 struct tpms_auth_cmd {
@@ -70,7 +58,8 @@ struct tpms_auth_resp {
 struct tpm2_cmd {
 	struct tpm_header *header;
 	u32 *handles;		/* TPM_HANDLE		*/
-	struct tpm2b *auth;	/* Authorization Area	*/
+	u32 *auth_size;		/* authorizationSize	*/
+	u8 *auth;		/* Authorization Area	*/
 	u8 *params;		/* Parameters		*/
 	u8 *raw;		/* internal raw buffer	*/
 };
@@ -83,7 +72,11 @@ struct tpm2_resp {
 	u8 *raw;		/* internal raw buffer	*/
 };
 
+u16 tpm2_digest_size(u16 alg);
 int tpm2_extend_pcr(struct tpm *t, u32 pcr,
 		struct tpml_digest_values *digests);
+int tpm2_pcr_banks(struct tpm *t, u16 *banks, u8 *count);
+int tpm2_hash_sequence(struct tpm *t, u32 pcr, const u8 *data, size_t len,
+		struct tpml_digest_values *digests, size_t size);
 
 #endif
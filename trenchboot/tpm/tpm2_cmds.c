@@ -6,12 +6,14 @@
  *
  */
 
+#include <mem.h>
 #include <tpm.h>
 #include <tpmbuff.h>
 
 #include "tpm_common.h"
 #include "tpm2.h"
 #include "tpm2_auth.h"
+#include "tpm_stats.h"
 #include "tis.h"
 #include "crb.h"
 
@@ -28,56 +30,220 @@ static int tpm2_alloc_cmd(struct tpmbuff *b, struct tpm2_cmd *c, u16 tag,
 	return 0;
 }
 
-static u16 convert_digest_list(struct tpml_digest_values *digests)
+u16 tpm2_digest_size(u16 alg)
 {
-	int i;
-	u16 size = 0;
-	struct tpmt_ha *h = digests->digests;
+	switch (alg) {
+	case TPM_ALG_SHA1:
+		return SHA1_SIZE;
+	case TPM_ALG_SHA256:
+		return SHA256_SIZE;
+	case TPM_ALG_SHA384:
+		return SHA384_SIZE;
+	case TPM_ALG_SHA512:
+		return SHA512_SIZE;
+	case TPM_ALG_SM3_256:
+		return SM3256_SIZE;
+	default:
+		return 0;
+	}
+}
+
+/* size of the marshalled TPML_DIGEST_VALUES, 0 if an alg is unknown */
+static u16 digest_list_size(struct tpml_digest_values *digests)
+{
+	u8 *p = (u8 *)digests->digests;
+	u16 size = sizeof(u32);
+	u16 dsize;
+	u32 i;
+
+	if (digests->count == 0)
+		return 0;
 
 	for (i = 0; i < digests->count; i++) {
-		switch (h->alg) {
-		case TPM_ALG_SHA1:
-			h->alg = cpu_to_be16(h->alg);
-			h = (struct tpmt_ha *)((u8 *)h + SHA1_SIZE);
-			size += sizeof(u16) + SHA1_SIZE;
+		dsize = tpm2_digest_size(((struct tpmt_ha *)p)->alg);
+		if (dsize == 0)
+			return 0;
+
+		p += sizeof(u16) + dsize;
+		size += sizeof(u16) + dsize;
+	}
+
+	return size;
+}
+
+/* marshal the host order list into dst, leaving the caller's list intact */
+static void marshal_digest_list(u8 *dst, struct tpml_digest_values *digests)
+{
+	u8 *p = (u8 *)digests->digests;
+	struct tpmt_ha *h;
+	u16 alg, dsize;
+	u32 i;
+
+	*(u32 *)dst = cpu_to_be32(digests->count);
+	dst += sizeof(u32);
+
+	for (i = 0; i < digests->count; i++) {
+		h = (struct tpmt_ha *)p;
+		alg = h->alg;
+		dsize = tpm2_digest_size(alg);
+
+		*(u16 *)dst = cpu_to_be16(alg);
+		memcpy(dst + sizeof(u16), h->digest, dsize);
+
+		p += sizeof(u16) + dsize;
+		dst += sizeof(u16) + dsize;
+	}
+}
+
+/* authorization area with a null password session for each handle */
+static int tpm2_put_null_auth(struct tpmbuff *b, struct tpm2_cmd *c,
+		int sessions)
+{
+	u32 size = 0;
+	int i;
+
+	c->auth_size = (u32 *)tpmb_put(b, sizeof(u32));
+	c->auth = tpmb_put(b, sessions * tpm2_null_auth_size());
+	if (c->auth_size == NULL || c->auth == NULL)
+		return -ENOMEM;
+
+	for (i = 0; i < sessions; i++)
+		size += tpm2_null_auth(c->auth + size);
+
+	*c->auth_size = cpu_to_be32(size);
+
+	return 0;
+}
+
+/* append a TPM2B_MAX_BUFFER, the size and payload going in separate puts */
+static int tpm2_put_buffer(struct tpmbuff *b, const u8 *data, u16 len)
+{
+	u16 *size;
+	u8 *p;
+
+	size = (u16 *)tpmb_put(b, sizeof(u16));
+	if (size == NULL)
+		return -ENOMEM;
+
+	*size = cpu_to_be16(len);
+	if (len == 0)
+		return 0;
+
+	p = tpmb_put(b, len);
+	if (p == NULL)
+		return -ENOMEM;
+
+	memcpy(p, data, len);
+
+	return 0;
+}
+
+/* duration class of a command, as the PTP assigns them */
+static u32 tpm2_duration(u32 code)
+{
+	switch (code) {
+	case TPM_CC_FLUSH_CONTEXT:
+		return TPM_DURATION_SHORT;
+	case TPM_CC_SEQUENCE_UPDATE:
+	case TPM_CC_PCR_EXTEND:
+	case TPM_CC_EVENT_SEQUENCE_COMPLETE:
+	case TPM_CC_HASH_SEQUENCE_START:
+	case TPM_CC_GET_CAPABILITY:
+		return TPM_DURATION_MEDIUM;
+	default:
+		return TPM_DURATION_LONG;
+	}
+}
+
+/*
+ * Submit the command built in b, wait for it to complete within its
+ * duration class and read back the response, which is left in b with its
+ * header in host order. Every TPM2 command goes through here so the next
+ * one is never issued over an unfinished one. Returns the TPM response
+ * code, -ETIMEDOUT if the command overran and was aborted, or another
+ * negative errno if the exchange failed.
+ */
+static int tpm2_transmit(struct tpm *t, struct tpmbuff *b)
+{
+	struct tpm_header *hdr = (struct tpm_header *)b->head;
+	u32 code = be32_to_cpu(hdr->code);
+	u32 duration = tpm2_duration(code);
+	size_t len = tpmb_size(b);
+	u64 start = tpm_stats_start();
+	int ret = -EIO;
+
+	switch (t->intf) {
+	case TPM_DEVNODE:
+		/* Not implemented yet */
+		break;
+	case TPM_TIS:
+		if (tis_send(b) != len)
 			break;
-		case TPM_ALG_SHA256:
-			h->alg = cpu_to_be16(h->alg);
-			h = (struct tpmt_ha *)((u8 *)h + SHA256_SIZE);
-			size += sizeof(u16) + SHA256_SIZE;
+
+		if (!tis_wait_response(duration)) {
+			ret = -ETIMEDOUT;
 			break;
-		case TPM_ALG_SHA384:
-			h->alg = cpu_to_be16(h->alg);
-			h = (struct tpmt_ha *)((u8 *)h + SHA384_SIZE);
-			size += sizeof(u16) + SHA384_SIZE;
+		}
+
+		/* Reset buffer for receive */
+		tpmb_free(b);
+		if (!tpmb_reserve(b))
+			return -ENOMEM;
+
+		if (tis_recv(b) < sizeof(struct tpm_header))
 			break;
-		case TPM_ALG_SHA512:
-			h->alg = cpu_to_be16(h->alg);
-			h = (struct tpmt_ha *)((u8 *)h + SHA512_SIZE);
-			size += sizeof(u16) + SHA512_SIZE;
+
+		/* receive converts the header to host order */
+		hdr = (struct tpm_header *)b->head;
+		ret = (int)hdr->code;
+		break;
+	case TPM_CRB:
+		if (crb_send(b) != len)
 			break;
-		case TPM_ALG_SM3_256:
-			h->alg = cpu_to_be16(h->alg);
-			h = (struct tpmt_ha *)((u8 *)h + SM3256_SIZE);
-			size += sizeof(u16) + SHA1_SIZE;
+
+		if (!crb_wait_response(duration)) {
+			ret = -ETIMEDOUT;
 			break;
-		default:
-			return 0;
 		}
+
+		tpmb_free(b);
+		if (!tpmb_reserve(b))
+			return -ENOMEM;
+
+		if (crb_recv(b) < sizeof(struct tpm_header))
+			break;
+
+		hdr = (struct tpm_header *)b->head;
+		ret = (int)hdr->code;
+		break;
+	case TPM_UEFI:
+		/* Not implemented yet */
+		break;
 	}
 
-	return size;
+	/* the header is only valid when a response was read */
+	tpm_stats_cmd(code, len, ret >= 0 ? hdr->size : 0, ret, start);
+
+	return ret;
 }
 
+/*
+ * Extend pcr in every bank given in digests with a single TPM2_PCR_Extend.
+ * Returns 0 on success, the TPM response code if the TPM rejected the
+ * command, or a negative errno.
+ */
 int tpm2_extend_pcr(struct tpm *t, u32 pcr,
 		struct tpml_digest_values *digests)
 {
 	struct tpmbuff *b = t->buff;
 	struct tpm2_cmd cmd;
-	u8 *ptr;
 	u16 size;
 	int ret = 0;
 
+	size = digest_list_size(digests);
+	if (size == 0)
+		return -EINVAL;
+
 	ret = tpm2_alloc_cmd(b, &cmd, TPM_ST_SESSIONS, TPM_CC_PCR_EXTEND);
 	if (ret < 0)
 		return ret;
@@ -90,46 +256,329 @@ int tpm2_extend_pcr(struct tpm *t, u32 pcr,
 
 	*cmd.handles = cpu_to_be32(pcr);
 
-	cmd.auth = (struct tpm2b *)tpmb_put(b, tpm2_null_auth_size());
-	if (cmd.auth == NULL) {
+	ret = tpm2_put_null_auth(b, &cmd, 1);
+	if (ret < 0) {
+		tpmb_free(b);
+		return ret;
+	}
+
+	cmd.params = (u8 *)tpmb_put(b, size);
+	if (cmd.params == NULL) {
 		tpmb_free(b);
 		return -ENOMEM;
 	}
 
-	cmd.auth->size = tpm2_null_auth(cmd.auth->buffer);
-	cmd.auth->size = cpu_to_be16(cmd.auth->size);
+	marshal_digest_list(cmd.params, digests);
+
+	cmd.header->size = cpu_to_be32(tpmb_size(b));
+
+	ret = tpm2_transmit(t, b);
+
+	tpmb_free(b);
+	return ret;
+}
+
+/*
+ * Read the PCR allocation with TPM2_GetCapability(TPM_CAP_PCRS) and return
+ * the algs of the banks that have PCRs allocated. count holds the room at
+ * banks on entry and the number of banks on return. Returns 0 on success,
+ * the TPM response code if the TPM failed the command, or a negative errno.
+ */
+int tpm2_pcr_banks(struct tpm *t, u16 *banks, u8 *count)
+{
+	struct tpmbuff *b = t->buff;
+	struct tpm_header *hdr;
+	struct tpm2_cmd cmd;
+	u32 *params;
+	u8 *p, *end;
+	u8 found = 0, select, any, j;
+	u32 n, i;
+	int ret;
+
+	ret = tpm2_alloc_cmd(b, &cmd, TPM_ST_NO_SESSIONS,
+			TPM_CC_GET_CAPABILITY);
+	if (ret < 0)
+		return ret;
 
-	size = convert_digest_list(digests);
-	if (size == 0) {
+	/* capability, property and propertyCount, one list is all there is */
+	params = (u32 *)tpmb_put(b, 3 * sizeof(u32));
+	if (params == NULL) {
 		tpmb_free(b);
-		return -EINVAL;
+		return -ENOMEM;
 	}
 
-	cmd.params = (u8 *)tpmb_put(b, size);
-	if (cmd.params == NULL) {
+	params[0] = cpu_to_be32(TPM_CAP_PCRS);
+	params[1] = 0;
+	params[2] = cpu_to_be32(1);
+
+	cmd.header->size = cpu_to_be32(tpmb_size(b));
+
+	ret = tpm2_transmit(t, b);
+	if (ret != 0)
+		goto out;
+
+	/* moreData, capability, then the TPML_PCR_SELECTION */
+	hdr = (struct tpm_header *)b->head;
+	p = b->head + sizeof(struct tpm_header) + sizeof(u8) + sizeof(u32);
+	end = b->head + hdr->size;
+	ret = -EIO;
+	if (hdr->size > tpmb_head_len(b) || p + sizeof(u32) > end)
+		goto out;
+
+	n = be32_to_cpu(*(u32 *)p);
+	p += sizeof(u32);
+
+	for (i = 0; i < n; i++) {
+		if (p + sizeof(u16) + sizeof(u8) > end)
+			goto out;
+
+		select = p[sizeof(u16)];
+		if (p + sizeof(u16) + sizeof(u8) + select > end)
+			goto out;
+
+		/* a bank with no PCRs selected is not allocated */
+		for (j = 0, any = 0; j < select; j++)
+			any |= p[sizeof(u16) + sizeof(u8) + j];
+
+		if (any) {
+			if (found == *count) {
+				ret = -ENOMEM;
+				goto out;
+			}
+			banks[found++] = be16_to_cpu(*(u16 *)p);
+		}
+
+		p += sizeof(u16) + sizeof(u8) + select;
+	}
+
+	*count = found;
+	ret = 0;
+
+out:
+	tpmb_free(b);
+	return ret;
+}
+
+/* ask the TPM to drop a sequence that will not be completed */
+static void tpm2_flush_context(struct tpm *t, u32 handle)
+{
+	struct tpmbuff *b = t->buff;
+	struct tpm2_cmd cmd;
+
+	if (tpm2_alloc_cmd(b, &cmd, TPM_ST_NO_SESSIONS,
+			TPM_CC_FLUSH_CONTEXT) < 0)
+		return;
+
+	cmd.params = tpmb_put(b, sizeof(u32));
+	if (cmd.params != NULL) {
+		*(u32 *)cmd.params = cpu_to_be32(handle);
+		cmd.header->size = cpu_to_be32(tpmb_size(b));
+		tpm2_transmit(t, b);
+	}
+
+	tpmb_free(b);
+}
+
+/* TPM2_HashSequenceStart with TPM_ALG_NULL, i.e. an event sequence */
+static int tpm2_event_sequence_start(struct tpm *t, u32 *handle)
+{
+	struct tpmbuff *b = t->buff;
+	struct tpm2_cmd cmd;
+	u16 *params;
+	int ret;
+
+	ret = tpm2_alloc_cmd(b, &cmd, TPM_ST_NO_SESSIONS,
+			TPM_CC_HASH_SEQUENCE_START);
+	if (ret < 0)
+		return ret;
+
+	/* empty auth for the sequence object, then hashAlg */
+	params = (u16 *)tpmb_put(b, 2 * sizeof(u16));
+	if (params == NULL) {
 		tpmb_free(b);
 		return -ENOMEM;
 	}
 
-	memcpy(cmd.params, digests, size);
+	params[0] = 0;
+	params[1] = cpu_to_be16(TPM_ALG_NULL);
 
-	cmd.header->size = cpu_to_be16(tpmb_size(b));
+	cmd.header->size = cpu_to_be32(tpmb_size(b));
 
-	switch (t->intf) {
-	case TPM_DEVNODE:
-		/* Not implemented yet */
-		break;
-	case TPM_TIS:
-		ret = tis_send(b);
-		break;
-	case TPM_CRB:
-		ret = crb_send(b);
-		break;
-	case TPM_UEFI:
-		/* Not implemented yet */
-		break;
+	ret = tpm2_transmit(t, b);
+	if (ret == 0) {
+		if (tpmb_head_len(b) < sizeof(struct tpm_header) + sizeof(u32))
+			ret = -EIO;
+		else
+			*handle = be32_to_cpu(*(u32 *)(b->head +
+					sizeof(struct tpm_header)));
 	}
 
 	tpmb_free(b);
 	return ret;
 }
+
+static int tpm2_sequence_update(struct tpm *t, u32 handle, const u8 *data,
+		u16 len)
+{
+	struct tpmbuff *b = t->buff;
+	struct tpm2_cmd cmd;
+	int ret;
+
+	ret = tpm2_alloc_cmd(b, &cmd, TPM_ST_SESSIONS, TPM_CC_SEQUENCE_UPDATE);
+	if (ret < 0)
+		return ret;
+
+	cmd.handles = (u32 *)tpmb_put(b, sizeof(u32));
+	if (cmd.handles == NULL) {
+		tpmb_free(b);
+		return -ENOMEM;
+	}
+
+	*cmd.handles = cpu_to_be32(handle);
+
+	ret = tpm2_put_null_auth(b, &cmd, 1);
+	if (ret == 0)
+		ret = tpm2_put_buffer(b, data, len);
+	if (ret < 0) {
+		tpmb_free(b);
+		return ret;
+	}
+
+	cmd.header->size = cpu_to_be32(tpmb_size(b));
+
+	ret = tpm2_transmit(t, b);
+
+	tpmb_free(b);
+	return ret;
+}
+
+/*
+ * Copy the TPML_DIGEST_VALUES at the start of the response parameters into
+ * digests in host order. size is the room available at digests.
+ */
+static int unmarshal_digest_list(struct tpmbuff *b,
+		struct tpml_digest_values *digests, size_t size)
+{
+	struct tpm_header *hdr = (struct tpm_header *)b->head;
+	u8 *p = b->head + sizeof(struct tpm_header) + sizeof(u32);
+	u8 *end = b->head + hdr->size;
+	u8 *dst = (u8 *)digests->digests;
+	u16 alg, dsize;
+	u32 count, i;
+
+	/* the list is small enough to always arrive in the head area */
+	if (hdr->size > tpmb_head_len(b) || p + sizeof(u32) > end)
+		return -EIO;
+
+	count = be32_to_cpu(*(u32 *)p);
+	p += sizeof(u32);
+	size -= sizeof(u32);
+
+	for (i = 0; i < count; i++) {
+		if (p + sizeof(u16) > end)
+			return -EIO;
+
+		alg = be16_to_cpu(*(u16 *)p);
+		dsize = tpm2_digest_size(alg);
+		if (dsize == 0 || p + sizeof(u16) + dsize > end)
+			return -EIO;
+		if (sizeof(u16) + dsize > size)
+			return -ENOMEM;
+
+		((struct tpmt_ha *)dst)->alg = alg;
+		memcpy(((struct tpmt_ha *)dst)->digest, p + sizeof(u16), dsize);
+
+		p += sizeof(u16) + dsize;
+		dst += sizeof(u16) + dsize;
+		size -= sizeof(u16) + dsize;
+	}
+
+	digests->count = count;
+
+	return 0;
+}
+
+/* TPM2_EventSequenceComplete, extending pcr with the digest of each bank */
+static int tpm2_event_sequence_complete(struct tpm *t, u32 pcr, u32 handle,
+		const u8 *data, u16 len, struct tpml_digest_values *digests,
+		size_t size)
+{
+	struct tpmbuff *b = t->buff;
+	struct tpm2_cmd cmd;
+	int ret;
+
+	ret = tpm2_alloc_cmd(b, &cmd, TPM_ST_SESSIONS,
+			TPM_CC_EVENT_SEQUENCE_COMPLETE);
+	if (ret < 0)
+		return ret;
+
+	cmd.handles = (u32 *)tpmb_put(b, 2 * sizeof(u32));
+	if (cmd.handles == NULL) {
+		tpmb_free(b);
+		return -ENOMEM;
+	}
+
+	cmd.handles[0] = cpu_to_be32(pcr);
+	cmd.handles[1] = cpu_to_be32(handle);
+
+	/* one session for the PCR and one for the sequence */
+	ret = tpm2_put_null_auth(b, &cmd, 2);
+	if (ret == 0)
+		ret = tpm2_put_buffer(b, data, len);
+	if (ret < 0) {
+		tpmb_free(b);
+		return ret;
+	}
+
+	cmd.header->size = cpu_to_be32(tpmb_size(b));
+
+	ret = tpm2_transmit(t, b);
+	if (ret == 0)
+		ret = unmarshal_digest_list(b, digests, size);
+
+	tpmb_free(b);
+	return ret;
+}
+
+/*
+ * Hash len bytes at data on the TPM in every active bank and extend pcr
+ * with the results, streaming the range through an event sequence in
+ * TPM_MAX_DIGEST_BUFFER chunks. The bank digests are returned in digests,
+ * host order, which has room for size bytes. Pass TPM_RH_NULL as pcr to
+ * only hash. Returns 0 on success, the TPM response code if the TPM failed
+ * a command, or a negative errno.
+ */
+int tpm2_hash_sequence(struct tpm *t, u32 pcr, const u8 *data, size_t len,
+		struct tpml_digest_values *digests, size_t size)
+{
+	u32 handle;
+	int ret;
+
+	if (size < sizeof(u32))
+		return -EINVAL;
+
+	ret = tpm2_event_sequence_start(t, &handle);
+	if (ret != 0)
+		return ret;
+
+	/* the last chunk, possibly empty, rides along with the complete */
+	while (len > TPM_MAX_DIGEST_BUFFER) {
+		ret = tpm2_sequence_update(t, handle, data,
+				TPM_MAX_DIGEST_BUFFER);
+		if (ret != 0)
+			goto flush;
+
+		data += TPM_MAX_DIGEST_BUFFER;
+		len -= TPM_MAX_DIGEST_BUFFER;
+	}
+
+	ret = tpm2_event_sequence_complete(t, pcr, handle, data, (u16)len,
+			digests, size);
+	/* a rejected complete leaves the sequence object loaded */
+	if (ret <= 0)
+		return ret;
+
+flush:
+	tpm2_flush_context(t, handle);
+	return ret;
+}
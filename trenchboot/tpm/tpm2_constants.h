@@ -56,13 +56,25 @@
  * Table 12  Definition of (UINT32) TPM_CC Constants (Numeric Order)
  * <IN/OUT, S>
  */
+#define TPM_CC_SEQUENCE_UPDATE (u32)(0x0000015C)
+#define TPM_CC_FLUSH_CONTEXT (u32)(0x00000165)
+#define TPM_CC_GET_CAPABILITY (u32)(0x0000017A)
 #define TPM_CC_PCR_EXTEND (u32)(0x00000182)
+#define TPM_CC_EVENT_SEQUENCE_COMPLETE (u32)(0x00000185)
+#define TPM_CC_HASH_SEQUENCE_START (u32)(0x00000186)
 
 /* Table 19  Definition of (UINT16) TPM_ST Constants <IN/OUT, S> */
 #define TPM_ST_NO_SESSIONS (u16)(0x8001)
 #define TPM_ST_SESSIONS (u16)(0x8002)
 
+/* Table 22  Definition of (UINT32) TPM_CAP Constants */
+#define TPM_CAP_PCRS (u32)(0x00000005)
+
 /* Table 28  Definition of (TPM_HANDLE) TPM_RH Constants <S> */
+#define TPM_RH_NULL (u32)(0x40000007)
 #define TPM_RS_PW (u32)(0x40000009)
 
+/* Part 2 Annex A, MAX_DIGEST_BUFFER: largest TPM2B_MAX_BUFFER payload */
+#define TPM_MAX_DIGEST_BUFFER 1024
+
 #endif
@@ -0,0 +1,301 @@
+/*
+ * Copyright (c) 2019 Apertus Solutions, LLC
+ *
+ * Author(s):
+ *      Daniel P. Smith <dpsmith@apertussolutions.com>
+ *
+ * Locate the TPM through the ACPI tables. The TPM2 table names the start
+ * method and control area, which saves enable_tpm from probing registers
+ * that may not exist, and the TCPA table marks a 1.2 TPM on TIS. The FADT
+ * supplies the PM timer for TSC calibration while the tables are walked.
+ */
+
+#include <tpm.h>
+
+#include "tpm_acpi.h"
+#include "tpm_common.h"
+
+/* signatures as little endian integers */
+#define ACPI_SIG_RSDP		0x2052545020445352ULL	/* "RSD PTR " */
+#define ACPI_SIG_TPM2		0x324D5054		/* "TPM2" */
+#define ACPI_SIG_TCPA		0x41504354		/* "TCPA" */
+#define ACPI_SIG_FACP		0x50434146		/* "FACP" */
+
+/* where the RSDP may live on a legacy BIOS system */
+#define ACPI_EBDA_PTR		0x40E
+#define ACPI_EBDA_LEN		1024
+#define ACPI_BIOS_START		0xE0000
+#define ACPI_BIOS_END		0x100000
+
+struct acpi_rsdp {
+	u64 signature;
+	u8 checksum;
+	char oem_id[6];
+	u8 revision;
+	u32 rsdt;
+	/* revision 2 and later */
+	u32 length;
+	u64 xsdt;
+	u8 ext_checksum;
+	u8 _reserved[3];
+} __packed;
+
+struct acpi_header {
+	u32 signature;
+	u32 length;
+	u8 revision;
+	u8 checksum;
+	char oem_id[6];
+	char oem_table_id[8];
+	u32 oem_revision;
+	u32 creator_id;
+	u32 creator_revision;
+} __packed;
+
+/* only the FADT fields up to the PM timer block are used */
+struct acpi_fadt {
+	struct acpi_header hdr;
+	u32 facs;
+	u32 dsdt;
+	u8 _reserved;
+	u8 pm_profile;
+	u16 sci_int;
+	u32 smi_cmd;
+	u8 acpi_enable;
+	u8 acpi_disable;
+	u8 s4bios_req;
+	u8 pstate_cnt;
+	u32 pm1a_evt_blk;
+	u32 pm1b_evt_blk;
+	u32 pm1a_cnt_blk;
+	u32 pm1b_cnt_blk;
+	u32 pm2_cnt_blk;
+	u32 pm_tmr_blk;
+} __packed;
+
+struct acpi_tpm2 {
+	struct acpi_header hdr;
+	u16 platform_class;
+	u16 _reserved;
+	u64 control_area;
+	u32 start_method;
+} __packed;
+
+static u64 rsdp_addr;
+
+/*
+ * Loaders that already know the RSDP, from the boot params or the EFI
+ * config table, hand it over here and spare the scan. TPM_NO_RSDP skips
+ * ACPI altogether and leaves enable_tpm to probe.
+ */
+void tpm_set_rsdp(u64 rsdp)
+{
+	rsdp_addr = rsdp;
+}
+
+static void *phys(u64 addr)
+{
+	return (void *)(u64)addr;
+}
+
+static u8 checksum(const void *p, u32 len)
+{
+	const u8 *b = p;
+	u8 sum = 0;
+
+	while (len--)
+		sum += *b++;
+
+	return sum;
+}
+
+static struct acpi_rsdp *valid_rsdp(u64 addr)
+{
+	struct acpi_rsdp *rsdp = phys(addr);
+
+	if (rsdp->signature != ACPI_SIG_RSDP)
+		return NULL;
+
+	/* the first 20 bytes are the ACPI 1.0 structure */
+	if (checksum(rsdp, 20) != 0)
+		return NULL;
+
+	if (rsdp->revision >= 2 &&
+	    checksum(rsdp, sizeof(*rsdp)) != 0)
+		return NULL;
+
+	return rsdp;
+}
+
+static struct acpi_rsdp *scan_rsdp(u64 start, u64 end)
+{
+	struct acpi_rsdp *rsdp;
+
+	/* the RSDP sits on a 16 byte boundary */
+	for (; start + sizeof(*rsdp) <= end; start += 16) {
+		rsdp = valid_rsdp(start);
+		if (rsdp)
+			return rsdp;
+	}
+
+	return NULL;
+}
+
+static struct acpi_rsdp *find_rsdp(void)
+{
+	struct acpi_rsdp *rsdp;
+	u64 ebda;
+
+	if (rsdp_addr == TPM_NO_RSDP)
+		return NULL;
+
+	if (rsdp_addr)
+		return valid_rsdp(rsdp_addr);
+
+	ebda = (u64)(*(u16 *)phys(ACPI_EBDA_PTR)) << 4;
+	if (ebda) {
+		rsdp = scan_rsdp(ebda, ebda + ACPI_EBDA_LEN);
+		if (rsdp)
+			return rsdp;
+	}
+
+	return scan_rsdp(ACPI_BIOS_START, ACPI_BIOS_END);
+}
+
+static struct acpi_header *valid_table(u64 addr)
+{
+	struct acpi_header *hdr = phys(addr);
+
+	if (!addr || hdr->length < sizeof(*hdr))
+		return NULL;
+
+	if (checksum(hdr, hdr->length) != 0)
+		return NULL;
+
+	return hdr;
+}
+
+/* pick the TPM description and the PM timer out of one table */
+static void parse_table(struct acpi_header *hdr, struct tpm_acpi *a,
+			u8 *found)
+{
+	struct acpi_tpm2 *tpm2 = (struct acpi_tpm2 *)hdr;
+	struct acpi_fadt *fadt = (struct acpi_fadt *)hdr;
+
+	switch (hdr->signature) {
+	case ACPI_SIG_TPM2:
+		if (hdr->length < sizeof(*tpm2))
+			break;
+
+		a->family = TPM20;
+		a->start_method = tpm2->start_method;
+		a->control_area = tpm2->control_area;
+		*found = 1;
+		break;
+	case ACPI_SIG_TCPA:
+		/* a TPM2 table wins, firmware may publish both */
+		if (*found)
+			break;
+
+		a->family = TPM12;
+		a->intf = TPM_TIS;
+		a->start_method = 0;
+		a->control_area = 0;
+		*found = 1;
+		break;
+	case ACPI_SIG_FACP:
+		if (hdr->length >= sizeof(*fadt) && fadt->pm_tmr_blk <= 0xFFFF)
+			a->pm_tmr_port = fadt->pm_tmr_blk;
+		break;
+	}
+}
+
+/* map the TPM2 start method onto an interface the driver can run */
+static int select_interface(struct tpm_acpi *a)
+{
+	if (a->family == TPM12)
+		return 0;
+
+	switch (a->start_method) {
+	case ACPI_TPM2_START_TIS:
+		/* the FIFO is always at the fixed base */
+		if (a->control_area && a->control_area != TPM_MMIO_BASE)
+			return -EOPNOTSUPP;
+
+		a->intf = TPM_TIS;
+		return 0;
+	case ACPI_TPM2_START_CRB:
+		/* crb_init checks the control area is one it can reach */
+		a->intf = TPM_CRB;
+		return 0;
+	case ACPI_TPM2_START_CRB_ACPI:
+		/*
+		 * A CRB that only starts a command once the ACPI start
+		 * method runs. Without AML the start is never seen, so it
+		 * must be refused rather than probed and driven as plain
+		 * CRB.
+		 */
+		return -EOPNOTSUPP;
+	default:
+		/*
+		 * The pure ACPI start method needs AML the loader cannot
+		 * run and the SMC method is ARM only.
+		 */
+		return -EOPNOTSUPP;
+	}
+}
+
+/*
+ * Walk the XSDT, or the RSDT before ACPI 2.0, for the TPM2 or TCPA table
+ * and the FADT. Returns 0 with a filled in when there is a TPM the driver
+ * can use as described, -EOPNOTSUPP when the tables describe one it cannot
+ * and -ENOENT when there is no TPM2 or TCPA table to go by. pm_tmr_port is
+ * set in every case the FADT is found.
+ */
+int tpm_acpi_discover(struct tpm_acpi *a)
+{
+	struct acpi_rsdp *rsdp;
+	struct acpi_header *sdt, *hdr;
+	u32 entries, entry_size, i;
+	u8 *entry;
+	u64 addr;
+	u8 found = 0;
+
+	a->family = TPM20;
+	a->intf = TPM_TIS;
+	a->start_method = 0;
+	a->control_area = 0;
+	a->pm_tmr_port = 0;
+
+	rsdp = find_rsdp();
+	if (!rsdp)
+		return -ENOENT;
+
+	if (rsdp->revision >= 2 && rsdp->xsdt) {
+		sdt = valid_table(rsdp->xsdt);
+		entry_size = sizeof(u64);
+	} else {
+		sdt = valid_table(rsdp->rsdt);
+		entry_size = sizeof(u32);
+	}
+	if (!sdt)
+		return -ENOENT;
+
+	entries = (sdt->length - sizeof(*sdt)) / entry_size;
+	entry = (u8 *)(sdt + 1);
+	for (i = 0; i < entries; i++, entry += entry_size) {
+		if (entry_size == sizeof(u64))
+			addr = *(u64 *)entry;
+		else
+			addr = *(u32 *)entry;
+
+		hdr = valid_table(addr);
+		if (hdr)
+			parse_table(hdr, a, &found);
+	}
+
+	if (!found)
+		return -ENOENT;
+
+	return select_interface(a);
+}
@@ -0,0 +1,36 @@
+/*
+ * Copyright (c) 2019 Apertus Solutions, LLC
+ *
+ * Author(s):
+ *      Daniel P. Smith <dpsmith@apertussolutions.com>
+ *
+ * The definitions in this header are extracted from the Trusted Computing
+ * Group's "TCG ACPI Specification" and the ACPI Specification.
+ *
+ */
+
+#ifndef _TPM_ACPI_H
+#define _TPM_ACPI_H
+
+#include <types.h>
+#include <tpm.h>
+
+/* TPM2 table start methods */
+#define ACPI_TPM2_START_ACPI		2
+#define ACPI_TPM2_START_TIS		6
+#define ACPI_TPM2_START_CRB		7
+#define ACPI_TPM2_START_CRB_ACPI	8
+#define ACPI_TPM2_START_CRB_SMC		11
+
+/* What the firmware tables say about the TPM and the platform */
+struct tpm_acpi {
+	enum tpm_family family;
+	enum tpm_hw_intf intf;
+	u32 start_method;	/* 0 for a TCPA table */
+	u64 control_area;
+	u16 pm_tmr_port;	/* from the FADT, 0 if there is none */
+};
+
+int tpm_acpi_discover(struct tpm_acpi *a);
+
+#endif
@@ -14,8 +14,61 @@
 #include "tpm1.h"
 #include "tis.h"
 
-#define TPM_CRB_DATA_BUFFER_OFFSET	0x80
-#define TPM_CRB_DATA_BUFFER_SIZE	3966
+static struct tpmbuff_seg seg_pool[TPMB_SEG_COUNT];
+static struct tpmbuff_seg *seg_free_list;
+static u8 seg_pool_ready;
+
+static struct tpmbuff_seg *seg_get(void)
+{
+	struct tpmbuff_seg *seg;
+	int i;
+
+	if (!seg_pool_ready) {
+		for (i = 0; i < TPMB_SEG_COUNT; i++) {
+			seg_pool[i].next = seg_free_list;
+			seg_free_list = &seg_pool[i];
+		}
+		seg_pool_ready = 1;
+	}
+
+	seg = seg_free_list;
+	if (!seg)
+		return NULL;
+
+	seg_free_list = seg->next;
+	seg->next = NULL;
+	seg->len = 0;
+
+	return seg;
+}
+
+static void seg_put(struct tpmbuff_seg *seg)
+{
+	seg->next = seg_free_list;
+	seg_free_list = seg;
+}
+
+static struct tpmbuff_seg *last_seg(struct tpmbuff *b)
+{
+	struct tpmbuff_seg *seg = b->overflow;
+
+	while (seg && seg->next)
+		seg = seg->next;
+
+	return seg;
+}
+
+static void release_overflow(struct tpmbuff *b)
+{
+	struct tpmbuff_seg *seg, *next;
+
+	for (seg = b->overflow; seg; seg = next) {
+		next = seg->next;
+		seg_put(seg);
+	}
+
+	b->overflow = NULL;
+}
 
 u8 *tpmb_reserve(struct tpmbuff *b)
 {
@@ -32,6 +85,8 @@ u8 *tpmb_reserve(struct tpmbuff *b)
 
 void tpmb_free(struct tpmbuff *b)
 {
+	release_overflow(b);
+
 	b->len = 0;
 	b->locked = 0;
 	b->data = NULL;
@@ -40,12 +95,37 @@ void tpmb_free(struct tpmbuff *b)
 
 u8 *tpmb_put(struct tpmbuff *b, size_t size)
 {
+	struct tpmbuff_seg *seg;
 	u8 *tail = b->tail;
 
-	if ((b->len + size) > b->truesize)
-		return NULL; /* TODO: add overflow buffer support */
+	/* the head area is used until something overflows */
+	if (!b->overflow && (tpmb_head_len(b) + size) <= b->truesize) {
+		b->tail += size;
+		b->len += size;
+
+		return tail;
+	}
+
+	/* each put is contiguous, so it must fit in a single segment */
+	if (size > TPMB_SEG_SIZE)
+		return NULL;
+
+	seg = last_seg(b);
+	if (!seg || (seg->len + size) > TPMB_SEG_SIZE) {
+		struct tpmbuff_seg *next = seg_get();
 
-	b->tail += size;
+		if (!next)
+			return NULL;
+
+		if (seg)
+			seg->next = next;
+		else
+			b->overflow = next;
+		seg = next;
+	}
+
+	tail = seg->data + seg->len;
+	seg->len += size;
 	b->len += size;
 
 	return tail;
@@ -53,12 +133,30 @@ u8 *tpmb_put(struct tpmbuff *b, size_t size)
 
 size_t tpmb_trim(struct tpmbuff *b, size_t size)
 {
+	struct tpmbuff_seg *seg, *prev;
+	size_t left, n;
+
 	if (b->len < size)
 		size = b->len;
 
-	/* TODO: add overflow buffer support */
+	/* take from the last overflow segment first */
+	for (left = size; left > 0 && b->overflow; left -= n) {
+		for (prev = NULL, seg = b->overflow; seg->next; seg = seg->next)
+			prev = seg;
+
+		n = seg->len < left ? seg->len : left;
+		seg->len -= n;
+
+		if (seg->len == 0) {
+			if (prev)
+				prev->next = NULL;
+			else
+				b->overflow = NULL;
+			seg_put(seg);
+		}
+	}
 
-	b->tail -= size;
+	b->tail -= left;
 	b->len -= size;
 
 	return size;
@@ -69,9 +167,19 @@ size_t tpmb_size(struct tpmbuff *b)
 	return b->len;
 }
 
+/* bytes held in the head area, the rest are in the overflow segments */
+size_t tpmb_head_len(struct tpmbuff *b)
+{
+	return b->tail - b->head;
+}
+
 static u8 tis_buff[STATIC_TIS_BUFFER_SIZE];
 static struct tpmbuff tpm_buff;
 
+/*
+ * Commands are marshalled in memory for every interface; CRB copies them
+ * into its data buffer on send.
+ */
 struct tpmbuff *alloc_tpmbuff(enum tpm_hw_intf intf, u8 locality)
 {
 	struct tpmbuff *b = &tpm_buff;
@@ -81,17 +189,13 @@ struct tpmbuff *alloc_tpmbuff(enum tpm_hw_intf intf, u8 locality)
 		/* TODO: need implementation */
 		goto err;
 	case TPM_TIS:
+	case TPM_CRB:
 		if (b->head)
 			goto reset;
 
 		b->head = (u8 *)&tis_buff;
 		b->truesize = STATIC_TIS_BUFFER_SIZE;
 		break;
-	case TPM_CRB:
-		b->head = (u8 *)(u64)(TPM_MMIO_BASE + (locality << 12)
-			       + TPM_CRB_DATA_BUFFER_OFFSET);
-		b->truesize = TPM_CRB_DATA_BUFFER_SIZE;
-		break;
 	case TPM_UEFI:
 		/* Not implemented yet */
 		goto err;
@@ -100,6 +204,7 @@ struct tpmbuff *alloc_tpmbuff(enum tpm_hw_intf intf, u8 locality)
 	}
 
 reset:
+	release_overflow(b);
 	b->len = 0;
 	b->locked = 0;
 	b->data = NULL;
@@ -119,9 +224,8 @@ void free_tpmbuff(struct tpmbuff *b, enum tpm_hw_intf intf)
 		/* Not implemented yet */
 		break;
 	case TPM_TIS:
-		b->head = NULL;
-		break;
 	case TPM_CRB:
+		release_overflow(b);
 		b->head = NULL;
 		break;
 	case TPM_UEFI:
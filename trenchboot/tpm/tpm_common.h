@@ -14,6 +14,8 @@
 #endif
 
 #define TPM_MMIO_BASE		0xFED40000
+/* a page of registers for each locality */
+#define TPM_MMIO_SIZE		0x5000
 #define TPM_MAX_LOCALITY	4
 
 #define SHA1_SIZE	20
@@ -26,7 +28,7 @@ struct tpm_header {
 	u16 tag;
 	u32 size;
 	u32 code;
-};
+} __packed;
 
 #define TPM_INTERFACE_ID_0	0x30
 #define TPM_TIS_INTF_ACTIVE	0x00
@@ -55,6 +57,11 @@ struct tpm_interface_id {
 #define TPM12_TIS_INTF_12	0x00
 #define TPM12_TIS_INTF_13	0x02
 #define TPM20_TIS_INTF_13	0x03
+/* data_transfer_size_support, largest FIFO access the TPM accepts */
+#define TPM_XFER_SIZE_LEGACY	0x00
+#define TPM_XFER_SIZE_8		0x01
+#define TPM_XFER_SIZE_32	0x02
+#define TPM_XFER_SIZE_64	0x03
 
 struct tpm_intf_capability {
 	union {
@@ -78,10 +85,47 @@ struct tpm_intf_capability {
 } __packed;
 
 void tpm_io_delay(void);
-void tpm_udelay(int loops);
 u8 tpm_read8(u32 field);
 void tpm_write8(unsigned char val, u32 field);
 u32 tpm_read32(u32 field);
 void tpm_write32(unsigned int val, u32 field);
 
+/*
+ * Command duration classes and interface timeouts of the PTP, Tables 15
+ * and 16, in microseconds. A command is given the duration of its class
+ * to complete before it is considered hung.
+ */
+#define TPM_DURATION_SHORT	20000
+#define TPM_DURATION_MEDIUM	750000
+#define TPM_DURATION_LONG	2000000
+
+#define TPM_TIMEOUT_A		750000
+#define TPM_TIMEOUT_B		2000000
+#define TPM_TIMEOUT_C		200000
+#define TPM_TIMEOUT_D		30000
+
+/* delay and timeout service, see tpm_time.c */
+u8 tpm_time_init(u16 pm_tmr_port);
+u8 tpm_time_calibrated(void);
+u32 tpm_time_khz(void);
+u64 tpm_now(void);
+void tpm_udelay(u32 usecs);
+u64 tpm_deadline(u32 usecs);
+u8 tpm_deadline_passed(u64 deadline);
+u64 tpm_elapsed_us(u64 start);
+
+/* interval between status reads while waiting on the TPM */
+#define TPM_POLL_INTERVAL	10
+
+u8 tpm_poll(u8 (*done)(void), u32 timeout);
+
+/*
+ * Backoff bounds for conditions that usually hold within a few register
+ * reads, such as a locality grant, but may take up to a timeout.
+ */
+#define TPM_BACKOFF_MIN		1
+#define TPM_BACKOFF_MAX		1024
+
+u8 tpm_poll_backoff(u8 (*done)(void), u32 timeout);
+
 #endif
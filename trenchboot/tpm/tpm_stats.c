@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2019 Apertus Solutions, LLC
+ *
+ * Author(s):
+ *      Daniel P. Smith <dpsmith@apertussolutions.com>
+ *
+ */
+
+#include <tpm.h>
+
+#include "tpm_common.h"
+#include "tpm_stats.h"
+
+#ifdef CONFIG_TPM_STATS
+
+struct tpm_stats tpm_stats = {
+	.version = TPM_STATS_VERSION,
+};
+
+static struct tpm_cmd_stats *cmd_slot(u32 code)
+{
+	int i;
+
+	for (i = 0; i < TPM_STATS_MAX_CMDS; i++) {
+		if (tpm_stats.cmds[i].code == code)
+			return &tpm_stats.cmds[i];
+
+		if (tpm_stats.cmds[i].code == 0) {
+			tpm_stats.cmds[i].code = code;
+			return &tpm_stats.cmds[i];
+		}
+	}
+
+	return NULL;
+}
+
+static int hist_bucket(u64 time)
+{
+	int i = 0;
+
+	time >>= TPM_STATS_HIST_SHIFT + 1;
+	while (time && i < TPM_STATS_HIST_BUCKETS - 1) {
+		time >>= 1;
+		i++;
+	}
+
+	return i;
+}
+
+/*
+ * Account one command exchange: out bytes sent, in bytes received, ret as
+ * returned by the submit path and start from tpm_stats_start at submit.
+ */
+void tpm_stats_cmd(u32 code, size_t out, size_t in, int ret, u64 start)
+{
+	struct tpm_cmd_stats *c = cmd_slot(code);
+	u64 time = tpm_now() - start;
+
+	if (c == NULL) {
+		tpm_stats.dropped++;
+		return;
+	}
+
+	c->count++;
+	if (ret == -ETIMEDOUT)
+		c->timeouts++;
+	if (ret != 0)
+		c->errors++;
+
+	c->bytes_out += out;
+	c->bytes_in += in;
+	c->time += time;
+	if (time > c->time_max)
+		c->time_max = time;
+	c->hist[hist_bucket(time)]++;
+}
+
+struct tpm_stats *tpm_get_stats(void)
+{
+	tpm_stats.tsc_khz = tpm_time_khz();
+
+	return &tpm_stats;
+}
+
+#else
+
+struct tpm_stats *tpm_get_stats(void)
+{
+	return NULL;
+}
+
+#endif
@@ -0,0 +1,41 @@
+/*
+ * Copyright (c) 2019 Apertus Solutions, LLC
+ *
+ * Author(s):
+ *      Daniel P. Smith <dpsmith@apertussolutions.com>
+ *
+ */
+
+#ifndef _TPM_STATS_H
+#define _TPM_STATS_H
+
+#include <types.h>
+#include <tpm.h>
+
+#include "tpm_common.h"
+
+/*
+ * Hooks for struct tpm_stats. Without CONFIG_TPM_STATS they expand to
+ * nothing and neither the block nor any clock reads are built in.
+ */
+#ifdef CONFIG_TPM_STATS
+
+extern struct tpm_stats tpm_stats;
+
+#define tpm_stats_start()		tpm_now()
+#define tpm_stats_add(field, n)		(tpm_stats.field += (n))
+#define tpm_stats_time(field, start)	(tpm_stats.field += tpm_now() - (start))
+
+void tpm_stats_cmd(u32 code, size_t out, size_t in, int ret, u64 start);
+
+#else
+
+#define tpm_stats_start()		0
+#define tpm_stats_add(field, n)		do { } while (0)
+#define tpm_stats_time(field, start)	do { (void)(start); } while (0)
+#define tpm_stats_cmd(code, out, in, ret, start) \
+	do { (void)(start); } while (0)
+
+#endif
+
+#endif
@@ -0,0 +1,261 @@
+/*
+ * Copyright (c) 2019 Apertus Solutions, LLC
+ *
+ * Author(s):
+ *      Daniel P. Smith <dpsmith@apertussolutions.com>
+ *
+ */
+
+#include <tpm.h>
+
+#include "tpm_common.h"
+#include "tpm_stats.h"
+
+/*
+ * Delays and timeouts for the TIS and CRB drivers. The TSC is calibrated
+ * once against the ACPI PM timer, when its port is known, or PIT channel 2.
+ * Without a TSC or a working reference the port 0x80 delay is used, and
+ * time is then counted in the microseconds tpm_udelay was asked for.
+ */
+
+#define PIT_TICK_RATE		1193182
+#define PM_TIMER_RATE		3579545
+#define PM_TIMER_MASK		0xFFFFFF
+
+/* length of the calibration window */
+#define CALIBRATE_MS		10
+/* give up on a reference that does not move within this many reads */
+#define CALIBRATE_MAX_LOOPS	1000000
+/* fewer reads than this means the reference ran out under us */
+#define CALIBRATE_MIN_LOOPS	100
+
+static u8 calibrated;
+static u32 tsc_khz;
+/* fallback clock, in microseconds of requested delay */
+static u64 fallback_us;
+
+static inline u8 port_in8(u16 port)
+{
+	u8 val;
+
+	asm volatile ("inb %1, %0" : "=a" (val) : "Nd" (port));
+	return val;
+}
+
+static inline void port_out8(u8 val, u16 port)
+{
+	asm volatile ("outb %0, %1" : : "a" (val), "Nd" (port));
+}
+
+static inline u32 port_in32(u16 port)
+{
+	u32 val;
+
+	asm volatile ("inl %1, %0" : "=a" (val) : "Nd" (port));
+	return val;
+}
+
+static inline u64 read_tsc(void)
+{
+	u32 lo, hi;
+
+	asm volatile ("rdtsc" : "=a" (lo), "=d" (hi));
+	return ((u64)hi << 32) | lo;
+}
+
+static u8 has_tsc(void)
+{
+	u32 eax = 1, ebx, ecx = 0, edx;
+
+	asm volatile ("cpuid"
+		      : "+a" (eax), "=b" (ebx), "+c" (ecx), "=d" (edx));
+
+	/* CPUID.01H:EDX.TSC[bit 4] */
+	return (edx >> 4) & 1;
+}
+
+/* count TSC cycles over CALIBRATE_MS of PIT channel 2, 0 on failure */
+static u64 calibrate_pit(void)
+{
+	u32 latch = PIT_TICK_RATE / (1000 / CALIBRATE_MS);
+	u64 start, end;
+	u32 loops = 0;
+
+	/* gate channel 2 on with the speaker output off */
+	port_out8((port_in8(0x61) & ~0x02) | 0x01, 0x61);
+
+	/* channel 2, lobyte/hibyte, mode 0 (interrupt on terminal count) */
+	port_out8(0xB0, 0x43);
+	port_out8(latch & 0xFF, 0x42);
+	port_out8(latch >> 8, 0x42);
+
+	start = read_tsc();
+	while ((port_in8(0x61) & 0x20) == 0) {
+		if (++loops > CALIBRATE_MAX_LOOPS)
+			return 0;
+	}
+	end = read_tsc();
+
+	if (loops < CALIBRATE_MIN_LOOPS)
+		return 0;
+
+	return end - start;
+}
+
+/* count TSC cycles over CALIBRATE_MS of the PM timer, 0 on failure */
+static u64 calibrate_pm_timer(u16 port)
+{
+	u32 ticks = PM_TIMER_RATE / (1000 / CALIBRATE_MS);
+	u32 first, now;
+	u64 start, end;
+	u32 loops = 0;
+
+	first = port_in32(port) & PM_TIMER_MASK;
+	start = read_tsc();
+	do {
+		if (++loops > CALIBRATE_MAX_LOOPS)
+			return 0;
+
+		now = port_in32(port) & PM_TIMER_MASK;
+	} while (((now - first) & PM_TIMER_MASK) < ticks);
+	end = read_tsc();
+
+	if (loops < CALIBRATE_MIN_LOOPS)
+		return 0;
+
+	return end - start;
+}
+
+/*
+ * Calibrate the TSC, against the ACPI PM timer at pm_tmr_port if it is not
+ * 0 and PIT channel 2 otherwise. Only the first successful call does any
+ * work. Returns 1 when the TSC is in use, 0 when delays fall back to port
+ * 0x80.
+ */
+u8 tpm_time_init(u16 pm_tmr_port)
+{
+	u64 cycles = 0;
+
+	if (calibrated)
+		return 1;
+
+	if (!has_tsc())
+		return 0;
+
+	if (pm_tmr_port)
+		cycles = calibrate_pm_timer(pm_tmr_port);
+	if (cycles == 0)
+		cycles = calibrate_pit();
+	if (cycles == 0)
+		return 0;
+
+	tsc_khz = cycles / CALIBRATE_MS;
+	if (tsc_khz == 0)
+		return 0;
+
+	calibrated = 1;
+	return 1;
+}
+
+u8 tpm_time_calibrated(void)
+{
+	return calibrated;
+}
+
+/* TSC frequency, 0 while time is counted in microseconds */
+u32 tpm_time_khz(void)
+{
+	return calibrated ? tsc_khz : 0;
+}
+
+/* current time in ticks, only meaningful to the functions below */
+u64 tpm_now(void)
+{
+	if (calibrated)
+		return read_tsc();
+
+	return fallback_us;
+}
+
+void tpm_udelay(u32 usecs)
+{
+	u64 end;
+
+	if (!calibrated) {
+		fallback_us += usecs;
+		while (usecs--)
+			tpm_io_delay();	/* Approximately 1 us */
+		return;
+	}
+
+	end = read_tsc() + (u64)usecs * tsc_khz / 1000;
+	while (read_tsc() < end)
+		asm volatile ("pause");
+}
+
+/* the tick count usecs from now, for tpm_deadline_passed */
+u64 tpm_deadline(u32 usecs)
+{
+	if (!calibrated)
+		return fallback_us + usecs;
+
+	return read_tsc() + (u64)usecs * tsc_khz / 1000;
+}
+
+u8 tpm_deadline_passed(u64 deadline)
+{
+	return tpm_now() >= deadline;
+}
+
+/* microseconds since start, a value from tpm_now */
+u64 tpm_elapsed_us(u64 start)
+{
+	u64 ticks = tpm_now() - start;
+
+	if (!calibrated)
+		return ticks;
+
+	return ticks * 1000 / tsc_khz;
+}
+
+/*
+ * Poll done() until it reports true or timeout microseconds have passed.
+ * Returns 1 if the condition was seen, 0 on timeout.
+ */
+u8 tpm_poll(u8 (*done)(void), u32 timeout)
+{
+	u64 deadline = tpm_deadline(timeout);
+
+	while (!done()) {
+		tpm_stats_add(polls, 1);
+		if (tpm_deadline_passed(deadline))
+			return done();
+
+		tpm_udelay(TPM_POLL_INTERVAL);
+	}
+
+	return 1;
+}
+
+/*
+ * As tpm_poll, but the delay between reads starts at TPM_BACKOFF_MIN and
+ * doubles up to TPM_BACKOFF_MAX, so a quick grant costs a read or two
+ * while a slow one does not spin on the bus for the whole timeout.
+ */
+u8 tpm_poll_backoff(u8 (*done)(void), u32 timeout)
+{
+	u64 deadline = tpm_deadline(timeout);
+	u32 delay = TPM_BACKOFF_MIN;
+
+	while (!done()) {
+		tpm_stats_add(polls, 1);
+		if (tpm_deadline_passed(deadline))
+			return done();
+
+		tpm_udelay(delay);
+		if (delay < TPM_BACKOFF_MAX)
+			delay <<= 1;
+	}
+
+	return 1;
+}
@@ -12,10 +12,21 @@
 
 static log_level current_log_level = log_level_warning;
 
+/* per thread so workers each see their own */
+static __thread char last_error[256];
+
 void log_set_level(log_level value) {
     current_log_level = value;
 }
 
+const char *log_last_error(void) {
+    return last_error;
+}
+
+void log_clear_last_error(void) {
+    last_error[0] = '\0';
+}
+
 static const char *
 get_level_msg(log_level level) {
     const char *value = "UNK";
@@ -35,6 +46,13 @@ get_level_msg(log_level level) {
 void _log(log_level level, const char *file, unsigned lineno, const char *fmt,
         ...) {
 
+    if (level == log_level_error) {
+        va_list errptr;
+        va_start(errptr, fmt);
+        vsnprintf(last_error, sizeof(last_error), fmt, errptr);
+        va_end(errptr);
+    }
+
     /* Skip printing messages outside of the log level */
     if (level > current_log_level)
         return;
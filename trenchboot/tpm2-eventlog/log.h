@@ -76,4 +76,15 @@ static inline void _LOG_PERR(const char *func, TSS2_RC rc) {
  */
 void log_set_level(log_level level);
 
+/**
+ * The last error message logged by the calling thread, or an empty string.
+ * Lets callers that keep going after an error report why, e.g. per file.
+ */
+const char *log_last_error(void);
+
+/**
+ * Forget the calling thread's last error message.
+ */
+void log_clear_last_error(void);
+
 #endif /* SRC_LOG_H_ */
@@ -1,11 +1,14 @@
 #include <inttypes.h>
+#include <stddef.h>
 #include <stdlib.h>
+#include <string.h>
 #include "tss2_tpm2_types.h"
 
 #include "log.h"
 #include "efi_event.h"
 #include "tpm2_alg_util.h"
 #include "tpm2_eventlog.h"
+#include "tpm2_eventlog_replay.h"
 #include "tpm2_openssl.h"
 
 bool digest2_accumulator_callback(TCG_DIGEST2 const *digest, size_t size,
@@ -21,6 +24,99 @@ bool digest2_accumulator_callback(TCG_DIGEST2 const *digest, size_t size,
 
     return true;
 }
+#define EVENTLOG_BANK(_alg, _name, _field) { \
+        .alg = _alg, \
+        .name = _name, \
+        .digest_size = sizeof(((tpm2_eventlog_context *)0)->_field##_pcrs[0]), \
+        .pcrs_offset = offsetof(tpm2_eventlog_context, _field##_pcrs), \
+        .used_offset = offsetof(tpm2_eventlog_context, _field##_used), \
+    }
+
+tpm2_eventlog_bank const tpm2_eventlog_banks[TPM2_EVENTLOG_BANK_COUNT] = {
+    EVENTLOG_BANK(TPM2_ALG_SHA1, "sha1", sha1),
+    EVENTLOG_BANK(TPM2_ALG_SHA256, "sha256", sha256),
+    EVENTLOG_BANK(TPM2_ALG_SHA384, "sha384", sha384),
+    EVENTLOG_BANK(TPM2_ALG_SHA512, "sha512", sha512),
+    EVENTLOG_BANK(TPM2_ALG_SM3_256, "sm3_256", sm3_256),
+};
+
+int tpm2_eventlog_bank_index(TPMI_ALG_HASH alg) {
+
+    for (int i = 0; i < TPM2_EVENTLOG_BANK_COUNT; ++i) {
+        if (tpm2_eventlog_banks[i].alg == alg) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+size_t tpm2_eventlog_pcrs_size(void) {
+
+    size_t size = 0;
+
+    for (unsigned b = 0; b < TPM2_EVENTLOG_BANK_COUNT; b++) {
+        size += sizeof(uint32_t) +
+                TPM2_MAX_PCRS * tpm2_eventlog_banks[b].digest_size;
+    }
+
+    return size;
+}
+
+void tpm2_eventlog_pcrs_save(tpm2_eventlog_context *ctx, uint8_t *buf) {
+
+    for (unsigned b = 0; b < TPM2_EVENTLOG_BANK_COUNT; b++) {
+        tpm2_eventlog_bank const *bank = &tpm2_eventlog_banks[b];
+        size_t pcrs_size = TPM2_MAX_PCRS * bank->digest_size;
+
+        memcpy(buf, tpm2_eventlog_bank_used(ctx, bank), sizeof(uint32_t));
+        buf += sizeof(uint32_t);
+        memcpy(buf, tpm2_eventlog_bank_pcr(ctx, bank, 0), pcrs_size);
+        buf += pcrs_size;
+    }
+}
+
+void tpm2_eventlog_pcrs_restore(tpm2_eventlog_context *ctx, uint8_t const *buf) {
+
+    for (unsigned b = 0; b < TPM2_EVENTLOG_BANK_COUNT; b++) {
+        tpm2_eventlog_bank const *bank = &tpm2_eventlog_banks[b];
+        size_t pcrs_size = TPM2_MAX_PCRS * bank->digest_size;
+
+        memcpy(tpm2_eventlog_bank_used(ctx, bank), buf, sizeof(uint32_t));
+        buf += sizeof(uint32_t);
+        memcpy(tpm2_eventlog_bank_pcr(ctx, bank, 0), buf, pcrs_size);
+        buf += pcrs_size;
+    }
+}
+
+/*
+ * extend pcr_index of the given bank with digest, either in place or by
+ * queueing it on the replay engine
+ */
+static bool extend_bank_pcr(tpm2_eventlog_context *ctx, int bank_index,
+                            unsigned pcr_index, uint8_t const *digest) {
+
+    tpm2_eventlog_bank const *bank = &tpm2_eventlog_banks[bank_index];
+
+    *tpm2_eventlog_bank_used(ctx, bank) |= (1 << pcr_index);
+
+    if (ctx->replay) {
+        return tpm2_eventlog_replay_queue(ctx->replay, bank_index, pcr_index,
+                                          digest);
+    }
+
+    uint8_t *pcr = tpm2_eventlog_bank_pcr(ctx, bank, pcr_index);
+    if (!tpm2_openssl_pcr_extend(bank->alg, pcr, digest, bank->digest_size)) {
+        return false;
+    }
+
+    if (ctx->pcr_extend_cb != NULL) {
+        return ctx->pcr_extend_cb(bank_index, pcr_index, pcr, ctx->data);
+    }
+
+    return true;
+}
+
 /*
  * Invoke callback function for each TCG_DIGEST2 structure in the provided
  * TCG_EVENT_HEADER2. The callback function is only invoked if this function
@@ -58,27 +154,10 @@ bool foreach_digest2(tpm2_eventlog_context *ctx, unsigned pcr_index, TCG_DIGEST2
             return false;
         }
 
-        uint8_t *pcr = NULL;
-        if (alg == TPM2_ALG_SHA1) {
-            pcr = ctx->sha1_pcrs[pcr_index];
-            ctx->sha1_used |= (1 << pcr_index);
-        } else if (alg == TPM2_ALG_SHA256) {
-            pcr = ctx->sha256_pcrs[pcr_index];
-            ctx->sha256_used |= (1 << pcr_index);
-        } else if (alg == TPM2_ALG_SHA384) {
-            pcr = ctx->sha384_pcrs[pcr_index];
-            ctx->sha384_used |= (1 << pcr_index);
-        } else if (alg == TPM2_ALG_SHA512) {
-            pcr = ctx->sha512_pcrs[pcr_index];
-            ctx->sha512_used |= (1 << pcr_index);
-        } else if (alg == TPM2_ALG_SM3_256) {
-            pcr = ctx->sm3_256_pcrs[pcr_index];
-            ctx->sm3_256_used |= (1 << pcr_index);
-        } else {
+        int bank_index = tpm2_eventlog_bank_index(alg);
+        if (bank_index < 0) {
             LOG_WARN("PCR%d algorithm %d unsupported", pcr_index, alg);
-        }
-
-        if (pcr && !tpm2_openssl_pcr_extend(alg, pcr, digest->Digest, alg_size)) {
+        } else if (!extend_bank_pcr(ctx, bank_index, pcr_index, digest->Digest)) {
             LOG_ERR("PCR%d extend failed", pcr_index);
             return false;
         }
@@ -158,6 +237,35 @@ bool parse_event2body(TCG_EVENT2 const *event, UINT32 type) {
 
     return true;
 }
+/*
+ * Validate that count TCG_DIGEST2 structures fit in size bytes and sum up
+ * their size. This is the sizing half of foreach_digest2, without replaying
+ * the digests into a throwaway context.
+ */
+static bool digests2_size(TCG_DIGEST2 const *digest, size_t count, size_t size,
+                          size_t *digests_size) {
+
+    size_t i;
+    for (i = 0; i < count; ++i) {
+        if (size < sizeof(*digest)) {
+            LOG_ERR("insufficient size for digest header");
+            return false;
+        }
+
+        const size_t alg_size = tpm2_alg_util_get_hash_size(digest->AlgorithmId);
+        if (size < sizeof(*digest) + alg_size) {
+            LOG_ERR("insufficient size for digest buffer");
+            return false;
+        }
+
+        *digests_size += sizeof(*digest) + alg_size;
+        size -= sizeof(*digest) + alg_size;
+        digest = (TCG_DIGEST2*)((uintptr_t)digest->Digest + alg_size);
+    }
+
+    return true;
+}
+
 /*
  * parse event structure, including header, digests and event buffer ensuring
  * it all fits within the provided buffer (buf_size).
@@ -173,13 +281,14 @@ bool parse_event2(TCG_EVENT_HEADER2 const *eventhdr, size_t buf_size,
     }
     *event_size = sizeof(*eventhdr);
 
-    tpm2_eventlog_context ctx = {
-        .data = digests_size,
-        .digest2_cb = digest2_accumulator_callback,
-    };
-    ret = foreach_digest2(&ctx, eventhdr->PCRIndex,
-                          eventhdr->Digests, eventhdr->DigestCount,
-                          buf_size - sizeof(*eventhdr));
+    if (eventhdr->PCRIndex > (TPM2_MAX_PCRS - 1)) {
+        LOG_ERR("PCR Index %d is out of bounds for max available PCRS %d",
+        eventhdr->PCRIndex, TPM2_MAX_PCRS);
+        return false;
+    }
+
+    ret = digests2_size(eventhdr->Digests, eventhdr->DigestCount,
+                        buf_size - sizeof(*eventhdr), digests_size);
     if (ret != true) {
         return false;
     }
@@ -204,8 +313,6 @@ bool parse_event2(TCG_EVENT_HEADER2 const *eventhdr, size_t buf_size,
 bool parse_sha1_log_event(tpm2_eventlog_context *ctx, TCG_EVENT const *event, size_t size,
                       size_t *event_size) {
 
-    uint8_t *pcr = NULL;
-
     /* enough size for the 1.2 event structure */
     if (size < sizeof(*event)) {
         LOG_ERR("insufficient size for SpecID event header");
@@ -213,10 +320,16 @@ bool parse_sha1_log_event(tpm2_eventlog_context *ctx, TCG_EVENT const *event, si
     }
     *event_size = sizeof(*event);
 
-    pcr = ctx->sha1_pcrs[ event->pcrIndex];
-    if (pcr) {
-        tpm2_openssl_pcr_extend(TPM2_ALG_SHA1, pcr, &event->digest[0], 20);
-        ctx->sha1_used |= (1 << event->pcrIndex);
+    if (event->pcrIndex > (TPM2_MAX_PCRS - 1)) {
+        LOG_ERR("PCR Index %d is out of bounds for max available PCRS %d",
+        event->pcrIndex, TPM2_MAX_PCRS);
+        return false;
+    }
+
+    if (!extend_bank_pcr(ctx, tpm2_eventlog_bank_index(TPM2_ALG_SHA1),
+                         event->pcrIndex, event->digest)) {
+        LOG_ERR("PCR%d extend failed", event->pcrIndex);
+        return false;
     }
 
     /* buffer size must be sufficient to hold event and event data */
@@ -229,6 +342,45 @@ bool parse_sha1_log_event(tpm2_eventlog_context *ctx, TCG_EVENT const *event, si
     return true;
 }
 
+/*
+ * parse a single SHA1 format event and invoke the callbacks for it. On
+ * success event_size holds the number of bytes consumed.
+ */
+static bool process_sha1_log_event(tpm2_eventlog_context *ctx,
+                                   TCG_EVENT const *eventhdr, size_t size,
+                                   size_t *event_size) {
+
+    bool ret = parse_sha1_log_event(ctx, eventhdr, size, event_size);
+    if (!ret) {
+        return ret;
+    }
+
+    TCG_EVENT2 *event = (TCG_EVENT2*)((uintptr_t)&eventhdr->eventDataSize);
+
+    /* event header callback */
+    if (ctx->log_eventhdr_cb != NULL) {
+        ret = ctx->log_eventhdr_cb(eventhdr, *event_size, ctx->data);
+        if (ret != true) {
+            return false;
+        }
+    }
+
+    ret = parse_event2body(event, eventhdr->eventType);
+    if (ret != true) {
+        return ret;
+    }
+
+    /* event data callback */
+    if (ctx->event2_cb != NULL) {
+        ret = ctx->event2_cb(event, eventhdr->eventType, ctx->data);
+        if (ret != true) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
 bool foreach_sha1_log_event(tpm2_eventlog_context *ctx, TCG_EVENT const *eventhdr_start, size_t size) {
 
     if (eventhdr_start == NULL) {
@@ -245,36 +397,60 @@ bool foreach_sha1_log_event(tpm2_eventlog_context *ctx, TCG_EVENT const *eventhd
     bool ret;
 
     for (eventhdr = eventhdr_start, event_size = 0;
-         size > 0;
+         size > 0 && !ctx->done;
          eventhdr = (TCG_EVENT*)((uintptr_t)eventhdr + event_size),
          size -= event_size) {
 
-        ret = parse_sha1_log_event(ctx, eventhdr, size, &event_size);
+        ret = process_sha1_log_event(ctx, eventhdr, size, &event_size);
         if (!ret) {
             return ret;
         }
+    }
+
+    return true;
+}
 
-        TCG_EVENT2 *event = (TCG_EVENT2*)((uintptr_t)&eventhdr->eventDataSize);
+/*
+ * parse a single crypto agile event, replay its digests and invoke the
+ * callbacks for it. On success event_size holds the number of bytes consumed.
+ */
+static bool process_event2(tpm2_eventlog_context *ctx,
+                           TCG_EVENT_HEADER2 const *eventhdr, size_t size,
+                           size_t *event_size) {
 
-        /* event header callback */
-        if (ctx->log_eventhdr_cb != NULL) {
-            ret = ctx->log_eventhdr_cb(eventhdr, event_size, ctx->data);
-            if (ret != true) {
-                return false;
-            }
-        }
+    size_t digests_size = 0;
 
-        ret = parse_event2body(event, eventhdr->eventType);
+    bool ret = parse_event2(eventhdr, size, event_size, &digests_size);
+    if (!ret) {
+        return ret;
+    }
+
+    TCG_EVENT2 *event = (TCG_EVENT2*)((uintptr_t)eventhdr->Digests + digests_size);
+
+    /* event header callback */
+    if (ctx->event2hdr_cb != NULL) {
+        ret = ctx->event2hdr_cb(eventhdr, *event_size, ctx->data);
         if (ret != true) {
-            return ret;
+            return false;
         }
+    }
 
-        /* event data callback */
-        if (ctx->event2_cb != NULL) {
-            ret = ctx->event2_cb(event, eventhdr->eventType, ctx->data);
-            if (ret != true) {
-                return false;
-            }
+    /* digest callback foreach digest */
+    ret = foreach_digest2(ctx, eventhdr->PCRIndex, eventhdr->Digests, eventhdr->DigestCount, digests_size);
+    if (ret != true) {
+        return false;
+    }
+
+    ret = parse_event2body(event, eventhdr->EventType);
+    if (ret != true) {
+        return ret;
+    }
+
+    /* event data callback */
+    if (ctx->event2_cb != NULL) {
+        ret = ctx->event2_cb(event, eventhdr->EventType, ctx->data);
+        if (ret != true) {
+            return false;
         }
     }
 
@@ -296,48 +472,29 @@ bool foreach_event2(tpm2_eventlog_context *ctx, TCG_EVENT_HEADER2 const *eventhd
     bool ret;
 
     for (eventhdr = eventhdr_start, event_size = 0;
-         size > 0;
+         size > 0 && !ctx->done;
          eventhdr = (TCG_EVENT_HEADER2*)((uintptr_t)eventhdr + event_size),
          size -= event_size) {
 
-        size_t digests_size = 0;
-
-        ret = parse_event2(eventhdr, size, &event_size, &digests_size);
+        ret = process_event2(ctx, eventhdr, size, &event_size);
         if (!ret) {
             return ret;
         }
+    }
 
-        TCG_EVENT2 *event = (TCG_EVENT2*)((uintptr_t)eventhdr->Digests + digests_size);
-
-        /* event header callback */
-        if (ctx->event2hdr_cb != NULL) {
-            ret = ctx->event2hdr_cb(eventhdr, event_size, ctx->data);
-            if (ret != true) {
-                return false;
-            }
-        }
-
-        /* digest callback foreach digest */
-        ret = foreach_digest2(ctx, eventhdr->PCRIndex, eventhdr->Digests, eventhdr->DigestCount, digests_size);
-        if (ret != true) {
-            return false;
-        }
+    return true;
+}
 
-        ret = parse_event2body(event, eventhdr->EventType);
-        if (ret != true) {
-            return ret;
-        }
+bool parse_eventlog_event(tpm2_eventlog_context *ctx, BYTE const *buf,
+                          size_t size, bool agile, size_t *event_size) {
 
-        /* event data callback */
-        if (ctx->event2_cb != NULL) {
-            ret = ctx->event2_cb(event, eventhdr->EventType, ctx->data);
-            if (ret != true) {
-                return false;
-            }
-        }
+    if (agile) {
+        return process_event2(ctx, (TCG_EVENT_HEADER2 const *)buf, size,
+                              event_size);
     }
 
-    return true;
+    return process_sha1_log_event(ctx, (TCG_EVENT const *)buf, size,
+                                  event_size);
 }
 
 bool specid_event(TCG_EVENT const *event, size_t size,
@@ -419,7 +576,17 @@ bool specid_event(TCG_EVENT const *event, size_t size,
     return true;
 }
 
-bool parse_eventlog(tpm2_eventlog_context *ctx, BYTE const *eventlog, size_t size) {
+/* drain deferred extends so the PCR arrays in the context are final */
+static bool replay_finish(tpm2_eventlog_context *ctx, bool ret) {
+
+    if (ctx->replay && !tpm2_eventlog_replay_flush(ctx->replay)) {
+        return false;
+    }
+
+    return ret;
+}
+
+static bool walk_eventlog(tpm2_eventlog_context *ctx, BYTE const *eventlog, size_t size) {
 
     if(!eventlog || (size < sizeof(TCG_EVENT))) {
         return false;
@@ -448,3 +615,151 @@ bool parse_eventlog(tpm2_eventlog_context *ctx, BYTE const *eventlog, size_t siz
     /* No specid event found. sha1 log format will be parsed. */
     return foreach_sha1_log_event(ctx, event, size);
 }
+
+bool parse_eventlog(tpm2_eventlog_context *ctx, BYTE const *eventlog, size_t size) {
+
+    return replay_finish(ctx, walk_eventlog(ctx, eventlog, size));
+}
+
+/*
+ * Number of bytes needed to hold the crypto agile event at buf, given that
+ * avail bytes are present. When the answer depends on bytes that are not yet
+ * available the size needed to make progress is returned instead, so callers
+ * loop until the result no longer exceeds avail. Malformed events are left to
+ * parse_event2 to report.
+ */
+static size_t event2_size_hint(UINT8 const *buf, size_t avail) {
+
+    TCG_EVENT_HEADER2 const *eventhdr = (TCG_EVENT_HEADER2 const *)buf;
+    size_t need = sizeof(*eventhdr);
+    if (avail < need) {
+        return need;
+    }
+
+    for (UINT32 i = 0; i < eventhdr->DigestCount; ++i) {
+        TCG_DIGEST2 const *digest = (TCG_DIGEST2 const *)(buf + need);
+        if (avail < need + sizeof(*digest)) {
+            return need + sizeof(*digest);
+        }
+        need += sizeof(*digest) + tpm2_alg_util_get_hash_size(digest->AlgorithmId);
+    }
+
+    TCG_EVENT2 const *event = (TCG_EVENT2 const *)(buf + need);
+    if (avail < need + sizeof(*event)) {
+        return need + sizeof(*event);
+    }
+
+    return need + sizeof(*event) + event->EventSize;
+}
+
+/* same for TCG_EVENT, which covers both SHA1 log events and the SpecID event */
+static size_t event_size_hint(UINT8 const *buf, size_t avail) {
+
+    TCG_EVENT const *event = (TCG_EVENT const *)buf;
+    if (avail < sizeof(*event)) {
+        return sizeof(*event);
+    }
+
+    return sizeof(*event) + event->eventDataSize;
+}
+
+typedef size_t (*event_size_hint_fn)(UINT8 const *buf, size_t avail);
+
+/*
+ * Buffer the next complete event. Returns false on read error; at the end
+ * of the log avail is set to 0.
+ */
+static bool input_next_event(tpm2_eventlog_input *in, event_size_hint_fn hint,
+                             UINT8 const **buf, size_t *avail) {
+
+    size_t need = 1;
+
+    for (;;) {
+        if (!tpm2_eventlog_input_peek(in, need, buf, avail)) {
+            return false;
+        }
+        if (*avail < need) {
+            /* end of log, or a truncated event the parser will report */
+            return true;
+        }
+        need = hint(*buf, *avail);
+        if (need <= *avail) {
+            return true;
+        }
+    }
+}
+
+/* walk the events following the cursor up to the end of the log */
+static bool walk_events_input(tpm2_eventlog_context *ctx, tpm2_eventlog_input *in,
+                              bool agile) {
+
+    event_size_hint_fn hint = agile ? event2_size_hint : event_size_hint;
+    UINT8 const *buf;
+    size_t avail, event_size;
+    bool ret;
+
+    while (!ctx->done) {
+        ret = input_next_event(in, hint, &buf, &avail);
+        if (!ret) {
+            return false;
+        }
+        if (avail == 0) {
+            return true;
+        }
+
+        ret = parse_eventlog_event(ctx, buf, avail, agile, &event_size);
+        if (!ret) {
+            return false;
+        }
+        tpm2_eventlog_input_consume(in, event_size);
+        in->events++;
+    }
+
+    return true;
+}
+
+static bool walk_eventlog_input(tpm2_eventlog_context *ctx, tpm2_eventlog_input *in) {
+
+    UINT8 const *buf;
+    size_t avail;
+    bool ret;
+
+    ret = input_next_event(in, event_size_hint, &buf, &avail);
+    if (!ret || avail < sizeof(TCG_EVENT)) {
+        return false;
+    }
+
+    TCG_EVENT *event = (TCG_EVENT*)buf;
+    if (event->eventType != EV_NO_ACTION) {
+        /* No specid event found. sha1 log format will be parsed. */
+        return walk_events_input(ctx, in, false);
+    }
+
+    TCG_EVENT_HEADER2 *next;
+    ret = specid_event(event, avail, &next);
+    if (!ret) {
+        return false;
+    }
+
+    if (ctx->specid_cb) {
+        ret = ctx->specid_cb(event, ctx->data);
+        if (!ret) {
+            return false;
+        }
+    }
+    tpm2_eventlog_input_consume(in, (uintptr_t)next - (uintptr_t)buf);
+    in->events++;
+
+    return walk_events_input(ctx, in, true);
+}
+
+bool parse_eventlog_input(tpm2_eventlog_context *ctx, tpm2_eventlog_input *in) {
+
+    return replay_finish(ctx, walk_eventlog_input(ctx, in));
+}
+
+bool parse_eventlog_input_resume(tpm2_eventlog_context *ctx,
+                                 tpm2_eventlog_input *in, bool agile) {
+
+    return replay_finish(ctx, walk_events_input(ctx, in, agile));
+}
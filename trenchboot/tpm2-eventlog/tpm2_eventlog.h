@@ -8,6 +8,10 @@
 #include "tss2_tpm2_types.h"
 
 #include "efi_event.h"
+#include "tpm2_eventlog_input.h"
+
+/* raw event data beyond this is not rendered */
+#define EVENT_DATA_MAX 1024
 
 typedef bool (*DIGEST2_CALLBACK)(TCG_DIGEST2 const *digest, size_t size,
                                  void *data);
@@ -18,7 +22,11 @@ typedef bool (*EVENT2DATA_CALLBACK)(TCG_EVENT2 const *event, UINT32 type,
 typedef bool (*SPECID_CALLBACK)(TCG_EVENT const *event, void *data);
 typedef bool (*LOG_EVENT_CALLBACK)(TCG_EVENT const *event_hdr, size_t size,
                                    void *data);
+typedef bool (*PCR_EXTEND_CALLBACK)(unsigned bank_index, unsigned pcr_index,
+                                    uint8_t const *pcr, void *data);
+
 
+typedef struct tpm2_eventlog_replay tpm2_eventlog_replay;
 
 typedef struct {
     void *data;
@@ -27,6 +35,12 @@ typedef struct {
     EVENT2_CALLBACK event2hdr_cb;
     DIGEST2_CALLBACK digest2_cb;
     EVENT2DATA_CALLBACK event2_cb;
+    /* called with the new PCR value after each extend that is not deferred */
+    PCR_EXTEND_CALLBACK pcr_extend_cb;
+    /* set by a callback to end the walk successfully after this event */
+    bool done;
+    /* when set, extends are deferred to the parallel replay engine */
+    tpm2_eventlog_replay *replay;
     uint32_t sha1_used;
     uint32_t sha256_used;
     uint32_t sha384_used;
@@ -39,6 +53,44 @@ typedef struct {
     uint8_t sm3_256_pcrs[TPM2_MAX_PCRS][TPM2_SM3_256_DIGEST_SIZE];
 } tpm2_eventlog_context;
 
+/*
+ * Describes one PCR bank of tpm2_eventlog_context so banks can be handled
+ * by table lookup rather than per-algorithm code.
+ */
+typedef struct {
+    TPMI_ALG_HASH alg;
+    char const *name;
+    size_t digest_size;
+    size_t pcrs_offset;
+    size_t used_offset;
+} tpm2_eventlog_bank;
+
+#define TPM2_EVENTLOG_BANK_COUNT 5
+
+extern tpm2_eventlog_bank const tpm2_eventlog_banks[TPM2_EVENTLOG_BANK_COUNT];
+
+/* index into tpm2_eventlog_banks or -1 if alg has no bank */
+int tpm2_eventlog_bank_index(TPMI_ALG_HASH alg);
+
+static inline uint8_t *tpm2_eventlog_bank_pcr(tpm2_eventlog_context *ctx,
+                                              tpm2_eventlog_bank const *bank,
+                                              unsigned pcr_index) {
+    return (uint8_t *)ctx + bank->pcrs_offset + pcr_index * bank->digest_size;
+}
+
+static inline uint32_t *tpm2_eventlog_bank_used(tpm2_eventlog_context *ctx,
+                                                tpm2_eventlog_bank const *bank) {
+    return (uint32_t *)((uint8_t *)ctx + bank->used_offset);
+}
+
+/*
+ * The PCR state of a context (used mask and PCR array of every bank) as a
+ * flat buffer of tpm2_eventlog_pcrs_size() bytes, for saving it to disk.
+ */
+size_t tpm2_eventlog_pcrs_size(void);
+void tpm2_eventlog_pcrs_save(tpm2_eventlog_context *ctx, uint8_t *buf);
+void tpm2_eventlog_pcrs_restore(tpm2_eventlog_context *ctx, uint8_t const *buf);
+
 bool digest2_accumulator_callback(TCG_DIGEST2 const *digest, size_t size,
                                   void *data);
 
@@ -48,7 +100,22 @@ bool foreach_digest2(tpm2_eventlog_context *ctx, unsigned pcr_index,
 bool parse_event2(TCG_EVENT_HEADER2 const *eventhdr, size_t buf_size,
                   size_t *event_size, size_t *digests_size);
 bool foreach_event2(tpm2_eventlog_context *ctx, TCG_EVENT_HEADER2 const *eventhdr_start, size_t size);
+/*
+ * Parse, replay and invoke the callbacks for the single event at buf, which
+ * is a TCG_EVENT_HEADER2 when agile is set and a SHA1 format TCG_EVENT
+ * otherwise. Lets callers that know where events start, such as the index,
+ * replay a subset of the log.
+ */
+bool parse_eventlog_event(tpm2_eventlog_context *ctx, BYTE const *buf,
+                          size_t size, bool agile, size_t *event_size);
 bool specid_event(TCG_EVENT const *event, size_t size, TCG_EVENT_HEADER2 **next);
 bool parse_eventlog(tpm2_eventlog_context *ctx, BYTE const *eventlog, size_t size);
+bool parse_eventlog_input(tpm2_eventlog_context *ctx, tpm2_eventlog_input *in);
+/*
+ * Continue parsing at the input cursor, which must be at an event boundary
+ * past the SpecID event, up to the end of the log.
+ */
+bool parse_eventlog_input_resume(tpm2_eventlog_context *ctx,
+                                 tpm2_eventlog_input *in, bool agile);
 
 #endif
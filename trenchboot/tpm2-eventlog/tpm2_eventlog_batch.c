@@ -0,0 +1,360 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+#include <dirent.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "log.h"
+#include "tpm2_eventlog.h"
+#include "tpm2_eventlog_batch.h"
+#include "tpm2_eventlog_input.h"
+#include "tpm2_eventlog_yaml.h"
+#include "tpm2_openssl.h"
+#include "tpm2_tool_output.h"
+
+static bool batch_list_push(tpm2_eventlog_batch_list *list, char *path) {
+
+    if (list->count == list->capacity) {
+        size_t capacity = list->capacity ? list->capacity * 2 : 64;
+        char **tmp = realloc(list->paths, capacity * sizeof(*tmp));
+        if (!tmp) {
+            LOG_ERR("failed to grow batch list: %s", strerror(errno));
+            free(path);
+            return false;
+        }
+        list->paths = tmp;
+        list->capacity = capacity;
+    }
+
+    list->paths[list->count++] = path;
+    return true;
+}
+
+static int batch_name_cmp(void const *a, void const *b) {
+
+    return strcmp(*(char * const *)a, *(char * const *)b);
+}
+
+static bool batch_add_dir(tpm2_eventlog_batch_list *list, char const *dir) {
+
+    DIR *d = opendir(dir);
+    if (!d) {
+        LOG_ERR("failed to open directory: %s error: %s", dir, strerror(errno));
+        return false;
+    }
+
+    size_t first = list->count;
+    struct dirent *entry;
+    bool ret = true;
+
+    while (ret && (entry = readdir(d)) != NULL) {
+        struct stat s;
+        size_t len = strlen(dir) + strlen(entry->d_name) + 2;
+        char *path = malloc(len);
+        if (!path) {
+            LOG_ERR("oom");
+            ret = false;
+            break;
+        }
+        snprintf(path, len, "%s/%s", dir, entry->d_name);
+
+        if (stat(path, &s) || !S_ISREG(s.st_mode)) {
+            free(path);
+            continue;
+        }
+        ret = batch_list_push(list, path);
+    }
+    closedir(d);
+
+    qsort(&list->paths[first], list->count - first, sizeof(*list->paths),
+          batch_name_cmp);
+    return ret;
+}
+
+static bool batch_add_stdin(tpm2_eventlog_batch_list *list) {
+
+    char *line = NULL;
+    size_t size = 0;
+    ssize_t len;
+    bool ret = true;
+
+    while (ret && (len = getline(&line, &size, stdin)) != -1) {
+        while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r')) {
+            line[--len] = '\0';
+        }
+        if (len == 0) {
+            continue;
+        }
+
+        char *path = strdup(line);
+        if (!path) {
+            LOG_ERR("oom");
+            ret = false;
+            break;
+        }
+        ret = batch_list_push(list, path);
+    }
+
+    free(line);
+    return ret;
+}
+
+bool tpm2_eventlog_batch_add(tpm2_eventlog_batch_list *list, char const *path) {
+
+    struct stat s;
+
+    if (!strcmp(path, "-")) {
+        return batch_add_stdin(list);
+    }
+
+    if (!stat(path, &s) && S_ISDIR(s.st_mode)) {
+        return batch_add_dir(list, path);
+    }
+
+    /* anything else is reported as a failed log if it cannot be read */
+    char *copy = strdup(path);
+    if (!copy) {
+        LOG_ERR("oom");
+        return false;
+    }
+    return batch_list_push(list, copy);
+}
+
+void tpm2_eventlog_batch_list_free(tpm2_eventlog_batch_list *list) {
+
+    for (size_t i = 0; i < list->count; ++i) {
+        free(list->paths[i]);
+    }
+    free(list->paths);
+    memset(list, 0, sizeof(*list));
+}
+
+typedef struct {
+    bool done;
+    bool ok;
+    bool agile;
+    size_t events;
+    size_t bytes;
+    uint8_t *pcrs;     /* tpm2_eventlog_pcrs_size() bytes when ok */
+    char *error;       /* why it failed when not ok */
+} batch_result;
+
+typedef struct {
+    tpm2_eventlog_batch_list const *list;
+    batch_result *results;
+    bool stream;
+    size_t next;
+    pthread_mutex_t lock;
+    pthread_cond_t done_cond;
+} batch;
+
+static bool batch_specid_callback(TCG_EVENT const *event, void *data) {
+
+    (void)event;
+    *(bool *)data = true;
+    return true;
+}
+
+/* replay one log without rendering it, keeping only the final PCRs */
+static bool batch_replay(tpm2_eventlog_input *in, batch_result *r) {
+
+    tpm2_eventlog_context ctx = {
+        .data = &r->agile,
+        .specid_cb = batch_specid_callback,
+    };
+
+    if (!parse_eventlog_input(&ctx, in)) {
+        return false;
+    }
+
+    r->pcrs = malloc(tpm2_eventlog_pcrs_size());
+    if (!r->pcrs) {
+        LOG_ERR("oom");
+        return false;
+    }
+    tpm2_eventlog_pcrs_save(&ctx, r->pcrs);
+
+    r->events = in->events;
+    r->bytes = in->offset;
+    return true;
+}
+
+static void batch_process(batch *b, tpm2_eventlog_input *in, size_t i,
+                          batch_result *r) {
+
+    memset(r, 0, sizeof(*r));
+    log_clear_last_error();
+
+    r->ok = tpm2_eventlog_input_reopen(in, b->list->paths[i], b->stream) &&
+            batch_replay(in, r);
+    if (!r->ok) {
+        free(r->pcrs);
+        r->pcrs = NULL;
+        r->error = strdup(*log_last_error() ? log_last_error() :
+                           "could not parse event log");
+    }
+}
+
+static void *batch_worker(void *arg) {
+
+    batch *b = arg;
+    tpm2_eventlog_input in = { .fd = -1 };
+    batch_result r;
+
+    /* the digest cache is per thread and lives for the whole batch */
+    bool cached = tpm2_openssl_hash_cache_init();
+
+    for (;;) {
+        pthread_mutex_lock(&b->lock);
+        size_t i = b->next++;
+        pthread_mutex_unlock(&b->lock);
+        if (i >= b->list->count) {
+            break;
+        }
+
+        batch_process(b, &in, i, &r);
+
+        pthread_mutex_lock(&b->lock);
+        b->results[i] = r;
+        b->results[i].done = true;
+        pthread_cond_broadcast(&b->done_cond);
+        pthread_mutex_unlock(&b->lock);
+    }
+
+    tpm2_eventlog_input_close(&in);
+
+    if (cached) {
+        tpm2_openssl_hash_cache_teardown();
+    }
+
+    return NULL;
+}
+
+/* single quoted YAML scalar, quotes are escaped by doubling them */
+static void batch_output_quoted(char const *str) {
+
+    tpm2_tool_output_write("'", 1);
+    for (char const *quote; (quote = strchr(str, '\'')) != NULL;
+         str = quote + 1) {
+        tpm2_tool_output_write(str, quote - str + 1);
+        tpm2_tool_output_write("'", 1);
+    }
+    tpm2_tool_output_write(str, strlen(str));
+    tpm2_tool_output_write("'\n", 2);
+}
+
+static void batch_output_result(char const *path, batch_result const *r) {
+
+    tpm2_tool_output("  - path: ");
+    batch_output_quoted(path);
+
+    if (!r->ok) {
+        tpm2_tool_output("    status: error\n"
+                         "    error: ");
+        batch_output_quoted(r->error ? r->error : "failed");
+        return;
+    }
+
+    tpm2_tool_output("    status: ok\n"
+                     "    format: %s\n"
+                     "    events: %zu\n"
+                     "    bytes: %zu\n",
+                     r->agile ? "crypto-agile" : "sha1",
+                     r->events, r->bytes);
+
+    tpm2_eventlog_context ctx = { 0 };
+    tpm2_eventlog_pcrs_restore(&ctx, r->pcrs);
+    yaml_eventlog_pcrs(&ctx, 4);
+}
+
+bool tpm2_eventlog_batch_run(tpm2_eventlog_batch_list const *list,
+                             unsigned jobs, bool stream, size_t *failed) {
+
+    batch b = {
+        .list = list,
+        .stream = stream,
+    };
+    size_t events = 0, bytes = 0;
+    bool ret = true;
+
+    *failed = 0;
+
+    b.results = calloc(list->count ? list->count : 1, sizeof(*b.results));
+    if (!b.results) {
+        LOG_ERR("failed to allocate batch results: %s", strerror(errno));
+        return false;
+    }
+
+    if (jobs > list->count) {
+        jobs = list->count;
+    }
+    pthread_t *threads = calloc(jobs ? jobs : 1, sizeof(*threads));
+    if (!threads) {
+        LOG_ERR("failed to allocate batch threads: %s", strerror(errno));
+        free(b.results);
+        return false;
+    }
+
+    pthread_mutex_init(&b.lock, NULL);
+    pthread_cond_init(&b.done_cond, NULL);
+
+    unsigned nthreads;
+    for (nthreads = 0; nthreads < jobs; ++nthreads) {
+        int rc = pthread_create(&threads[nthreads], NULL, batch_worker, &b);
+        if (rc) {
+            LOG_ERR("failed to start batch thread: %s", strerror(rc));
+            break;
+        }
+    }
+
+    if (nthreads == 0 && list->count) {
+        ret = false;
+        goto out;
+    }
+
+    /* report in list order while the workers move on */
+    tpm2_tool_output("---\n"
+                     "logs:\n");
+    for (size_t i = 0; i < list->count; ++i) {
+        pthread_mutex_lock(&b.lock);
+        while (!b.results[i].done) {
+            pthread_cond_wait(&b.done_cond, &b.lock);
+        }
+        pthread_mutex_unlock(&b.lock);
+
+        batch_result *r = &b.results[i];
+        batch_output_result(list->paths[i], r);
+        if (r->ok) {
+            events += r->events;
+            bytes += r->bytes;
+        } else {
+            (*failed)++;
+        }
+        free(r->pcrs);
+        free(r->error);
+        r->pcrs = NULL;
+        r->error = NULL;
+    }
+
+    tpm2_tool_output("summary:\n"
+                     "  logs: %zu\n"
+                     "  ok: %zu\n"
+                     "  failed: %zu\n"
+                     "  events: %zu\n"
+                     "  bytes: %zu\n",
+                     list->count, list->count - *failed, *failed,
+                     events, bytes);
+
+out:
+    for (unsigned i = 0; i < nthreads; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+    free(threads);
+    pthread_cond_destroy(&b.done_cond);
+    pthread_mutex_destroy(&b.lock);
+    free(b.results);
+
+    return ret;
+}
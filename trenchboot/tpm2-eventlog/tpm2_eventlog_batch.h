@@ -0,0 +1,39 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+#ifndef TPM2_EVENTLOG_BATCH_H
+#define TPM2_EVENTLOG_BATCH_H
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+/* the event logs of a batch run, in report order */
+typedef struct {
+    char **paths;
+    size_t count;
+    size_t capacity;
+} tpm2_eventlog_batch_list;
+
+/**
+ * Add logs to a batch. A directory adds the regular files directly in it,
+ * sorted by name, and "-" adds the newline separated paths read from stdin.
+ * @return
+ *  true on success, false on error.
+ */
+bool tpm2_eventlog_batch_add(tpm2_eventlog_batch_list *list, char const *path);
+
+void tpm2_eventlog_batch_list_free(tpm2_eventlog_batch_list *list);
+
+/**
+ * Replay every log of the batch on a pool of jobs worker threads, each
+ * reusing its digest contexts and read window from one log to the next,
+ * and print a YAML report with the PCR values or the error of each log and
+ * an aggregate summary. A log that fails to open or parse is reported and
+ * does not stop the others.
+ * @param failed
+ *  Set to the number of logs that failed.
+ * @return
+ *  true if the batch ran, false on a setup error.
+ */
+bool tpm2_eventlog_batch_run(tpm2_eventlog_batch_list const *list,
+                             unsigned jobs, bool stream, size_t *failed);
+
+#endif
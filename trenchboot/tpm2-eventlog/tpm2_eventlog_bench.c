@@ -0,0 +1,311 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/*
+ * Measure tpm2_eventlog throughput on one log: the full parse_eventlog walk,
+ * the foreach_digest2 replay on its own and rendering with each output
+ * format. Rendered output is discarded; the report goes to stdout. A log
+ * that fails to parse is still measured, up to where the parser gives up,
+ * and each phase reports how many of its passes failed.
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "log.h"
+#include "tpm2_eventlog.h"
+#include "tpm2_eventlog_emitter.h"
+#include "tpm2_eventlog_input.h"
+#include "tpm2_openssl.h"
+#include "tpm2_tool_output.h"
+#include "tpm2_util.h"
+
+/* the digests of one crypto agile event, collected ahead of the replay */
+typedef struct {
+    TCG_EVENT_HEADER2 const *hdr;
+    size_t digests_size;
+} bench_event;
+
+typedef struct {
+    BYTE const *log;
+    size_t size;
+    size_t events;      /* events parsed, up to the first bad one */
+    size_t parsed;      /* bytes those events take */
+    bool parses;
+    bool agile;
+    bench_event *agile_events;
+    size_t agile_count;
+    unsigned iterations;
+    unsigned jobs;
+    int devnull;
+} bench;
+
+static double now_seconds(void) {
+
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static void bench_report(bench const *b, char const *phase, double secs,
+                         unsigned failures) {
+
+    double bytes = (double)b->parsed * b->iterations;
+    double events = (double)b->events * b->iterations;
+
+    if (secs <= 0) {
+        secs = 1e-9;
+    }
+
+    tpm2_tool_output("  - phase: %s\n"
+                     "    seconds: %.6f\n"
+                     "    events/sec: %.0f\n"
+                     "    MB/sec: %.2f\n"
+                     "    failures: %u\n",
+                     phase, secs, events / secs, bytes / secs / (1024 * 1024),
+                     failures);
+}
+
+/*
+ * Count events and, for agile logs, find each event's digests. Both stop at
+ * the first event the parser rejects.
+ */
+static bool bench_scan(bench *b) {
+
+    tpm2_eventlog_input in;
+    tpm2_eventlog_context ctx = { 0 };
+
+    tpm2_eventlog_input_from_buffer(&in, b->log, b->size);
+    b->parses = parse_eventlog_input(&ctx, &in);
+    b->events = in.events;
+    b->parsed = in.offset;
+
+    TCG_EVENT const *first = (TCG_EVENT const *)b->log;
+    b->agile = b->size >= sizeof(*first) && first->eventType == EV_NO_ACTION;
+    if (!b->agile) {
+        return true;
+    }
+
+    /* without a SpecID event there are no TCG_DIGEST2 lists to replay */
+    TCG_EVENT_HEADER2 *next;
+    if (!specid_event(first, b->size, &next)) {
+        return true;
+    }
+
+    b->agile_events = calloc(b->events ? b->events : 1,
+                             sizeof(*b->agile_events));
+    if (!b->agile_events) {
+        LOG_ERR("oom");
+        return false;
+    }
+
+    BYTE const *p = (BYTE const *)next;
+    BYTE const *end = b->log + b->size;
+    while (p < end && b->agile_count < b->events) {
+        bench_event *e = &b->agile_events[b->agile_count++];
+        size_t event_size;
+
+        e->hdr = (TCG_EVENT_HEADER2 const *)p;
+        e->digests_size = 0;
+        if (!parse_event2(e->hdr, end - p, &event_size, &e->digests_size)) {
+            b->agile_count--;
+            break;
+        }
+        p += event_size;
+    }
+
+    return true;
+}
+
+static void bench_parse(bench *b) {
+
+    unsigned failures = 0;
+    double start = now_seconds();
+
+    for (unsigned i = 0; i < b->iterations; ++i) {
+        tpm2_eventlog_context ctx = { 0 };
+        if (!parse_eventlog(&ctx, b->log, b->size)) {
+            ++failures;
+        }
+    }
+
+    bench_report(b, "parse_eventlog", now_seconds() - start, failures);
+}
+
+static bool bench_replay(bench *b) {
+
+    double start = now_seconds();
+
+    for (unsigned i = 0; i < b->iterations; ++i) {
+        tpm2_eventlog_context ctx = { 0 };
+        for (size_t j = 0; j < b->agile_count; ++j) {
+            TCG_EVENT_HEADER2 const *hdr = b->agile_events[j].hdr;
+            if (!foreach_digest2(&ctx, hdr->PCRIndex, hdr->Digests,
+                                 hdr->DigestCount,
+                                 b->agile_events[j].digests_size)) {
+                return false;
+            }
+        }
+    }
+
+    bench_report(b, "foreach_digest2", now_seconds() - start, 0);
+    return true;
+}
+
+/* render to /dev/null by pointing stdout there for the duration */
+static bool bench_emit(bench *b, tpm2_eventlog_emitter const *emitter) {
+
+    unsigned failures = 0;
+
+    tpm2_tool_output_flush();
+    int out = dup(STDOUT_FILENO);
+    if (out < 0 || dup2(b->devnull, STDOUT_FILENO) < 0) {
+        LOG_ERR("failed to redirect output: %s", strerror(errno));
+        if (out >= 0) {
+            close(out);
+        }
+        return false;
+    }
+
+    double start = now_seconds();
+    for (unsigned i = 0; i < b->iterations; ++i) {
+        tpm2_eventlog_input in;
+        tpm2_eventlog_input_from_buffer(&in, b->log, b->size);
+        if (!tpm2_eventlog_emit(emitter, &in, b->jobs)) {
+            ++failures;
+        }
+    }
+    tpm2_tool_output_flush();
+    double secs = now_seconds() - start;
+
+    dup2(out, STDOUT_FILENO);
+    close(out);
+
+    bench_report(b, emitter->name, secs, failures);
+    return true;
+}
+
+static bool bench_run(bench *b) {
+
+    static tpm2_eventlog_emitter const *const emitters[] = {
+        &yaml_emitter,
+        &json_emitter,
+        &cbor_emitter,
+    };
+
+    if (!bench_scan(b)) {
+        return false;
+    }
+
+    tpm2_tool_output("---\n"
+                     "bench:\n"
+                     "  format: %s\n"
+                     "  bytes: %zu\n"
+                     "  parsed-bytes: %zu\n"
+                     "  events: %zu\n"
+                     "  parses: %s\n"
+                     "  iterations: %u\n"
+                     "  jobs: %u\n"
+                     "results:\n",
+                     b->agile ? "crypto-agile" : "sha1", b->size, b->parsed, b->events,
+                     b->parses ? "yes" : "no", b->iterations, b->jobs);
+
+    bench_parse(b);
+
+    /* SHA1 format logs extend from the event header, not TCG_DIGEST2 */
+    if (b->agile && !bench_replay(b)) {
+        return false;
+    }
+
+    for (size_t i = 0; i < sizeof(emitters) / sizeof(emitters[0]); ++i) {
+        if (!bench_emit(b, emitters[i])) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static void usage(void)
+{
+    printf("Usage: tpm2_eventlog_bench [options] <evtlog-file>\n"
+           "  -n, --iterations N  passes over the log per phase (default 5)\n"
+           "  -j, --jobs N        replay threads when rendering (default 1)\n");
+}
+
+int main(int argc, char *argv[])
+{
+    static const struct option long_options[] = {
+        { "iterations", required_argument, NULL, 'n' },
+        { "jobs",       required_argument, NULL, 'j' },
+        { "help",       no_argument,       NULL, 'h' },
+        { NULL,         0,                 NULL, 0   },
+    };
+    bench b = {
+        .iterations = 5,
+        .jobs = 1,
+    };
+    tpm2_eventlog_input in;
+    int c;
+
+    while ((c = getopt_long(argc, argv, "n:j:h", long_options, NULL)) != -1) {
+        switch (c) {
+        case 'n':
+            if (!tpm2_util_string_to_uint32(optarg, &b.iterations) ||
+                b.iterations == 0) {
+                LOG_ERR("invalid iteration count: %s", optarg);
+                return 1;
+            }
+            break;
+        case 'j':
+            if (!tpm2_util_string_to_uint32(optarg, &b.jobs) || b.jobs == 0) {
+                LOG_ERR("invalid job count: %s", optarg);
+                return 1;
+            }
+            break;
+        default:
+            usage();
+            return 1;
+        }
+    }
+
+    if (optind >= argc) {
+        usage();
+        return 1;
+    }
+
+    b.devnull = open("/dev/null", O_WRONLY);
+    if (b.devnull < 0) {
+        LOG_ERR("failed to open /dev/null: %s", strerror(errno));
+        return 1;
+    }
+
+    if (!tpm2_openssl_hash_cache_init()) {
+        close(b.devnull);
+        return 1;
+    }
+
+    int r = 1;
+    if (tpm2_eventlog_input_open(&in, argv[optind], false)) {
+        if (!in.mapped) {
+            LOG_ERR("the log must be a regular file");
+        } else {
+            b.log = in.buf;
+            b.size = in.buf_size;
+            r = bench_run(&b) ? 0 : 1;
+        }
+        tpm2_eventlog_input_close(&in);
+    }
+
+    tpm2_tool_output_flush();
+
+    free(b.agile_events);
+    tpm2_openssl_hash_cache_teardown();
+    close(b.devnull);
+
+    return r;
+}
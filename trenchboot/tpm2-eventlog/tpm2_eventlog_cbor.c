@@ -0,0 +1,134 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+#include <string.h>
+
+#include "tpm2_eventlog_doc.h"
+#include "tpm2_tool_output.h"
+
+/* RFC 8949 major types */
+#define CBOR_UINT        0
+#define CBOR_BYTES       2
+#define CBOR_TEXT        3
+#define CBOR_ARRAY       4
+#define CBOR_MAP         5
+
+/* indefinite length container and its terminator */
+#define CBOR_INDEFINITE  31
+#define CBOR_BREAK       0xff
+
+/* write a major type with its argument in the shortest encoding */
+static void cbor_head(unsigned major, uint64_t value) {
+
+    uint8_t buf[9];
+    size_t len;
+
+    buf[0] = major << 5;
+    if (value < 24) {
+        buf[0] |= value;
+        len = 1;
+    } else if (value <= UINT8_MAX) {
+        buf[0] |= 24;
+        len = 2;
+    } else if (value <= UINT16_MAX) {
+        buf[0] |= 25;
+        len = 3;
+    } else if (value <= UINT32_MAX) {
+        buf[0] |= 26;
+        len = 5;
+    } else {
+        buf[0] |= 27;
+        len = 9;
+    }
+
+    for (size_t i = len - 1; i > 0; --i, value >>= 8) {
+        buf[i] = value & 0xff;
+    }
+
+    tpm2_tool_output_write(buf, len);
+}
+
+static void cbor_open(unsigned major) {
+
+    uint8_t b = (major << 5) | CBOR_INDEFINITE;
+    tpm2_tool_output_write(&b, 1);
+}
+
+static void cbor_close(void) {
+
+    uint8_t b = CBOR_BREAK;
+    tpm2_tool_output_write(&b, 1);
+}
+
+/* containers are streamed, their element counts are not known up front */
+static void cbor_map_begin(tpm2_eventlog_doc *doc) {
+    (void)doc;
+    cbor_open(CBOR_MAP);
+}
+
+static void cbor_map_end(tpm2_eventlog_doc *doc) {
+    (void)doc;
+    cbor_close();
+}
+
+static void cbor_list_begin(tpm2_eventlog_doc *doc) {
+    (void)doc;
+    cbor_open(CBOR_ARRAY);
+}
+
+static void cbor_list_end(tpm2_eventlog_doc *doc) {
+    (void)doc;
+    cbor_close();
+}
+
+static void cbor_text(char const *str, size_t len) {
+
+    cbor_head(CBOR_TEXT, len);
+    tpm2_tool_output_write(str, len);
+}
+
+static void cbor_bytes(tpm2_eventlog_doc *doc, uint8_t const *buf, size_t size) {
+
+    (void)doc;
+    cbor_head(CBOR_BYTES, size);
+    tpm2_tool_output_write(buf, size);
+}
+
+/* a text string must hold UTF-8, anything else is a byte string */
+static void cbor_string(tpm2_eventlog_doc *doc, char const *str, size_t len) {
+
+    if (!tpm2_eventlog_doc_utf8(str, len)) {
+        cbor_bytes(doc, (uint8_t const *)str, len);
+        return;
+    }
+
+    cbor_text(str, len);
+}
+
+/* keys are the renderer's own names */
+static void cbor_key(tpm2_eventlog_doc *doc, char const *key) {
+
+    (void)doc;
+    cbor_text(key, strlen(key));
+}
+
+static void cbor_uint(tpm2_eventlog_doc *doc, uint64_t value) {
+
+    (void)doc;
+    cbor_head(CBOR_UINT, value);
+}
+
+static void cbor_finish(tpm2_eventlog_doc *doc) {
+
+    (void)doc;
+}
+
+tpm2_eventlog_doc_ops const tpm2_eventlog_cbor_ops = {
+    .map_begin = cbor_map_begin,
+    .map_end = cbor_map_end,
+    .list_begin = cbor_list_begin,
+    .list_end = cbor_list_end,
+    .key = cbor_key,
+    .string = cbor_string,
+    .uint = cbor_uint,
+    .bytes = cbor_bytes,
+    .finish = cbor_finish,
+};
@@ -0,0 +1,409 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+#include <stdio.h>
+#include <string.h>
+
+#include "log.h"
+#include "tpm2_alg_util.h"
+#include "tpm2_eventlog_doc.h"
+#include "tpm2_eventlog_emitter.h"
+#include "tpm2_eventlog_yaml.h"
+
+/*
+ * Well formed UTF-8 as RFC 3629 has it: no overlong forms, surrogates or
+ * code points past U+10FFFF.
+ */
+bool tpm2_eventlog_doc_utf8(char const *str, size_t len) {
+
+    unsigned char const *s = (unsigned char const *)str;
+    size_t i = 0;
+
+    while (i < len) {
+        unsigned char c = s[i];
+        uint32_t cp, min;
+        size_t n;
+
+        if (c < 0x80) {
+            ++i;
+            continue;
+        }
+
+        if (c >= 0xc2 && c <= 0xdf) {
+            n = 1;
+            cp = c & 0x1f;
+            min = 0x80;
+        } else if ((c & 0xf0) == 0xe0) {
+            n = 2;
+            cp = c & 0x0f;
+            min = 0x800;
+        } else if (c >= 0xf0 && c <= 0xf4) {
+            n = 3;
+            cp = c & 0x07;
+            min = 0x10000;
+        } else {
+            return false;
+        }
+
+        if (len - i <= n) {
+            return false;
+        }
+
+        for (size_t k = 1; k <= n; ++k) {
+            if ((s[i + k] & 0xc0) != 0x80) {
+                return false;
+            }
+            cp = cp << 6 | (s[i + k] & 0x3f);
+        }
+
+        if (cp < min || cp > 0x10ffff || (cp >= 0xd800 && cp <= 0xdfff)) {
+            return false;
+        }
+        i += n + 1;
+    }
+
+    return true;
+}
+
+static void doc_key_string(tpm2_eventlog_doc *doc, char const *key,
+                           char const *str) {
+
+    doc->ops->key(doc, key);
+    doc->ops->string(doc, str, strlen(str));
+}
+
+static void doc_key_uint(tpm2_eventlog_doc *doc, char const *key,
+                         uint64_t value) {
+
+    doc->ops->key(doc, key);
+    doc->ops->uint(doc, value);
+}
+
+static void doc_key_bytes(tpm2_eventlog_doc *doc, char const *key,
+                          uint8_t const *buf, size_t size) {
+
+    doc->ops->key(doc, key);
+    doc->ops->bytes(doc, buf, size);
+}
+
+static void doc_digest(tpm2_eventlog_doc *doc, TPMI_ALG_HASH alg,
+                       uint8_t const *digest, size_t size) {
+
+    doc->ops->map_begin(doc);
+    doc_key_string(doc, "AlgorithmId",
+                   tpm2_alg_util_algtostr(alg, tpm2_alg_util_flags_hash));
+    doc_key_bytes(doc, "Digest", digest, size);
+    doc->ops->map_end(doc);
+}
+
+static bool doc_digest2_callback(TCG_DIGEST2 const *digest, size_t size,
+                                 void *data) {
+
+    tpm2_eventlog_doc *doc = data;
+
+    if (size > TPM2_MAX_DIGEST_BUFFER) {
+        size = TPM2_MAX_DIGEST_BUFFER;
+    }
+
+    doc_digest(doc, digest->AlgorithmId, digest->Digest, size);
+    return true;
+}
+
+/*
+ * Opens the event map and its Digests list, which stays open for the digest
+ * callbacks until the event data callback closes it.
+ */
+static bool doc_event2hdr_callback(TCG_EVENT_HEADER2 const *eventhdr,
+                                   size_t size, void *data) {
+
+    tpm2_eventlog_doc *doc = data;
+
+    (void)size;
+
+    doc->ops->map_begin(doc);
+    doc_key_uint(doc, "EventNum", doc->count++);
+    doc_key_uint(doc, "PCRIndex", eventhdr->PCRIndex);
+    doc_key_string(doc, "EventType", eventtype_to_string(eventhdr->EventType));
+    doc_key_uint(doc, "DigestCount", eventhdr->DigestCount);
+    doc->ops->key(doc, "Digests");
+    doc->ops->list_begin(doc);
+    doc->digests_open = true;
+
+    return true;
+}
+
+static bool doc_sha1_log_eventhdr_callback(TCG_EVENT const *eventhdr,
+                                           size_t size, void *data) {
+
+    tpm2_eventlog_doc *doc = data;
+
+    (void)size;
+
+    doc->ops->map_begin(doc);
+    doc_key_uint(doc, "EventNum", doc->count++);
+    doc_key_uint(doc, "PCRIndex", eventhdr->pcrIndex);
+    doc_key_string(doc, "EventType", eventtype_to_string(eventhdr->eventType));
+    doc_key_uint(doc, "DigestCount", 1);
+    doc->ops->key(doc, "Digests");
+    doc->ops->list_begin(doc);
+    doc_digest(doc, TPM2_ALG_SHA1, eventhdr->digest, sizeof(eventhdr->digest));
+    doc->ops->list_end(doc);
+
+    return true;
+}
+
+/* TCG PC Client FPF section 9.2.6 */
+static bool doc_uefi_var(tpm2_eventlog_doc *doc, UEFI_VARIABLE_DATA *data) {
+
+    char uuidstr[37] = { 0 };
+
+    uuid_unparse_lower(data->VariableName, uuidstr);
+
+    char *name = uefi_var_unicodename_str(data);
+    if (name == NULL) {
+        return false;
+    }
+
+    doc->ops->map_begin(doc);
+    doc_key_string(doc, "VariableName", uuidstr);
+    doc_key_uint(doc, "UnicodeNameLength", data->UnicodeNameLength);
+    doc_key_uint(doc, "VariableDataLength", data->VariableDataLength);
+    doc_key_string(doc, "UnicodeName", name);
+    if (data->VariableDataLength != 0) {
+        doc_key_bytes(doc, "VariableData",
+                      (uint8_t *)&data->UnicodeName[data->UnicodeNameLength],
+                      data->VariableDataLength);
+    }
+    doc->ops->map_end(doc);
+
+    free(name);
+    return true;
+}
+
+/* TCG PC Client FPF section 9.2.5 */
+static void doc_uefi_platfwblob(tpm2_eventlog_doc *doc,
+                                UEFI_PLATFORM_FIRMWARE_BLOB *data) {
+
+    doc->ops->map_begin(doc);
+    doc_key_uint(doc, "BlobBase", data->BlobBase);
+    doc_key_uint(doc, "BlobLength", data->BlobLength);
+    doc->ops->map_end(doc);
+}
+
+/* TCG PC Client PFP section 9.2.3 */
+static void doc_uefi_image_load(tpm2_eventlog_doc *doc,
+                                UEFI_IMAGE_LOAD_EVENT *data, size_t size) {
+
+    doc->ops->map_begin(doc);
+    doc_key_uint(doc, "ImageLocationInMemory", data->ImageLocationInMemory);
+    doc_key_uint(doc, "ImageLengthInMemory", data->ImageLengthInMemory);
+    doc_key_uint(doc, "ImageLinkTimeAddress", data->ImageLinkTimeAddress);
+    doc_key_uint(doc, "LengthOfDevicePath", data->LengthOfDevicePath);
+    doc_key_bytes(doc, "DevicePath", data->DevicePath, size - sizeof(*data));
+    doc->ops->map_end(doc);
+}
+
+static bool doc_event2data(tpm2_eventlog_doc *doc, TCG_EVENT2 const *event,
+                           UINT32 type) {
+
+    doc_key_uint(doc, "EventSize", event->EventSize);
+
+    if (event->EventSize == 0) {
+        return true;
+    }
+
+    doc->ops->key(doc, "Event");
+
+    switch (type) {
+    case EV_EFI_VARIABLE_DRIVER_CONFIG:
+    case EV_EFI_VARIABLE_BOOT:
+    case EV_EFI_VARIABLE_AUTHORITY:
+        return doc_uefi_var(doc, (UEFI_VARIABLE_DATA*)event->Event);
+    case EV_POST_CODE:
+    case EV_EFI_ACTION:
+        doc->ops->string(doc, (char const *)event->Event, event->EventSize);
+        return true;
+    case EV_S_CRTM_CONTENTS:
+    case EV_EFI_PLATFORM_FIRMWARE_BLOB:
+        doc_uefi_platfwblob(doc, (UEFI_PLATFORM_FIRMWARE_BLOB*)event->Event);
+        return true;
+    case EV_EFI_BOOT_SERVICES_APPLICATION:
+    case EV_EFI_BOOT_SERVICES_DRIVER:
+    case EV_EFI_RUNTIME_SERVICES_DRIVER:
+        doc_uefi_image_load(doc, (UEFI_IMAGE_LOAD_EVENT*)event->Event,
+                            event->EventSize);
+        return true;
+    default:
+        doc->ops->bytes(doc, event->Event, event->EventSize < EVENT_DATA_MAX ?
+                        event->EventSize : EVENT_DATA_MAX);
+        return true;
+    }
+}
+
+/* closes what the header callbacks opened */
+static bool doc_event2data_callback(TCG_EVENT2 const *event, UINT32 type,
+                                    void *data) {
+
+    tpm2_eventlog_doc *doc = data;
+
+    if (doc->digests_open) {
+        doc->ops->list_end(doc);
+        doc->digests_open = false;
+    }
+
+    if (!doc_event2data(doc, event, type)) {
+        return false;
+    }
+
+    doc->ops->map_end(doc);
+    return true;
+}
+
+static bool doc_specid_callback(TCG_EVENT const *event, void *data) {
+
+    tpm2_eventlog_doc *doc = data;
+    TCG_SPECID_EVENT *specid = (TCG_SPECID_EVENT*)event->event;
+    TCG_SPECID_ALG *alg = (TCG_SPECID_ALG*)specid->digestSizes;
+    TCG_VENDOR_INFO *vendor = (TCG_VENDOR_INFO*)(alg + specid->numberOfAlgorithms);
+
+    doc->ops->map_begin(doc);
+    doc_key_uint(doc, "EventNum", doc->count++);
+    doc_key_uint(doc, "PCRIndex", event->pcrIndex);
+    doc_key_string(doc, "EventType", eventtype_to_string(event->eventType));
+    doc_key_bytes(doc, "Digest", event->digest, sizeof(event->digest));
+    doc_key_uint(doc, "EventSize", event->eventDataSize);
+
+    /* 'Signature' defined as byte buf, spec treats it like string w/o null. */
+    doc->ops->key(doc, "SpecID");
+    doc->ops->map_begin(doc);
+    doc->ops->key(doc, "Signature");
+    doc->ops->string(doc, (char const *)specid->Signature,
+                     strnlen((char const *)specid->Signature,
+                             sizeof(specid->Signature)));
+    doc_key_uint(doc, "platformClass", specid->platformClass);
+    doc_key_uint(doc, "specVersionMinor", specid->specVersionMinor);
+    doc_key_uint(doc, "specVersionMajor", specid->specVersionMajor);
+    doc_key_uint(doc, "specErrata", specid->specErrata);
+    doc_key_uint(doc, "uintnSize", specid->uintnSize);
+    doc_key_uint(doc, "numberOfAlgorithms", specid->numberOfAlgorithms);
+
+    doc->ops->key(doc, "Algorithms");
+    doc->ops->list_begin(doc);
+    for (UINT32 i = 0; i < specid->numberOfAlgorithms; ++i, ++alg) {
+        doc->ops->map_begin(doc);
+        doc_key_string(doc, "algorithmId",
+                       tpm2_alg_util_algtostr(alg->algorithmId,
+                                              tpm2_alg_util_flags_hash));
+        doc_key_uint(doc, "digestSize", alg->digestSize);
+        doc->ops->map_end(doc);
+    }
+    doc->ops->list_end(doc);
+
+    doc_key_uint(doc, "vendorInfoSize", vendor->vendorInfoSize);
+    if (vendor->vendorInfoSize != 0) {
+        doc_key_bytes(doc, "vendorInfo", vendor->vendorInfo,
+                      vendor->vendorInfoSize);
+    }
+    doc->ops->map_end(doc);
+
+    doc->ops->map_end(doc);
+    return true;
+}
+
+static void doc_pcrs(tpm2_eventlog_doc *doc, tpm2_eventlog_context *ctx) {
+
+    char index[4];
+
+    doc->ops->key(doc, "pcrs");
+    doc->ops->map_begin(doc);
+
+    for (unsigned b = 0; b < TPM2_EVENTLOG_BANK_COUNT; b++) {
+        tpm2_eventlog_bank const *bank = &tpm2_eventlog_banks[b];
+        uint32_t used = *tpm2_eventlog_bank_used(ctx, bank);
+        if (used == 0) {
+            continue;
+        }
+
+        doc->ops->key(doc, bank->name);
+        doc->ops->map_begin(doc);
+        for (unsigned i = 0; i < TPM2_MAX_PCRS; i++) {
+            if ((used & (1 << i)) == 0) {
+                continue;
+            }
+            snprintf(index, sizeof(index), "%u", i);
+            doc_key_bytes(doc, index, tpm2_eventlog_bank_pcr(ctx, bank, i),
+                          bank->digest_size);
+        }
+        doc->ops->map_end(doc);
+    }
+
+    doc->ops->map_end(doc);
+}
+
+static bool doc_begin(tpm2_eventlog_context *ctx,
+                      tpm2_eventlog_doc_ops const *ops) {
+
+    tpm2_eventlog_doc *doc = calloc(1, sizeof(*doc));
+    if (doc == NULL) {
+        LOG_ERR("oom");
+        return false;
+    }
+    doc->ops = ops;
+    doc->first[0] = true;
+
+    *ctx = (tpm2_eventlog_context) {
+        .data = doc,
+        .specid_cb = doc_specid_callback,
+        .event2hdr_cb = doc_event2hdr_callback,
+        .log_eventhdr_cb = doc_sha1_log_eventhdr_callback,
+        .digest2_cb = doc_digest2_callback,
+        .event2_cb = doc_event2data_callback,
+    };
+
+    doc->ops->map_begin(doc);
+    doc->ops->key(doc, "events");
+    doc->ops->list_begin(doc);
+    return true;
+}
+
+/* a failed walk leaves the document truncated, as the YAML output does */
+static bool doc_end(tpm2_eventlog_context *ctx, bool ok) {
+
+    tpm2_eventlog_doc *doc = ctx->data;
+
+    if (ok) {
+        doc->ops->list_end(doc);
+        doc_pcrs(doc, ctx);
+        doc->ops->map_end(doc);
+        doc->ops->finish(doc);
+    }
+
+    free(doc);
+    return true;
+}
+
+static void doc_set_event_num(void *data, size_t event_num) {
+
+    tpm2_eventlog_doc *doc = data;
+    doc->count = event_num;
+}
+
+static bool json_begin(tpm2_eventlog_context *ctx) {
+    return doc_begin(ctx, &tpm2_eventlog_json_ops);
+}
+
+static bool cbor_begin(tpm2_eventlog_context *ctx) {
+    return doc_begin(ctx, &tpm2_eventlog_cbor_ops);
+}
+
+tpm2_eventlog_emitter const json_emitter = {
+    .name = "json",
+    .begin = json_begin,
+    .end = doc_end,
+    .set_event_num = doc_set_event_num,
+};
+
+tpm2_eventlog_emitter const cbor_emitter = {
+    .name = "cbor",
+    .begin = cbor_begin,
+    .end = doc_end,
+    .set_event_num = doc_set_event_num,
+};
@@ -0,0 +1,50 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+#ifndef TPM2_EVENTLOG_DOC_H
+#define TPM2_EVENTLOG_DOC_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "tpm2_eventlog.h"
+
+#define TPM2_EVENTLOG_DOC_DEPTH_MAX 16
+
+typedef struct tpm2_eventlog_doc tpm2_eventlog_doc;
+
+/*
+ * Structured document writer. The event log is rendered once into nested
+ * maps, lists and scalars in tpm2_eventlog_doc.c, and each serialization
+ * (JSON, CBOR) only implements these primitives. Strings come straight
+ * from the log, so string must check them with tpm2_eventlog_doc_utf8 and
+ * write what is not UTF-8 the way bytes would.
+ */
+typedef struct {
+    void (*map_begin)(tpm2_eventlog_doc *doc);
+    void (*map_end)(tpm2_eventlog_doc *doc);
+    void (*list_begin)(tpm2_eventlog_doc *doc);
+    void (*list_end)(tpm2_eventlog_doc *doc);
+    void (*key)(tpm2_eventlog_doc *doc, char const *key);
+    void (*string)(tpm2_eventlog_doc *doc, char const *str, size_t len);
+    void (*uint)(tpm2_eventlog_doc *doc, uint64_t value);
+    void (*bytes)(tpm2_eventlog_doc *doc, uint8_t const *buf, size_t size);
+    void (*finish)(tpm2_eventlog_doc *doc);
+} tpm2_eventlog_doc_ops;
+
+struct tpm2_eventlog_doc {
+    tpm2_eventlog_doc_ops const *ops;
+    /* writer state */
+    unsigned depth;
+    bool first[TPM2_EVENTLOG_DOC_DEPTH_MAX];
+    bool after_key;
+    /* renderer state */
+    size_t count;
+    bool digests_open;
+};
+
+bool tpm2_eventlog_doc_utf8(char const *str, size_t len);
+
+extern tpm2_eventlog_doc_ops const tpm2_eventlog_json_ops;
+extern tpm2_eventlog_doc_ops const tpm2_eventlog_cbor_ops;
+
+#endif
@@ -0,0 +1,47 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+#include <string.h>
+
+#include "log.h"
+#include "tpm2_eventlog_emitter.h"
+#include "tpm2_eventlog_replay.h"
+
+static tpm2_eventlog_emitter const *emitters[] = {
+    &yaml_emitter,
+    &json_emitter,
+    &cbor_emitter,
+};
+
+tpm2_eventlog_emitter const *tpm2_eventlog_emitter_find(char const *name) {
+
+    for (size_t i = 0; i < ARRAY_LEN(emitters); ++i) {
+        if (!strcmp(emitters[i]->name, name)) {
+            return emitters[i];
+        }
+    }
+
+    return NULL;
+}
+
+bool tpm2_eventlog_emit(tpm2_eventlog_emitter const *emitter,
+                        tpm2_eventlog_input *in, unsigned jobs) {
+
+    tpm2_eventlog_context ctx = { 0 };
+
+    if (!emitter->begin(&ctx)) {
+        return false;
+    }
+
+    if (jobs > 1) {
+        ctx.replay = tpm2_eventlog_replay_new(&ctx, jobs);
+        if (!ctx.replay) {
+            emitter->end(&ctx, false);
+            return false;
+        }
+    }
+
+    bool rc = parse_eventlog_input(&ctx, in);
+    tpm2_eventlog_replay_free(ctx.replay);
+    ctx.replay = NULL;
+
+    return emitter->end(&ctx, rc) && rc;
+}
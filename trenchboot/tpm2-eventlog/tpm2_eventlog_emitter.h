@@ -0,0 +1,45 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+#ifndef TPM2_EVENTLOG_EMITTER_H
+#define TPM2_EVENTLOG_EMITTER_H
+
+#include <stdbool.h>
+
+#include "tpm2_eventlog.h"
+#include "tpm2_eventlog_input.h"
+
+/*
+ * An output format for tpm2_eventlog. begin installs the format's callbacks
+ * and state into a zeroed context before the log is walked, end emits the
+ * trailer (including the replayed PCR values when the walk succeeded) and
+ * releases that state. The walk itself is shared by all formats.
+ * set_event_num renumbers the next event for callers that only walk part
+ * of the log; data is the ctx->data installed by begin.
+ */
+typedef struct {
+    char const *name;
+    bool (*begin)(tpm2_eventlog_context *ctx);
+    bool (*end)(tpm2_eventlog_context *ctx, bool ok);
+    void (*set_event_num)(void *data, size_t event_num);
+} tpm2_eventlog_emitter;
+
+extern tpm2_eventlog_emitter const yaml_emitter;
+extern tpm2_eventlog_emitter const json_emitter;
+extern tpm2_eventlog_emitter const cbor_emitter;
+
+/**
+ * Look up an output format by name.
+ * @return
+ *  The emitter or NULL if name is unknown.
+ */
+tpm2_eventlog_emitter const *tpm2_eventlog_emitter_find(char const *name);
+
+/**
+ * Walk the log from in, replaying on jobs threads, and render it with
+ * emitter.
+ * @return
+ *  true on success, false on error.
+ */
+bool tpm2_eventlog_emit(tpm2_eventlog_emitter const *emitter,
+                        tpm2_eventlog_input *in, unsigned jobs);
+
+#endif
@@ -0,0 +1,447 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/*
+ * Generate synthetic TCG event logs, crypto agile or SHA1 format, for
+ * exercising and benchmarking tpm2_eventlog. Output is reproducible for a
+ * given seed.
+ */
+#include <errno.h>
+#include <getopt.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <uchar.h>
+
+#include <openssl/evp.h>
+
+#include "tss2_tpm2_types.h"
+
+#include "efi_event.h"
+#include "log.h"
+
+/* cap on a single generated event data size */
+#define GEN_DATA_MAX (1024 * 1024)
+
+typedef struct {
+    char const *name;
+    char const *md;     /* OpenSSL digest name */
+    TPM2_ALG_ID alg;
+    UINT16 size;
+} gen_bank;
+
+static gen_bank const gen_banks[] = {
+    { "sha1",    "SHA1",   TPM2_ALG_SHA1,    TPM2_SHA1_DIGEST_SIZE },
+    { "sha256",  "SHA256", TPM2_ALG_SHA256,  TPM2_SHA256_DIGEST_SIZE },
+    { "sha384",  "SHA384", TPM2_ALG_SHA384,  TPM2_SHA384_DIGEST_SIZE },
+    { "sha512",  "SHA512", TPM2_ALG_SHA512,  TPM2_SHA512_DIGEST_SIZE },
+    { "sm3_256", "SM3",    TPM2_ALG_SM3_256, TPM2_SM3_256_DIGEST_SIZE },
+};
+
+#define GEN_BANK_COUNT (sizeof(gen_banks) / sizeof(gen_banks[0]))
+
+typedef enum {
+    GEN_SIZE_FIXED,
+    GEN_SIZE_UNIFORM,
+    GEN_SIZE_EXP,
+} gen_size_dist;
+
+typedef struct {
+    unsigned long events;
+    bool agile;
+    gen_bank const *banks[GEN_BANK_COUNT];
+    EVP_MD const *mds[GEN_BANK_COUNT];
+    size_t bank_count;
+    gen_size_dist dist;
+    size_t size_a;      /* fixed size, uniform min or exponential mean */
+    size_t size_b;      /* uniform max */
+    double malformed;   /* ratio of records to corrupt */
+    uint64_t rng;
+    FILE *out;
+} gen;
+
+static UINT32 const gen_types[] = {
+    EV_POST_CODE,
+    EV_IPL,
+    EV_SEPARATOR,
+    EV_EFI_ACTION,
+    EV_EFI_VARIABLE_BOOT,
+};
+
+#define GEN_TYPE_COUNT (sizeof(gen_types) / sizeof(gen_types[0]))
+
+/* xorshift64*, good enough for sizes and filler and cheap */
+static uint64_t gen_rand(gen *g) {
+
+    g->rng ^= g->rng >> 12;
+    g->rng ^= g->rng << 25;
+    g->rng ^= g->rng >> 27;
+    return g->rng * 2685821657736338717ULL;
+}
+
+static double gen_rand_unit(gen *g) {
+
+    return (gen_rand(g) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static size_t gen_data_size(gen *g) {
+
+    size_t size;
+
+    switch (g->dist) {
+    case GEN_SIZE_UNIFORM:
+        size = g->size_a + gen_rand(g) % (g->size_b - g->size_a + 1);
+        break;
+    case GEN_SIZE_EXP: {
+        double u = gen_rand_unit(g);
+        size = (size_t)(-(double)g->size_a * log1p(-u));
+        break;
+    }
+    default:
+        size = g->size_a;
+        break;
+    }
+
+    return size > GEN_DATA_MAX ? GEN_DATA_MAX : size;
+}
+
+static void gen_fill(gen *g, BYTE *buf, size_t size, bool printable) {
+
+    for (size_t i = 0; i < size; ++i) {
+        BYTE b = gen_rand(g) >> 56;
+        buf[i] = printable ? ' ' + b % 95 : b;
+    }
+}
+
+/* event data of a type the parser accepts, roughly size bytes */
+static size_t gen_event_data(gen *g, UINT32 type, BYTE *buf, size_t size) {
+
+    switch (type) {
+    case EV_SEPARATOR:
+        memset(buf, 0, 4);
+        return 4;
+    case EV_POST_CODE:
+    case EV_EFI_ACTION:
+        gen_fill(g, buf, size, true);
+        return size;
+    case EV_EFI_VARIABLE_BOOT: {
+        static char16_t const name[] = u"Boot0000";
+        size_t name_len = sizeof(name) / sizeof(name[0]) - 1;
+        UEFI_VARIABLE_DATA *var = (UEFI_VARIABLE_DATA *)buf;
+
+        gen_fill(g, var->VariableName, sizeof(var->VariableName), false);
+        var->UnicodeNameLength = name_len;
+        var->VariableDataLength = size;
+        memcpy(var->UnicodeName, name, name_len * sizeof(char16_t));
+        gen_fill(g, (BYTE *)&var->UnicodeName[name_len], size, false);
+        return sizeof(*var) + name_len * sizeof(char16_t) + size;
+    }
+    default:
+        gen_fill(g, buf, size, false);
+        return size;
+    }
+}
+
+static void gen_digest(gen *g, size_t bank, BYTE const *data, size_t size,
+                       BYTE *digest) {
+
+    if (g->mds[bank] == NULL ||
+        !EVP_Digest(data, size, digest, NULL, g->mds[bank], NULL)) {
+        /* no implementation of the algorithm, any bytes will do */
+        gen_fill(g, digest, g->banks[bank]->size, false);
+    }
+}
+
+static bool gen_write(gen *g, void const *buf, size_t size) {
+
+    if (fwrite(buf, 1, size, g->out) != size) {
+        LOG_ERR("write failed: %s", strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+static bool gen_specid(gen *g) {
+
+    BYTE buf[sizeof(TCG_EVENT) + sizeof(TCG_SPECID_EVENT) +
+             GEN_BANK_COUNT * sizeof(TCG_SPECID_ALG) + sizeof(TCG_VENDOR_INFO)];
+    TCG_EVENT *event = (TCG_EVENT *)buf;
+    TCG_SPECID_EVENT *specid = (TCG_SPECID_EVENT *)event->event;
+
+    memset(buf, 0, sizeof(buf));
+    event->eventType = EV_NO_ACTION;
+    event->eventDataSize = sizeof(*specid) +
+                           g->bank_count * sizeof(TCG_SPECID_ALG) +
+                           sizeof(TCG_VENDOR_INFO);
+
+    memcpy(specid->Signature, "Spec ID Event03", 16);
+    specid->specVersionMajor = 2;
+    specid->uintnSize = 2;
+    specid->numberOfAlgorithms = g->bank_count;
+    for (size_t i = 0; i < g->bank_count; ++i) {
+        specid->digestSizes[i].algorithmId = g->banks[i]->alg;
+        specid->digestSizes[i].digestSize = g->banks[i]->size;
+    }
+    /* vendorInfoSize is the zeroed byte after the algorithms */
+
+    return gen_write(g, buf, sizeof(*event) + event->eventDataSize);
+}
+
+/*
+ * Write one record, corrupting it if malformed: a PCR index out of range,
+ * an event size running past the end of the log or, for agile logs, a
+ * digest count larger than the digests present.
+ */
+static bool gen_event(gen *g, BYTE *hdr, BYTE *data, bool malformed) {
+
+    UINT32 type = gen_types[gen_rand(g) % GEN_TYPE_COUNT];
+    UINT32 pcr = gen_rand(g) % TPM2_MAX_PCRS;
+    size_t size = gen_event_data(g, type, data, gen_data_size(g));
+    UINT32 event_size = size;
+    UINT32 count = g->bank_count;
+    unsigned kind = malformed ? 1 + gen_rand(g) % (g->agile ? 3 : 2) : 0;
+
+    if (kind == 1) {
+        pcr = TPM2_MAX_PCRS + gen_rand(g) % 1000;
+    } else if (kind == 2) {
+        event_size = UINT32_MAX - (UINT32)(gen_rand(g) % 1000);
+    } else if (kind == 3) {
+        count += 1 + gen_rand(g) % 8;
+    }
+
+    if (!g->agile) {
+        TCG_EVENT *event = (TCG_EVENT *)hdr;
+
+        event->pcrIndex = pcr;
+        event->eventType = type;
+        gen_digest(g, 0, data, size, event->digest);
+        event->eventDataSize = event_size;
+        return gen_write(g, hdr, sizeof(*event)) && gen_write(g, data, size);
+    }
+
+    TCG_EVENT_HEADER2 *event = (TCG_EVENT_HEADER2 *)hdr;
+    BYTE *p = (BYTE *)event->Digests;
+
+    event->PCRIndex = pcr;
+    event->EventType = type;
+    event->DigestCount = count;
+    for (size_t i = 0; i < g->bank_count; ++i) {
+        TCG_DIGEST2 *digest = (TCG_DIGEST2 *)p;
+        digest->AlgorithmId = g->banks[i]->alg;
+        gen_digest(g, i, data, size, digest->Digest);
+        p += sizeof(*digest) + g->banks[i]->size;
+    }
+    memcpy(p, &event_size, sizeof(event_size));
+    p += sizeof(event_size);
+
+    return gen_write(g, hdr, p - hdr) && gen_write(g, data, size);
+}
+
+static bool gen_log(gen *g) {
+
+    size_t hdr_size = sizeof(TCG_EVENT_HEADER2) + sizeof(TCG_EVENT2) +
+                      g->bank_count * (sizeof(TCG_DIGEST2) +
+                                       TPM2_SHA512_DIGEST_SIZE);
+    BYTE *hdr = calloc(1, hdr_size);
+    BYTE *data = malloc(sizeof(UEFI_VARIABLE_DATA) + 64 + GEN_DATA_MAX);
+    bool ret = hdr && data;
+
+    if (!ret) {
+        LOG_ERR("oom");
+    }
+
+    if (ret && g->agile) {
+        ret = gen_specid(g);
+    }
+
+    for (unsigned long i = 0; ret && i < g->events; ++i) {
+        bool malformed = g->malformed > 0 && gen_rand_unit(g) < g->malformed;
+        ret = gen_event(g, hdr, data, malformed);
+    }
+
+    free(hdr);
+    free(data);
+    return ret;
+}
+
+static bool parse_banks(gen *g, char *list) {
+
+    g->bank_count = 0;
+
+    for (char *name = strtok(list, ","); name; name = strtok(NULL, ",")) {
+        size_t i;
+        for (i = 0; i < GEN_BANK_COUNT; ++i) {
+            if (!strcmp(name, gen_banks[i].name)) {
+                break;
+            }
+        }
+        if (i == GEN_BANK_COUNT) {
+            LOG_ERR("unknown bank: %s", name);
+            return false;
+        }
+        if (g->bank_count == GEN_BANK_COUNT) {
+            LOG_ERR("too many banks");
+            return false;
+        }
+        g->banks[g->bank_count++] = &gen_banks[i];
+    }
+
+    if (g->bank_count == 0) {
+        LOG_ERR("no banks given");
+        return false;
+    }
+
+    return true;
+}
+
+/* N, MIN:MAX or exp:MEAN */
+static bool parse_size_dist(gen *g, char const *str) {
+
+    char *end;
+
+    if (!strncmp(str, "exp:", 4)) {
+        g->dist = GEN_SIZE_EXP;
+        g->size_a = strtoul(str + 4, &end, 0);
+        return end != str + 4 && *end == '\0';
+    }
+
+    g->size_a = strtoul(str, &end, 0);
+    if (end == str) {
+        return false;
+    }
+    if (*end == '\0') {
+        g->dist = GEN_SIZE_FIXED;
+        return g->size_a <= GEN_DATA_MAX;
+    }
+    if (*end != ':') {
+        return false;
+    }
+
+    char const *max = end + 1;
+    g->dist = GEN_SIZE_UNIFORM;
+    g->size_b = strtoul(max, &end, 0);
+    return end != max && *end == '\0' && g->size_a <= g->size_b &&
+           g->size_b <= GEN_DATA_MAX;
+}
+
+static void usage(void)
+{
+    printf("Usage: tpm2_eventlog_gen [options]\n"
+           "  -n, --events N     number of events after the SpecID event\n"
+           "                     (default 1000)\n"
+           "  -F, --sha1         SHA1 format log instead of crypto agile\n"
+           "  -B, --banks LIST   comma separated banks of an agile log:\n"
+           "                     sha1, sha256, sha384, sha512, sm3_256\n"
+           "                     (default sha1,sha256)\n"
+           "  -d, --data-size D  event data size: N bytes, uniform MIN:MAX\n"
+           "                     or exponential exp:MEAN (default 64)\n"
+           "  -m, --malformed R  ratio of corrupted records, 0 to 1; the\n"
+           "                     parser stops at the first one (default 0)\n"
+           "  -s, --seed N       random seed (default 1)\n"
+           "  -o, --output F     write to F instead of stdout\n");
+}
+
+int main(int argc, char *argv[])
+{
+    static const struct option long_options[] = {
+        { "events",    required_argument, NULL, 'n' },
+        { "sha1",      no_argument,       NULL, 'F' },
+        { "banks",     required_argument, NULL, 'B' },
+        { "data-size", required_argument, NULL, 'd' },
+        { "malformed", required_argument, NULL, 'm' },
+        { "seed",      required_argument, NULL, 's' },
+        { "output",    required_argument, NULL, 'o' },
+        { "help",      no_argument,       NULL, 'h' },
+        { NULL,        0,                 NULL, 0   },
+    };
+    char default_banks[] = "sha1,sha256";
+    char const *output = NULL;
+    char *end;
+    gen g = {
+        .events = 1000,
+        .agile = true,
+        .dist = GEN_SIZE_FIXED,
+        .size_a = 64,
+        .rng = 1,
+    };
+    int c;
+
+    if (!parse_banks(&g, default_banks)) {
+        return 1;
+    }
+
+    while ((c = getopt_long(argc, argv, "n:FB:d:m:s:o:h", long_options, NULL)) != -1) {
+        switch (c) {
+        case 'n':
+            g.events = strtoul(optarg, &end, 0);
+            if (end == optarg || *end) {
+                LOG_ERR("invalid event count: %s", optarg);
+                return 1;
+            }
+            break;
+        case 'F':
+            g.agile = false;
+            break;
+        case 'B':
+            if (!parse_banks(&g, optarg)) {
+                return 1;
+            }
+            break;
+        case 'd':
+            if (!parse_size_dist(&g, optarg)) {
+                LOG_ERR("invalid data size: %s", optarg);
+                return 1;
+            }
+            break;
+        case 'm':
+            g.malformed = strtod(optarg, &end);
+            if (end == optarg || *end || g.malformed < 0 || g.malformed > 1) {
+                LOG_ERR("invalid malformed ratio: %s", optarg);
+                return 1;
+            }
+            break;
+        case 's':
+            g.rng = strtoull(optarg, &end, 0);
+            if (end == optarg || *end) {
+                LOG_ERR("invalid seed: %s", optarg);
+                return 1;
+            }
+            /* xorshift never leaves 0 */
+            if (g.rng == 0) {
+                g.rng = 1;
+            }
+            break;
+        case 'o':
+            output = optarg;
+            break;
+        default:
+            usage();
+            return 1;
+        }
+    }
+
+    if (!g.agile) {
+        g.banks[0] = &gen_banks[0];
+        g.bank_count = 1;
+    }
+
+    for (size_t i = 0; i < g.bank_count; ++i) {
+        g.mds[i] = EVP_get_digestbyname(g.banks[i]->md);
+    }
+
+    g.out = output ? fopen(output, "wb") : stdout;
+    if (!g.out) {
+        LOG_ERR("failed to open file: %s error: %s", output, strerror(errno));
+        return 1;
+    }
+
+    bool ret = gen_log(&g);
+    if (fflush(g.out) != 0) {
+        LOG_ERR("write failed: %s", strerror(errno));
+        ret = false;
+    }
+    if (output) {
+        fclose(g.out);
+    }
+
+    return ret ? 0 : 1;
+}
@@ -0,0 +1,504 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <openssl/evp.h>
+
+#include "log.h"
+#include "tpm2_eventlog_index.h"
+
+static bool log_sha256(tpm2_eventlog_input const *in, uint8_t *digest) {
+
+    if (!EVP_Digest(in->buf, in->buf_size, digest, NULL, EVP_sha256(), NULL)) {
+        LOG_ERR("failed to hash event log");
+        return false;
+    }
+
+    return true;
+}
+
+typedef struct {
+    tpm2_eventlog_index *index;
+    tpm2_eventlog_input *in;
+    tpm2_eventlog_context *ctx;
+} index_builder;
+
+static bool index_add_event(index_builder *b, void const *event, UINT32 pcr,
+                            UINT32 type, bool chain) {
+
+    tpm2_eventlog_index *index = b->index;
+    tpm2_eventlog_index_header *hdr = &index->hdr;
+
+    if (hdr->event_count == EVENTLOG_INDEX_NO_EVENT) {
+        LOG_ERR("too many events to index");
+        return false;
+    }
+
+    if (hdr->event_count == index->events_size) {
+        size_t size = index->events_size ? index->events_size * 2 : 1024;
+        tpm2_eventlog_index_event *events =
+            realloc(index->events, size * sizeof(*events));
+        if (events == NULL) {
+            LOG_ERR("oom");
+            return false;
+        }
+        index->events = events;
+        index->events_size = size;
+    }
+
+    uint32_t n = hdr->event_count++;
+    tpm2_eventlog_index_event *entry = &index->events[n];
+
+    entry->offset = b->in->offset +
+                    ((UINT8 const *)event - (b->in->buf + b->in->start));
+    entry->pcr = pcr;
+    entry->type = type;
+    entry->prev = EVENTLOG_INDEX_NO_EVENT;
+    entry->reserved = 0;
+
+    if (chain) {
+        entry->prev = hdr->pcr_last[pcr];
+        hdr->pcr_last[pcr] = n;
+    }
+
+    return true;
+}
+
+static bool index_specid_callback(TCG_EVENT const *event, void *data) {
+
+    index_builder *b = data;
+
+    b->index->hdr.agile = 1;
+    b->index->hdr.first_event = 1;
+    return index_add_event(b, event, event->pcrIndex, event->eventType, false);
+}
+
+static bool index_event2hdr_callback(TCG_EVENT_HEADER2 const *eventhdr,
+                                     size_t size, void *data) {
+
+    (void)size;
+    return index_add_event(data, eventhdr, eventhdr->PCRIndex,
+                           eventhdr->EventType, true);
+}
+
+static bool index_log_eventhdr_callback(TCG_EVENT const *eventhdr, size_t size,
+                                        void *data) {
+
+    (void)size;
+    return index_add_event(data, eventhdr, eventhdr->pcrIndex,
+                           eventhdr->eventType, true);
+}
+
+/* the event is fully replayed here, snapshot the state the next one sees */
+static bool index_event2_callback(TCG_EVENT2 const *event, UINT32 type,
+                                  void *data) {
+
+    index_builder *b = data;
+    tpm2_eventlog_index_header *hdr = &b->index->hdr;
+
+    (void)event;
+    (void)type;
+
+    if ((hdr->event_count - hdr->first_event) % hdr->checkpoint_interval) {
+        return true;
+    }
+
+    size_t size = tpm2_eventlog_pcrs_size();
+    uint8_t *checkpoints = realloc(b->index->checkpoints,
+                                   (hdr->checkpoint_count + 1) * size);
+    if (checkpoints == NULL) {
+        LOG_ERR("oom");
+        return false;
+    }
+    b->index->checkpoints = checkpoints;
+
+    tpm2_eventlog_pcrs_save(b->ctx,
+                            &checkpoints[hdr->checkpoint_count++ * size]);
+    return true;
+}
+
+bool tpm2_eventlog_index_build(tpm2_eventlog_index *index,
+                               tpm2_eventlog_input *in) {
+
+    if (!in->mapped) {
+        LOG_ERR("an index can only be built for a regular file");
+        return false;
+    }
+
+    memset(index, 0, sizeof(*index));
+    memcpy(index->hdr.magic, EVENTLOG_INDEX_MAGIC, sizeof(index->hdr.magic));
+    index->hdr.version = EVENTLOG_INDEX_VERSION;
+    index->hdr.log_size = in->buf_size;
+    index->hdr.checkpoint_interval = EVENTLOG_INDEX_CHECKPOINT_INTERVAL;
+    for (unsigned i = 0; i < TPM2_MAX_PCRS; i++) {
+        index->hdr.pcr_last[i] = EVENTLOG_INDEX_NO_EVENT;
+    }
+
+    if (!log_sha256(in, index->hdr.log_sha256)) {
+        return false;
+    }
+
+    tpm2_eventlog_context ctx = { 0 };
+    index_builder builder = {
+        .index = index,
+        .in = in,
+        .ctx = &ctx,
+    };
+
+    ctx.data = &builder;
+    ctx.specid_cb = index_specid_callback;
+    ctx.event2hdr_cb = index_event2hdr_callback;
+    ctx.log_eventhdr_cb = index_log_eventhdr_callback;
+    ctx.event2_cb = index_event2_callback;
+
+    if (!parse_eventlog_input(&ctx, in)) {
+        tpm2_eventlog_index_free(index);
+        return false;
+    }
+
+    return true;
+}
+
+/* reject indexes that would send queries outside the log */
+static bool index_check(tpm2_eventlog_index const *index) {
+
+    tpm2_eventlog_index_header const *hdr = &index->hdr;
+
+    for (uint32_t i = 0; i < hdr->event_count; i++) {
+        tpm2_eventlog_index_event const *entry = &index->events[i];
+        if (entry->offset >= hdr->log_size || entry->pcr >= TPM2_MAX_PCRS ||
+            (entry->prev != EVENTLOG_INDEX_NO_EVENT && entry->prev >= i)) {
+            return false;
+        }
+    }
+
+    for (unsigned i = 0; i < TPM2_MAX_PCRS; i++) {
+        if (hdr->pcr_last[i] != EVENTLOG_INDEX_NO_EVENT &&
+            hdr->pcr_last[i] >= hdr->event_count) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool tpm2_eventlog_index_load(tpm2_eventlog_index *index, char const *path,
+                              tpm2_eventlog_input const *in) {
+
+    tpm2_eventlog_index_header *hdr = &index->hdr;
+    uint8_t digest[sizeof(hdr->log_sha256)];
+
+    memset(index, 0, sizeof(*index));
+
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        return false;
+    }
+
+    if (fread(hdr, sizeof(*hdr), 1, f) != 1 ||
+        memcmp(hdr->magic, EVENTLOG_INDEX_MAGIC, sizeof(hdr->magic)) ||
+        hdr->version != EVENTLOG_INDEX_VERSION ||
+        hdr->log_size != in->buf_size ||
+        hdr->checkpoint_interval == 0 ||
+        hdr->first_event > hdr->event_count) {
+        goto stale;
+    }
+
+    size_t cp_size = tpm2_eventlog_pcrs_size();
+    index->events = calloc(hdr->event_count ? hdr->event_count : 1,
+                           sizeof(*index->events));
+    index->checkpoints = malloc(hdr->checkpoint_count ?
+                                hdr->checkpoint_count * cp_size : 1);
+    if (index->events == NULL || index->checkpoints == NULL) {
+        LOG_ERR("oom");
+        goto stale;
+    }
+    index->events_size = hdr->event_count;
+
+    if (fread(index->events, sizeof(*index->events), hdr->event_count, f) !=
+            hdr->event_count ||
+        fread(index->checkpoints, cp_size, hdr->checkpoint_count, f) !=
+            hdr->checkpoint_count ||
+        !index_check(index)) {
+        goto stale;
+    }
+
+    if (!log_sha256(in, digest) ||
+        memcmp(digest, hdr->log_sha256, sizeof(digest))) {
+        goto stale;
+    }
+
+    fclose(f);
+    return true;
+
+stale:
+    fclose(f);
+    tpm2_eventlog_index_free(index);
+    return false;
+}
+
+bool tpm2_eventlog_index_save(tpm2_eventlog_index const *index,
+                              char const *path) {
+
+    tpm2_eventlog_index_header const *hdr = &index->hdr;
+
+    FILE *f = fopen(path, "wb");
+    if (f == NULL) {
+        LOG_ERR("could not open index \"%s\": %s", path, strerror(errno));
+        return false;
+    }
+
+    bool ok = fwrite(hdr, sizeof(*hdr), 1, f) == 1 &&
+              fwrite(index->events, sizeof(*index->events), hdr->event_count,
+                     f) == hdr->event_count &&
+              fwrite(index->checkpoints, tpm2_eventlog_pcrs_size(),
+                     hdr->checkpoint_count, f) == hdr->checkpoint_count;
+
+    if (fclose(f) != 0 || !ok) {
+        LOG_ERR("could not write index \"%s\"", path);
+        return false;
+    }
+
+    return true;
+}
+
+void tpm2_eventlog_index_free(tpm2_eventlog_index *index) {
+
+    free(index->events);
+    free(index->checkpoints);
+    index->events = NULL;
+    index->events_size = 0;
+    index->checkpoints = NULL;
+}
+
+/*
+ * Query state. Every replayed event goes through these callbacks, which pass
+ * only the selected ones on to the emitter's callbacks saved in emitter_ctx.
+ */
+typedef struct {
+    tpm2_eventlog_context emitter_ctx;
+    tpm2_eventlog_emitter const *emitter;
+    tpm2_eventlog_query const *query;
+    uint32_t event_num;
+    bool emit;
+} index_filter;
+
+static bool filter_select(index_filter *f, UINT32 pcr, UINT32 type) {
+
+    tpm2_eventlog_query const *q = f->query;
+
+    f->emit = f->event_num >= q->from_event &&
+              (!q->has_pcr || pcr == q->pcr) &&
+              (!q->has_type || type == q->type);
+
+    if (f->emit) {
+        f->emitter->set_event_num(f->emitter_ctx.data, f->event_num);
+    }
+
+    return f->emit;
+}
+
+static bool filter_event2hdr_callback(TCG_EVENT_HEADER2 const *eventhdr,
+                                      size_t size, void *data) {
+
+    index_filter *f = data;
+
+    if (!filter_select(f, eventhdr->PCRIndex, eventhdr->EventType) ||
+        !f->emitter_ctx.event2hdr_cb) {
+        return true;
+    }
+
+    return f->emitter_ctx.event2hdr_cb(eventhdr, size, f->emitter_ctx.data);
+}
+
+static bool filter_log_eventhdr_callback(TCG_EVENT const *eventhdr,
+                                         size_t size, void *data) {
+
+    index_filter *f = data;
+
+    if (!filter_select(f, eventhdr->pcrIndex, eventhdr->eventType) ||
+        !f->emitter_ctx.log_eventhdr_cb) {
+        return true;
+    }
+
+    return f->emitter_ctx.log_eventhdr_cb(eventhdr, size, f->emitter_ctx.data);
+}
+
+static bool filter_digest2_callback(TCG_DIGEST2 const *digest, size_t size,
+                                    void *data) {
+
+    index_filter *f = data;
+
+    if (!f->emit || !f->emitter_ctx.digest2_cb) {
+        return true;
+    }
+
+    return f->emitter_ctx.digest2_cb(digest, size, f->emitter_ctx.data);
+}
+
+static bool filter_event2_callback(TCG_EVENT2 const *event, UINT32 type,
+                                   void *data) {
+
+    index_filter *f = data;
+
+    if (!f->emit || !f->emitter_ctx.event2_cb) {
+        return true;
+    }
+
+    return f->emitter_ctx.event2_cb(event, type, f->emitter_ctx.data);
+}
+
+static bool index_replay_event(tpm2_eventlog_index const *index,
+                               tpm2_eventlog_input const *in,
+                               tpm2_eventlog_context *ctx, index_filter *f,
+                               uint32_t n) {
+
+    uint64_t offset = index->events[n].offset;
+    size_t event_size;
+
+    f->event_num = n;
+    return parse_eventlog_event(ctx, in->buf + offset,
+                                index->hdr.log_size - offset,
+                                index->hdr.agile, &event_size);
+}
+
+/* replay the events of the queried PCR's chain from event first on */
+static bool index_replay_chain(tpm2_eventlog_index const *index,
+                               tpm2_eventlog_input const *in,
+                               tpm2_eventlog_context *ctx, index_filter *f,
+                               uint32_t first) {
+
+    size_t count = 0;
+    uint32_t n;
+
+    for (n = index->hdr.pcr_last[f->query->pcr];
+         n != EVENTLOG_INDEX_NO_EVENT && n >= first;
+         n = index->events[n].prev) {
+        count++;
+    }
+
+    uint32_t *chain = calloc(count ? count : 1, sizeof(*chain));
+    if (chain == NULL) {
+        LOG_ERR("oom");
+        return false;
+    }
+
+    size_t i = count;
+    for (n = index->hdr.pcr_last[f->query->pcr]; i > 0;
+         n = index->events[n].prev) {
+        chain[--i] = n;
+    }
+
+    bool ret = true;
+    for (i = 0; i < count && ret; i++) {
+        ret = index_replay_event(index, in, ctx, f, chain[i]);
+    }
+
+    free(chain);
+    return ret;
+}
+
+static bool index_replay(tpm2_eventlog_index const *index,
+                         tpm2_eventlog_input const *in,
+                         tpm2_eventlog_context *ctx, index_filter *f) {
+
+    tpm2_eventlog_index_header const *hdr = &index->hdr;
+    tpm2_eventlog_query const *q = f->query;
+
+    /* the SpecID event is not replayed, hand it to the emitter directly */
+    if (hdr->agile && q->from_event == 0 && !q->has_pcr &&
+        (!q->has_type || q->type == EV_NO_ACTION)) {
+        TCG_EVENT const *event = (TCG_EVENT const *)in->buf;
+        TCG_EVENT_HEADER2 *next;
+
+        if (!specid_event(event, hdr->log_size, &next)) {
+            return false;
+        }
+        f->emitter->set_event_num(f->emitter_ctx.data, 0);
+        if (f->emitter_ctx.specid_cb &&
+            !f->emitter_ctx.specid_cb(event, f->emitter_ctx.data)) {
+            return false;
+        }
+    }
+
+    uint32_t start = q->from_event;
+    if (start < hdr->first_event) {
+        start = hdr->first_event;
+    }
+    if (start > hdr->event_count) {
+        start = hdr->event_count;
+    }
+
+    uint32_t k = (start - hdr->first_event) / hdr->checkpoint_interval;
+    if (k > hdr->checkpoint_count) {
+        k = hdr->checkpoint_count;
+    }
+    if (k > 0) {
+        tpm2_eventlog_pcrs_restore(ctx, &index->checkpoints[(k - 1) *
+                                   tpm2_eventlog_pcrs_size()]);
+    }
+
+    uint32_t first = hdr->first_event + k * hdr->checkpoint_interval;
+    if (q->has_pcr) {
+        return index_replay_chain(index, in, ctx, f, first);
+    }
+
+    for (uint32_t n = first; n < hdr->event_count; n++) {
+        if (!index_replay_event(index, in, ctx, f, n)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool tpm2_eventlog_index_query(tpm2_eventlog_index const *index,
+                               tpm2_eventlog_input const *in,
+                               tpm2_eventlog_query const *query,
+                               tpm2_eventlog_emitter const *emitter) {
+
+    if (query->has_pcr && query->pcr >= TPM2_MAX_PCRS) {
+        LOG_ERR("PCR Index %u is out of bounds for max available PCRS %d",
+                query->pcr, TPM2_MAX_PCRS);
+        return false;
+    }
+
+    tpm2_eventlog_context ctx = { 0 };
+
+    if (!emitter->begin(&ctx)) {
+        return false;
+    }
+
+    index_filter filter = {
+        .emitter_ctx = ctx,
+        .emitter = emitter,
+        .query = query,
+    };
+
+    ctx.data = &filter;
+    ctx.specid_cb = NULL;
+    ctx.event2hdr_cb = filter_event2hdr_callback;
+    ctx.log_eventhdr_cb = filter_log_eventhdr_callback;
+    ctx.digest2_cb = filter_digest2_callback;
+    ctx.event2_cb = filter_event2_callback;
+
+    bool rc = index_replay(index, in, &ctx, &filter);
+
+    ctx.data = filter.emitter_ctx.data;
+    ctx.specid_cb = filter.emitter_ctx.specid_cb;
+    ctx.event2hdr_cb = filter.emitter_ctx.event2hdr_cb;
+    ctx.log_eventhdr_cb = filter.emitter_ctx.log_eventhdr_cb;
+    ctx.digest2_cb = filter.emitter_ctx.digest2_cb;
+    ctx.event2_cb = filter.emitter_ctx.event2_cb;
+
+    /* other PCRs were not replayed past the checkpoint */
+    if (query->has_pcr) {
+        for (unsigned b = 0; b < TPM2_EVENTLOG_BANK_COUNT; b++) {
+            *tpm2_eventlog_bank_used(&ctx, &tpm2_eventlog_banks[b]) &=
+                (1 << query->pcr);
+        }
+    }
+
+    return emitter->end(&ctx, rc) && rc;
+}
@@ -0,0 +1,106 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+#ifndef TPM2_EVENTLOG_INDEX_H
+#define TPM2_EVENTLOG_INDEX_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "tpm2_eventlog.h"
+#include "tpm2_eventlog_emitter.h"
+#include "tpm2_eventlog_input.h"
+
+#define EVENTLOG_INDEX_MAGIC "TPM2EVIX"
+#define EVENTLOG_INDEX_VERSION 1
+/* events between PCR state checkpoints */
+#define EVENTLOG_INDEX_CHECKPOINT_INTERVAL 1024
+/* terminates the per-PCR event chains */
+#define EVENTLOG_INDEX_NO_EVENT UINT32_MAX
+
+/*
+ * Sidecar index for an event log. It records where each event starts, links
+ * the events extending the same PCR into a chain and keeps a snapshot of
+ * all PCR banks every EVENTLOG_INDEX_CHECKPOINT_INTERVAL events, so queries
+ * only replay from the nearest checkpoint. The index is bound to the log by
+ * its size and SHA-256 and is rebuilt when either changes.
+ *
+ * Event numbers match the EventNum of the output: the SpecID event of a
+ * crypto agile log is event 0 and first_event is 1, SHA1 format logs start
+ * at 0.
+ */
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t agile;
+    uint64_t log_size;
+    uint8_t log_sha256[32];
+    uint32_t event_count;
+    uint32_t first_event;
+    uint32_t checkpoint_interval;
+    uint32_t checkpoint_count;
+    /* last event of each PCR chain */
+    uint32_t pcr_last[TPM2_MAX_PCRS];
+} tpm2_eventlog_index_header;
+
+typedef struct {
+    uint64_t offset;      /* of the event in the log */
+    uint32_t pcr;
+    uint32_t type;
+    uint32_t prev;        /* previous event extending the same PCR */
+    uint32_t reserved;
+} tpm2_eventlog_index_event;
+
+typedef struct {
+    tpm2_eventlog_index_header hdr;
+    tpm2_eventlog_index_event *events;
+    size_t events_size;   /* allocated entries */
+    /*
+     * checkpoint k (from 1) is the PCR state before event
+     * first_event + k * checkpoint_interval, the state before first_event
+     * is all zero and not stored
+     */
+    uint8_t *checkpoints;
+} tpm2_eventlog_index;
+
+/* which events a query renders, all when nothing is set */
+typedef struct {
+    uint32_t from_event;
+    bool has_pcr;
+    uint32_t pcr;
+    bool has_type;
+    uint32_t type;
+} tpm2_eventlog_query;
+
+/**
+ * Walk a mapped log and build its index.
+ * @return
+ *  true on success, false on error.
+ */
+bool tpm2_eventlog_index_build(tpm2_eventlog_index *index,
+                               tpm2_eventlog_input *in);
+
+/**
+ * Load an index from path and check that it belongs to the mapped log in.
+ * @return
+ *  true if the index is present and current, false otherwise.
+ */
+bool tpm2_eventlog_index_load(tpm2_eventlog_index *index, char const *path,
+                              tpm2_eventlog_input const *in);
+
+bool tpm2_eventlog_index_save(tpm2_eventlog_index const *index,
+                              char const *path);
+
+void tpm2_eventlog_index_free(tpm2_eventlog_index *index);
+
+/**
+ * Render the events selected by query with emitter, followed by the PCR
+ * values at the end of the log. With a PCR filter only that PCR's chain is
+ * replayed and only its values are reported.
+ * @return
+ *  true on success, false on error.
+ */
+bool tpm2_eventlog_index_query(tpm2_eventlog_index const *index,
+                               tpm2_eventlog_input const *in,
+                               tpm2_eventlog_query const *query,
+                               tpm2_eventlog_emitter const *emitter);
+
+#endif
@@ -0,0 +1,208 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "log.h"
+#include "tpm2_eventlog_input.h"
+
+static bool input_map(tpm2_eventlog_input *in, size_t size) {
+
+    void *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, in->fd, 0);
+    if (map == MAP_FAILED) {
+        return false;
+    }
+    madvise(map, size, MADV_SEQUENTIAL);
+
+    in->mapped = true;
+    in->eof = true;
+    in->buf = map;
+    in->buf_size = size;
+    in->end = size;
+    return true;
+}
+
+/* open path, streaming through window if one is passed in */
+static bool input_open(tpm2_eventlog_input *in, const char *path, bool stream,
+                       UINT8 *window, size_t window_size) {
+
+    struct stat s;
+
+    memset(in, 0, sizeof(*in));
+
+    if (!strcmp(path, "-")) {
+        in->fd = STDIN_FILENO;
+    } else {
+        in->fd = open(path, O_RDONLY);
+        if (in->fd < 0) {
+            LOG_ERR("failed to open file: %s error: %s", path, strerror(errno));
+            free(window);
+            return false;
+        }
+    }
+
+    if (fstat(in->fd, &s)) {
+        LOG_ERR("failed to stat file: %s error: %s", path, strerror(errno));
+        free(window);
+        tpm2_eventlog_input_close(in);
+        return false;
+    }
+
+    /* pseudo-files report a size of 0 and must be streamed */
+    if (!stream && S_ISREG(s.st_mode) && s.st_size > 0 &&
+        input_map(in, s.st_size)) {
+        /* kept for the next reopen rather than freed */
+        in->spare = window;
+        in->spare_size = window_size;
+        return true;
+    }
+
+    if (window) {
+        in->buf = window;
+        in->buf_size = in->peak_window = window_size;
+        return true;
+    }
+
+    in->buf = malloc(EVENTLOG_INPUT_WINDOW_SIZE);
+    if (!in->buf) {
+        LOG_ERR("failed to allocate input window: %s", strerror(errno));
+        tpm2_eventlog_input_close(in);
+        return false;
+    }
+    in->buf_size = in->peak_window = EVENTLOG_INPUT_WINDOW_SIZE;
+
+    return true;
+}
+
+bool tpm2_eventlog_input_open(tpm2_eventlog_input *in, const char *path,
+                              bool stream) {
+
+    return input_open(in, path, stream, NULL, 0);
+}
+
+bool tpm2_eventlog_input_reopen(tpm2_eventlog_input *in, const char *path,
+                                bool stream) {
+
+    UINT8 *window = in->spare;
+    size_t window_size = in->spare_size;
+
+    if (!in->mapped && in->fd >= 0 && in->buf) {
+        window = in->buf;
+        window_size = in->buf_size;
+        in->buf = NULL;
+    }
+    in->spare = NULL;
+    tpm2_eventlog_input_close(in);
+
+    return input_open(in, path, stream, window, window_size);
+}
+
+void tpm2_eventlog_input_from_buffer(tpm2_eventlog_input *in,
+                                     UINT8 const *buf, size_t size) {
+
+    memset(in, 0, sizeof(*in));
+    in->fd = -1;
+    in->eof = true;
+    in->buf = (UINT8 *)buf;
+    in->buf_size = in->end = size;
+}
+
+void tpm2_eventlog_input_close(tpm2_eventlog_input *in) {
+
+    if (in->mapped) {
+        munmap(in->buf, in->buf_size);
+    } else if (in->fd >= 0) {
+        free(in->buf);
+    }
+
+    if (in->fd > STDIN_FILENO) {
+        close(in->fd);
+    }
+
+    free(in->spare);
+
+    in->fd = -1;
+    in->buf = NULL;
+    in->spare = NULL;
+    in->mapped = false;
+}
+
+/*
+ * Slide the unconsumed bytes to the start of the window, growing it if the
+ * requested size does not fit, then read until size bytes are buffered or
+ * the source is exhausted.
+ */
+static bool input_fill(tpm2_eventlog_input *in, size_t size) {
+
+    if (size > EVENTLOG_INPUT_WINDOW_MAX) {
+        LOG_ERR("event of %zu bytes exceeds input window limit", size);
+        return false;
+    }
+
+    if (in->start > 0) {
+        memmove(in->buf, in->buf + in->start, in->end - in->start);
+        in->end -= in->start;
+        in->start = 0;
+    }
+
+    if (size > in->buf_size) {
+        size_t new_size = in->buf_size;
+        while (new_size < size) {
+            new_size *= 2;
+        }
+        UINT8 *tmp = realloc(in->buf, new_size);
+        if (!tmp) {
+            LOG_ERR("failed to grow input window: %s", strerror(errno));
+            return false;
+        }
+        in->buf = tmp;
+        in->buf_size = new_size;
+        if (new_size > in->peak_window) {
+            in->peak_window = new_size;
+        }
+    }
+
+    while (in->end < size) {
+        ssize_t n = read(in->fd, in->buf + in->end, in->buf_size - in->end);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            LOG_ERR("failed to read event log: %s", strerror(errno));
+            return false;
+        }
+        if (n == 0) {
+            in->eof = true;
+            break;
+        }
+        in->end += n;
+    }
+
+    return true;
+}
+
+bool tpm2_eventlog_input_peek(tpm2_eventlog_input *in, size_t size,
+                              UINT8 const **data, size_t *avail) {
+
+    if (in->end - in->start < size && !in->eof) {
+        if (!input_fill(in, size)) {
+            return false;
+        }
+    }
+
+    *data = in->buf + in->start;
+    *avail = in->end - in->start;
+    return true;
+}
+
+void tpm2_eventlog_input_consume(tpm2_eventlog_input *in, size_t size) {
+
+    if (in->md_ctx) {
+        EVP_DigestUpdate(in->md_ctx, in->buf + in->start, size);
+    }
+    in->start += size;
+    in->offset += size;
+}
@@ -0,0 +1,89 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+#ifndef TPM2_EVENTLOG_INPUT_H
+#define TPM2_EVENTLOG_INPUT_H
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include <openssl/evp.h>
+
+#include "tss2_tpm2_types.h"
+
+/* initial size of the streaming window, grown only for oversized events */
+#define EVENTLOG_INPUT_WINDOW_SIZE (64 * 1024)
+/* upper bound on the streaming window, i.e. on a single event */
+#define EVENTLOG_INPUT_WINDOW_MAX (16 * 1024 * 1024)
+
+/*
+ * Event log input source. Regular files with a known size are mapped and
+ * parsed in place. Anything else (pipes, stdin, securityfs pseudo-files that
+ * report a size of 0) is read through a bounded window that only ever holds
+ * the event currently being parsed plus read-ahead.
+ */
+typedef struct {
+    int fd;
+    bool mapped;
+    bool eof;
+    UINT8 *buf;           /* mapping or streaming window */
+    size_t buf_size;      /* mapping length or window capacity */
+    size_t start;         /* cursor offset within buf */
+    size_t end;           /* valid bytes within buf */
+    size_t offset;        /* absolute offset of the cursor in the log */
+    size_t events;        /* events consumed so far */
+    size_t peak_window;   /* largest window capacity used */
+    EVP_MD_CTX *md_ctx;   /* when set, consumed bytes are hashed into it */
+    UINT8 *spare;         /* streaming window kept across a mapped reopen */
+    size_t spare_size;
+} tpm2_eventlog_input;
+
+/**
+ * Open an event log for parsing.
+ * @param in
+ *  The input to initialize.
+ * @param path
+ *  The file to open, "-" for stdin.
+ * @param stream
+ *  Force the streaming path even if the file could be mapped.
+ * @return
+ *  true on success, false on error.
+ */
+bool tpm2_eventlog_input_open(tpm2_eventlog_input *in, const char *path,
+                              bool stream);
+
+/**
+ * Close in and open path, reusing the streaming window of in if it had
+ * one. in must have been opened before, even if that failed, or have its
+ * fd set to -1 and everything else zeroed.
+ * @return
+ *  true on success, false on error.
+ */
+bool tpm2_eventlog_input_reopen(tpm2_eventlog_input *in, const char *path,
+                                bool stream);
+
+/**
+ * Wrap a caller owned memory buffer. Nothing is released on close.
+ */
+void tpm2_eventlog_input_from_buffer(tpm2_eventlog_input *in,
+                                     UINT8 const *buf, size_t size);
+
+void tpm2_eventlog_input_close(tpm2_eventlog_input *in);
+
+/**
+ * Make up to size bytes at the cursor available without consuming them.
+ * @param data
+ *  Set to the bytes at the cursor.
+ * @param avail
+ *  Set to the number of bytes available, less than size only at EOF.
+ * @return
+ *  true on success, false on read error or if size exceeds the window limit.
+ */
+bool tpm2_eventlog_input_peek(tpm2_eventlog_input *in, size_t size,
+                              UINT8 const **data, size_t *avail);
+
+/**
+ * Advance the cursor past size bytes previously returned by peek, adding
+ * them to md_ctx if set.
+ */
+void tpm2_eventlog_input_consume(tpm2_eventlog_input *in, size_t size);
+
+#endif
@@ -0,0 +1,139 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "tpm2_eventlog_doc.h"
+#include "tpm2_tool_output.h"
+
+/* emit the separator owed before a value or key at the current depth */
+static void json_separator(tpm2_eventlog_doc *doc) {
+
+    if (doc->after_key) {
+        doc->after_key = false;
+        return;
+    }
+
+    if (!doc->first[doc->depth]) {
+        tpm2_tool_output_write(",", 1);
+    }
+    doc->first[doc->depth] = false;
+}
+
+static void json_open(tpm2_eventlog_doc *doc, char c) {
+
+    json_separator(doc);
+    tpm2_tool_output_write(&c, 1);
+    if (doc->depth < TPM2_EVENTLOG_DOC_DEPTH_MAX - 1) {
+        doc->depth++;
+    }
+    doc->first[doc->depth] = true;
+}
+
+static void json_close(tpm2_eventlog_doc *doc, char c) {
+
+    tpm2_tool_output_write(&c, 1);
+    if (doc->depth > 0) {
+        doc->depth--;
+    }
+}
+
+static void json_map_begin(tpm2_eventlog_doc *doc) {
+    json_open(doc, '{');
+}
+
+static void json_map_end(tpm2_eventlog_doc *doc) {
+    json_close(doc, '}');
+}
+
+static void json_list_begin(tpm2_eventlog_doc *doc) {
+    json_open(doc, '[');
+}
+
+static void json_list_end(tpm2_eventlog_doc *doc) {
+    json_close(doc, ']');
+}
+
+static void json_quoted(char const *str, size_t len) {
+
+    static const char hex_digits[] = "0123456789abcdef";
+    size_t run = 0;
+
+    tpm2_tool_output_write("\"", 1);
+    for (size_t i = 0; i < len; ++i) {
+        unsigned char c = str[i];
+        if (c >= 0x20 && c != '"' && c != '\\') {
+            continue;
+        }
+
+        /* write the clean run before the character needing an escape */
+        tpm2_tool_output_write(&str[run], i - run);
+        run = i + 1;
+        if (c == '"' || c == '\\') {
+            char esc[2] = { '\\', c };
+            tpm2_tool_output_write(esc, sizeof(esc));
+        } else {
+            char esc[6] = { '\\', 'u', '0', '0',
+                            hex_digits[c >> 4], hex_digits[c & 0xf] };
+            tpm2_tool_output_write(esc, sizeof(esc));
+        }
+    }
+    tpm2_tool_output_write(&str[run], len - run);
+    tpm2_tool_output_write("\"", 1);
+}
+
+static void json_key(tpm2_eventlog_doc *doc, char const *key) {
+
+    json_separator(doc);
+    json_quoted(key, strlen(key));
+    tpm2_tool_output_write(":", 1);
+    doc->after_key = true;
+}
+
+static void json_uint(tpm2_eventlog_doc *doc, uint64_t value) {
+
+    char buf[24];
+
+    json_separator(doc);
+    int n = snprintf(buf, sizeof(buf), "%" PRIu64, value);
+    tpm2_tool_output_write(buf, n);
+}
+
+/* JSON has no byte strings, use lower case hex like the YAML output */
+static void json_bytes(tpm2_eventlog_doc *doc, uint8_t const *buf, size_t size) {
+
+    json_separator(doc);
+    tpm2_tool_output_write("\"", 1);
+    tpm2_tool_output_hex(buf, size);
+    tpm2_tool_output_write("\"", 1);
+}
+
+/* JSON text must be UTF-8, anything else goes out as hex */
+static void json_string(tpm2_eventlog_doc *doc, char const *str, size_t len) {
+
+    if (!tpm2_eventlog_doc_utf8(str, len)) {
+        json_bytes(doc, (uint8_t const *)str, len);
+        return;
+    }
+
+    json_separator(doc);
+    json_quoted(str, len);
+}
+
+static void json_finish(tpm2_eventlog_doc *doc) {
+
+    (void)doc;
+    tpm2_tool_output_write("\n", 1);
+}
+
+tpm2_eventlog_doc_ops const tpm2_eventlog_json_ops = {
+    .map_begin = json_map_begin,
+    .map_end = json_map_end,
+    .list_begin = json_list_begin,
+    .list_end = json_list_end,
+    .key = json_key,
+    .string = json_string,
+    .uint = json_uint,
+    .bytes = json_bytes,
+    .finish = json_finish,
+};
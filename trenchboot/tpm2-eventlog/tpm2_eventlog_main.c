@@ -0,0 +1,304 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <sys/resource.h>
+
+#include "log.h"
+#include "tpm2_eventlog.h"
+#include "tpm2_eventlog_batch.h"
+#include "tpm2_eventlog_emitter.h"
+#include "tpm2_eventlog_index.h"
+#include "tpm2_eventlog_input.h"
+#include "tpm2_eventlog_resume.h"
+#include "tpm2_eventlog_verify.h"
+#include "tpm2_eventlog_yaml.h"
+#include "tpm2_openssl.h"
+#include "tpm2_tool_output.h"
+#include "tpm2_util.h"
+
+static void usage(void)
+{
+    printf("Usage: tpm2_eventlog [options] <evtlog-file>\n"
+           "       tpm2_eventlog --batch [options] [<evtlog-file|dir|->...]\n"
+           "  -s, --stream   parse through a bounded read window instead of\n"
+           "                 mapping the file (implied for pipes and\n"
+           "                 pseudo-files)\n"
+           "  -S, --stats    report throughput and peak RSS on stderr\n"
+           "  -j, --jobs N   replay the PCR banks on N threads\n"
+           "  -f, --format F output format: yaml (default), json or cbor\n"
+           "  -i, --index F  answer from the index in F, (re)building it\n"
+           "                 when missing or stale\n"
+           "  -e, --from-event N\n"
+           "                 with --index, only events from N on\n"
+           "  -p, --pcr N    with --index, only events extending PCR N\n"
+           "  -t, --type T   with --index, only events of type T\n"
+           "  -r, --resume F only the events appended since the run that\n"
+           "                 saved F, replaying in full if the log was\n"
+           "                 truncated or rewritten; F is then updated\n"
+           "  -b, --batch    replay many logs on --jobs threads and report\n"
+           "                 their PCRs; a directory adds the files in it,\n"
+           "                 - or no argument reads paths from stdin\n"
+           "  -V, --verify F check the PCRs against the expected values in F,\n"
+           "                 a \"pcrs\" section as printed by this tool, and\n"
+           "                 report where the log first diverges\n"
+           "Use - as the file to read the log from stdin.\n");
+}
+
+/* use the index at path, rebuilding it if needed, to answer query */
+static bool index_eventlog(tpm2_eventlog_input *in, char const *path,
+                           tpm2_eventlog_query const *query,
+                           tpm2_eventlog_emitter const *emitter) {
+
+    tpm2_eventlog_index index;
+
+    if (!in->mapped) {
+        LOG_ERR("--index requires a regular file");
+        return false;
+    }
+
+    if (!tpm2_eventlog_index_load(&index, path, in)) {
+        LOG_INFO("building index %s", path);
+        if (!tpm2_eventlog_index_build(&index, in)) {
+            return false;
+        }
+        if (!tpm2_eventlog_index_save(&index, path)) {
+            tpm2_eventlog_index_free(&index);
+            return false;
+        }
+    }
+
+    bool rc = tpm2_eventlog_index_query(&index, in, query, emitter);
+    tpm2_eventlog_index_free(&index);
+    return rc;
+}
+
+/* check the log against the golden PCR values at path */
+static bool verify_eventlog(tpm2_eventlog_input *in, char const *path,
+                            bool *pass) {
+
+    tpm2_eventlog_verify verify;
+
+    if (!tpm2_eventlog_verify_load(&verify, path)) {
+        return false;
+    }
+
+    bool rc = tpm2_eventlog_verify_run(&verify, in, pass);
+    tpm2_eventlog_verify_free(&verify);
+    return rc;
+}
+
+static int batch_eventlogs(int count, char *paths[], unsigned jobs,
+                           bool stream) {
+
+    tpm2_eventlog_batch_list list = { 0 };
+    size_t failed = 0;
+    bool ret = true;
+
+    if (count == 0) {
+        ret = tpm2_eventlog_batch_add(&list, "-");
+    }
+    for (int i = 0; ret && i < count; ++i) {
+        ret = tpm2_eventlog_batch_add(&list, paths[i]);
+    }
+
+    if (ret) {
+        ret = tpm2_eventlog_batch_run(&list, jobs, stream, &failed);
+    }
+
+    tpm2_tool_output_flush();
+    tpm2_eventlog_batch_list_free(&list);
+
+    return ret && failed == 0 ? 0 : 1;
+}
+
+static double elapsed_seconds(struct timespec const *start) {
+
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) +
+           (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static void print_input_stats(tpm2_eventlog_input const *in, double secs) {
+
+    struct rusage ru;
+
+    getrusage(RUSAGE_SELF, &ru);
+
+    if (secs <= 0) {
+        secs = 1e-9;
+    }
+
+    fprintf(stderr, "stats:\n"
+                    "  input: %s\n"
+                    "  bytes: %zu\n"
+                    "  events: %zu\n"
+                    "  seconds: %.6f\n"
+                    "  MB/sec: %.2f\n"
+                    "  events/sec: %.0f\n"
+                    "  window_bytes: %zu\n"
+                    "  peak_rss_kb: %ld\n",
+                    in->mapped ? "mmap" : "stream",
+                    in->offset, in->events, secs,
+                    in->offset / secs / (1024 * 1024),
+                    in->events / secs,
+                    in->mapped ? in->buf_size : in->peak_window,
+                    ru.ru_maxrss);
+}
+
+int main(int argc, char *argv[])
+{
+    static const struct option long_options[] = {
+        { "stream", no_argument, NULL, 's' },
+        { "stats",  no_argument, NULL, 'S' },
+        { "jobs",   required_argument, NULL, 'j' },
+        { "format", required_argument, NULL, 'f' },
+        { "index",  required_argument, NULL, 'i' },
+        { "from-event", required_argument, NULL, 'e' },
+        { "pcr",    required_argument, NULL, 'p' },
+        { "type",   required_argument, NULL, 't' },
+        { "resume", required_argument, NULL, 'r' },
+        { "batch",  no_argument, NULL, 'b' },
+        { "verify", required_argument, NULL, 'V' },
+        { "help",   no_argument, NULL, 'h' },
+        { NULL,     0,           NULL, 0   },
+    };
+    tpm2_eventlog_emitter const *emitter = &yaml_emitter;
+    tpm2_eventlog_query query = { 0 };
+    tpm2_eventlog_input in;
+    struct timespec start;
+    char const *index_path = NULL, *resume_path = NULL, *verify_path = NULL;
+    bool stream = false, stats = false, filtered = false, batch = false;
+    bool pass = true;
+    uint32_t jobs = 1;
+    int c, r = 0;
+
+    while ((c = getopt_long(argc, argv, "sSj:f:i:e:p:t:r:bV:h", long_options, NULL)) != -1) {
+        switch (c) {
+        case 's':
+            stream = true;
+            break;
+        case 'S':
+            stats = true;
+            break;
+        case 'j':
+            if (!tpm2_util_string_to_uint32(optarg, &jobs) || jobs == 0) {
+                LOG_ERR("invalid job count: %s", optarg);
+                return 1;
+            }
+            break;
+        case 'f':
+            emitter = tpm2_eventlog_emitter_find(optarg);
+            if (!emitter) {
+                LOG_ERR("unknown output format: %s", optarg);
+                return 1;
+            }
+            break;
+        case 'i':
+            index_path = optarg;
+            break;
+        case 'r':
+            resume_path = optarg;
+            break;
+        case 'b':
+            batch = true;
+            break;
+        case 'V':
+            verify_path = optarg;
+            break;
+        case 'e':
+            if (!tpm2_util_string_to_uint32(optarg, &query.from_event)) {
+                LOG_ERR("invalid event number: %s", optarg);
+                return 1;
+            }
+            filtered = true;
+            break;
+        case 'p':
+            if (!tpm2_util_string_to_uint32(optarg, &query.pcr) ||
+                query.pcr >= TPM2_MAX_PCRS) {
+                LOG_ERR("invalid PCR index: %s", optarg);
+                return 1;
+            }
+            query.has_pcr = filtered = true;
+            break;
+        case 't':
+            if (!eventtype_from_string(optarg, &query.type)) {
+                LOG_ERR("invalid event type: %s", optarg);
+                return 1;
+            }
+            query.has_type = filtered = true;
+            break;
+        default:
+            usage();
+            return 1;
+        }
+    }
+
+    if (batch) {
+        if (index_path || resume_path || verify_path || filtered ||
+            emitter != &yaml_emitter) {
+            LOG_ERR("--batch only supports --stream, --jobs and yaml output");
+            return 1;
+        }
+        return batch_eventlogs(argc - optind, &argv[optind], jobs, stream);
+    }
+
+    if (optind >= argc) {
+        usage();
+        return 1;
+    }
+
+    if (filtered && !index_path) {
+        LOG_ERR("--from-event, --pcr and --type require --index");
+        return 1;
+    }
+
+    if (index_path && resume_path) {
+        LOG_ERR("--index and --resume are exclusive");
+        return 1;
+    }
+
+    if (verify_path && (index_path || resume_path || jobs > 1 ||
+                        emitter != &yaml_emitter)) {
+        LOG_ERR("--verify only supports --stream and yaml output");
+        return 1;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    if (!tpm2_openssl_hash_cache_init()) {
+        return 1;
+    }
+
+    if (!tpm2_eventlog_input_open(&in, argv[optind], stream)) {
+        tpm2_openssl_hash_cache_teardown();
+        return 1;
+    }
+
+    if (verify_path) {
+        if (!verify_eventlog(&in, verify_path, &pass) || !pass)
+            r = 1;
+    } else if (index_path) {
+        if (!index_eventlog(&in, index_path, &query, emitter))
+            r = 1;
+    } else if (resume_path) {
+        if (!tpm2_eventlog_resume(&in, argv[optind], stream, resume_path,
+                                  emitter, jobs))
+            r = 1;
+    } else if (!tpm2_eventlog_emit(emitter, &in, jobs))
+        r = 1;
+
+    tpm2_tool_output_flush();
+
+    if (stats) {
+        print_input_stats(&in, elapsed_seconds(&start));
+    }
+
+    tpm2_eventlog_input_close(&in);
+    tpm2_openssl_hash_cache_teardown();
+
+    return r;
+}
@@ -0,0 +1,239 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+#include <errno.h>
+#include <pthread.h>
+#include <string.h>
+
+#include "log.h"
+#include "tpm2_eventlog.h"
+#include "tpm2_eventlog_replay.h"
+#include "tpm2_openssl.h"
+
+typedef struct {
+    unsigned bank_index;
+    unsigned pcr_index;
+    uint8_t *digests;
+    size_t count;
+    size_t capacity;
+} replay_chain;
+
+struct tpm2_eventlog_replay {
+    tpm2_eventlog_context *ctx;
+    unsigned jobs;
+    pthread_t *threads;
+    unsigned nthreads;
+    pthread_mutex_t lock;
+    pthread_cond_t work_cond;
+    pthread_cond_t done_cond;
+    replay_chain chains[TPM2_EVENTLOG_BANK_COUNT][TPM2_MAX_PCRS];
+    replay_chain *pending[TPM2_EVENTLOG_BANK_COUNT * TPM2_MAX_PCRS];
+    size_t npending;
+    size_t next;
+    size_t finished;
+    size_t queued_bytes;
+    bool failed;
+    bool stop;
+};
+
+static bool replay_chain_run(tpm2_eventlog_replay *replay, replay_chain *chain) {
+
+    tpm2_eventlog_bank const *bank = &tpm2_eventlog_banks[chain->bank_index];
+    uint8_t *pcr = tpm2_eventlog_bank_pcr(replay->ctx, bank, chain->pcr_index);
+
+    for (size_t i = 0; i < chain->count; ++i) {
+        if (!tpm2_openssl_pcr_extend(bank->alg, pcr,
+                                     chain->digests + i * bank->digest_size,
+                                     bank->digest_size)) {
+            LOG_ERR("PCR%d extend failed", chain->pcr_index);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static void *replay_worker(void *arg) {
+
+    tpm2_eventlog_replay *replay = arg;
+
+    /* the digest cache is per thread */
+    bool cached = tpm2_openssl_hash_cache_init();
+
+    pthread_mutex_lock(&replay->lock);
+    for (;;) {
+        while (!replay->stop && replay->next >= replay->npending) {
+            pthread_cond_wait(&replay->work_cond, &replay->lock);
+        }
+        if (replay->stop) {
+            break;
+        }
+
+        replay_chain *chain = replay->pending[replay->next++];
+        pthread_mutex_unlock(&replay->lock);
+
+        bool ok = replay_chain_run(replay, chain);
+
+        pthread_mutex_lock(&replay->lock);
+        if (!ok) {
+            replay->failed = true;
+        }
+        if (++replay->finished == replay->npending) {
+            pthread_cond_signal(&replay->done_cond);
+        }
+    }
+    pthread_mutex_unlock(&replay->lock);
+
+    if (cached) {
+        tpm2_openssl_hash_cache_teardown();
+    }
+
+    return NULL;
+}
+
+tpm2_eventlog_replay *tpm2_eventlog_replay_new(tpm2_eventlog_context *ctx,
+                                               unsigned jobs) {
+
+    tpm2_eventlog_replay *replay = calloc(1, sizeof(*replay));
+    if (!replay) {
+        LOG_ERR("failed to allocate replay engine: %s", strerror(errno));
+        return NULL;
+    }
+
+    replay->ctx = ctx;
+    replay->jobs = jobs ? jobs : 1;
+
+    for (unsigned b = 0; b < TPM2_EVENTLOG_BANK_COUNT; ++b) {
+        for (unsigned p = 0; p < TPM2_MAX_PCRS; ++p) {
+            replay->chains[b][p].bank_index = b;
+            replay->chains[b][p].pcr_index = p;
+        }
+    }
+
+    pthread_mutex_init(&replay->lock, NULL);
+    pthread_cond_init(&replay->work_cond, NULL);
+    pthread_cond_init(&replay->done_cond, NULL);
+
+    if (replay->jobs == 1) {
+        return replay;
+    }
+
+    replay->threads = calloc(replay->jobs, sizeof(*replay->threads));
+    if (!replay->threads) {
+        LOG_ERR("failed to allocate replay threads: %s", strerror(errno));
+        tpm2_eventlog_replay_free(replay);
+        return NULL;
+    }
+
+    for (; replay->nthreads < replay->jobs; ++replay->nthreads) {
+        int rc = pthread_create(&replay->threads[replay->nthreads], NULL,
+                                replay_worker, replay);
+        if (rc) {
+            LOG_ERR("failed to start replay thread: %s", strerror(rc));
+            tpm2_eventlog_replay_free(replay);
+            return NULL;
+        }
+    }
+
+    return replay;
+}
+
+bool tpm2_eventlog_replay_queue(tpm2_eventlog_replay *replay,
+                                unsigned bank_index, unsigned pcr_index,
+                                uint8_t const *digest) {
+
+    replay_chain *chain = &replay->chains[bank_index][pcr_index];
+    size_t digest_size = tpm2_eventlog_banks[bank_index].digest_size;
+
+    if (chain->count == chain->capacity) {
+        size_t capacity = chain->capacity ? chain->capacity * 2 : 64;
+        uint8_t *tmp = realloc(chain->digests, capacity * digest_size);
+        if (!tmp) {
+            LOG_ERR("failed to grow replay queue: %s", strerror(errno));
+            return false;
+        }
+        chain->digests = tmp;
+        chain->capacity = capacity;
+    }
+
+    /* the digest may live in a streaming window that is about to move */
+    memcpy(chain->digests + chain->count * digest_size, digest, digest_size);
+    chain->count++;
+    replay->queued_bytes += digest_size;
+
+    if (replay->queued_bytes >= EVENTLOG_REPLAY_FLUSH_BYTES) {
+        return tpm2_eventlog_replay_flush(replay);
+    }
+
+    return true;
+}
+
+bool tpm2_eventlog_replay_flush(tpm2_eventlog_replay *replay) {
+
+    bool ret = true;
+
+    pthread_mutex_lock(&replay->lock);
+
+    replay->npending = replay->next = replay->finished = 0;
+    for (unsigned b = 0; b < TPM2_EVENTLOG_BANK_COUNT; ++b) {
+        for (unsigned p = 0; p < TPM2_MAX_PCRS; ++p) {
+            if (replay->chains[b][p].count) {
+                replay->pending[replay->npending++] = &replay->chains[b][p];
+            }
+        }
+    }
+
+    if (replay->nthreads == 0) {
+        for (size_t i = 0; i < replay->npending; ++i) {
+            if (!replay_chain_run(replay, replay->pending[i])) {
+                replay->failed = true;
+                break;
+            }
+        }
+    } else if (replay->npending) {
+        pthread_cond_broadcast(&replay->work_cond);
+        while (replay->finished < replay->npending) {
+            pthread_cond_wait(&replay->done_cond, &replay->lock);
+        }
+    }
+
+    for (size_t i = 0; i < replay->npending; ++i) {
+        replay->pending[i]->count = 0;
+    }
+    replay->npending = replay->next = 0;
+    replay->queued_bytes = 0;
+
+    if (replay->failed) {
+        ret = false;
+    }
+
+    pthread_mutex_unlock(&replay->lock);
+
+    return ret;
+}
+
+void tpm2_eventlog_replay_free(tpm2_eventlog_replay *replay) {
+
+    if (!replay) {
+        return;
+    }
+
+    pthread_mutex_lock(&replay->lock);
+    replay->stop = true;
+    pthread_cond_broadcast(&replay->work_cond);
+    pthread_mutex_unlock(&replay->lock);
+
+    for (unsigned i = 0; i < replay->nthreads; ++i) {
+        pthread_join(replay->threads[i], NULL);
+    }
+    free(replay->threads);
+
+    for (unsigned b = 0; b < TPM2_EVENTLOG_BANK_COUNT; ++b) {
+        for (unsigned p = 0; p < TPM2_MAX_PCRS; ++p) {
+            free(replay->chains[b][p].digests);
+        }
+    }
+
+    pthread_cond_destroy(&replay->work_cond);
+    pthread_cond_destroy(&replay->done_cond);
+    pthread_mutex_destroy(&replay->lock);
+    free(replay);
+}
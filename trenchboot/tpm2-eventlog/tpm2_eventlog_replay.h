@@ -0,0 +1,49 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+#ifndef TPM2_EVENTLOG_REPLAY_H
+#define TPM2_EVENTLOG_REPLAY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "tpm2_eventlog.h"
+
+/* queued digest bytes that trigger a replay pass */
+#define EVENTLOG_REPLAY_FLUSH_BYTES (4 * 1024 * 1024)
+
+/*
+ * Parallel PCR replay. Digests are queued per bank and PCR while the log is
+ * walked, then each (bank, PCR) chain is extended in order by one of a pool
+ * of worker threads. Chains are independent, so the result is identical to
+ * the serial replay regardless of scheduling.
+ */
+
+/**
+ * Create a replay engine writing into the PCR arrays of ctx.
+ * @param jobs
+ *  Number of worker threads, 1 replays on the calling thread.
+ * @return
+ *  The engine or NULL on error.
+ */
+tpm2_eventlog_replay *tpm2_eventlog_replay_new(tpm2_eventlog_context *ctx,
+                                               unsigned jobs);
+
+/**
+ * Queue an extend of PCR pcr_index in bank bank_index with digest. May run a
+ * replay pass when enough digests are pending.
+ * @return
+ *  true on success, false if queueing or a replay pass failed.
+ */
+bool tpm2_eventlog_replay_queue(tpm2_eventlog_replay *replay,
+                                unsigned bank_index, unsigned pcr_index,
+                                uint8_t const *digest);
+
+/**
+ * Replay everything queued so far and wait for completion.
+ * @return
+ *  true on success, false if any extend failed.
+ */
+bool tpm2_eventlog_replay_flush(tpm2_eventlog_replay *replay);
+
+void tpm2_eventlog_replay_free(tpm2_eventlog_replay *replay);
+
+#endif
@@ -0,0 +1,223 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "log.h"
+#include "tpm2_eventlog.h"
+#include "tpm2_eventlog_replay.h"
+#include "tpm2_eventlog_resume.h"
+
+static bool state_load(char const *path, tpm2_eventlog_resume_state *state,
+                       uint8_t *pcrs) {
+
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        return false;
+    }
+
+    bool ok = fread(state, sizeof(*state), 1, f) == 1 &&
+              fread(pcrs, tpm2_eventlog_pcrs_size(), 1, f) == 1 &&
+              !memcmp(state->magic, EVENTLOG_RESUME_MAGIC,
+                      sizeof(state->magic)) &&
+              state->version == EVENTLOG_RESUME_VERSION;
+
+    fclose(f);
+    return ok;
+}
+
+/* written aside and renamed so an interrupted run leaves the old state */
+static bool state_save(char const *path,
+                       tpm2_eventlog_resume_state const *state,
+                       uint8_t const *pcrs) {
+
+    size_t len = strlen(path) + sizeof(".tmp");
+    char *tmp = malloc(len);
+    if (tmp == NULL) {
+        LOG_ERR("oom");
+        return false;
+    }
+    snprintf(tmp, len, "%s.tmp", path);
+
+    FILE *f = fopen(tmp, "wb");
+    if (f == NULL) {
+        LOG_ERR("could not open \"%s\": %s", tmp, strerror(errno));
+        free(tmp);
+        return false;
+    }
+
+    bool ok = fwrite(state, sizeof(*state), 1, f) == 1 &&
+              fwrite(pcrs, tpm2_eventlog_pcrs_size(), 1, f) == 1;
+    ok = fclose(f) == 0 && ok;
+
+    if (!ok || rename(tmp, path) != 0) {
+        LOG_ERR("could not write resume state \"%s\"", path);
+        remove(tmp);
+        free(tmp);
+        return false;
+    }
+
+    free(tmp);
+    return true;
+}
+
+/*
+ * Consume the prefix recorded in state and check it hashes to the same
+ * value. match is false if the log is now shorter or the bytes differ.
+ */
+static bool prefix_check(tpm2_eventlog_input *in,
+                         tpm2_eventlog_resume_state const *state,
+                         bool *match) {
+
+    uint8_t digest[sizeof(state->prefix_sha256)];
+    uint64_t remaining = state->offset;
+
+    *match = false;
+
+    while (remaining > 0) {
+        size_t chunk = remaining < EVENTLOG_INPUT_WINDOW_SIZE ?
+                       remaining : EVENTLOG_INPUT_WINDOW_SIZE;
+        UINT8 const *data;
+        size_t avail;
+
+        if (!tpm2_eventlog_input_peek(in, chunk, &data, &avail)) {
+            return false;
+        }
+        if (avail == 0) {
+            return true;
+        }
+        if (avail > chunk) {
+            avail = chunk;
+        }
+        tpm2_eventlog_input_consume(in, avail);
+        remaining -= avail;
+    }
+
+    EVP_MD_CTX *check = EVP_MD_CTX_new();
+    if (check == NULL || !EVP_MD_CTX_copy_ex(check, in->md_ctx) ||
+        !EVP_DigestFinal_ex(check, digest, NULL)) {
+        LOG_ERR("failed to hash event log prefix");
+        EVP_MD_CTX_free(check);
+        return false;
+    }
+    EVP_MD_CTX_free(check);
+
+    *match = !memcmp(digest, state->prefix_sha256, sizeof(digest));
+    return true;
+}
+
+/* crypto agile logs start with the SpecID event */
+static bool input_is_agile(tpm2_eventlog_input *in) {
+
+    UINT8 const *data;
+    size_t avail;
+
+    return tpm2_eventlog_input_peek(in, sizeof(TCG_EVENT), &data, &avail) &&
+           avail >= sizeof(TCG_EVENT) &&
+           ((TCG_EVENT const *)data)->eventType == EV_NO_ACTION;
+}
+
+/*
+ * Walk and render from the input cursor, starting from the PCR state in
+ * pcrs when resumed. On success state and pcrs describe the end of the log.
+ */
+static bool resume_emit(tpm2_eventlog_input *in,
+                        tpm2_eventlog_emitter const *emitter, unsigned jobs,
+                        bool resumed, tpm2_eventlog_resume_state *state,
+                        uint8_t *pcrs) {
+
+    tpm2_eventlog_context ctx = { 0 };
+
+    if (!resumed) {
+        state->agile = input_is_agile(in);
+    }
+
+    if (!emitter->begin(&ctx)) {
+        return false;
+    }
+
+    if (resumed) {
+        tpm2_eventlog_pcrs_restore(&ctx, pcrs);
+        emitter->set_event_num(ctx.data, state->events);
+        in->events = state->events;
+    }
+
+    if (jobs > 1) {
+        ctx.replay = tpm2_eventlog_replay_new(&ctx, jobs);
+        if (!ctx.replay) {
+            emitter->end(&ctx, false);
+            return false;
+        }
+    }
+
+    bool rc = resumed ? parse_eventlog_input_resume(&ctx, in, state->agile) :
+                        parse_eventlog_input(&ctx, in);
+    tpm2_eventlog_replay_free(ctx.replay);
+    ctx.replay = NULL;
+
+    if (rc) {
+        state->offset = in->offset;
+        state->events = in->events;
+        tpm2_eventlog_pcrs_save(&ctx, pcrs);
+        if (!EVP_DigestFinal_ex(in->md_ctx, state->prefix_sha256, NULL)) {
+            LOG_ERR("failed to hash event log");
+            rc = false;
+        }
+    }
+
+    return emitter->end(&ctx, rc) && rc;
+}
+
+bool tpm2_eventlog_resume(tpm2_eventlog_input *in, char const *path,
+                          bool stream, char const *state_path,
+                          tpm2_eventlog_emitter const *emitter, unsigned jobs) {
+
+    tpm2_eventlog_resume_state state;
+    bool resumed = false, rc = false;
+
+    uint8_t *pcrs = calloc(1, tpm2_eventlog_pcrs_size());
+    EVP_MD_CTX *md_ctx = EVP_MD_CTX_new();
+    if (pcrs == NULL || md_ctx == NULL ||
+        !EVP_DigestInit_ex(md_ctx, EVP_sha256(), NULL)) {
+        LOG_ERR("oom");
+        goto out;
+    }
+    in->md_ctx = md_ctx;
+
+    if (state_load(state_path, &state, pcrs)) {
+        if (!prefix_check(in, &state, &resumed)) {
+            goto out;
+        }
+        if (!resumed) {
+            LOG_WARN("event log was truncated or rewritten, replaying it in full");
+        }
+    }
+
+    if (!resumed && in->offset > 0) {
+        if (!strcmp(path, "-")) {
+            LOG_ERR("cannot replay stdin in full after reading part of it");
+            goto out;
+        }
+        tpm2_eventlog_input_close(in);
+        if (!tpm2_eventlog_input_open(in, path, stream) ||
+            !EVP_DigestInit_ex(md_ctx, EVP_sha256(), NULL)) {
+            goto out;
+        }
+        in->md_ctx = md_ctx;
+    }
+
+    if (!resumed) {
+        memset(&state, 0, sizeof(state));
+        memcpy(state.magic, EVENTLOG_RESUME_MAGIC, sizeof(state.magic));
+        state.version = EVENTLOG_RESUME_VERSION;
+    }
+
+    rc = resume_emit(in, emitter, jobs, resumed, &state, pcrs) &&
+         state_save(state_path, &state, pcrs);
+
+out:
+    in->md_ctx = NULL;
+    EVP_MD_CTX_free(md_ctx);
+    free(pcrs);
+    return rc;
+}
@@ -0,0 +1,44 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+#ifndef TPM2_EVENTLOG_RESUME_H
+#define TPM2_EVENTLOG_RESUME_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "tpm2_eventlog_emitter.h"
+#include "tpm2_eventlog_input.h"
+
+#define EVENTLOG_RESUME_MAGIC "TPM2EVRS"
+#define EVENTLOG_RESUME_VERSION 1
+
+/*
+ * Where a previous run stopped in a growing log: the number of bytes and
+ * events consumed, a SHA-256 over those bytes to recognise the same prefix
+ * again, and the PCR state after the last event. Followed on disk by
+ * tpm2_eventlog_pcrs_size() bytes of PCR state.
+ */
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t agile;
+    uint64_t offset;
+    uint64_t events;
+    uint8_t prefix_sha256[32];
+} tpm2_eventlog_resume_state;
+
+/**
+ * Render only the events appended to the log since the run that saved
+ * state_path, then save the new position. When there is no usable state,
+ * or the consumed prefix was truncated or rewritten, the whole log is
+ * replayed and rendered instead.
+ * @param in
+ *  The open log, reopened from path and stream if a full replay is needed
+ *  after part of it was read.
+ * @return
+ *  true on success, false on error.
+ */
+bool tpm2_eventlog_resume(tpm2_eventlog_input *in, char const *path,
+                          bool stream, char const *state_path,
+                          tpm2_eventlog_emitter const *emitter, unsigned jobs);
+
+#endif
@@ -0,0 +1,325 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+#include <ctype.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "log.h"
+#include "tpm2_eventlog_verify.h"
+#include "tpm2_tool_output.h"
+#include "tpm2_util.h"
+
+static bool verify_add(tpm2_eventlog_verify *verify, int bank_index,
+                       unsigned pcr_index, char const *hex) {
+
+    tpm2_eventlog_bank const *bank = &tpm2_eventlog_banks[bank_index];
+    tpm2_eventlog_verify_pcr *p = &verify->pcrs[bank_index][pcr_index];
+    BYTE value[TPM2_SHA512_DIGEST_SIZE];
+    UINT16 size = sizeof(value);
+
+    if (!strncmp(hex, "0x", 2)) {
+        hex += 2;
+    }
+
+    if (tpm2_util_hex_to_byte_structure(hex, &size, value) != 0 ||
+        size != bank->digest_size) {
+        LOG_ERR("bad %s value for PCR%u: %s", bank->name, pcr_index, hex);
+        return false;
+    }
+
+    uint8_t *values = realloc(p->values, (p->count + 1) * bank->digest_size);
+    if (!values) {
+        LOG_ERR("oom");
+        return false;
+    }
+    memcpy(values + p->count * bank->digest_size, value, bank->digest_size);
+    p->values = values;
+
+    if (p->count++ == 0) {
+        verify->pending++;
+    }
+
+    return true;
+}
+
+/* parse a "    17 : 0x..." line of the current bank */
+static bool verify_parse_pcr(tpm2_eventlog_verify *verify, int bank_index,
+                             char *line) {
+
+    char *end;
+
+    errno = 0;
+    unsigned long pcr_index = strtoul(line, &end, 10);
+    if (errno || end == line || pcr_index >= TPM2_MAX_PCRS) {
+        LOG_ERR("bad PCR line: %s", line);
+        return false;
+    }
+
+    while (isspace((unsigned char)*end)) {
+        end++;
+    }
+    if (*end++ != ':') {
+        LOG_ERR("bad PCR line: %s", line);
+        return false;
+    }
+    while (isspace((unsigned char)*end)) {
+        end++;
+    }
+
+    return verify_add(verify, bank_index, pcr_index, end);
+}
+
+bool tpm2_eventlog_verify_load(tpm2_eventlog_verify *verify, char const *path) {
+
+    char *line = NULL;
+    size_t size = 0;
+    ssize_t len;
+    bool in_pcrs = false, ret = true;
+    int bank_index = -1;
+
+    memset(verify, 0, sizeof(*verify));
+
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        LOG_ERR("failed to open file: %s error: %s", path, strerror(errno));
+        return false;
+    }
+
+    while (ret && (len = getline(&line, &size, f)) != -1) {
+        while (len > 0 && isspace((unsigned char)line[len - 1])) {
+            line[--len] = '\0';
+        }
+
+        char *s = line;
+        while (isspace((unsigned char)*s)) {
+            s++;
+        }
+        if (*s == '\0') {
+            continue;
+        }
+
+        if (!strcmp(s, "pcrs:")) {
+            in_pcrs = true;
+            bank_index = -1;
+            continue;
+        }
+
+        /* any other top level key ends the section */
+        if (s == line) {
+            in_pcrs = false;
+            continue;
+        }
+
+        if (!in_pcrs) {
+            continue;
+        }
+
+        if (s[strlen(s) - 1] == ':') {
+            s[strlen(s) - 1] = '\0';
+            bank_index = -1;
+            for (int b = 0; b < TPM2_EVENTLOG_BANK_COUNT; b++) {
+                if (!strcmp(s, tpm2_eventlog_banks[b].name)) {
+                    bank_index = b;
+                }
+            }
+            if (bank_index < 0) {
+                LOG_ERR("unknown PCR bank: %s", s);
+                ret = false;
+            }
+            continue;
+        }
+
+        if (bank_index < 0) {
+            LOG_ERR("PCR value outside of a bank: %s", s);
+            ret = false;
+            continue;
+        }
+
+        ret = verify_parse_pcr(verify, bank_index, s);
+    }
+
+    free(line);
+    fclose(f);
+
+    if (ret && verify->pending == 0) {
+        LOG_ERR("no expected PCR values in %s", path);
+        ret = false;
+    }
+
+    if (!ret) {
+        tpm2_eventlog_verify_free(verify);
+    }
+
+    return ret;
+}
+
+void tpm2_eventlog_verify_free(tpm2_eventlog_verify *verify) {
+
+    for (unsigned b = 0; b < TPM2_EVENTLOG_BANK_COUNT; b++) {
+        for (unsigned i = 0; i < TPM2_MAX_PCRS; i++) {
+            free(verify->pcrs[b][i].values);
+            verify->pcrs[b][i].values = NULL;
+            verify->pcrs[b][i].count = 0;
+        }
+    }
+}
+
+typedef struct {
+    tpm2_eventlog_verify *verify;
+    tpm2_eventlog_context *ctx;
+} verify_walk;
+
+static bool verify_specid_callback(TCG_EVENT const *event, void *data) {
+
+    verify_walk *w = data;
+
+    (void)event;
+
+    /* the SpecID event is event 0 */
+    w->verify->event = 1;
+    return true;
+}
+
+static bool verify_event2_callback(TCG_EVENT2 const *event, UINT32 type,
+                                   void *data) {
+
+    verify_walk *w = data;
+
+    (void)event;
+    (void)type;
+
+    w->verify->event++;
+    return true;
+}
+
+static void verify_decide(verify_walk *w, tpm2_eventlog_verify_pcr *p,
+                          tpm2_eventlog_verify_status status) {
+
+    p->status = status;
+    if (--w->verify->pending == 0) {
+        w->ctx->done = true;
+    }
+}
+
+static bool verify_pcr_extend_callback(unsigned bank_index, unsigned pcr_index,
+                                       uint8_t const *pcr, void *data) {
+
+    verify_walk *w = data;
+    tpm2_eventlog_verify_pcr *p = &w->verify->pcrs[bank_index][pcr_index];
+    size_t digest_size = tpm2_eventlog_banks[bank_index].digest_size;
+
+    if (p->count == 0 || p->status != VERIFY_PENDING) {
+        return true;
+    }
+
+    size_t k = p->extends++;
+    p->event = w->verify->event;
+    memcpy(p->actual, pcr, digest_size);
+
+    /* a lone value may be reached after any extend */
+    if (p->count == 1) {
+        if (!memcmp(pcr, p->values, digest_size)) {
+            verify_decide(w, p, VERIFY_MATCH);
+        }
+        return true;
+    }
+
+    if (memcmp(pcr, p->values + k * digest_size, digest_size)) {
+        verify_decide(w, p, VERIFY_DIVERGED);
+    } else if (k == p->count - 1) {
+        verify_decide(w, p, VERIFY_MATCH);
+    }
+
+    return true;
+}
+
+static char const *verify_status_str(tpm2_eventlog_verify_status status) {
+
+    switch (status) {
+    case VERIFY_MATCH:
+        return "match";
+    case VERIFY_DIVERGED:
+        return "diverged";
+    case VERIFY_MISMATCH:
+        return "mismatch";
+    default:
+        return "pending";
+    }
+}
+
+static void verify_output_pcr(tpm2_eventlog_bank const *bank,
+                              unsigned pcr_index,
+                              tpm2_eventlog_verify_pcr const *p) {
+
+    tpm2_tool_output("  - bank: %s\n"
+                     "    pcr: %u\n"
+                     "    status: %s\n"
+                     "    extends: %zu\n",
+                     bank->name, pcr_index, verify_status_str(p->status),
+                     p->extends);
+
+    if (p->extends) {
+        tpm2_tool_output("    event: %zu\n", p->event);
+    }
+
+    if (p->status == VERIFY_MATCH) {
+        return;
+    }
+
+    /* the value that was due when the PCR was decided */
+    size_t k = p->status == VERIFY_DIVERGED ? p->extends - 1 : p->count - 1;
+    tpm2_tool_output("    expected: 0x");
+    tpm2_tool_output_hex(p->values + k * bank->digest_size, bank->digest_size);
+    tpm2_tool_output_write("\n", 1);
+
+    if (p->extends) {
+        tpm2_tool_output("    actual: 0x");
+        tpm2_tool_output_hex(p->actual, bank->digest_size);
+        tpm2_tool_output_write("\n", 1);
+    }
+}
+
+bool tpm2_eventlog_verify_run(tpm2_eventlog_verify *verify,
+                              tpm2_eventlog_input *in, bool *pass) {
+
+    tpm2_eventlog_context ctx = { 0 };
+    verify_walk w = {
+        .verify = verify,
+        .ctx = &ctx,
+    };
+
+    ctx.data = &w;
+    ctx.specid_cb = verify_specid_callback;
+    ctx.event2_cb = verify_event2_callback;
+    ctx.pcr_extend_cb = verify_pcr_extend_callback;
+
+    if (!parse_eventlog_input(&ctx, in)) {
+        return false;
+    }
+
+    *pass = true;
+    tpm2_tool_output("---\n"
+                     "verify:\n");
+    for (unsigned b = 0; b < TPM2_EVENTLOG_BANK_COUNT; b++) {
+        for (unsigned i = 0; i < TPM2_MAX_PCRS; i++) {
+            tpm2_eventlog_verify_pcr *p = &verify->pcrs[b][i];
+            if (p->count == 0) {
+                continue;
+            }
+            if (p->status == VERIFY_PENDING) {
+                p->status = VERIFY_MISMATCH;
+            }
+            if (p->status != VERIFY_MATCH) {
+                *pass = false;
+            }
+            verify_output_pcr(&tpm2_eventlog_banks[b], i, p);
+        }
+    }
+
+    tpm2_tool_output("events: %zu\n"
+                     "result: %s\n",
+                     in->events, *pass ? "pass" : "fail");
+
+    return true;
+}
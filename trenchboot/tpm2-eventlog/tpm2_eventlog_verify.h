@@ -0,0 +1,61 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+#ifndef TPM2_EVENTLOG_VERIFY_H
+#define TPM2_EVENTLOG_VERIFY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "tpm2_eventlog.h"
+#include "tpm2_eventlog_input.h"
+
+typedef enum {
+    VERIFY_PENDING,     /* not decided yet */
+    VERIFY_MATCH,       /* reached the last expected value */
+    VERIFY_DIVERGED,    /* an extend produced a value other than expected */
+    VERIFY_MISMATCH,    /* log ended without reaching the expected value */
+} tpm2_eventlog_verify_status;
+
+/*
+ * Expected values for one PCR of one bank. A single value is the value at
+ * the end of the log or at the time of a quote; several are the values
+ * expected after each extend in turn, so a divergence is pinned to the
+ * extend that caused it.
+ */
+typedef struct {
+    uint8_t *values;
+    size_t count;
+    size_t extends;     /* extends replayed so far */
+    tpm2_eventlog_verify_status status;
+    size_t event;       /* deciding event, or last extending event */
+    uint8_t actual[TPM2_SHA512_DIGEST_SIZE];
+} tpm2_eventlog_verify_pcr;
+
+typedef struct {
+    tpm2_eventlog_verify_pcr pcrs[TPM2_EVENTLOG_BANK_COUNT][TPM2_MAX_PCRS];
+    unsigned pending;   /* PCRs with expected values not decided yet */
+    size_t event;       /* event being replayed */
+} tpm2_eventlog_verify;
+
+/**
+ * Load expected PCR values in the format of the "pcrs" section printed by
+ * tpm2_eventlog, e.g. the output of a run over a golden log. Repeating a
+ * PCR line gives the values after each of its extends.
+ * @return
+ *  true on success, false on error.
+ */
+bool tpm2_eventlog_verify_load(tpm2_eventlog_verify *verify, char const *path);
+
+void tpm2_eventlog_verify_free(tpm2_eventlog_verify *verify);
+
+/**
+ * Replay the log, checking every extend of a PCR with expected values, and
+ * stop as soon as all of them are decided. Prints a YAML report.
+ * @param pass
+ *  Set when every PCR with expected values matched.
+ * @return
+ *  true if the log was verified, false on error.
+ */
+bool tpm2_eventlog_verify_run(tpm2_eventlog_verify *verify,
+                              tpm2_eventlog_input *in, bool *pass);
+
+#endif
@@ -4,7 +4,6 @@
 #include <stdlib.h>
 #include <string.h>
 #include <uchar.h>
-#include <sys/stat.h>
 #include <unistd.h>
 
 #include "tss2_tpm2_types.h"
@@ -13,7 +12,10 @@
 #include "efi_event.h"
 #include "tpm2_alg_util.h"
 #include "tpm2_eventlog.h"
+#include "tpm2_eventlog_emitter.h"
+#include "tpm2_eventlog_input.h"
 #include "tpm2_eventlog_yaml.h"
+#include "tpm2_openssl.h"
 #include "tpm2_tool.h"
 #include "tpm2_tool_output.h"
 
@@ -82,14 +84,45 @@ char const *eventtype_to_string (UINT32 event_type) {
         return "Unknown event type";
     }
 }
-void bytes_to_str(uint8_t const *buf, size_t size, char *dest, size_t dest_size) {
+/* inverse of eventtype_to_string for the event types it knows */
+bool eventtype_from_string(char const *str, UINT32 *event_type) {
+
+    for (UINT32 type = EV_PREBOOT_CERT; type <= EV_OMIT_BOOT_DEVICE_EVENTS; ++type) {
+        if (!strcmp(str, eventtype_to_string(type))) {
+            *event_type = type;
+            return true;
+        }
+    }
+
+    for (UINT32 type = EV_EFI_VARIABLE_DRIVER_CONFIG;
+         type <= (EV_EFI_VARIABLE_AUTHORITY); ++type) {
+        char const *name = eventtype_to_string(type);
+        if (strncmp(name, "EV_", 3)) {
+            continue;
+        }
+        if (!strcmp(str, name)) {
+            *event_type = type;
+            return true;
+        }
+    }
 
-    size_t i, j;
+    return tpm2_util_string_to_uint32(str, event_type);
+}
+void bytes_to_str(uint8_t const *buf, size_t size, char *dest, size_t dest_size) {
 
-    for(i = 0, j = 0; i < size && j < dest_size - 2; ++i, j+=2) {
-        sprintf(&dest[j], "%02x", buf[i]);
+    if (size > (dest_size - 1) / 2) {
+        size = (dest_size - 1) / 2;
     }
-    dest[j] = '\0';
+
+    tpm2_tool_output_hex_encode(buf, size, dest);
+    dest[size * 2] = '\0';
+}
+/* print a quoted hex string followed by a newline */
+static void yaml_hex_line(uint8_t const *buf, size_t size) {
+
+    tpm2_tool_output_write("\"", 1);
+    tpm2_tool_output_hex(buf, size);
+    tpm2_tool_output_write("\"\n", 2);
 }
 void yaml_event2hdr(TCG_EVENT_HEADER2 const *eventhdr, size_t size) {
 
@@ -115,22 +148,20 @@ void yaml_sha1_log_eventhdr(TCG_EVENT const *eventhdr, size_t size) {
 
     return;
 }
-/* converting byte buffer to hex string requires 2x, plus 1 for '\0' */
-#define BYTES_TO_HEX_STRING_SIZE(byte_count) (byte_count * 2 + 1)
-#define DIGEST_HEX_STRING_MAX BYTES_TO_HEX_STRING_SIZE(TPM2_MAX_DIGEST_BUFFER)
 bool yaml_digest2(TCG_DIGEST2 const *digest, size_t size) {
 
-    char hexstr[DIGEST_HEX_STRING_MAX] = { 0, };
-    bytes_to_str(digest->Digest, size, hexstr, sizeof(hexstr));
+    if (size > TPM2_MAX_DIGEST_BUFFER) {
+        size = TPM2_MAX_DIGEST_BUFFER;
+    }
 
     tpm2_tool_output("      - AlgorithmId: %s\n"
-                     "        Digest: \"%s\"\n",
-                     tpm2_alg_util_algtostr(digest->AlgorithmId, tpm2_alg_util_flags_hash),
-                     hexstr);
+                     "        Digest: ",
+                     tpm2_alg_util_algtostr(digest->AlgorithmId, tpm2_alg_util_flags_hash));
+    yaml_hex_line(digest->Digest, size);
 
     return true;
 }
-bool yaml_uefi_var_unicodename(UEFI_VARIABLE_DATA *data) {
+char *uefi_var_unicodename_str(UEFI_VARIABLE_DATA *data) {
 
     int ret = 0;
     char *mbstr = NULL, *tmp = NULL;
@@ -141,7 +172,7 @@ bool yaml_uefi_var_unicodename(UEFI_VARIABLE_DATA *data) {
     mbstr = tmp = calloc(data->UnicodeNameLength + 1, MB_CUR_MAX);
     if (mbstr == NULL) {
         LOG_ERR("failed to allocate data: %s\n", strerror(errno));
-        return false;
+        return NULL;
     }
 
     for(size_t i = 0; i < data->UnicodeNameLength; ++i, tmp += ret) {
@@ -149,33 +180,35 @@ bool yaml_uefi_var_unicodename(UEFI_VARIABLE_DATA *data) {
         if (ret < 0) {
             LOG_ERR("c16rtomb failed: %s", strerror(errno));
             free(mbstr);
-            return false;
+            return NULL;
         }
     }
+
+    return mbstr;
+}
+bool yaml_uefi_var_unicodename(UEFI_VARIABLE_DATA *data) {
+
+    char *mbstr = uefi_var_unicodename_str(data);
+    if (mbstr == NULL) {
+        return false;
+    }
+
     tpm2_tool_output("      UnicodeName: %s\n", mbstr);
     free(mbstr);
 
     return true;
 }
-#define VAR_DATA_HEX_SIZE(data) BYTES_TO_HEX_STRING_SIZE(data->VariableDataLength)
 static bool yaml_uefi_var_data(UEFI_VARIABLE_DATA *data) {
 
     if (data->VariableDataLength == 0) {
         return true;
     }
 
-    char *var_data = calloc (1, VAR_DATA_HEX_SIZE(data));
     uint8_t *variable_data = (uint8_t*)&data->UnicodeName[
         data->UnicodeNameLength];
-    if (var_data == NULL) {
-        LOG_ERR("failled to allocate data: %s\n", strerror(errno));
-        return false;
-    }
-    bytes_to_str(variable_data, data->VariableDataLength, var_data,
-                 VAR_DATA_HEX_SIZE(data));
 
-    tpm2_tool_output("      VariableData: \"%s\"\n", var_data);
-    free(var_data);
+    tpm2_tool_output("      VariableData: ");
+    yaml_hex_line(variable_data, data->VariableDataLength);
 
     return true;
 }
@@ -248,13 +281,6 @@ bool yaml_uefi_action(UINT8 const *action, size_t size) {
 /* TCG PC Client PFP section 9.2.3 */
 bool yaml_uefi_image_load(UEFI_IMAGE_LOAD_EVENT *data, size_t size) {
 
-    size_t devpath_len = (size - sizeof(*data)) * 2 + 1;
-    char *buf = calloc (1, devpath_len);
-    if (!buf) {
-        LOG_ERR("failed to allocate memory: %s\n", strerror(errno));
-        return false;
-    }
-
     tpm2_tool_output("    Event:\n"
                      "      ImageLocationInMemory: 0x%" PRIx64 "\n"
                      "      ImageLengthInMemory: %" PRIu64 "\n"
@@ -263,17 +289,13 @@ bool yaml_uefi_image_load(UEFI_IMAGE_LOAD_EVENT *data, size_t size) {
                      data->ImageLocationInMemory, data->ImageLengthInMemory,
                      data->ImageLinkTimeAddress, data->LengthOfDevicePath);
 
-    bytes_to_str(data->DevicePath, size - sizeof(*data), buf, devpath_len);
-    tpm2_tool_output("      DevicePath: \"%s\"\n", buf);
+    tpm2_tool_output("      DevicePath: ");
+    yaml_hex_line(data->DevicePath, size - sizeof(*data));
 
-    free(buf);
     return true;
 }
-#define EVENT_BUF_MAX BYTES_TO_HEX_STRING_SIZE(1024)
 bool yaml_event2data(TCG_EVENT2 const *event, UINT32 type) {
 
-    char hexstr[EVENT_BUF_MAX] = { 0, };
-
     tpm2_tool_output("    EventSize: %" PRIu32 "\n", event->EventSize);
 
     if (event->EventSize == 0) {
@@ -298,8 +320,9 @@ bool yaml_event2data(TCG_EVENT2 const *event, UINT32 type) {
         return yaml_uefi_image_load((UEFI_IMAGE_LOAD_EVENT*)event->Event,
                                     event->EventSize);
     default:
-        bytes_to_str(event->Event, event->EventSize, hexstr, sizeof(hexstr));
-        tpm2_tool_output("    Event: \"%s\"\n", hexstr);
+        tpm2_tool_output("    Event: ");
+        yaml_hex_line(event->Event, event->EventSize < EVENT_DATA_MAX ?
+                      event->EventSize : EVENT_DATA_MAX);
         return true;
     }
 }
@@ -342,31 +365,24 @@ bool yaml_sha1_log_eventhdr_callback(TCG_EVENT const *eventhdr, size_t size,
 
     yaml_sha1_log_eventhdr(eventhdr, size);
 
-    char hexstr[BYTES_TO_HEX_STRING_SIZE(sizeof(eventhdr->digest))] = { 0, };
-    bytes_to_str(eventhdr->digest, sizeof(eventhdr->digest), hexstr, sizeof(hexstr));
-
     tpm2_tool_output("    DigestCount: 1\n"
                      "    Digests:\n"
                      "      - AlgorithmId: %s\n"
-                     "        Digest: \"%s\"\n",
-                     tpm2_alg_util_algtostr(TPM2_ALG_SHA1, tpm2_alg_util_flags_hash),
-                     hexstr);
+                     "        Digest: ",
+                     tpm2_alg_util_algtostr(TPM2_ALG_SHA1, tpm2_alg_util_flags_hash));
+    yaml_hex_line(eventhdr->digest, sizeof(eventhdr->digest));
     return true;
 }
 void yaml_eventhdr(TCG_EVENT const *event, size_t *count) {
 
-    /* digest is 20 bytes, 2 chars / byte and null terminator for string*/
-    char digest_hex[2*sizeof(event->digest) + 1] = {};
-    bytes_to_str(event->digest, sizeof(event->digest), digest_hex, sizeof(digest_hex));
-
     tpm2_tool_output("  - EventNum: %zu\n"
                      "    PCRIndex: %" PRIu32 "\n"
                      "    EventType: %s\n"
-                     "    Digest: \"%s\"\n"
-                     "    EventSize: %" PRIu32 "\n",
+                     "    Digest: ",
                      (*count)++, event->pcrIndex,
-                     eventtype_to_string(event->eventType), digest_hex,
-                     event->eventDataSize);
+                     eventtype_to_string(event->eventType));
+    yaml_hex_line(event->digest, sizeof(event->digest));
+    tpm2_tool_output("    EventSize: %" PRIu32 "\n", event->eventDataSize);
 }
 
 void yaml_specid(TCG_SPECID_EVENT* specid) {
@@ -405,22 +421,12 @@ void yaml_specid_algs(TCG_SPECID_ALG const *alg, size_t count) {
 }
 bool yaml_specid_vendor(TCG_VENDOR_INFO *vendor) {
 
-    char *vendinfo_str;
-
     tpm2_tool_output("        vendorInfoSize: %" PRIu8 "\n", vendor->vendorInfoSize);
     if (vendor->vendorInfoSize == 0) {
         return true;
     }
-    vendinfo_str = calloc(1, vendor->vendorInfoSize * 2 + 1);
-    if (vendinfo_str == NULL) {
-        LOG_ERR("failed to allocate memory for vendorInfo: %s\n",
-                strerror(errno));
-        return false;
-    }
-    bytes_to_str(vendor->vendorInfo, vendor->vendorInfoSize, vendinfo_str,
-                 vendor->vendorInfoSize * 2 + 1);
-    tpm2_tool_output("        vendorInfo: \"%s\"\n", vendinfo_str);
-    free(vendinfo_str);
+    tpm2_tool_output("        vendorInfo: ");
+    yaml_hex_line(vendor->vendorInfo, vendor->vendorInfoSize);
     return true;
 }
 bool yaml_specid_event(TCG_EVENT const *event, size_t *count) {
@@ -440,152 +446,98 @@ bool yaml_specid_callback(TCG_EVENT const *event, void *data) {
     return yaml_specid_event(event, count);
 }
 
-static void yaml_eventlog_pcrs(tpm2_eventlog_context *ctx) {
+static void yaml_eventlog_bank_pcrs(tpm2_eventlog_context *ctx,
+                                    tpm2_eventlog_bank const *bank,
+                                    int indent) {
 
-    char hexstr[DIGEST_HEX_STRING_MAX] = { 0, };
-
-    tpm2_tool_output("pcrs:\n");
-
-    if (ctx->sha1_used != 0) {
-        tpm2_tool_output("  sha1:\n");
-        for(unsigned i = 0 ; i < TPM2_MAX_PCRS ; i++) {
-            if ((ctx->sha1_used & (1 << i)) == 0)
-                continue;
-            bytes_to_str(ctx->sha1_pcrs[i], sizeof(ctx->sha1_pcrs[i]),
-                hexstr, sizeof(hexstr));
-            tpm2_tool_output("    %-2d : 0x%s\n", i, hexstr);
-        }
+    uint32_t used = *tpm2_eventlog_bank_used(ctx, bank);
+    if (used == 0) {
+        return;
     }
 
-    if (ctx->sha256_used != 0) {
-        tpm2_tool_output("  sha256:\n");
-        for(unsigned i = 0 ; i < TPM2_MAX_PCRS ; i++) {
-            if ((ctx->sha256_used & (1 << i)) == 0)
-                continue;
-            bytes_to_str(ctx->sha256_pcrs[i], sizeof(ctx->sha256_pcrs[i]),
-                hexstr, sizeof(hexstr));
-            tpm2_tool_output("    %-2d : 0x%s\n", i, hexstr);
-        }
+    tpm2_tool_output("%*s  %s:\n", indent, "", bank->name);
+    for(unsigned i = 0 ; i < TPM2_MAX_PCRS ; i++) {
+        if ((used & (1 << i)) == 0)
+            continue;
+        tpm2_tool_output("%*s    %-2d : 0x", indent, "", i);
+        tpm2_tool_output_hex(tpm2_eventlog_bank_pcr(ctx, bank, i),
+                             bank->digest_size);
+        tpm2_tool_output_write("\n", 1);
     }
+}
 
-    if (ctx->sha384_used != 0) {
-        tpm2_tool_output("  sha384:\n");
-        for(unsigned i = 0 ; i < TPM2_MAX_PCRS ; i++) {
-            if ((ctx->sha384_used & (1 << i)) == 0)
-                continue;
-            bytes_to_str(ctx->sha384_pcrs[i], sizeof(ctx->sha384_pcrs[i]),
-                hexstr, sizeof(hexstr));
-            tpm2_tool_output("    %-2d : 0x%s\n", i, hexstr);
-        }
-    }
+void yaml_eventlog_pcrs(tpm2_eventlog_context *ctx, int indent) {
 
-    if (ctx->sha512_used != 0) {
-        tpm2_tool_output("  sha512:\n");
-        for(unsigned i = 0 ; i < TPM2_MAX_PCRS ; i++) {
-            if ((ctx->sha512_used & (1 << i)) == 0)
-                continue;
-            bytes_to_str(ctx->sha512_pcrs[i], sizeof(ctx->sha512_pcrs[i]),
-                hexstr, sizeof(hexstr));
-            tpm2_tool_output("    %-2d : 0x%s\n", i, hexstr);
-        }
-    }
+    tpm2_tool_output("%*spcrs:\n", indent, "");
 
-    if (ctx->sm3_256_used != 0) {
-        tpm2_tool_output("  sm3_256:\n");
-        for(unsigned i = 0 ; i < TPM2_MAX_PCRS ; i++) {
-            if ((ctx->sm3_256_used & (1 << i)) == 0)
-                continue;
-            bytes_to_str(ctx->sm3_256_pcrs[i], sizeof(ctx->sm3_256_pcrs[i]),
-                hexstr, sizeof(hexstr));
-            tpm2_tool_output("    %-2d : 0x%s\n", i, hexstr);
-        }
+    for (unsigned b = 0; b < TPM2_EVENTLOG_BANK_COUNT; b++) {
+        yaml_eventlog_bank_pcrs(ctx, &tpm2_eventlog_banks[b], indent);
     }
 }
 
-bool yaml_eventlog(UINT8 const *eventlog, size_t size) {
+static void yaml_eventlog_context_init(tpm2_eventlog_context *ctx,
+                                       size_t *count) {
 
-    size_t count = 0;
-    tpm2_eventlog_context ctx = {
-        .data = &count,
+    *ctx = (tpm2_eventlog_context) {
+        .data = count,
         .specid_cb = yaml_specid_callback,
         .event2hdr_cb = yaml_event2hdr_callback,
         .log_eventhdr_cb = yaml_sha1_log_eventhdr_callback,
         .digest2_cb = yaml_digest2_callback,
         .event2_cb = yaml_event2data_callback,
     };
+}
 
-    tpm2_tool_output("---\n");
-    tpm2_tool_output("events:\n");
-    bool rc = parse_eventlog(&ctx, eventlog, size);
-    if (!rc) {
-        return rc;
+static bool yaml_begin(tpm2_eventlog_context *ctx) {
+
+    size_t *count = calloc(1, sizeof(*count));
+    if (count == NULL) {
+        LOG_ERR("oom");
+        return false;
     }
 
-    yaml_eventlog_pcrs(&ctx);
+    yaml_eventlog_context_init(ctx, count);
+
+    tpm2_tool_output("---\n");
+    tpm2_tool_output("events:\n");
     return true;
 }
 
-void Esys_Free(void *__ptr) {
-    if (__ptr != NULL) {
-        free(__ptr);
+static bool yaml_end(tpm2_eventlog_context *ctx, bool ok) {
+
+    if (ok) {
+        yaml_eventlog_pcrs(ctx, 0);
     }
+    free(ctx->data);
+    return true;
 }
 
-static void usage(void)
-{
-    printf("Usage: tpm2_eventlog <evtlog-file>\n");
-}
+static void yaml_set_event_num(void *data, size_t event_num) {
 
-int main(int argc, char *argv[])
-{
-    FILE *f;
-    struct stat s;
-    UINT8 *b;
-    size_t n;
-    int r = 0;
-
-    if (argc <= 1) {
-        usage();
-        return 1;
-    }
+    *(size_t *)data = event_num;
+}
 
-    if (!strcmp(argv[1], "-h") || !strcmp(argv[1], "--help")) {
-        usage();
-        return 1;
-    }
+tpm2_eventlog_emitter const yaml_emitter = {
+    .name = "yaml",
+    .begin = yaml_begin,
+    .end = yaml_end,
+    .set_event_num = yaml_set_event_num,
+};
 
+bool yaml_eventlog(UINT8 const *eventlog, size_t size) {
 
-    f = fopen(argv[1], "r");
-    if (!f) {
-        printf("Failed to open file: %s error: %d\n",
-               argv[1], errno);
-        return 1;
-    }
+    tpm2_eventlog_context ctx = { 0 };
 
-    if (stat(argv[1], &s)) {
-        printf("Failed to stat file: %s error: %d\n",
-               argv[1], errno);
-        return 1;
+    if (!yaml_begin(&ctx)) {
+        return false;
     }
 
-    b = malloc(s.st_size);
-    if (!b) {
-        printf("Failed to alloc buffer error: %d\n", errno);
-        return 1;
-    }
+    bool rc = parse_eventlog(&ctx, eventlog, size);
+    return yaml_end(&ctx, rc) && rc;
+}
 
-    n = fread(b, 1, s.st_size, f);
-    if (n != s.st_size) {
-        printf("Failed to read file: %sd\n", argv[1]);
-        return 1;
+void Esys_Free(void *__ptr) {
+    if (__ptr != NULL) {
+        free(__ptr);
     }
-
-    fclose(f);
-
-    if (!yaml_eventlog(b, n))
-        r = 1;
-
-    free(b);
-
-    return r;
 }
@@ -9,8 +9,10 @@
 #include "tpm2_eventlog.h"
 
 char const *eventtype_to_string (UINT32 event_type);
+bool eventtype_from_string(char const *str, UINT32 *event_type);
 void yaml_event2hdr(TCG_EVENT_HEADER2 const *event_hdr, size_t size);
 bool yaml_digest2(TCG_DIGEST2 const *digest, size_t size);
+char *uefi_var_unicodename_str(UEFI_VARIABLE_DATA *data);
 bool yaml_uefi_var_unicodename(UEFI_VARIABLE_DATA *data);
 bool yaml_event2data(TCG_EVENT2 const *event, UINT32 type);
 bool yaml_digest2_callback(TCG_DIGEST2 const *digest, size_t size, void *data);
@@ -18,6 +20,9 @@ bool yaml_event2hdr_callback(TCG_EVENT_HEADER2 const *event_hdr, size_t size,
                              void *data);
 bool yaml_event2data_callback(TCG_EVENT2 const *event, UINT32 type, void *data);
 
+/* print the replayed PCR values of ctx as a "pcrs" map, indented by indent */
+void yaml_eventlog_pcrs(tpm2_eventlog_context *ctx, int indent);
+
 bool yaml_eventlog(UINT8 const *eventlog, size_t size);
 
 #endif
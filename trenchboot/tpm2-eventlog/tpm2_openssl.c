@@ -72,6 +72,123 @@ const EVP_MD *tpm2_openssl_halg_from_tpmhalg(TPMI_ALG_HASH algorithm) {
     /* no return, not possible */
 }
 
+/*
+ * Per-thread cache of digest methods and contexts keyed by TPM2_ALG_ID. The
+ * event log replay extends one PCR per digest per event, so creating a
+ * context and resolving the method on every call dominates the run time.
+ * With OpenSSL 3 the methods are explicitly fetched once, avoiding the
+ * implicit provider lookup done by every EVP_DigestInit_ex() otherwise.
+ */
+typedef struct {
+    TPMI_ALG_HASH alg;
+    EVP_MD *md;
+    EVP_MD_CTX *ctx;
+} hash_cache_entry;
+
+static const TPMI_ALG_HASH hash_cache_algs[] = {
+    TPM2_ALG_SHA1,
+    TPM2_ALG_SHA256,
+    TPM2_ALG_SHA384,
+    TPM2_ALG_SHA512,
+};
+
+static __thread hash_cache_entry hash_cache[ARRAY_LEN(hash_cache_algs)];
+static __thread bool hash_cache_ready;
+
+bool tpm2_openssl_hash_cache_init(void) {
+
+    if (hash_cache_ready) {
+        return true;
+    }
+
+    size_t i;
+    for (i = 0; i < ARRAY_LEN(hash_cache_algs); i++) {
+        const EVP_MD *md = tpm2_openssl_halg_from_tpmhalg(hash_cache_algs[i]);
+        hash_cache_entry *e = &hash_cache[i];
+
+        e->alg = hash_cache_algs[i];
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+        e->md = EVP_MD_fetch(NULL, EVP_MD_get0_name(md), NULL);
+#else
+        e->md = (EVP_MD *)md;
+#endif
+        e->ctx = EVP_MD_CTX_create();
+        if (!e->md || !e->ctx) {
+            LOG_ERR("%s", tpm2_openssl_get_err());
+            goto error;
+        }
+    }
+
+    hash_cache_ready = true;
+    return true;
+
+error:
+    hash_cache_ready = true;
+    tpm2_openssl_hash_cache_teardown();
+    return false;
+}
+
+void tpm2_openssl_hash_cache_teardown(void) {
+
+    if (!hash_cache_ready) {
+        return;
+    }
+
+    size_t i;
+    for (i = 0; i < ARRAY_LEN(hash_cache); i++) {
+        hash_cache_entry *e = &hash_cache[i];
+        EVP_MD_CTX_destroy(e->ctx);
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+        EVP_MD_free(e->md);
+#endif
+        memset(e, 0, sizeof(*e));
+    }
+
+    hash_cache_ready = false;
+}
+
+/*
+ * Get a digest context and method for halg, from the cache when it is
+ * initialized and holds halg, freshly allocated otherwise. Contexts must be
+ * returned with hash_ctx_put().
+ */
+static EVP_MD_CTX *hash_ctx_get(TPMI_ALG_HASH halg, const EVP_MD **md) {
+
+    if (hash_cache_ready) {
+        size_t i;
+        for (i = 0; i < ARRAY_LEN(hash_cache); i++) {
+            if (hash_cache[i].alg == halg) {
+                *md = hash_cache[i].md;
+                return hash_cache[i].ctx;
+            }
+        }
+    }
+
+    *md = tpm2_openssl_halg_from_tpmhalg(halg);
+    if (!*md) {
+        return NULL;
+    }
+
+    EVP_MD_CTX *mdctx = EVP_MD_CTX_create();
+    if (!mdctx) {
+        LOG_ERR("%s", tpm2_openssl_get_err());
+    }
+    return mdctx;
+}
+
+static void hash_ctx_put(EVP_MD_CTX *mdctx) {
+
+    size_t i;
+    for (i = 0; hash_cache_ready && i < ARRAY_LEN(hash_cache); i++) {
+        if (hash_cache[i].ctx == mdctx) {
+            /* keep the allocation, the next init resets the state */
+            return;
+        }
+    }
+
+    EVP_MD_CTX_destroy(mdctx);
+}
+
 #if 0
 #if defined(LIB_TPM2_OPENSSL_OPENSSL_PRE11)
 int RSA_set0_key(RSA *r, BIGNUM *n, BIGNUM *e, BIGNUM *d) {
@@ -131,14 +248,9 @@ bool tpm2_openssl_hash_compute_data(TPMI_ALG_HASH halg, BYTE *buffer,
 
     bool result = false;
 
-    const EVP_MD *md = tpm2_openssl_halg_from_tpmhalg(halg);
-    if (!md) {
-        return false;
-    }
-
-    EVP_MD_CTX *mdctx = EVP_MD_CTX_create();
+    const EVP_MD *md;
+    EVP_MD_CTX *mdctx = hash_ctx_get(halg, &md);
     if (!mdctx) {
-        LOG_ERR("%s", tpm2_openssl_get_err());
         return false;
     }
 
@@ -166,7 +278,7 @@ bool tpm2_openssl_hash_compute_data(TPMI_ALG_HASH halg, BYTE *buffer,
     result = true;
 
 out:
-    EVP_MD_CTX_destroy(mdctx);
+    hash_ctx_put(mdctx);
     return result;
 }
 
@@ -175,14 +287,9 @@ bool tpm2_openssl_pcr_extend(TPMI_ALG_HASH halg, BYTE *pcr,
 
     bool result = false;
 
-    const EVP_MD *md = tpm2_openssl_halg_from_tpmhalg(halg);
-    if (!md) {
-        return false;
-    }
-
-    EVP_MD_CTX *mdctx = EVP_MD_CTX_create();
+    const EVP_MD *md;
+    EVP_MD_CTX *mdctx = hash_ctx_get(halg, &md);
     if (!mdctx) {
-        LOG_ERR("%s", tpm2_openssl_get_err());
         return false;
     }
 
@@ -215,7 +322,7 @@ bool tpm2_openssl_pcr_extend(TPMI_ALG_HASH halg, BYTE *pcr,
     result = true;
 
 out:
-    EVP_MD_CTX_destroy(mdctx);
+    hash_ctx_put(mdctx);
     return result;
 }
 
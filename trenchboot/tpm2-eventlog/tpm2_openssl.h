@@ -77,6 +77,22 @@ int tpm2_openssl_halgid_from_tpmhalg(TPMI_ALG_HASH algorithm);
  */
 const EVP_MD *tpm2_openssl_halg_from_tpmhalg(TPMI_ALG_HASH algorithm);
 
+/**
+ * Pre-fetch the digest methods and allocate one reusable digest context per
+ * supported TPM2_ALG_ID for the calling thread.
+ * tpm2_openssl_hash_compute_data() and tpm2_openssl_pcr_extend() use the
+ * cache when it is initialized and allocate per call otherwise.
+ * @return
+ *  true on success, false on error.
+ */
+bool tpm2_openssl_hash_cache_init(void);
+
+/**
+ * Release the calling thread's digest cache set up by
+ * tpm2_openssl_hash_cache_init().
+ */
+void tpm2_openssl_hash_cache_teardown(void);
+
 /**
  * Start an openssl hmac session.
  * @return
@@ -1,3 +1,97 @@
+#include <stdarg.h>
 #include <stdbool.h>
+#include <string.h>
+
+#include "tpm2_tool_output.h"
 
 bool output_enabled = true;
+
+static char output_buf[TPM2_TOOL_OUTPUT_BUF_SIZE];
+static size_t output_len;
+
+static const char hex_digits[] = "0123456789abcdef";
+
+void tpm2_tool_output_flush(void) {
+
+    if (output_len) {
+        fwrite(output_buf, 1, output_len, stdout);
+        output_len = 0;
+    }
+    fflush(stdout);
+}
+
+void tpm2_tool_output_write(const void *data, size_t size) {
+
+    if (!output_enabled) {
+        return;
+    }
+
+    if (size > sizeof(output_buf) - output_len) {
+        tpm2_tool_output_flush();
+        if (size > sizeof(output_buf)) {
+            fwrite(data, 1, size, stdout);
+            return;
+        }
+    }
+
+    memcpy(&output_buf[output_len], data, size);
+    output_len += size;
+}
+
+void tpm2_tool_output_printf(const char *fmt, ...) {
+
+    va_list ap;
+    size_t room = sizeof(output_buf) - output_len;
+
+    va_start(ap, fmt);
+    int n = vsnprintf(&output_buf[output_len], room, fmt, ap);
+    va_end(ap);
+
+    if (n < 0) {
+        return;
+    }
+
+    if ((size_t)n < room) {
+        output_len += n;
+        return;
+    }
+
+    /* did not fit, drain and format again */
+    tpm2_tool_output_flush();
+    va_start(ap, fmt);
+    if ((size_t)n < sizeof(output_buf)) {
+        output_len = vsnprintf(output_buf, sizeof(output_buf), fmt, ap);
+    } else {
+        vfprintf(stdout, fmt, ap);
+    }
+    va_end(ap);
+}
+
+void tpm2_tool_output_hex_encode(const uint8_t *buf, size_t size, char *dest) {
+
+    for (size_t i = 0; i < size; ++i) {
+        *dest++ = hex_digits[buf[i] >> 4];
+        *dest++ = hex_digits[buf[i] & 0xf];
+    }
+}
+
+void tpm2_tool_output_hex(const uint8_t *buf, size_t size) {
+
+    if (!output_enabled) {
+        return;
+    }
+
+    while (size) {
+        size_t room = (sizeof(output_buf) - output_len) / 2;
+        if (room == 0) {
+            tpm2_tool_output_flush();
+            continue;
+        }
+
+        size_t chunk = size < room ? size : room;
+        tpm2_tool_output_hex_encode(buf, chunk, &output_buf[output_len]);
+        output_len += chunk * 2;
+        buf += chunk;
+        size -= chunk;
+    }
+}
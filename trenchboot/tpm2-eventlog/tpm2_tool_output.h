@@ -1,8 +1,13 @@
 #ifndef TPM2_TOOL_OUTPUT_H
 #define TPM2_TOOL_OUTPUT_H
 
+#include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 
+/* output is staged here and written to stdout in blocks of this size */
+#define TPM2_TOOL_OUTPUT_BUF_SIZE (64 * 1024)
+
 extern bool output_enabled;
 
 /**
@@ -12,6 +17,44 @@ extern bool output_enabled;
  */
 #define tpm2_tool_output_disable() (output_enabled = false)
 
+/**
+ * Formats into the output buffer, flushing it first if the result does not
+ * fit. Use tpm2_tool_output() rather than calling this directly.
+ */
+void tpm2_tool_output_printf(const char *fmt, ...)
+    __attribute__((format (printf, 1, 2)));
+
+/**
+ * Appends raw bytes to the output buffer, respecting the quiet option.
+ * @param data
+ *  The bytes to output.
+ * @param size
+ *  The number of bytes.
+ */
+void tpm2_tool_output_write(const void *data, size_t size);
+
+/**
+ * Appends the lower case hex encoding of a byte buffer to the output buffer
+ * without going through printf, respecting the quiet option.
+ * @param buf
+ *  The bytes to encode.
+ * @param size
+ *  The number of bytes.
+ */
+void tpm2_tool_output_hex(const uint8_t *buf, size_t size);
+
+/**
+ * Writes out anything buffered. Must be called before exiting and before
+ * writing to stdout by other means.
+ */
+void tpm2_tool_output_flush(void);
+
+/**
+ * Encodes size bytes of buf as lower case hex into dest, which must hold
+ * 2 * size bytes. No terminator is written.
+ */
+void tpm2_tool_output_hex_encode(const uint8_t *buf, size_t size, char *dest);
+
 /**
  * prints output to stdout respecting the quiet option.
  * Ie when quiet, don't print.
@@ -23,7 +66,7 @@ extern bool output_enabled;
 #define tpm2_tool_output(fmt, ...)                   \
     do {                                        \
         if (output_enabled) {                   \
-            printf(fmt, ##__VA_ARGS__);         \
+            tpm2_tool_output_printf(fmt, ##__VA_ARGS__); \
         }                                       \
     } while (0)
 